@@ -0,0 +1,577 @@
+/**
+ * \file meshgen.cpp
+ * \brief Generates synthetic binary STL meshes for benchmarking.
+ * \author Gregory Gluszek.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <getopt.h>
+
+/**
+ * Mesh shapes that can be generated.
+ */
+enum Shape
+{
+	SHAPE_PLANES, //!< Disconnected tessellated flat patches, each with
+		//!< its own normal.
+	SHAPE_SPHERE, //!< Closed UV sphere. Every triangle is its own face.
+	SHAPE_BOX, //!< Closed box with each side tessellated as a grid.
+	SHAPE_SCAN //!< Box with every vertex jittered, like a noisy 3D scan.
+};
+
+/**
+ * Point in space.
+ */
+struct Vec3
+{
+	float x;
+	float y;
+	float z;
+};
+
+/**
+ * Streams triangles to a binary STL file.
+ */
+class StlWriter
+{
+public:
+	StlWriter(const char* filename, uint32_t numTriangles,
+		const char* description);
+	~StlWriter();
+
+	void write(const Vec3& v0, const Vec3& v1, const Vec3& v2);
+
+	uint32_t getWritten() const { return written; }
+
+private:
+	FILE* file; //!< File triangles are streamed to.
+	uint32_t written; //!< Number of triangles written so far.
+};
+
+/**
+ * Constructor. Opens file and writes header.
+ *
+ * \param[in] filename File to write STL data to.
+ * \param numTriangles Number of triangles that will be written.
+ * \param[in] description Text placed in the 80 byte header.
+ */
+StlWriter::StlWriter(const char* filename, uint32_t numTriangles,
+	const char* description)
+: file(NULL)
+, written(0)
+{
+	char header[80];
+
+	file = fopen(filename, "w");
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open file \"%s\" for writing.\n",
+			filename);
+		exit(EXIT_FAILURE);
+	}
+
+	// Large buffer since we will be streaming up to gigabytes
+	setvbuf(file, NULL, _IOFBF, 1 << 20);
+
+	memset(header, 0, sizeof(header));
+	strncpy(header, description, sizeof(header) - 1);
+
+	if (fwrite(header, 1, sizeof(header), file) != sizeof(header) ||
+		fwrite(&numTriangles, 1, sizeof(numTriangles), file) !=
+		sizeof(numTriangles))
+	{
+		fprintf(stderr, "Failed to write header to \"%s\".\n",
+			filename);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * Destructor. Flushes and closes file.
+ */
+StlWriter::~StlWriter()
+{
+	if (fclose(file))
+	{
+		fprintf(stderr, "Failed to close file after writing data.\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * Write a single triangle, computing its normal from the vertices.
+ *
+ * \param[in] v0 First vertex.
+ * \param[in] v1 Second vertex.
+ * \param[in] v2 Third vertex.
+ *
+ * \return None.
+ */
+void StlWriter::write(const Vec3& v0, const Vec3& v1, const Vec3& v2)
+{
+	// 12 floats followed by 2 byte attribute count
+	uint8_t record[50];
+	float data[12];
+	float ax = v1.x - v0.x, ay = v1.y - v0.y, az = v1.z - v0.z;
+	float bx = v2.x - v0.x, by = v2.y - v0.y, bz = v2.z - v0.z;
+	float nx = ay*bz - az*by;
+	float ny = az*bx - ax*bz;
+	float nz = ax*by - ay*bx;
+	float len = sqrtf(nx*nx + ny*ny + nz*nz);
+
+	if (len > 0)
+	{
+		nx /= len;
+		ny /= len;
+		nz /= len;
+	}
+
+	data[0] = nx; data[1] = ny; data[2] = nz;
+	data[3] = v0.x; data[4] = v0.y; data[5] = v0.z;
+	data[6] = v1.x; data[7] = v1.y; data[8] = v1.z;
+	data[9] = v2.x; data[10] = v2.y; data[11] = v2.z;
+
+	memcpy(record, data, sizeof(data));
+	record[48] = 0;
+	record[49] = 0;
+
+	if (fwrite(record, 1, sizeof(record), file) != sizeof(record))
+	{
+		fprintf(stderr, "Failed to write triangle %u.\n", written);
+		exit(EXIT_FAILURE);
+	}
+
+	written++;
+}
+
+/**
+ * Deterministic pseudo random value in [-1, 1] for an integer lattice point.
+ *  Shared vertices get the same value, so jittered meshes stay closed.
+ *
+ * \param ix Lattice x coordinate.
+ * \param iy Lattice y coordinate.
+ * \param iz Lattice z coordinate.
+ * \param seed Seed mixed into the hash.
+ *
+ * \return Value in [-1, 1].
+ */
+static float latticeNoise(uint32_t ix, uint32_t iy, uint32_t iz, uint32_t seed)
+{
+	uint64_t hash = seed * 0x9E3779B97F4A7C15ull;
+
+	hash ^= ix + 0x632BE59BD9B4E019ull + (hash << 6) + (hash >> 2);
+	hash ^= iy + 0x8CB92BA72F3D8DD7ull + (hash << 6) + (hash >> 2);
+	hash ^= iz + 0xABC98388FB8FAC03ull + (hash << 6) + (hash >> 2);
+	hash ^= hash >> 33;
+	hash *= 0xFF51AFD7ED558CCDull;
+	hash ^= hash >> 33;
+
+	return (float)((double)(hash >> 11) / (double)(1ull << 52) - 1.0);
+}
+
+/**
+ * Write grid tessellated planar patches. Each patch is tilted differently so
+ *  that it forms its own face.
+ *
+ * \param numTriangles Approximate total number of triangles.
+ * \param facesPerPlane Approximate number of triangles in each patch.
+ * \param[in] filename File to write.
+ *
+ * \return None.
+ */
+static void genPlanes(uint32_t numTriangles, uint32_t facesPerPlane,
+	const char* filename)
+{
+	uint32_t cells = (uint32_t)ceil(sqrt(facesPerPlane / 2.0));
+	uint32_t per_plane = 2 * cells * cells;
+	uint32_t num_planes = (numTriangles + per_plane - 1) / per_plane;
+	uint32_t grid = (uint32_t)ceil(sqrt((double)num_planes));
+	StlWriter writer(filename, num_planes * per_plane, "meshgen planes");
+
+	for (uint32_t plane = 0; plane < num_planes; plane++)
+	{
+		// Golden angle spacing of tilts gives every plane a unique normal
+		double tilt = 0.1 + 1.2 * (double)plane / num_planes;
+		double spin = 2.399963 * plane;
+		double ox = 2.0 * (plane % grid);
+		double oy = 2.0 * (plane / grid);
+		double ux = cos(spin), uy = sin(spin);
+		double vx = -sin(spin) * cos(tilt);
+		double vy = cos(spin) * cos(tilt);
+		double vz = sin(tilt);
+
+		for (uint32_t row = 0; row < cells; row++)
+		{
+			for (uint32_t col = 0; col < cells; col++)
+			{
+				Vec3 quad[4];
+
+				for (int corner = 0; corner < 4; corner++)
+				{
+					double u = (double)(col + (corner & 1)) /
+						cells;
+					double v = (double)(row + (corner >> 1)) /
+						cells;
+
+					quad[corner].x = (float)(ox + u*ux + v*vx);
+					quad[corner].y = (float)(oy + u*uy + v*vy);
+					quad[corner].z = (float)(v*vz);
+				}
+
+				writer.write(quad[0], quad[1], quad[3]);
+				writer.write(quad[0], quad[3], quad[2]);
+			}
+		}
+	}
+}
+
+/**
+ * Write closed UV sphere.
+ *
+ * \param numTriangles Approximate total number of triangles.
+ * \param[in] filename File to write.
+ *
+ * \return None.
+ */
+static void genSphere(uint32_t numTriangles, const char* filename)
+{
+	// Triangles = 2 * slices * (stacks - 1) with slices = 2 * stacks
+	uint32_t stacks = (uint32_t)ceil(sqrt(numTriangles / 4.0));
+	if (stacks < 2)
+		stacks = 2;
+	uint32_t slices = 2 * stacks;
+	StlWriter writer(filename, 2 * slices * (stacks - 1), "meshgen sphere");
+
+	// Build each vertex from integer indices so shared vertices are
+	//  bit identical
+	for (uint32_t stack = 0; stack < stacks; stack++)
+	{
+		for (uint32_t slice = 0; slice < slices; slice++)
+		{
+			Vec3 quad[4];
+
+			for (int corner = 0; corner < 4; corner++)
+			{
+				uint32_t st = stack + (corner >> 1);
+				uint32_t sl = (slice + (corner & 1)) % slices;
+				double theta = M_PI * st / stacks;
+				double phi = 2 * M_PI * sl / slices;
+
+				if (st == 0 || st == stacks)
+					phi = 0;
+
+				quad[corner].x = (float)(sin(theta) * cos(phi));
+				quad[corner].y = (float)(sin(theta) * sin(phi));
+				quad[corner].z = (float)cos(theta);
+			}
+
+			if (stack != 0)
+				writer.write(quad[0], quad[2], quad[1]);
+			if (stack != stacks - 1)
+				writer.write(quad[1], quad[2], quad[3]);
+		}
+	}
+}
+
+/**
+ * Write closed box with each side tessellated into a grid, optionally
+ *  jittering every vertex.
+ *
+ * \param numTriangles Approximate total number of triangles.
+ * \param noise Maximum jitter applied to each vertex coordinate, relative to
+ *	the grid spacing.
+ * \param seed Seed for jitter.
+ * \param[in] filename File to write.
+ *
+ * \return None.
+ */
+static void genBox(uint32_t numTriangles, float noise, uint32_t seed,
+	const char* filename)
+{
+	uint32_t cells = (uint32_t)ceil(sqrt(numTriangles / 12.0));
+	if (cells < 1)
+		cells = 1;
+	StlWriter writer(filename, 12 * cells * cells,
+		noise > 0 ? "meshgen scan" : "meshgen box");
+
+	for (int side = 0; side < 6; side++)
+	{
+		// Axis that is constant on this side and whether it is at min
+		//  or max of the box
+		int axis = side / 2;
+		uint32_t fixed = (side & 1) ? cells : 0;
+
+		for (uint32_t row = 0; row < cells; row++)
+		{
+			for (uint32_t col = 0; col < cells; col++)
+			{
+				Vec3 quad[4];
+
+				for (int corner = 0; corner < 4; corner++)
+				{
+					uint32_t lattice[3];
+					float pos[3];
+
+					lattice[axis] = fixed;
+					lattice[(axis + 1) % 3] = col + (corner & 1);
+					lattice[(axis + 2) % 3] = row + (corner >> 1);
+
+					for (int dim = 0; dim < 3; dim++)
+					{
+						pos[dim] = (float)lattice[dim] /
+							(float)cells;
+						if (noise > 0)
+							pos[dim] += noise / (float)cells *
+								latticeNoise(
+								lattice[0],
+								lattice[1],
+								lattice[2],
+								seed + dim);
+					}
+
+					quad[corner].x = pos[0];
+					quad[corner].y = pos[1];
+					quad[corner].z = pos[2];
+				}
+
+				// Keep outward winding on min and max sides
+				if (side & 1)
+				{
+					writer.write(quad[0], quad[1], quad[3]);
+					writer.write(quad[0], quad[3], quad[2]);
+				}
+				else
+				{
+					writer.write(quad[0], quad[3], quad[1]);
+					writer.write(quad[0], quad[2], quad[3]);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Shuffle the order of triangles in a binary STL file in place. Generated
+ *  models are written in a spatially coherent order, while files from many
+ *  exporters are not, so this gives locality optimizations something to do.
+ *
+ * \param[in] filename Binary STL file to shuffle.
+ * \param seed Seed for shuffle order.
+ *
+ * \return None.
+ */
+static void shuffleStl(const char* filename, uint32_t seed)
+{
+	const size_t header_size = 84;
+	const size_t record_size = 50;
+	std::vector<uint8_t> data;
+	std::vector<uint8_t> record(record_size);
+	FILE* file = fopen(filename, "r+b");
+	long size;
+
+	if (!file || fseek(file, 0, SEEK_END) || (size = ftell(file)) < 
+		(long)header_size || fseek(file, 0, SEEK_SET))
+	{
+		fprintf(stderr, "Failed to open file \"%s\" for shuffling.\n",
+			filename);
+		exit(EXIT_FAILURE);
+	}
+
+	data.resize((size_t)size);
+	if (fread(data.data(), 1, data.size(), file) != data.size())
+	{
+		fprintf(stderr, "Failed to read \"%s\".\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	size_t num_records = (data.size() - header_size) / record_size;
+	uint8_t* records = &data[header_size];
+	uint64_t state = seed * 0x9E3779B97F4A7C15ull + 1;
+
+	// Fisher-Yates with xorshift, so output only depends on seed
+	for (size_t cnt = num_records; cnt > 1; cnt--)
+	{
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+
+		size_t other = (size_t)(state % cnt);
+
+		memcpy(record.data(), &records[(cnt - 1) * record_size], 
+			record_size);
+		memcpy(&records[(cnt - 1) * record_size], 
+			&records[other * record_size], record_size);
+		memcpy(&records[other * record_size], record.data(), 
+			record_size);
+	}
+
+	if (fseek(file, 0, SEEK_SET) || 
+		fwrite(data.data(), 1, data.size(), file) != data.size() ||
+		fclose(file))
+	{
+		fprintf(stderr, "Failed to write \"%s\".\n", filename);
+		exit(EXIT_FAILURE);
+	}
+}
+
+/**
+ * Print application usage to stderr.
+ *
+ * \param[in] apExeName Executable name.
+ *
+ * \return None.
+ */
+static void print_usage(const char* apExeName)
+{
+	fprintf(stderr, "Usage: %s -s <shape> -n <triangles> -o <file> "
+		"[options]\n"
+		"\n"
+		"Options:\n"
+		"  -s, --shape <shape>          planes, sphere, box or scan.\n"
+		"  -n, --triangles <count>      Approximate triangle count "
+		"(1K to 50M).\n"
+		"  -p, --faces-per-plane <cnt>  Triangles per patch for "
+		"planes (default 200).\n"
+		"  -j, --noise <amount>         Jitter relative to grid "
+		"spacing for scan\n"
+		"                               (default 0.25).\n"
+		"  -r, --seed <seed>            Seed for scan jitter and "
+		"shuffle.\n"
+		"  -S, --shuffle                Write triangles in random "
+		"order.\n"
+		"  -o, --output-file <file>     Binary STL file to write.\n"
+		"  -h, --help                   Print this message.\n",
+		apExeName);
+}
+
+/**
+ * Command line application entry point.
+ *
+ * \param argc Number of command line arguments.
+ * \param argv Array of command line argument strings.
+ *
+ * \return EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int main(int argc, char* argv[])
+{
+	std::string shape_name = "";
+	std::string output_file = "";
+	Shape shape = SHAPE_PLANES;
+	unsigned long num_triangles = 0;
+	unsigned long faces_per_plane = 200;
+	float noise = 0.25f;
+	uint32_t seed = 1;
+	bool shuffle = false;
+
+	int opt;
+	int option_index = 0;
+	static struct option long_options[] =
+	{
+		{"shape", required_argument, 0, 's'},
+		{"triangles", required_argument, 0, 'n'},
+		{"faces-per-plane", required_argument, 0, 'p'},
+		{"noise", required_argument, 0, 'j'},
+		{"seed", required_argument, 0, 'r'},
+		{"shuffle", no_argument, 0, 'S'},
+		{"output-file", required_argument, 0, 'o'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	while ((opt = getopt_long(argc, argv, "s:n:p:j:r:So:h", long_options,
+		&option_index)) != -1)
+	{
+		switch (opt) {
+			case 's':
+				shape_name = optarg;
+				break;
+
+			case 'n':
+				num_triangles = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'p':
+				faces_per_plane = strtoul(optarg, NULL, 0);
+				break;
+
+			case 'j':
+				noise = strtof(optarg, NULL);
+				break;
+
+			case 'r':
+				seed = (uint32_t)strtoul(optarg, NULL, 0);
+				break;
+
+			case 'S':
+				shuffle = true;
+				break;
+
+			case 'o':
+				output_file = optarg;
+				break;
+
+			case 'h':
+				print_usage(argv[0]);
+				exit(EXIT_SUCCESS);
+				break;
+
+			default: /* '?' */
+				print_usage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	if (shape_name == "planes")
+		shape = SHAPE_PLANES;
+	else if (shape_name == "sphere")
+		shape = SHAPE_SPHERE;
+	else if (shape_name == "box")
+		shape = SHAPE_BOX;
+	else if (shape_name == "scan")
+		shape = SHAPE_SCAN;
+	else
+	{
+		fprintf(stderr, "Unknown shape \"%s\".\n", shape_name.c_str());
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	if (!num_triangles || num_triangles > 100000000ul ||
+		!faces_per_plane || output_file.empty())
+	{
+		fprintf(stderr, "Invalid triangle count, faces per plane or "
+			"output file.\n");
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	switch (shape)
+	{
+		case SHAPE_PLANES:
+			genPlanes((uint32_t)num_triangles,
+				(uint32_t)faces_per_plane, output_file.c_str());
+			break;
+		case SHAPE_SPHERE:
+			genSphere((uint32_t)num_triangles, output_file.c_str());
+			break;
+		case SHAPE_BOX:
+			genBox((uint32_t)num_triangles, 0, seed,
+				output_file.c_str());
+			break;
+		case SHAPE_SCAN:
+			genBox((uint32_t)num_triangles, noise, seed,
+				output_file.c_str());
+			break;
+	}
+
+	if (shuffle)
+		shuffleStl(output_file.c_str(), seed);
+
+	exit(EXIT_SUCCESS);
+}
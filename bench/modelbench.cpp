@@ -0,0 +1,792 @@
+/**
+ * \file modelbench.cpp
+ * \brief Times each ModelConv phase over repeated runs and reports
+ *	throughput.
+ * \author Gregory Gluszek.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <random>
+#include <chrono>
+#include <getopt.h>
+
+#include "../modelconv.h"
+
+#define QUERY_SIZE 0.01 //!< Half size of query boxes and distance of point
+	//!< queries, relative to the model's bounding box diagonal.
+#define QUERY_SEED 1 //!< Seed for query positions, so every run and build
+	//!< times the same queries.
+
+/**
+ * Timing results for a single model.
+ */
+struct BenchResult
+{
+	std::string filename; //!< Model that was converted.
+	uint64_t triangles; //!< Number of triangles in model.
+	double phaseMedian[Stats::NUM_PHASES]; //!< Median seconds per phase.
+	double missMedian[Stats::NUM_PHASES]; //!< Median cache misses per 
+		//!< phase. 0 if misses could not be counted.
+	double totalMedian; //!< Median seconds for entire conversion.
+	double totalMin; //!< Fastest entire conversion.
+};
+
+/**
+ * Timing results of resegmenting a single model.
+ */
+struct ResegmentResult
+{
+	std::string filename; //!< Model that was resegmented.
+	uint64_t triangles; //!< Number of triangles in model.
+	double buildMedian; //!< Median seconds to build faces on load.
+	double toMedian; //!< Median seconds to resegment to the new angle.
+	double backMedian; //!< Median seconds to resegment back again.
+	uint64_t faces; //!< Faces at the new angle.
+};
+
+/**
+ * Timing results of spatial queries on a single model.
+ */
+struct QueryResult
+{
+	std::string filename; //!< Model that was queried.
+	uint64_t triangles; //!< Number of triangles in model.
+	double buildMedian; //!< Median seconds to build hierarchy.
+	double pickMedian; //!< Median seconds per pickFace().
+	double boxMedian; //!< Median seconds per findTrianglesInBox().
+	double pointMedian; //!< Median seconds per findFacesNearPoint().
+	double hitRate; //!< Fraction of picks that hit a triangle.
+	double boxTriangles; //!< Average triangles found per box query.
+	double pointFaces; //!< Average faces found per point query.
+};
+
+/**
+ * \return Median of given samples.
+ */
+static double median(std::vector<double> samples)
+{
+	std::sort(samples.begin(), samples.end());
+
+	if (samples.empty())
+		return 0;
+
+	if (samples.size() % 2)
+		return samples[samples.size() / 2];
+
+	return (samples[samples.size() / 2 - 1] +
+		samples[samples.size() / 2]) / 2;
+}
+
+/**
+ * Convert a model repeatedly and gather timings.
+ *
+ * \param[in] filename Model to convert.
+ * \param repeats Number of times to convert model.
+ * \param[in] options Options to load model with.
+ *
+ * \return Median timings of the runs.
+ */
+static BenchResult runModel(const std::string& filename, int repeats,
+	const ModelConv::Options& options)
+{
+	std::vector<double> phase_samples[Stats::NUM_PHASES];
+	std::vector<double> miss_samples[Stats::NUM_PHASES];
+	std::vector<double> total_samples;
+	BenchResult result;
+
+	result.filename = filename;
+	result.triangles = 0;
+
+	for (int run = 0; run < repeats; run++)
+	{
+		ModelConv* model_conv = ModelConv::load(filename.c_str(), 
+			options);
+
+		model_conv->exportBinStl("/dev/null");
+
+		const Stats& stats = model_conv->getStats();
+
+		for (int phase = 0; phase < Stats::NUM_PHASES; phase++)
+		{
+			phase_samples[phase].push_back(
+				stats.getTime((Stats::Phase)phase));
+			miss_samples[phase].push_back((double)
+				stats.getCacheMisses((Stats::Phase)phase));
+		}
+
+		total_samples.push_back(stats.getTotalTime());
+		result.triangles = stats.getCount(Stats::TRIANGLES);
+
+		delete model_conv;
+	}
+
+	for (int phase = 0; phase < Stats::NUM_PHASES; phase++)
+	{
+		result.phaseMedian[phase] = median(phase_samples[phase]);
+		result.missMedian[phase] = median(miss_samples[phase]);
+	}
+
+	result.totalMedian = median(total_samples);
+	result.totalMin = *std::min_element(total_samples.begin(),
+		total_samples.end());
+
+	return result;
+}
+
+/**
+ * \return Seconds since start.
+ */
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+		start).count();
+}
+
+/**
+ * Build the spatial index of a model repeatedly and time queries against it.
+ *  Rays are aimed at random points within the model's bounds from outside
+ *  them, and boxes and points are placed at random within the bounds.
+ *
+ * \param[in] filename Model to query.
+ * \param repeats Number of times to load model and run queries.
+ * \param count Number of queries of each kind per run.
+ * \param[in] options Options to load model with.
+ *
+ * \return Median timings of the runs.
+ */
+static QueryResult runQueries(const std::string& filename, int repeats,
+	int count, const ModelConv::Options& options)
+{
+	std::vector<double> build_samples;
+	std::vector<double> pick_samples;
+	std::vector<double> box_samples;
+	std::vector<double> point_samples;
+	uint64_t hits = 0;
+	uint64_t box_triangles = 0;
+	uint64_t point_faces = 0;
+	QueryResult result;
+
+	result.filename = filename;
+	result.triangles = 0;
+
+	for (int run = 0; run < repeats; run++)
+	{
+		ModelConv* model_conv = ModelConv::load(filename.c_str(),
+			options);
+		std::mt19937 random(QUERY_SEED);
+		std::uniform_real_distribution<double> unit(0, 1);
+		std::vector<uint32_t> ids;
+		float bound_min[3], bound_max[3];
+		double min[3], size[3], center[3];
+		double diagonal = 0;
+
+		model_conv->getBounds(bound_min, bound_max);
+		for (int axis = 0; axis < 3; axis++)
+		{
+			min[axis] = bound_min[axis];
+			size[axis] = (double)bound_max[axis] - bound_min[axis];
+			center[axis] = min[axis] + size[axis] / 2;
+			diagonal += size[axis] * size[axis];
+		}
+		diagonal = sqrt(diagonal);
+
+		model_conv->buildBvh();
+		build_samples.push_back(model_conv->getStats().getTime(
+			Stats::BVH_BUILD));
+		result.triangles = model_conv->getStats().getCount(
+			Stats::TRIANGLES);
+
+		std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+		for (int query = 0; query < count; query++)
+		{
+			double origin[3], dir[3], from[3], dist = 0;
+			uint32_t triangle = 0, face = 0;
+
+			// Start a diagonal away from center in a random direction
+			for (int axis = 0; axis < 3; axis++)
+				from[axis] = 2 * unit(random) - 1;
+			double len = sqrt(from[0]*from[0] + from[1]*from[1] +
+				from[2]*from[2]);
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				origin[axis] = center[axis] + diagonal *
+					from[axis] / std::max(len, 1e-9);
+				dir[axis] = min[axis] + size[axis] *
+					unit(random) - origin[axis];
+			}
+
+			if (model_conv->pickFace(origin, dir, triangle, face,
+				dist))
+				hits++;
+		}
+		pick_samples.push_back(secondsSince(start) / count);
+
+		start = std::chrono::steady_clock::now();
+		for (int query = 0; query < count; query++)
+		{
+			double box_min[3], box_max[3];
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				double mid = min[axis] + size[axis] *
+					unit(random);
+
+				box_min[axis] = mid - QUERY_SIZE * diagonal;
+				box_max[axis] = mid + QUERY_SIZE * diagonal;
+			}
+
+			model_conv->findTrianglesInBox(box_min, box_max, ids);
+			box_triangles += ids.size();
+		}
+		box_samples.push_back(secondsSince(start) / count);
+
+		start = std::chrono::steady_clock::now();
+		for (int query = 0; query < count; query++)
+		{
+			double point[3];
+
+			for (int axis = 0; axis < 3; axis++)
+				point[axis] = min[axis] + size[axis] *
+					unit(random);
+
+			model_conv->findFacesNearPoint(point, QUERY_SIZE *
+				diagonal, ids);
+			point_faces += ids.size();
+		}
+		point_samples.push_back(secondsSince(start) / count);
+
+		delete model_conv;
+	}
+
+	double total = (double)repeats * count;
+
+	result.buildMedian = median(build_samples);
+	result.pickMedian = median(pick_samples);
+	result.boxMedian = median(box_samples);
+	result.pointMedian = median(point_samples);
+	result.hitRate = (double)hits / total;
+	result.boxTriangles = (double)box_triangles / total;
+	result.pointFaces = (double)point_faces / total;
+
+	return result;
+}
+
+/**
+ * Load a model repeatedly and time resegmenting it to another coplanar 
+ *  angle and back, against building its faces from scratch on load.
+ *
+ * \param[in] filename Model to resegment.
+ * \param repeats Number of times to load and resegment model.
+ * \param angle Coplanar angle, in degrees, to resegment to.
+ * \param[in] options Options to load model with.
+ *
+ * \return Median timings of the runs.
+ */
+static ResegmentResult runResegment(const std::string& filename, int repeats,
+	float angle, const ModelConv::Options& options)
+{
+	std::vector<double> build_samples;
+	std::vector<double> to_samples;
+	std::vector<double> back_samples;
+	ResegmentResult result;
+
+	result.filename = filename;
+	result.triangles = 0;
+	result.faces = 0;
+
+	for (int run = 0; run < repeats; run++)
+	{
+		ModelConv* model_conv = ModelConv::load(filename.c_str(),
+			options);
+
+		build_samples.push_back(model_conv->getStats().getTime(
+			Stats::FACE_BUILD));
+		result.triangles = model_conv->getStats().getCount(
+			Stats::TRIANGLES);
+
+		std::chrono::steady_clock::time_point start =
+			std::chrono::steady_clock::now();
+		model_conv->resegment(angle);
+		to_samples.push_back(secondsSince(start));
+		result.faces = model_conv->getStats().getCount(Stats::FACES);
+
+		start = std::chrono::steady_clock::now();
+		model_conv->resegment(options.coplanarAngle);
+		back_samples.push_back(secondsSince(start));
+
+		delete model_conv;
+	}
+
+	result.buildMedian = median(build_samples);
+	result.toMedian = median(to_samples);
+	result.backMedian = median(back_samples);
+
+	return result;
+}
+
+/**
+ * \return Triangles per second, or 0 if no time was measured.
+ */
+static double throughput(uint64_t triangles, double seconds)
+{
+	return seconds > 0 ? (double)triangles / seconds : 0;
+}
+
+/**
+ * Print results as a human readable table.
+ *
+ * \param[in] results Results to print.
+ *
+ * \return None.
+ */
+static void printTable(const std::vector<BenchResult>& results)
+{
+	printf("%-32s %10s", "model", "triangles");
+	for (int phase = 0; phase < Stats::NUM_PHASES; phase++)
+		printf(" %15s", Stats::getName((Stats::Phase)phase));
+	printf(" %12s %14s\n", "total_ms", "tris_per_s");
+
+	for (size_t cnt = 0; cnt < results.size(); cnt++)
+	{
+		const BenchResult& result = results[cnt];
+		std::string name = result.filename;
+
+		if (name.size() > 32)
+			name = "..." + name.substr(name.size() - 29);
+
+		printf("%-32s %10lu", name.c_str(),
+			(unsigned long)result.triangles);
+		for (int phase = 0; phase < Stats::NUM_PHASES; phase++)
+			printf(" %15.3f", result.phaseMedian[phase] * 1000);
+		printf(" %12.3f %14.0f\n", result.totalMedian * 1000,
+			throughput(result.triangles, result.totalMedian));
+	}
+}
+
+/**
+ * \return Percent change from before to after, or 0 if before is 0.
+ */
+static double percentChange(double before, double after)
+{
+	return before > 0 ? 100 * (after - before) / before : 0;
+}
+
+/**
+ * Print how Morton reordering changed the phases that walk triangle 
+ *  neighbors. The reorder phase itself is listed separately since it is the
+ *  cost paid for any improvement.
+ *
+ * \param[in] original Results without reordering.
+ * \param[in] reordered Results of the same models with reordering.
+ *
+ * \return None.
+ */
+static void printMortonTable(const std::vector<BenchResult>& original,
+	const std::vector<BenchResult>& reordered)
+{
+	bool misses = Stats::cacheMissesEnabled();
+
+	printf("\nMorton order (adjacency + face_build):\n");
+	printf("%-32s %12s %12s %8s %14s %14s %8s %12s\n", "model", 
+		"orig_ms", "morton_ms", "change", "orig_misses", 
+		"morton_misses", "change", "reorder_ms");
+
+	for (size_t cnt = 0; cnt < original.size(); cnt++)
+	{
+		const BenchResult& before = original[cnt];
+		const BenchResult& after = reordered[cnt];
+		std::string name = before.filename;
+		double before_ms = (before.phaseMedian[Stats::ADJACENCY] +
+			before.phaseMedian[Stats::FACE_BUILD]) * 1000;
+		double after_ms = (after.phaseMedian[Stats::ADJACENCY] +
+			after.phaseMedian[Stats::FACE_BUILD]) * 1000;
+		double before_misses = before.missMedian[Stats::ADJACENCY] +
+			before.missMedian[Stats::FACE_BUILD];
+		double after_misses = after.missMedian[Stats::ADJACENCY] +
+			after.missMedian[Stats::FACE_BUILD];
+
+		if (name.size() > 32)
+			name = "..." + name.substr(name.size() - 29);
+
+		printf("%-32s %12.3f %12.3f %7.1f%%", name.c_str(), before_ms,
+			after_ms, percentChange(before_ms, after_ms));
+		if (misses)
+			printf(" %14.0f %14.0f %7.1f%%", before_misses, 
+				after_misses, percentChange(before_misses, 
+				after_misses));
+		else
+			printf(" %14s %14s %8s", "n/a", "n/a", "n/a");
+		printf(" %12.3f\n", after.phaseMedian[Stats::REORDER] * 1000);
+	}
+
+	if (!misses)
+		printf("Cache misses not available (perf_event_open not "
+			"permitted).\n");
+}
+
+/**
+ * Print spatial query timings as a human readable table.
+ *
+ * \param[in] results Results to print.
+ * \param count Number of queries of each kind per run.
+ *
+ * \return None.
+ */
+static void printQueryTable(const std::vector<QueryResult>& results,
+	int count)
+{
+	printf("\nSpatial queries (%d of each per run):\n", count);
+	printf("%-32s %10s %12s %10s %10s %10s %8s %10s %10s\n", "model",
+		"triangles", "build_ms", "pick_us", "box_us", "point_us",
+		"hit_pct", "box_tris", "pt_faces");
+
+	for (size_t cnt = 0; cnt < results.size(); cnt++)
+	{
+		const QueryResult& result = results[cnt];
+		std::string name = result.filename;
+
+		if (name.size() > 32)
+			name = "..." + name.substr(name.size() - 29);
+
+		printf("%-32s %10lu %12.3f %10.3f %10.3f %10.3f %7.1f%% "
+			"%10.1f %10.1f\n", name.c_str(),
+			(unsigned long)result.triangles,
+			result.buildMedian * 1000, result.pickMedian * 1e6,
+			result.boxMedian * 1e6, result.pointMedian * 1e6,
+			result.hitRate * 100, result.boxTriangles,
+			result.pointFaces);
+	}
+}
+
+/**
+ * Print resegment timings as a human readable table.
+ *
+ * \param[in] results Results to print.
+ * \param from Coplanar angle models were loaded with.
+ * \param to Coplanar angle models were resegmented to.
+ *
+ * \return None.
+ */
+static void printResegmentTable(const std::vector<ResegmentResult>& results,
+	float from, float to)
+{
+	printf("\nResegment from %g to %g degrees and back:\n", (double)from,
+		(double)to);
+	printf("%-32s %10s %12s %12s %12s %10s\n", "model", "triangles",
+		"build_ms", "to_ms", "back_ms", "faces");
+
+	for (size_t cnt = 0; cnt < results.size(); cnt++)
+	{
+		const ResegmentResult& result = results[cnt];
+		std::string name = result.filename;
+
+		if (name.size() > 32)
+			name = "..." + name.substr(name.size() - 29);
+
+		printf("%-32s %10lu %12.3f %12.3f %12.3f %10lu\n", 
+			name.c_str(), (unsigned long)result.triangles,
+			result.buildMedian * 1000, result.toMedian * 1000,
+			result.backMedian * 1000, (unsigned long)result.faces);
+	}
+}
+
+/**
+ * Write results as CSV so they can be used as a baseline for later runs.
+ *
+ * \param[in] results Results to write.
+ * \param[in] filename CSV file to write.
+ *
+ * \return None.
+ */
+static void writeCsv(const std::vector<BenchResult>& results,
+	const std::string& filename)
+{
+	FILE* file = fopen(filename.c_str(), "w");
+
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open file \"%s\" for writing.\n",
+			filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(file, "model,triangles");
+	for (int phase = 0; phase < Stats::NUM_PHASES; phase++)
+		fprintf(file, ",%s_s", Stats::getName((Stats::Phase)phase));
+	fprintf(file, ",total_s,tris_per_s\n");
+
+	for (size_t cnt = 0; cnt < results.size(); cnt++)
+	{
+		const BenchResult& result = results[cnt];
+
+		fprintf(file, "%s,%lu", result.filename.c_str(),
+			(unsigned long)result.triangles);
+		for (int phase = 0; phase < Stats::NUM_PHASES; phase++)
+			fprintf(file, ",%.9f", result.phaseMedian[phase]);
+		fprintf(file, ",%.9f,%.1f\n", result.totalMedian,
+			throughput(result.triangles, result.totalMedian));
+	}
+
+	fclose(file);
+}
+
+/**
+ * Read throughput of each model from a CSV written by writeCsv().
+ *
+ * \param[in] filename CSV file to read.
+ *
+ * \return Map of model filename to triangles per second.
+ */
+static std::map<std::string, double> readBaseline(const std::string& filename)
+{
+	std::map<std::string, double> baseline;
+	FILE* file = fopen(filename.c_str(), "r");
+	char line[4096];
+
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open baseline \"%s\"\n",
+			filename.c_str());
+		exit(EXIT_FAILURE);
+	}
+
+	// Skip column names
+	if (!fgets(line, sizeof(line), file))
+	{
+		fclose(file);
+		return baseline;
+	}
+
+	while (fgets(line, sizeof(line), file))
+	{
+		char* first_comma = strchr(line, ',');
+		char* last_comma = strrchr(line, ',');
+
+		if (!first_comma || first_comma == last_comma)
+			continue;
+
+		baseline[std::string(line, first_comma)] =
+			strtod(last_comma + 1, NULL);
+	}
+
+	fclose(file);
+
+	return baseline;
+}
+
+/**
+ * Print application usage to stderr.
+ *
+ * \param[in] apExeName Executable name.
+ *
+ * \return None.
+ */
+static void print_usage(const char* apExeName)
+{
+	fprintf(stderr, "Usage: %s [options] <model.stl>...\n"
+		"\n"
+		"Options:\n"
+		"  -r, --repeats <count>      Conversions per model "
+		"(default 5).\n"
+		"  -c, --csv <file>           Write results as CSV.\n"
+		"  -b, --baseline <file>      CSV from an earlier run to "
+		"compare against.\n"
+		"  -t, --tolerance <percent>  Allowed throughput drop versus "
+		"baseline\n"
+		"                             before failing (default 10).\n"
+		"  -z, --morton-compare       Also convert each model with "
+		"Morton\n"
+		"                             reordering and compare time "
+		"and cache\n"
+		"                             misses.\n"
+		"  -q, --queries <count>      Also build the spatial index of "
+		"each\n"
+		"                             model and time this many ray, "
+		"box and\n"
+		"                             point queries against it.\n"
+		"  -a, --angle <degrees>      Coplanar angle to load models "
+		"with.\n"
+		"  -s, --resegment <degrees>  Also time resegmenting each "
+		"model to\n"
+		"                             this coplanar angle and back.\n"
+		"  -h, --help                 Print this message.\n",
+		apExeName);
+}
+
+/**
+ * Command line application entry point.
+ *
+ * \param argc Number of command line arguments.
+ * \param argv Array of command line argument strings.
+ *
+ * \return EXIT_SUCCESS, or EXIT_FAILURE if a regression against the
+ *	baseline was found.
+ */
+int main(int argc, char* argv[])
+{
+	int repeats = 5;
+	std::string csv_file = "";
+	std::string baseline_file = "";
+	double tolerance = 10;
+	bool morton_compare = false;
+	int queries = 0;
+	float resegment_angle = -1;
+	ModelConv::Options options;
+	std::vector<BenchResult> results;
+	std::vector<BenchResult> morton_results;
+	std::vector<QueryResult> query_results;
+	std::vector<ResegmentResult> resegment_results;
+	int regressions = 0;
+
+	int opt;
+	int option_index = 0;
+	static struct option long_options[] =
+	{
+		{"repeats", required_argument, 0, 'r'},
+		{"csv", required_argument, 0, 'c'},
+		{"baseline", required_argument, 0, 'b'},
+		{"tolerance", required_argument, 0, 't'},
+		{"morton-compare", no_argument, 0, 'z'},
+		{"queries", required_argument, 0, 'q'},
+		{"angle", required_argument, 0, 'a'},
+		{"resegment", required_argument, 0, 's'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
+	};
+
+	while ((opt = getopt_long(argc, argv, "r:c:b:t:zq:a:s:h", long_options,
+		&option_index)) != -1)
+	{
+		switch (opt) {
+			case 'r':
+				repeats = atoi(optarg);
+				break;
+
+			case 'c':
+				csv_file = optarg;
+				break;
+
+			case 'b':
+				baseline_file = optarg;
+				break;
+
+			case 't':
+				tolerance = strtod(optarg, NULL);
+				break;
+
+			case 'z':
+				morton_compare = true;
+				break;
+
+			case 'q':
+				queries = atoi(optarg);
+				break;
+
+			case 'a':
+				options.coplanarAngle = strtof(optarg, NULL);
+				break;
+
+			case 's':
+				resegment_angle = strtof(optarg, NULL);
+				break;
+
+			case 'h':
+				print_usage(argv[0]);
+				exit(EXIT_SUCCESS);
+				break;
+
+			default: /* '?' */
+				print_usage(argv[0]);
+				exit(EXIT_FAILURE);
+		}
+	}
+
+	if (optind >= argc || repeats < 1 || queries < 0)
+	{
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
+
+	// Before any threads are started so they are counted too
+	Stats::enableCacheMisses();
+
+	for (int cnt = optind; cnt < argc; cnt++)
+		results.push_back(runModel(argv[cnt], repeats, options));
+
+	printTable(results);
+
+	if (queries)
+	{
+		for (int cnt = optind; cnt < argc; cnt++)
+			query_results.push_back(runQueries(argv[cnt], repeats,
+				queries, options));
+
+		printQueryTable(query_results, queries);
+	}
+
+	if (resegment_angle >= 0)
+	{
+		for (int cnt = optind; cnt < argc; cnt++)
+			resegment_results.push_back(runResegment(argv[cnt], 
+				repeats, resegment_angle, options));
+
+		printResegmentTable(resegment_results, options.coplanarAngle,
+			resegment_angle);
+	}
+
+	if (morton_compare)
+	{
+		options.reorder = true;
+
+		for (int cnt = optind; cnt < argc; cnt++)
+			morton_results.push_back(runModel(argv[cnt], repeats,
+				options));
+
+		printMortonTable(results, morton_results);
+	}
+
+	if (!csv_file.empty())
+		writeCsv(results, csv_file);
+
+	if (!baseline_file.empty())
+	{
+		std::map<std::string, double> baseline =
+			readBaseline(baseline_file);
+
+		for (size_t cnt = 0; cnt < results.size(); cnt++)
+		{
+			const BenchResult& result = results[cnt];
+			std::map<std::string, double>::iterator itr =
+				baseline.find(result.filename);
+
+			if (itr == baseline.end() || itr->second <= 0)
+				continue;
+
+			double current = throughput(result.triangles,
+				result.totalMedian);
+			double change = 100 * (current - itr->second) /
+				itr->second;
+
+			if (change < -tolerance)
+			{
+				printf("REGRESSION %s: %.0f tris/s vs %.0f "
+					"baseline (%.1f%%)\n",
+					result.filename.c_str(), current,
+					itr->second, change);
+				regressions++;
+			}
+		}
+	}
+
+	exit(regressions ? EXIT_FAILURE : EXIT_SUCCESS);
+}
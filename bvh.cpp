@@ -0,0 +1,778 @@
+/**
+ * \file bvh.cpp
+ * \brief Bounding volume hierarchy over triangles for point, ray and box
+ *	queries.
+ * \author Gregory Gluszek.
+ */
+
+#include "bvh.h"
+
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#define BVH_NUM_BINS 16 //!< Number of bins SAH split candidates are
+	//!< evaluated at along each axis.
+#define BVH_MAX_LEAF 4 //!< Leaves are always made at or below this size.
+#define BVH_MAX_LEAF_SAH 16 //!< Leaves up to this size are made if SAH
+	//!< says splitting would not help.
+#define BVH_SPAWN_MIN 65536 //!< Minimum triangles in a subtree before it
+	//!< is worth building on another thread.
+#define BVH_STACK_SIZE 64 //!< Traversal stack depth.
+
+// Layout of entries in bounds used during build
+#define BOUNDS_STRIDE 9
+#define BOUNDS_MIN 0
+#define BOUNDS_MAX 3
+#define BOUNDS_CENTROID 6
+
+/**
+ * \return Half the surface area of a box. Constant factor does not matter for
+ *	SAH comparisons.
+ */
+static float halfArea(const float min[3], const float max[3])
+{
+	float dx = max[0] - min[0];
+	float dy = max[1] - min[1];
+	float dz = max[2] - min[2];
+
+	if (dx < 0 || dy < 0 || dz < 0)
+		return 0;
+
+	return dx*dy + dy*dz + dz*dx;
+}
+
+/**
+ * Grow box to contain another box.
+ *
+ * \param[inout] min Minimum corner of box to grow.
+ * \param[inout] max Maximum corner of box to grow.
+ * \param[in] otherMin Minimum corner of box to contain.
+ * \param[in] otherMax Maximum corner of box to contain.
+ *
+ * \return None.
+ */
+static void growBox(float min[3], float max[3], const float otherMin[3],
+	const float otherMax[3])
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		min[axis] = std::min(min[axis], otherMin[axis]);
+		max[axis] = std::max(max[axis], otherMax[axis]);
+	}
+}
+
+/**
+ * \return Largest float no greater than value, so boxes made of floats still
+ *	contain double precision coordinates.
+ */
+static float roundDown(double value)
+{
+	float rounded = (float)value;
+
+	return (double)rounded > value ? nextafterf(rounded, -FLT_MAX) : rounded;
+}
+
+/**
+ * \return Smallest float no less than value.
+ */
+static float roundUp(double value)
+{
+	float rounded = (float)value;
+
+	return (double)rounded < value ? nextafterf(rounded, FLT_MAX) : rounded;
+}
+
+/**
+ * Set box to be empty (inverted) so any growBox() call replaces it.
+ *
+ * \param[out] min Minimum corner.
+ * \param[out] max Maximum corner.
+ *
+ * \return None.
+ */
+static void emptyBox(float min[3], float max[3])
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		min[axis] = FLT_MAX;
+		max[axis] = -FLT_MAX;
+	}
+}
+
+/**
+ * Constructor.
+ */
+template <typename Real>
+Bvh<Real>::Bvh()
+: nodes({})
+, indices({})
+, coords({})
+, bounds({})
+, spawnDepth(0)
+{
+}
+
+/**
+ * Build hierarchy over the given triangles, replacing any previous build.
+ *
+ * \param[in] coords 9 coordinates per triangle (x, y, z of each vertex).
+ *	Triangle ids returned by queries are indices into this array.
+ * \param count Number of triangles.
+ * \param numThreads Maximum number of threads to build with. 0 means use
+ *	one per core.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Bvh<Real>::build(const Real* coords, size_t count, unsigned numThreads)
+{
+	clear();
+
+	if (!count)
+		return;
+
+	if (!numThreads)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	// Each level of spawning doubles number of threads working
+	spawnDepth = 0;
+	while ((1u << spawnDepth) < numThreads)
+		spawnDepth++;
+
+	bounds.resize(BOUNDS_STRIDE * count);
+	indices.resize(count);
+
+	for (size_t tri = 0; tri < count; tri++)
+	{
+		const Real* vtx = coords + 9*tri;
+		float* bound = &bounds[BOUNDS_STRIDE * tri];
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			bound[BOUNDS_MIN + axis] = roundDown(std::min(vtx[axis],
+				std::min(vtx[3 + axis], vtx[6 + axis])));
+			bound[BOUNDS_MAX + axis] = roundUp(std::max(vtx[axis],
+				std::max(vtx[3 + axis], vtx[6 + axis])));
+			bound[BOUNDS_CENTROID + axis] = 0.5f *
+				(bound[BOUNDS_MIN + axis] +
+				bound[BOUNDS_MAX + axis]);
+		}
+
+		indices[tri] = (uint32_t)tri;
+	}
+
+	// Around two nodes per triangle with leaves of one or two triangles
+	nodes.reserve(count);
+	buildNode(0, (uint32_t)count, nodes, 0);
+
+	std::vector<float>().swap(bounds);
+
+	// Store coordinates in leaf order so leaf tests read contiguous memory
+	this->coords.resize(9 * count);
+	for (size_t entry = 0; entry < count; entry++)
+		memcpy(&this->coords[9 * entry], coords + 9 * indices[entry],
+			9 * sizeof(Real));
+}
+
+/**
+ * Release all memory used by hierarchy.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Bvh<Real>::clear()
+{
+	std::vector<Node>().swap(nodes);
+	std::vector<uint32_t>().swap(indices);
+	std::vector<Real>().swap(coords);
+	std::vector<float>().swap(bounds);
+}
+
+/**
+ * \return True if build() has been called with at least one triangle.
+ */
+template <typename Real>
+bool Bvh<Real>::isBuilt() const
+{
+	return !nodes.empty();
+}
+
+/**
+ * \return Number of nodes in hierarchy.
+ */
+template <typename Real>
+size_t Bvh<Real>::getNodeCount() const
+{
+	return nodes.size();
+}
+
+/**
+ * Recursively build subtree over a range of entries using binned SAH. The
+ *  root of the subtree is appended to out, followed by its left subtree and
+ *  then its right subtree.
+ *
+ * \param begin First entry in indices to build over.
+ * \param end One past last entry in indices to build over.
+ * \param[inout] out Nodes are appended to this.
+ * \param depth Depth of this node in hierarchy.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Bvh<Real>::buildNode(uint32_t begin, uint32_t end, std::vector<Node>& out,
+	unsigned depth)
+{
+	uint32_t count = end - begin;
+	size_t me = out.size();
+	Node node;
+	float cmin[3], cmax[3];
+
+	emptyBox(node.min, node.max);
+	emptyBox(cmin, cmax);
+
+	for (uint32_t entry = begin; entry < end; entry++)
+	{
+		const float* bound = &bounds[BOUNDS_STRIDE * indices[entry]];
+
+		growBox(node.min, node.max, bound + BOUNDS_MIN,
+			bound + BOUNDS_MAX);
+		growBox(cmin, cmax, bound + BOUNDS_CENTROID,
+			bound + BOUNDS_CENTROID);
+	}
+
+	node.offset = begin;
+	node.count = count;
+	out.push_back(node);
+
+	if (count <= BVH_MAX_LEAF)
+		return;
+
+	// Find cheapest split amongst bin boundaries on every axis
+	float best_cost = FLT_MAX;
+	int best_axis = -1;
+	int best_bin = 0;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float extent = cmax[axis] - cmin[axis];
+		uint32_t bin_count[BVH_NUM_BINS] = {0};
+		float bin_min[BVH_NUM_BINS][3], bin_max[BVH_NUM_BINS][3];
+		float right_area[BVH_NUM_BINS];
+		float acc_min[3], acc_max[3];
+		uint32_t acc_count = 0;
+
+		if (extent <= 0)
+			continue;
+
+		for (int bin = 0; bin < BVH_NUM_BINS; bin++)
+			emptyBox(bin_min[bin], bin_max[bin]);
+
+		float scale = BVH_NUM_BINS / extent;
+		for (uint32_t entry = begin; entry < end; entry++)
+		{
+			const float* bound =
+				&bounds[BOUNDS_STRIDE * indices[entry]];
+			int bin = std::min(BVH_NUM_BINS - 1, (int)(scale *
+				(bound[BOUNDS_CENTROID + axis] - cmin[axis])));
+
+			bin_count[bin]++;
+			growBox(bin_min[bin], bin_max[bin], bound + BOUNDS_MIN,
+				bound + BOUNDS_MAX);
+		}
+
+		// Sweep from right to get area of everything right of split
+		emptyBox(acc_min, acc_max);
+		for (int bin = BVH_NUM_BINS - 1; bin > 0; bin--)
+		{
+			growBox(acc_min, acc_max, bin_min[bin], bin_max[bin]);
+			right_area[bin] = halfArea(acc_min, acc_max);
+		}
+
+		// Sweep from left evaluating split before each bin
+		emptyBox(acc_min, acc_max);
+		for (int bin = 1; bin < BVH_NUM_BINS; bin++)
+		{
+			growBox(acc_min, acc_max, bin_min[bin - 1],
+				bin_max[bin - 1]);
+			acc_count += bin_count[bin - 1];
+
+			float cost = (float)acc_count * 
+				halfArea(acc_min, acc_max) +
+				(float)(count - acc_count) * right_area[bin];
+
+			if (acc_count && acc_count < count && cost < best_cost)
+			{
+				best_cost = cost;
+				best_axis = axis;
+				best_bin = bin;
+			}
+		}
+	}
+
+	uint32_t mid = begin;
+
+	if (best_axis >= 0)
+	{
+		// Leaf is better if split costs more than testing everything
+		if (count <= BVH_MAX_LEAF_SAH &&
+			best_cost >= (float)count * halfArea(node.min, node.max))
+			return;
+
+		float scale = BVH_NUM_BINS / (cmax[best_axis] - cmin[best_axis]);
+		float split_min = cmin[best_axis];
+
+		mid = (uint32_t)(std::partition(indices.begin() + begin,
+			indices.begin() + end, [&](uint32_t tri) {
+				const float* bound = &bounds[BOUNDS_STRIDE*tri];
+				int bin = std::min(BVH_NUM_BINS - 1,
+					(int)(scale * (bound[BOUNDS_CENTROID +
+					best_axis] - split_min)));
+				return bin < best_bin;
+			}) - indices.begin());
+	}
+
+	// All centroids the same or a degenerate split, so just halve range
+	if (mid == begin || mid == end)
+	{
+		if (count <= BVH_MAX_LEAF_SAH)
+			return;
+
+		mid = begin + count / 2;
+	}
+
+	out[me].count = 0;
+
+	if (depth < spawnDepth && count >= BVH_SPAWN_MIN)
+	{
+		std::vector<Node> left_nodes;
+		std::vector<Node> right_nodes;
+
+		// Entry ranges are disjoint, so the two halves can partition
+		//  indices concurrently
+		std::thread left_thread([&]() {
+			buildNode(begin, mid, left_nodes, depth + 1);
+		});
+		buildNode(mid, end, right_nodes, depth + 1);
+		left_thread.join();
+
+		appendSubtree(out, left_nodes);
+		out[me].offset = (uint32_t)out.size();
+		appendSubtree(out, right_nodes);
+	}
+	else
+	{
+		buildNode(begin, mid, out, depth + 1);
+		out[me].offset = (uint32_t)out.size();
+		buildNode(mid, end, out, depth + 1);
+	}
+}
+
+/**
+ * Append a subtree built into its own array, fixing up child references.
+ *
+ * \param[inout] out Nodes to append to.
+ * \param[in] subtree Subtree with its root at index 0.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Bvh<Real>::appendSubtree(std::vector<Node>& out,
+	const std::vector<Node>& subtree)
+{
+	uint32_t base = (uint32_t)out.size();
+
+	for (size_t cnt = 0; cnt < subtree.size(); cnt++)
+	{
+		Node node = subtree[cnt];
+
+		if (!node.count)
+			node.offset += base;
+
+		out.push_back(node);
+	}
+}
+
+/**
+ * Find closest triangle hit by a ray.
+ *
+ * \param[in] origin Start of ray.
+ * \param[in] dir Direction of ray. Does not need to be normalized; distances
+ *	are in multiples of its length.
+ * \param maxDist Ignore hits further than this.
+ * \param[out] triangle Id of closest triangle hit.
+ * \param[out] dist Distance along ray to hit.
+ *
+ * \return True if a triangle was hit.
+ */
+template <typename Real>
+bool Bvh<Real>::intersectRay(const Real origin[3], const Real dir[3],
+	Real maxDist, uint32_t& triangle, Real& dist) const
+{
+	uint32_t stack[BVH_STACK_SIZE];
+	int stack_size = 0;
+	Real inv_dir[3];
+	bool hit = false;
+
+	if (nodes.empty())
+		return false;
+
+	for (int axis = 0; axis < 3; axis++)
+		inv_dir[axis] = 1 / dir[axis];
+
+	dist = maxDist;
+	stack[stack_size++] = 0;
+
+	while (stack_size)
+	{
+		const Node& node = nodes[stack[--stack_size]];
+		Real tmin = 0;
+		Real tmax = dist;
+
+		// Slab test
+		for (int axis = 0; axis < 3; axis++)
+		{
+			Real t1 = (node.min[axis] - origin[axis]) * inv_dir[axis];
+			Real t2 = (node.max[axis] - origin[axis]) * inv_dir[axis];
+
+			// NaN from 0 * inf means ray is on slab plane, so treat
+			//  as inside
+			if (t1 != t1 || t2 != t2)
+				continue;
+
+			tmin = std::max(tmin, std::min(t1, t2));
+			tmax = std::min(tmax, std::max(t1, t2));
+		}
+
+		if (tmin > tmax)
+			continue;
+
+		if (node.count)
+		{
+			for (uint32_t entry = node.offset;
+				entry < node.offset + node.count; entry++)
+			{
+				// Moller-Trumbore
+				const Real* vtx = &coords[9 * entry];
+				Real e1[3], e2[3], p[3], s[3], q[3];
+
+				for (int axis = 0; axis < 3; axis++)
+				{
+					e1[axis] = vtx[3 + axis] - vtx[axis];
+					e2[axis] = vtx[6 + axis] - vtx[axis];
+					s[axis] = origin[axis] - vtx[axis];
+				}
+
+				p[0] = dir[1]*e2[2] - dir[2]*e2[1];
+				p[1] = dir[2]*e2[0] - dir[0]*e2[2];
+				p[2] = dir[0]*e2[1] - dir[1]*e2[0];
+
+				Real det = e1[0]*p[0] + e1[1]*p[1] + e1[2]*p[2];
+				if (fabs(det) < (Real)1e-20)
+					continue;
+
+				Real inv_det = 1 / det;
+				Real u = (s[0]*p[0] + s[1]*p[1] + s[2]*p[2]) *
+					inv_det;
+				if (u < 0 || u > 1)
+					continue;
+
+				q[0] = s[1]*e1[2] - s[2]*e1[1];
+				q[1] = s[2]*e1[0] - s[0]*e1[2];
+				q[2] = s[0]*e1[1] - s[1]*e1[0];
+
+				Real v = (dir[0]*q[0] + dir[1]*q[1] +
+					dir[2]*q[2]) * inv_det;
+				if (v < 0 || u + v > 1)
+					continue;
+
+				Real t = (e2[0]*q[0] + e2[1]*q[1] + e2[2]*q[2]) *
+					inv_det;
+				if (t >= 0 && t < dist)
+				{
+					dist = t;
+					triangle = indices[entry];
+					hit = true;
+				}
+			}
+			continue;
+		}
+
+		if (stack_size + 2 > BVH_STACK_SIZE)
+			continue;
+
+		stack[stack_size++] = node.offset;
+		stack[stack_size++] = (uint32_t)(&node - &nodes[0]) + 1;
+	}
+
+	return hit;
+}
+
+/**
+ * Find all triangles that touch an axis aligned box.
+ *
+ * \param[in] min Minimum corner of box.
+ * \param[in] max Maximum corner of box.
+ * \param[out] triangles Ids of triangles touching box are appended to this.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Bvh<Real>::queryBox(const Real min[3], const Real max[3],
+	std::vector<uint32_t>& triangles) const
+{
+	uint32_t stack[BVH_STACK_SIZE];
+	int stack_size = 0;
+	Real center[3], half[3];
+
+	if (nodes.empty())
+		return;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		center[axis] = (min[axis] + max[axis]) / 2;
+		half[axis] = (max[axis] - min[axis]) / 2;
+	}
+
+	stack[stack_size++] = 0;
+
+	while (stack_size)
+	{
+		uint32_t idx = stack[--stack_size];
+		const Node& node = nodes[idx];
+
+		if (node.min[0] > max[0] || node.max[0] < min[0] ||
+			node.min[1] > max[1] || node.max[1] < min[1] ||
+			node.min[2] > max[2] || node.max[2] < min[2])
+			continue;
+
+		if (node.count)
+		{
+			for (uint32_t entry = node.offset;
+				entry < node.offset + node.count; entry++)
+			{
+				if (triangleOverlapsBox(entry, center, half))
+					triangles.push_back(indices[entry]);
+			}
+			continue;
+		}
+
+		if (stack_size + 2 > BVH_STACK_SIZE)
+			continue;
+
+		stack[stack_size++] = node.offset;
+		stack[stack_size++] = idx + 1;
+	}
+}
+
+/**
+ * Find all triangles within a distance of a point.
+ *
+ * \param[in] point Point to search around.
+ * \param tolerance Maximum distance from point to triangle.
+ * \param[out] triangles Ids of triangles near point are appended to this.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Bvh<Real>::queryPoint(const Real point[3], Real tolerance,
+	std::vector<uint32_t>& triangles) const
+{
+	uint32_t stack[BVH_STACK_SIZE];
+	int stack_size = 0;
+	Real tol2 = tolerance * tolerance;
+
+	if (nodes.empty())
+		return;
+
+	stack[stack_size++] = 0;
+
+	while (stack_size)
+	{
+		uint32_t idx = stack[--stack_size];
+		const Node& node = nodes[idx];
+		bool outside = false;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (node.min[axis] - tolerance > point[axis] ||
+				node.max[axis] + tolerance < point[axis])
+				outside = true;
+		}
+
+		if (outside)
+			continue;
+
+		if (node.count)
+		{
+			for (uint32_t entry = node.offset;
+				entry < node.offset + node.count; entry++)
+			{
+				if (distanceToTriangle2(entry, point) <= tol2)
+					triangles.push_back(indices[entry]);
+			}
+			continue;
+		}
+
+		if (stack_size + 2 > BVH_STACK_SIZE)
+			continue;
+
+		stack[stack_size++] = node.offset;
+		stack[stack_size++] = idx + 1;
+	}
+}
+
+/**
+ * Exact triangle/box overlap using separating axis theorem (Akenine-Moller).
+ *
+ * \param entry Entry of triangle in coords.
+ * \param[in] center Center of box.
+ * \param[in] half Half size of box along each axis.
+ *
+ * \return True if triangle touches box.
+ */
+template <typename Real>
+bool Bvh<Real>::triangleOverlapsBox(uint32_t entry, const Real center[3],
+	const Real half[3]) const
+{
+	const Real* tri = &coords[9 * entry];
+	Real v[3][3], e[3][3], normal[3];
+
+	// Move box to origin
+	for (int vtx = 0; vtx < 3; vtx++)
+		for (int axis = 0; axis < 3; axis++)
+			v[vtx][axis] = tri[3*vtx + axis] - center[axis];
+
+	for (int edge = 0; edge < 3; edge++)
+		for (int axis = 0; axis < 3; axis++)
+			e[edge][axis] = v[(edge + 1) % 3][axis] - v[edge][axis];
+
+	// 9 axes from cross products of box axes and triangle edges
+	for (int edge = 0; edge < 3; edge++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			int a1 = (axis + 1) % 3;
+			int a2 = (axis + 2) % 3;
+			Real p[3];
+
+			// Project onto axis x e where x is box axis
+			for (int vtx = 0; vtx < 3; vtx++)
+				p[vtx] = v[vtx][a2] * e[edge][a1] -
+					v[vtx][a1] * e[edge][a2];
+
+			Real rad = half[a1] * fabs(e[edge][a2]) +
+				half[a2] * fabs(e[edge][a1]);
+			Real pmin = std::min(p[0], std::min(p[1], p[2]));
+			Real pmax = std::max(p[0], std::max(p[1], p[2]));
+
+			if (pmin > rad || pmax < -rad)
+				return false;
+		}
+	}
+
+	// Box face normals
+	for (int axis = 0; axis < 3; axis++)
+	{
+		Real pmin = std::min(v[0][axis], std::min(v[1][axis], v[2][axis]));
+		Real pmax = std::max(v[0][axis], std::max(v[1][axis], v[2][axis]));
+
+		if (pmin > half[axis] || pmax < -half[axis])
+			return false;
+	}
+
+	// Triangle plane
+	normal[0] = e[0][1]*e[1][2] - e[0][2]*e[1][1];
+	normal[1] = e[0][2]*e[1][0] - e[0][0]*e[1][2];
+	normal[2] = e[0][0]*e[1][1] - e[0][1]*e[1][0];
+
+	Real dist = normal[0]*v[0][0] + normal[1]*v[0][1] + normal[2]*v[0][2];
+	Real rad = half[0]*fabs(normal[0]) + half[1]*fabs(normal[1]) +
+		half[2]*fabs(normal[2]);
+
+	return fabs(dist) <= rad;
+}
+
+/**
+ * Squared distance from point to closest point on triangle (Ericson, Real-
+ *  Time Collision Detection 5.1.5).
+ *
+ * \param entry Entry of triangle in coords.
+ * \param[in] point Point to measure from.
+ *
+ * \return Squared distance.
+ */
+template <typename Real>
+Real Bvh<Real>::distanceToTriangle2(uint32_t entry, const Real point[3]) const
+{
+	const Real* a = &coords[9 * entry];
+	const Real* b = a + 3;
+	const Real* c = a + 6;
+	Real ab[3], ac[3], ap[3], bp[3], cp[3], closest[3];
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		ab[axis] = b[axis] - a[axis];
+		ac[axis] = c[axis] - a[axis];
+		ap[axis] = point[axis] - a[axis];
+		bp[axis] = point[axis] - b[axis];
+		cp[axis] = point[axis] - c[axis];
+	}
+
+#define DOT(x, y) ((x)[0]*(y)[0] + (x)[1]*(y)[1] + (x)[2]*(y)[2])
+	Real d1 = DOT(ab, ap), d2 = DOT(ac, ap);
+	Real d3 = DOT(ab, bp), d4 = DOT(ac, bp);
+	Real d5 = DOT(ab, cp), d6 = DOT(ac, cp);
+#undef DOT
+	Real va = d3*d6 - d5*d4;
+	Real vb = d5*d2 - d1*d6;
+	Real vc = d1*d4 - d3*d2;
+	Real s = 0, t = 0;
+
+	if (d1 <= 0 && d2 <= 0)
+	{
+		// Vertex a region
+	}
+	else if (d3 >= 0 && d4 <= d3)
+	{
+		s = 1;
+	}
+	else if (d6 >= 0 && d5 <= d6)
+	{
+		t = 1;
+	}
+	else if (vc <= 0 && d1 >= 0 && d3 <= 0)
+	{
+		s = d1 / (d1 - d3);
+	}
+	else if (vb <= 0 && d2 >= 0 && d6 <= 0)
+	{
+		t = d2 / (d2 - d6);
+	}
+	else if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+	{
+		t = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		s = 1 - t;
+	}
+	else
+	{
+		Real denom = 1 / (va + vb + vc);
+		s = vb * denom;
+		t = vc * denom;
+	}
+
+	Real dist2 = 0;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		closest[axis] = a[axis] + s * ab[axis] + t * ac[axis];
+		dist2 += (point[axis] - closest[axis]) *
+			(point[axis] - closest[axis]);
+	}
+
+	return dist2;
+}
+
+template class Bvh<float>;
+template class Bvh<double>;
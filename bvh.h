@@ -0,0 +1,79 @@
+/**
+ * \file bvh.h
+ * \brief Bounding volume hierarchy over triangles for point, ray and box
+ *	queries.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _BVH_
+#define _BVH_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Hierarchy over triangles with coordinates in Real, which is float or double.
+ *  Node bounds are always float, rounded outwards, to keep nodes small;
+ *  triangles themselves are tested at full precision.
+ */
+template <typename Real>
+class Bvh
+{
+public:
+	Bvh();
+
+	void build(const Real* coords, size_t count, unsigned numThreads);
+	void clear();
+
+	bool isBuilt() const;
+	size_t getNodeCount() const;
+
+	bool intersectRay(const Real origin[3], const Real dir[3],
+		Real maxDist, uint32_t& triangle, Real& dist) const;
+	void queryBox(const Real min[3], const Real max[3],
+		std::vector<uint32_t>& triangles) const;
+	void queryPoint(const Real point[3], Real tolerance,
+		std::vector<uint32_t>& triangles) const;
+
+private:
+	/**
+	 * Node of the hierarchy. Nodes are stored in depth first order so the
+	 *  left child of an interior node is always the next node. 32 bytes
+	 *  so two nodes share a cache line.
+	 */
+	struct Node
+	{
+		float min[3]; //!< Minimum corner of bounding box.
+		uint32_t offset; //!< Leaf: first entry in indices. Interior:
+			//!< index of right child.
+		float max[3]; //!< Maximum corner of bounding box.
+		uint32_t count; //!< Number of triangles in leaf. 0 for interior
+			//!< nodes.
+	};
+
+	void buildNode(uint32_t begin, uint32_t end, std::vector<Node>& out,
+		unsigned depth);
+	void appendSubtree(std::vector<Node>& out,
+		const std::vector<Node>& subtree);
+
+	bool triangleOverlapsBox(uint32_t entry, const Real center[3],
+		const Real half[3]) const;
+	Real distanceToTriangle2(uint32_t entry, const Real point[3]) const;
+
+	std::vector<Node> nodes; //!< Flattened hierarchy. Root is node 0.
+
+	std::vector<uint32_t> indices; //!< Triangle id of each entry. Leaves
+		//!< refer to contiguous ranges of entries.
+
+	std::vector<Real> coords; //!< 9 coordinates per entry, in the same
+		//!< order as indices so leaf triangles are contiguous.
+
+	std::vector<float> bounds; //!< Only used during build. Bounding box
+		//!< (min xyz, max xyz) and centroid of each triangle.
+
+	unsigned spawnDepth; //!< Only used during build. Subtrees above this
+		//!< depth are built on their own thread.
+};
+
+#endif /* _BVH_ */
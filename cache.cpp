@@ -0,0 +1,691 @@
+/**
+ * \file cache.cpp
+ * \brief On disk cache of conversion results, keyed by a hash of the input
+ *	file and the settings it was converted with, so that batch runs can
+ *	skip models that have not changed since they were last converted.
+ * \author Gregory Gluszek.
+ */
+
+#include "cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+
+#define HASH_PRIME1 0x9E3779B185EBCA87ULL //!< Multipliers of the hash, as
+#define HASH_PRIME2 0xC2B2AE3D27D4EB4FULL //!< used by xxHash64, chosen for
+#define HASH_PRIME3 0x165667B19E3779F9ULL //!< good bit mixing.
+#define HASH_PRIME4 0x85EBCA77C2B2AE63ULL
+#define HASH_PRIME5 0x27D4EB2F165667C5ULL
+
+#define CACHE_COPY_BYTES 65536 //!< Size of buffer files are copied with.
+#define CACHE_INDEX "index" //!< File in each entry listing recipe and files.
+#define CACHE_REPORT "report" //!< File in each entry holding printed text.
+
+std::atomic<uint32_t> ResultCache::nextTemp(0);
+
+/**
+ * \param value Value to rotate.
+ * \param bits Number of bits to rotate left by.
+ *
+ * \return value rotated left.
+ */
+static inline uint64_t rotateLeft(uint64_t value, int bits)
+{
+	return (value << bits) | (value >> (64 - bits));
+}
+
+/**
+ * \param[in] data Pointer to 8 bytes, with any alignment.
+ *
+ * \return Bytes read as a little endian 64 bit value.
+ */
+static inline uint64_t read64(const uint8_t* data)
+{
+	uint64_t value;
+
+	memcpy(&value, data, sizeof(value));
+
+	return value;
+}
+
+/**
+ * \param[in] data Pointer to 4 bytes, with any alignment.
+ *
+ * \return Bytes read as a little endian 32 bit value.
+ */
+static inline uint32_t read32(const uint8_t* data)
+{
+	uint32_t value;
+
+	memcpy(&value, data, sizeof(value));
+
+	return value;
+}
+
+/**
+ * Mix 8 bytes of input into one lane of the hash.
+ *
+ * \param lane Current value of lane.
+ * \param input Input to mix in.
+ *
+ * \return New value of lane.
+ */
+static inline uint64_t hashRound(uint64_t lane, uint64_t input)
+{
+	lane += input * HASH_PRIME2;
+	lane = rotateLeft(lane, 31);
+
+	return lane * HASH_PRIME1;
+}
+
+/**
+ * Fold a finished lane into the combined hash.
+ *
+ * \param hash Combined hash so far.
+ * \param lane Lane to fold in.
+ *
+ * \return New combined hash.
+ */
+static inline uint64_t hashMergeLane(uint64_t hash, uint64_t lane)
+{
+	hash ^= hashRound(0, lane);
+
+	return hash * HASH_PRIME1 + HASH_PRIME4;
+}
+
+/**
+ * Fast non-cryptographic 64 bit hash, the xxHash64 algorithm. Input is taken
+ *  32 bytes at a time across four independent lanes, which keeps the
+ *  multipliers busy enough to hash about as fast as memory can be read.
+ *
+ * \param[in] data Bytes to hash.
+ * \param size Number of bytes.
+ * \param seed Starting value, so that the hash of one thing can be chained
+ *	into the hash of the next.
+ *
+ * \return Hash of bytes.
+ */
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* pos = (const uint8_t*)data;
+	const uint8_t* end = pos + size;
+	uint64_t hash;
+
+	if (size >= 32)
+	{
+		uint64_t lanes[4] = {seed + HASH_PRIME1 + HASH_PRIME2,
+			seed + HASH_PRIME2, seed, seed - HASH_PRIME1};
+
+		for (; pos + 32 <= end; pos += 32)
+		{
+			lanes[0] = hashRound(lanes[0], read64(pos));
+			lanes[1] = hashRound(lanes[1], read64(pos + 8));
+			lanes[2] = hashRound(lanes[2], read64(pos + 16));
+			lanes[3] = hashRound(lanes[3], read64(pos + 24));
+		}
+
+		hash = rotateLeft(lanes[0], 1) + rotateLeft(lanes[1], 7) +
+			rotateLeft(lanes[2], 12) + rotateLeft(lanes[3], 18);
+		for (int cnt = 0; cnt < 4; cnt++)
+			hash = hashMergeLane(hash, lanes[cnt]);
+	}
+	else
+		hash = seed + HASH_PRIME5;
+
+	hash += (uint64_t)size;
+
+	// Tail of less than 32 bytes
+	for (; pos + 8 <= end; pos += 8)
+	{
+		hash ^= hashRound(0, read64(pos));
+		hash = rotateLeft(hash, 27) * HASH_PRIME1 + HASH_PRIME4;
+	}
+
+	if (pos + 4 <= end)
+	{
+		hash ^= (uint64_t)read32(pos) * HASH_PRIME1;
+		hash = rotateLeft(hash, 23) * HASH_PRIME2 + HASH_PRIME3;
+		pos += 4;
+	}
+
+	for (; pos < end; pos++)
+	{
+		hash ^= (uint64_t)*pos * HASH_PRIME5;
+		hash = rotateLeft(hash, 11) * HASH_PRIME1;
+	}
+
+	// Spread the last bits added across the whole hash
+	hash ^= hash >> 33;
+	hash *= HASH_PRIME2;
+	hash ^= hash >> 29;
+	hash *= HASH_PRIME3;
+	hash ^= hash >> 32;
+
+	return hash;
+}
+
+/**
+ * Hash the contents of a file. The file is mapped rather than read, so the
+ *  hash streams straight over the page cache without copying.
+ *
+ * \param[in] filename File to hash.
+ * \param[out] hash Hash of file's bytes.
+ *
+ * \return True on success. False if file could not be opened or mapped.
+ */
+bool hashFile(const char* filename, uint64_t& hash)
+{
+	int fd = open(filename, O_RDONLY);
+	struct stat info;
+
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &info) || !S_ISREG(info.st_mode))
+	{
+		close(fd);
+		return false;
+	}
+
+	size_t size = (size_t)info.st_size;
+
+	if (!size)
+	{
+		close(fd);
+		hash = hashBytes(NULL, 0, 0);
+		return true;
+	}
+
+	void* data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+
+	madvise(data, size, MADV_SEQUENTIAL);
+	hash = hashBytes(data, size, 0);
+	munmap(data, size);
+
+	return true;
+}
+
+/**
+ * Constructor. Directory is created if it does not exist yet, else entries 
+ *  already in it are counted and any over the limit evicted.
+ *
+ * \param[in] dir Directory to keep entries in.
+ * \param maxBytes Most space entries may take up together.
+ */
+ResultCache::ResultCache(const std::string& dir, uint64_t maxBytes)
+: dir(dir)
+, maxBytes(maxBytes)
+, totalBytes(0)
+{
+	if (mkdir(dir.c_str(), 0777) && errno != EEXIST)
+	{
+		fprintf(stderr, "Failed to create cache directory \"%s\".\n",
+			dir.c_str());
+		//TODO: add proper exception throwing
+		exit(EXIT_FAILURE);
+	}
+
+	scan();
+	evict();
+}
+
+/**
+ * Build the key a conversion is cached under.
+ *
+ * \param[in] filename Input file.
+ * \param[in] recipe Everything besides the input that affects what the
+ *	conversion writes, i.e. its settings and output file names.
+ * \param[out] ok False if input file could not be hashed.
+ *
+ * \return Key of conversion.
+ */
+uint64_t ResultCache::makeKey(const char* filename, const std::string& recipe,
+	bool& ok)
+{
+	uint64_t hash = 0;
+
+	ok = hashFile(filename, hash);
+
+	return hashBytes(recipe.data(), recipe.size(), hash);
+}
+
+/**
+ * Build the key a conversion of a file already read into memory is cached
+ *  under. Gives the same key as hashing the file itself.
+ *
+ * \param[in] data Contents of input file.
+ * \param size Number of bytes in data.
+ * \param[in] recipe Everything besides the input that affects what the
+ *	conversion writes.
+ *
+ * \return Key of conversion.
+ */
+uint64_t ResultCache::makeKey(const uint8_t* data, size_t size,
+	const std::string& recipe)
+{
+	uint64_t hash = hashBytes(data, size, 0);
+
+	return hashBytes(recipe.data(), recipe.size(), hash);
+}
+
+/**
+ * Put back the files of a cached conversion, if there is one. Files are
+ *  copied next to where the conversion wrote them under temporary names, 
+ *  and only renamed into place once all of them are copied, so an entry 
+ *  evicted by another process part way through leaves earlier outputs 
+ *  alone. The entry is then marked as recently used.
+ *
+ * \param key Key of conversion, from makeKey().
+ * \param[in] recipe Recipe key was made from. Checked against the entry so
+ *	that a hash collision is not mistaken for a hit.
+ * \param[out] report Text conversion printed.
+ *
+ * \return True if entry was found and restored.
+ */
+bool ResultCache::restore(uint64_t key, const std::string& recipe,
+	std::string& report)
+{
+	std::string path = getEntryPath(key);
+	std::string index;
+
+	if (!readText(path + "/" CACHE_INDEX, index))
+		return false;
+
+	// First line is the recipe, then one line per file
+	size_t line_end = index.find('\n');
+
+	if (line_end == std::string::npos ||
+		index.compare(0, line_end, recipe) != 0)
+		return false;
+
+	if (!readText(path + "/" CACHE_REPORT, report))
+		return false;
+
+	std::string suffix = "." + std::to_string(getpid()) + "." + 
+		std::to_string(nextTemp++);
+	std::vector<std::string> files;
+	bool ok = true;
+
+	for (size_t start = line_end + 1; ok && start < index.size();
+		start = line_end + 1)
+	{
+		line_end = index.find('\n', start);
+		if (line_end == std::string::npos)
+		{
+			ok = false;
+			break;
+		}
+
+		files.push_back(index.substr(start, line_end - start));
+
+		// Entry may have been evicted by another process part way
+		ok = copyFile(path + "/" + std::to_string(files.size() - 1),
+			files.back() + suffix);
+	}
+
+	for (size_t cnt = 0; cnt < files.size(); cnt++)
+	{
+		std::string tmp_file = files[cnt] + suffix;
+
+		if (!ok)
+			unlink(tmp_file.c_str());
+		else if (rename(tmp_file.c_str(), files[cnt].c_str()))
+		{
+			// Only renames within a directory are left, so this is
+			//  unlikely, and the conversion being redone rewrites
+			//  every file anyway
+			ok = false;
+			unlink(tmp_file.c_str());
+		}
+	}
+
+	if (!ok)
+		return false;
+
+	utimensat(AT_FDCWD, (path + "/" CACHE_INDEX).c_str(), NULL, 0);
+
+	// Entry may have been added by another process since the cache was 
+	//  scanned
+	uint64_t bytes = 0;
+	int64_t used_ns = 0;
+
+	if (getEntrySize(path, bytes, used_ns))
+		use(key, bytes, false);
+
+	return true;
+}
+
+/**
+ * Add a conversion to the cache, then evict least recently used entries
+ *  until the running total fits the limit. Failing to store is not an error, it only
+ *  means the conversion will be done again next time.
+ *
+ * \param key Key of conversion, from makeKey().
+ * \param[in] recipe Recipe key was made from.
+ * \param[in] files Every file conversion wrote.
+ * \param[in] report Text conversion printed.
+ *
+ * \return None.
+ */
+void ResultCache::store(uint64_t key, const std::string& recipe,
+	const std::vector<std::string>& files, const std::string& report)
+{
+	std::string path = getEntryPath(key);
+	std::string tmp_path = path + "." + std::to_string(getpid()) + "." +
+		std::to_string(nextTemp++);
+	std::string index = recipe + "\n";
+	bool ok = !mkdir(tmp_path.c_str(), 0777);
+
+	for (size_t cnt = 0; cnt < files.size() && ok; cnt++)
+	{
+		ok = copyFile(files[cnt], tmp_path + "/" + std::to_string(cnt));
+		index += files[cnt] + "\n";
+	}
+
+	ok = ok && writeText(tmp_path + "/" CACHE_REPORT, report) &&
+		writeText(tmp_path + "/" CACHE_INDEX, index);
+
+	uint64_t bytes = 0;
+	int64_t used_ns = 0;
+
+	ok = ok && getEntrySize(tmp_path, bytes, used_ns);
+
+	// Replace any stale entry. Renaming fails if another thread or 
+	//  process stored the same entry in between, which is as good.
+	if (ok)
+	{
+		removeEntry(path);
+		if (rename(tmp_path.c_str(), path.c_str()))
+		{
+			ok = errno == EEXIST || errno == ENOTEMPTY;
+			removeEntry(tmp_path);
+		}
+	}
+
+	if (!ok)
+	{
+		fprintf(stderr, "Failed to add results to cache \"%s\".\n",
+			dir.c_str());
+		removeEntry(tmp_path);
+		return;
+	}
+
+	use(key, bytes, true);
+	evict();
+}
+
+/**
+ * \param key Key of conversion.
+ *
+ * \return Path of entry's directory.
+ */
+std::string ResultCache::getEntryPath(uint64_t key) const
+{
+	char name[17];
+
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)key);
+
+	return dir + "/" + name;
+}
+
+/**
+ * Find the entries already in the cache directory, and how big and how 
+ *  recently used each is. Entries still being written by other processes
+ *  are left out.
+ *
+ * \return None.
+ */
+void ResultCache::scan()
+{
+	DIR* cache_dir = opendir(dir.c_str());
+	std::vector<Entry> found;
+	struct dirent* item;
+
+	if (!cache_dir)
+		return;
+
+	while ((item = readdir(cache_dir)))
+	{
+		char* end = NULL;
+		Entry entry;
+
+		// Finished entries are named by key alone
+		if (strlen(item->d_name) != 16)
+			continue;
+
+		entry.key = strtoull(item->d_name, &end, 16);
+		if (*end || !getEntrySize(dir + "/" + item->d_name, entry.bytes,
+			entry.usedNs))
+			continue;
+
+		found.push_back(entry);
+	}
+
+	closedir(cache_dir);
+
+	std::sort(found.begin(), found.end(),
+		[](const Entry& lhs, const Entry& rhs)
+		{
+			return lhs.usedNs < rhs.usedNs;
+		});
+
+	std::lock_guard<std::mutex> lock(mutex);
+
+	for (size_t cnt = 0; cnt < found.size(); cnt++)
+	{
+		lookup[found[cnt].key] = entries.insert(entries.end(), found[cnt]);
+		totalBytes += found[cnt].bytes;
+	}
+}
+
+/**
+ * Mark an entry as the most recently used, adding it to the running total
+ *  if it is not known yet.
+ *
+ * \param key Key of entry.
+ * \param bytes Total size of entry's files.
+ * \param replace True if entry's files were written again, so its size may
+ *	have changed.
+ *
+ * \return None.
+ */
+void ResultCache::use(uint64_t key, uint64_t bytes, bool replace)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unordered_map<uint64_t, std::list<Entry>::iterator>::iterator 
+		found = lookup.find(key);
+
+	if (found != lookup.end())
+	{
+		entries.splice(entries.end(), entries, found->second);
+		if (replace)
+		{
+			totalBytes += bytes - found->second->bytes;
+			found->second->bytes = bytes;
+		}
+		return;
+	}
+
+	Entry entry = {key, bytes, 0};
+
+	lookup[key] = entries.insert(entries.end(), entry);
+	totalBytes += bytes;
+}
+
+/**
+ * Remove least recently used entries until the running total is no bigger 
+ *  than maxBytes.
+ *
+ * \return None.
+ */
+void ResultCache::evict()
+{
+	std::vector<uint64_t> evicted;
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		while (totalBytes > maxBytes && !entries.empty())
+		{
+			evicted.push_back(entries.front().key);
+			totalBytes -= entries.front().bytes;
+			lookup.erase(entries.front().key);
+			entries.pop_front();
+		}
+	}
+
+	// Files are removed without holding the lock
+	for (size_t cnt = 0; cnt < evicted.size(); cnt++)
+		removeEntry(getEntryPath(evicted[cnt]));
+}
+
+/**
+ * \param[in] path Path of entry.
+ * \param[out] bytes Total size of entry's files.
+ * \param[out] usedNs Last time entry was written or restored, in 
+ *	nanoseconds.
+ *
+ * \return True if entry exists.
+ */
+bool ResultCache::getEntrySize(const std::string& path, uint64_t& bytes,
+	int64_t& usedNs)
+{
+	DIR* entry_dir = opendir(path.c_str());
+	struct dirent* file;
+	struct stat info;
+
+	if (!entry_dir)
+		return false;
+
+	bytes = 0;
+	usedNs = 0;
+	while ((file = readdir(entry_dir)))
+	{
+		std::string file_path = path + "/" + file->d_name;
+
+		if (file->d_name[0] == '.' || stat(file_path.c_str(), &info))
+			continue;
+
+		bytes += (uint64_t)info.st_size;
+		if (!strcmp(file->d_name, CACHE_INDEX))
+			usedNs = (int64_t)info.st_mtim.tv_sec * 1000000000 + 
+				info.st_mtim.tv_nsec;
+	}
+
+	closedir(entry_dir);
+
+	return true;
+}
+
+/**
+ * \param[in] from File to copy.
+ * \param[in] to File to create or overwrite.
+ *
+ * \return True on success.
+ */
+bool ResultCache::copyFile(const std::string& from, const std::string& to)
+{
+	FILE* in = fopen(from.c_str(), "rb");
+	char buffer[CACHE_COPY_BYTES];
+	bool ok = true;
+	size_t num_read;
+
+	if (!in)
+		return false;
+
+	FILE* out = fopen(to.c_str(), "wb");
+
+	if (!out)
+	{
+		fclose(in);
+		return false;
+	}
+
+	while (ok && (num_read = fread(buffer, 1, sizeof(buffer), in)))
+		ok = fwrite(buffer, 1, num_read, out) == num_read;
+
+	ok = ok && !ferror(in);
+	fclose(in);
+
+	return !fclose(out) && ok;
+}
+
+/**
+ * \param[in] filename File to read.
+ * \param[out] text Contents of file.
+ *
+ * \return True on success.
+ */
+bool ResultCache::readText(const std::string& filename, std::string& text)
+{
+	FILE* file = fopen(filename.c_str(), "rb");
+	char buffer[4096];
+	size_t num_read;
+
+	if (!file)
+		return false;
+
+	text.clear();
+	while ((num_read = fread(buffer, 1, sizeof(buffer), file)))
+		text.append(buffer, num_read);
+
+	bool ok = !ferror(file);
+
+	fclose(file);
+
+	return ok;
+}
+
+/**
+ * \param[in] filename File to create or overwrite.
+ * \param[in] text Contents to write.
+ *
+ * \return True on success.
+ */
+bool ResultCache::writeText(const std::string& filename,
+	const std::string& text)
+{
+	FILE* file = fopen(filename.c_str(), "wb");
+
+	if (!file)
+		return false;
+
+	bool ok = fwrite(text.data(), 1, text.size(), file) == text.size();
+
+	return !fclose(file) && ok;
+}
+
+/**
+ * Delete an entry's directory and the files in it, if it exists.
+ *
+ * \param[in] path Path of entry.
+ *
+ * \return None.
+ */
+void ResultCache::removeEntry(const std::string& path)
+{
+	DIR* entry_dir = opendir(path.c_str());
+	struct dirent* file;
+
+	if (!entry_dir)
+		return;
+
+	while ((file = readdir(entry_dir)))
+		if (file->d_name[0] != '.')
+			unlink((path + "/" + file->d_name).c_str());
+
+	closedir(entry_dir);
+	rmdir(path.c_str());
+}
@@ -0,0 +1,94 @@
+/**
+ * \file cache.h
+ * \brief On disk cache of conversion results, keyed by a hash of the input
+ *	file and the settings it was converted with, so that batch runs can
+ *	skip models that have not changed since they were last converted.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _CACHE_
+#define _CACHE_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
+
+#define CACHE_DEFAULT_MAX_MB 1024 //!< Size cache is kept under when not set,
+	//!< in megabytes.
+
+uint64_t hashBytes(const void* data, size_t size, uint64_t seed);
+bool hashFile(const char* filename, uint64_t& hash);
+
+/**
+ * Directory of results, one subdirectory per entry named by its key. Each
+ *  entry holds a copy of every file a conversion wrote, along with where it
+ *  was written and text the conversion printed, so that a hit puts back
+ *  exactly what the conversion would have produced.
+ *
+ * Entries are written under a temporary name and renamed into place, so
+ *  several processes or threads can share a cache without seeing half 
+ *  written entries. The cache is scanned once when opened, and from then on
+ *  a running total of the size of entries is kept. Whenever the cache is 
+ *  opened or an entry is added, the least recently used entries are removed
+ *  until the total is no bigger than the limit. Entries other processes add
+ *  are only counted once this one restores them.
+ */
+class ResultCache
+{
+public:
+	ResultCache(const std::string& dir, uint64_t maxBytes);
+
+	static uint64_t makeKey(const char* filename, const std::string& recipe,
+		bool& ok);
+	static uint64_t makeKey(const uint8_t* data, size_t size,
+		const std::string& recipe);
+
+	bool restore(uint64_t key, const std::string& recipe,
+		std::string& report);
+	void store(uint64_t key, const std::string& recipe,
+		const std::vector<std::string>& files, const std::string& report);
+
+private:
+	/**
+	 * Entry known to be in the cache.
+	 */
+	struct Entry
+	{
+		uint64_t key; //!< Key entry's subdirectory is named by.
+		uint64_t bytes; //!< Total size of entry's files.
+		int64_t usedNs; //!< Last time entry was written or restored.
+	};
+
+	std::string getEntryPath(uint64_t key) const;
+	void scan();
+	void use(uint64_t key, uint64_t bytes, bool replace);
+	void evict();
+
+	static bool getEntrySize(const std::string& path, uint64_t& bytes,
+		int64_t& usedNs);
+
+	static bool copyFile(const std::string& from, const std::string& to);
+	static bool readText(const std::string& filename, std::string& text);
+	static bool writeText(const std::string& filename,
+		const std::string& text);
+	static void removeEntry(const std::string& path);
+
+	std::string dir; //!< Directory entries are kept in.
+	uint64_t maxBytes; //!< Most space entries may take up together.
+
+	std::mutex mutex; //!< Guards entries, lookup and totalBytes.
+	std::list<Entry> entries; //!< Entries, least recently used first.
+	std::unordered_map<uint64_t, std::list<Entry>::iterator> lookup; 
+		//!< Where each key's entry is in entries.
+	uint64_t totalBytes; //!< Size of all entries together.
+
+	static std::atomic<uint32_t> nextTemp; //!< Number of next temporary 
+		//!< entry, so threads storing at once use different names.
+};
+
+#endif /* _CACHE_ */
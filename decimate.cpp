@@ -0,0 +1,769 @@
+/**
+ * \file decimate.cpp
+ * \brief Mesh simplification by edge collapse ordered by quadric error.
+ *
+ * Each vertex carries a quadric that measures the summed squared distance to
+ *  the planes of the triangles originally around it (Garland and Heckbert).
+ *  Edges are collapsed cheapest first from a priority queue. The merged
+ *  vertex is placed where the summed quadric is smallest. On a noisy but
+ *  nearly flat panel that error stays tiny, so the panel collapses into a
+ *  few large triangles. Corners and creases cost a lot and are kept.
+ *
+ * \author Gregory Gluszek.
+ */
+
+#include "decimate.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+
+#define DECIMATE_MIN_NORMAL_DOT 0.5 //!< Collapses that tilt any remaining
+	//!< triangle by more than about 60 degrees are rejected, which also
+	//!< rejects fold overs.
+
+#define DECIMATE_MIN_RATIO 1e-4 //!< Collapses that leave a triangle whose
+	//!< doubled area is not more than this times the square of its longest
+	//!< edge are rejected, so slivers are not created.
+
+#define DECIMATE_MAX_DRIFT 2.0 //!< Optimal positions further than this many
+	//!< edge lengths from the middle of the edge are not trusted. Happens
+	//!< when the quadric is close to singular (e.g. on flat areas).
+
+#define DECIMATE_BOUNDARY_WEIGHT 1.0 //!< Weight of planes that hold free
+	//!< boundaries in shape, relative to the square of the edge length.
+
+/**
+ * Constructor.
+ */
+template <typename Real>
+Decimator<Real>::Decimator()
+: positions(NULL)
+, indices(NULL)
+, liveTriangles(0)
+, collapses(0)
+{
+}
+
+/**
+ * Simplify a triangle mesh in place. Collapses continue until the triangle
+ *  budget is reached or the cheapest collapse would exceed the error limit,
+ *  whichever comes first.
+ *
+ * \param[inout] positions x, y, z of each vertex. Moved vertices are updated.
+ *	Vertices that are merged away are left in place but no longer used.
+ * \param[inout] indices 3 vertex indices per triangle. Compacted to the
+ *	triangles that remain, in their original order.
+ * \param maxError Largest allowed error, as a distance in model units. 0 for
+ *	no limit.
+ * \param targetTriangles Stop once no more than this many triangles are
+ *	left. 0 for no budget.
+ * \param keepBoundaries If true, vertices on open edges are never moved or
+ *	removed. Vertices on non-manifold edges are always kept.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Decimator<Real>::decimate(std::vector<Real>& positions,
+	std::vector<uint32_t>& indices, float maxError, size_t targetTriangles,
+	bool keepBoundaries)
+{
+	size_t num_vertices = positions.size() / 3;
+	size_t num_triangles = indices.size() / 3;
+	double max_cost = (double)maxError * maxError;
+
+	this->positions = &positions;
+	this->indices = &indices;
+
+	quadrics.assign(num_vertices, Quadric());
+	vertexTriangles.assign(num_vertices, std::vector<uint32_t>());
+	versions.assign(num_vertices, 0);
+	locked.assign(num_vertices, 0);
+	removedVertices.assign(num_vertices, 0);
+	removedTriangles.assign(num_triangles, 0);
+	moved.assign(num_vertices, 0);
+	queue = std::priority_queue<Candidate>();
+	liveTriangles = num_triangles;
+	collapses = 0;
+
+	for (size_t cnt = 0; cnt < num_vertices; cnt++)
+	{
+		memset(quadrics[cnt].q, 0, sizeof(quadrics[cnt].q));
+		quadrics[cnt].area = 0;
+	}
+
+	// Plane of each triangle goes into the quadric of its vertices
+	for (size_t tri = 0; tri < num_triangles; tri++)
+	{
+		const Real* p[3];
+		double e1[3], e2[3], n[3];
+
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			uint32_t id = indices[3*tri + vtx];
+
+			p[vtx] = &positions[3 * (size_t)id];
+			vertexTriangles[id].push_back((uint32_t)tri);
+		}
+
+		for (int cnt = 0; cnt < 3; cnt++)
+		{
+			e1[cnt] = (double)p[1][cnt] - p[0][cnt];
+			e2[cnt] = (double)p[2][cnt] - p[0][cnt];
+		}
+
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+		double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		if (!(len > 0))
+			continue;
+
+		for (int cnt = 0; cnt < 3; cnt++)
+			n[cnt] /= len;
+
+		// Weight by area so many small triangles do not outvote a few
+		//  large ones
+		double d = -(n[0] * p[0][0] + n[1] * p[0][1] + n[2] * p[0][2]);
+		double area = len / 2;
+		Quadric plane;
+
+		plane.q[0] = area * n[0] * n[0];
+		plane.q[1] = area * n[0] * n[1];
+		plane.q[2] = area * n[0] * n[2];
+		plane.q[3] = area * n[0] * d;
+		plane.q[4] = area * n[1] * n[1];
+		plane.q[5] = area * n[1] * n[2];
+		plane.q[6] = area * n[1] * d;
+		plane.q[7] = area * n[2] * n[2];
+		plane.q[8] = area * n[2] * d;
+		plane.q[9] = area * d * d;
+		plane.area = area;
+
+		for (int vtx = 0; vtx < 3; vtx++)
+			addQuadric(quadrics[indices[3*tri + vtx]], plane);
+	}
+
+	// Find unique edges and how many triangles use each. Edges not shared
+	//  by exactly two triangles lock their vertices in place.
+	std::vector<uint64_t> edges;
+
+	edges.reserve(3 * num_triangles);
+	for (size_t tri = 0; tri < num_triangles; tri++)
+	{
+		for (int cnt = 0; cnt < 3; cnt++)
+		{
+			uint64_t vtx1 = indices[3*tri + cnt];
+			uint64_t vtx2 = indices[3*tri + (cnt + 1) % 3];
+
+			edges.push_back(vtx1 < vtx2 ? (vtx1 << 32 | vtx2) :
+				(vtx2 << 32 | vtx1));
+		}
+	}
+
+	std::sort(edges.begin(), edges.end());
+
+	for (size_t first = 0, last = 0; first < edges.size(); first = last)
+	{
+		uint32_t vtx1 = (uint32_t)(edges[first] >> 32);
+		uint32_t vtx2 = (uint32_t)edges[first];
+
+		while (last < edges.size() && edges[last] == edges[first])
+			last++;
+
+		if (last - first > 2 || (keepBoundaries && last - first == 1))
+		{
+			locked[vtx1] = 1;
+			locked[vtx2] = 1;
+		}
+	}
+
+	// Free boundaries would have no cost to shrink, so give each open edge
+	//  a plane through it at right angles to its triangle
+	for (size_t tri = 0; !keepBoundaries && tri < num_triangles; tri++)
+	{
+		for (int cnt = 0; cnt < 3; cnt++)
+		{
+			uint32_t vtx1 = indices[3*tri + cnt];
+			uint32_t vtx2 = indices[3*tri + (cnt + 1) % 3];
+			uint32_t vtx3 = indices[3*tri + (cnt + 2) % 3];
+			uint64_t key = vtx1 < vtx2 ? ((uint64_t)vtx1 << 32 | vtx2) :
+				((uint64_t)vtx2 << 32 | vtx1);
+
+			if (std::upper_bound(edges.begin(), edges.end(), key) -
+				std::lower_bound(edges.begin(), edges.end(), key) != 1)
+				continue;
+
+			addBoundaryPlane(&positions[3 * (size_t)vtx1],
+				&positions[3 * (size_t)vtx2],
+				&positions[3 * (size_t)vtx3], vtx1, vtx2);
+		}
+	}
+
+	for (size_t first = 0, last = 0; first < edges.size(); first = last)
+	{
+		Candidate candidate;
+
+		while (last < edges.size() && edges[last] == edges[first])
+			last++;
+
+		if (evaluate((uint32_t)(edges[first] >> 32),
+			(uint32_t)edges[first], candidate))
+			queue.push(candidate);
+	}
+
+	std::vector<uint64_t>().swap(edges);
+
+	// Collapse cheapest edges first
+	while (!queue.empty())
+	{
+		if (targetTriangles && liveTriangles <= targetTriangles)
+			break;
+
+		Candidate candidate = queue.top();
+
+		if (maxError > 0 && candidate.cost > max_cost)
+			break;
+
+		queue.pop();
+
+		if (collapse(candidate))
+		{
+			collapses++;
+			pushEdges(candidate.keep);
+		}
+	}
+
+	queue = std::priority_queue<Candidate>();
+
+	// Compact remaining triangles
+	size_t kept = 0;
+
+	triangleMap.clear();
+	triangleMap.reserve(liveTriangles);
+	for (size_t tri = 0; tri < num_triangles; tri++)
+	{
+		if (removedTriangles[tri])
+			continue;
+
+		triangleMap.push_back((uint32_t)tri);
+		for (int vtx = 0; vtx < 3; vtx++)
+			indices[3*kept + vtx] = indices[3*tri + vtx];
+		kept++;
+	}
+
+	indices.resize(3 * kept);
+
+	std::vector<Quadric>().swap(quadrics);
+	std::vector<std::vector<uint32_t> >().swap(vertexTriangles);
+}
+
+/**
+ * \return Index before decimation of each triangle left after decimation.
+ */
+template <typename Real>
+const std::vector<uint32_t>& Decimator<Real>::getTriangleMap() const
+{
+	return triangleMap;
+}
+
+/**
+ * \return Per vertex flag set if the vertex was moved by a collapse.
+ */
+template <typename Real>
+const std::vector<uint8_t>& Decimator<Real>::getMovedVertices() const
+{
+	return moved;
+}
+
+/**
+ * \return Number of edge collapses made by the last decimate().
+ */
+template <typename Real>
+size_t Decimator<Real>::getCollapseCount() const
+{
+	return collapses;
+}
+
+/**
+ * Add plane through an open edge, at right angles to the triangle it is on,
+ *  to the quadrics of the edge's vertices.
+ *
+ * \param[in] p1 Position of start of edge.
+ * \param[in] p2 Position of end of edge.
+ * \param[in] p3 Position of third vertex of triangle.
+ * \param vtx1 Index of start of edge.
+ * \param vtx2 Index of end of edge.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Decimator<Real>::addBoundaryPlane(const Real p1[3], const Real p2[3],
+	const Real p3[3], uint32_t vtx1, uint32_t vtx2)
+{
+	double edge[3], other[3], tri_n[3], n[3];
+
+	for (int cnt = 0; cnt < 3; cnt++)
+	{
+		edge[cnt] = (double)p2[cnt] - p1[cnt];
+		other[cnt] = (double)p3[cnt] - p1[cnt];
+	}
+
+	tri_n[0] = edge[1] * other[2] - edge[2] * other[1];
+	tri_n[1] = edge[2] * other[0] - edge[0] * other[2];
+	tri_n[2] = edge[0] * other[1] - edge[1] * other[0];
+
+	n[0] = edge[1] * tri_n[2] - edge[2] * tri_n[1];
+	n[1] = edge[2] * tri_n[0] - edge[0] * tri_n[2];
+	n[2] = edge[0] * tri_n[1] - edge[1] * tri_n[0];
+
+	double len = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+	if (!(len > 0))
+		return;
+
+	for (int cnt = 0; cnt < 3; cnt++)
+		n[cnt] /= len;
+
+	double d = -(n[0] * p1[0] + n[1] * p1[1] + n[2] * p1[2]);
+	double weight = DECIMATE_BOUNDARY_WEIGHT * (edge[0] * edge[0] +
+		edge[1] * edge[1] + edge[2] * edge[2]);
+	Quadric plane;
+
+	plane.q[0] = weight * n[0] * n[0];
+	plane.q[1] = weight * n[0] * n[1];
+	plane.q[2] = weight * n[0] * n[2];
+	plane.q[3] = weight * n[0] * d;
+	plane.q[4] = weight * n[1] * n[1];
+	plane.q[5] = weight * n[1] * n[2];
+	plane.q[6] = weight * n[1] * d;
+	plane.q[7] = weight * n[2] * n[2];
+	plane.q[8] = weight * n[2] * d;
+	plane.q[9] = weight * d * d;
+	plane.area = 0;
+
+	addQuadric(quadrics[vtx1], plane);
+	addQuadric(quadrics[vtx2], plane);
+}
+
+/**
+ * Accumulate one quadric into another.
+ *
+ * \param[inout] dst Quadric to add to.
+ * \param[in] src Quadric to add.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Decimator<Real>::addQuadric(Quadric& dst, const Quadric& src) const
+{
+	for (int cnt = 0; cnt < 10; cnt++)
+		dst.q[cnt] += src.q[cnt];
+	dst.area += src.area;
+}
+
+/**
+ * \return Mean squared distance from position to the planes in quadric.
+ */
+template <typename Real>
+double Decimator<Real>::evalQuadric(const Quadric& quadric,
+	const double pos[3]) const
+{
+	const double* q = quadric.q;
+	double x = pos[0];
+	double y = pos[1];
+	double z = pos[2];
+
+	double sum = q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z +
+		2 * q[3] * x + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y +
+		q[7] * z * z + 2 * q[8] * z + q[9];
+
+	return quadric.area > 0 ? sum / quadric.area : 0;
+}
+
+/**
+ * Work out where two vertices would merge to and what it would cost.
+ *
+ * \param first One end of edge.
+ * \param second Other end of edge.
+ * \param[out] candidate Collapse to queue.
+ *
+ * \return False if edge must not be collapsed.
+ */
+template <typename Real>
+bool Decimator<Real>::evaluate(uint32_t first, uint32_t second,
+	Candidate& candidate) const
+{
+	const std::vector<Real>& pos = *positions;
+	uint32_t keep = std::min(first, second);
+	uint32_t remove = std::max(first, second);
+
+	if (removedVertices[keep] || removedVertices[remove])
+		return false;
+
+	if (locked[keep] && locked[remove])
+		return false;
+
+	// Locked vertex must be the one kept, and stays where it is
+	if (locked[remove])
+		std::swap(keep, remove);
+
+	Quadric quadric = quadrics[keep];
+	addQuadric(quadric, quadrics[remove]);
+
+	double ends[2][3];
+	for (int cnt = 0; cnt < 3; cnt++)
+	{
+		ends[0][cnt] = pos[3 * (size_t)keep + cnt];
+		ends[1][cnt] = pos[3 * (size_t)remove + cnt];
+	}
+
+	double best[3] = {ends[0][0], ends[0][1], ends[0][2]};
+	double best_cost = evalQuadric(quadric, best);
+
+	if (!locked[keep])
+	{
+		const double* q = quadric.q;
+		double mid[3];
+		double len2 = 0;
+
+		for (int cnt = 0; cnt < 3; cnt++)
+		{
+			mid[cnt] = (ends[0][cnt] + ends[1][cnt]) / 2;
+			len2 += (ends[1][cnt] - ends[0][cnt]) *
+				(ends[1][cnt] - ends[0][cnt]);
+		}
+
+		// Solve for minimum of quadric using Cramer's rule
+		double det = q[0] * (q[4] * q[7] - q[5] * q[5]) -
+			q[1] * (q[1] * q[7] - q[5] * q[2]) +
+			q[2] * (q[1] * q[5] - q[4] * q[2]);
+		double trace = q[0] + q[4] + q[7];
+
+		if (fabs(det) > 1e-10 * trace * trace * trace)
+		{
+			double opt[3];
+
+			opt[0] = -(q[3] * (q[4] * q[7] - q[5] * q[5]) -
+				q[1] * (q[6] * q[7] - q[5] * q[8]) +
+				q[2] * (q[6] * q[5] - q[4] * q[8])) / det;
+			opt[1] = -(q[0] * (q[6] * q[7] - q[8] * q[5]) -
+				q[3] * (q[1] * q[7] - q[5] * q[2]) +
+				q[2] * (q[1] * q[8] - q[6] * q[2])) / det;
+			opt[2] = -(q[0] * (q[4] * q[8] - q[5] * q[6]) -
+				q[1] * (q[1] * q[8] - q[6] * q[2]) +
+				q[3] * (q[1] * q[5] - q[4] * q[2])) / det;
+
+			double drift2 = 0;
+			for (int cnt = 0; cnt < 3; cnt++)
+				drift2 += (opt[cnt] - mid[cnt]) * (opt[cnt] - mid[cnt]);
+
+			if (drift2 <= DECIMATE_MAX_DRIFT * DECIMATE_MAX_DRIFT * len2)
+			{
+				double cost = evalQuadric(quadric, opt);
+
+				if (cost < best_cost)
+				{
+					best_cost = cost;
+					memcpy(best, opt, sizeof(best));
+				}
+			}
+		}
+
+		double options[2][3];
+		memcpy(options[0], ends[1], sizeof(options[0]));
+		memcpy(options[1], mid, sizeof(options[1]));
+
+		for (int opt = 0; opt < 2; opt++)
+		{
+			double cost = evalQuadric(quadric, options[opt]);
+
+			if (cost < best_cost)
+			{
+				best_cost = cost;
+				memcpy(best, options[opt], sizeof(best));
+			}
+		}
+	}
+
+	candidate.cost = std::max(best_cost, 0.0);
+	candidate.length2 = 0;
+	for (int cnt = 0; cnt < 3; cnt++)
+		candidate.length2 += (ends[1][cnt] - ends[0][cnt]) *
+			(ends[1][cnt] - ends[0][cnt]);
+	candidate.keep = keep;
+	candidate.remove = remove;
+	candidate.keepVersion = versions[keep];
+	candidate.removeVersion = versions[remove];
+	for (int cnt = 0; cnt < 3; cnt++)
+		candidate.position[cnt] = (Real)best[cnt];
+
+	return true;
+}
+
+/**
+ * Queue collapses of every edge around a vertex.
+ *
+ * \param vertex Vertex whose edges changed.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Decimator<Real>::pushEdges(uint32_t vertex)
+{
+	std::vector<uint32_t> neighbors;
+
+	liveNeighbors(vertex, neighbors);
+
+	for (size_t cnt = 0; cnt < neighbors.size(); cnt++)
+	{
+		Candidate candidate;
+
+		if (evaluate(vertex, neighbors[cnt], candidate))
+			queue.push(candidate);
+	}
+}
+
+/**
+ * Merge remove into keep, if that does not change the topology of the mesh
+ *  or flip any triangles.
+ *
+ * \param[in] candidate Collapse to make.
+ *
+ * \return True if collapse was made.
+ */
+template <typename Real>
+bool Decimator<Real>::collapse(const Candidate& candidate)
+{
+	std::vector<uint32_t>& idx = *indices;
+	uint32_t keep = candidate.keep;
+	uint32_t remove = candidate.remove;
+
+	if (removedVertices[keep] || removedVertices[remove] ||
+		versions[keep] != candidate.keepVersion ||
+		versions[remove] != candidate.removeVersion)
+		return false;
+
+	// Triangles on the edge disappear
+	std::vector<uint32_t> shared;
+	const std::vector<uint32_t>& remove_tris = vertexTriangles[remove];
+
+	for (size_t cnt = 0; cnt < remove_tris.size(); cnt++)
+	{
+		uint32_t tri = remove_tris[cnt];
+
+		if (removedTriangles[tri])
+			continue;
+
+		if (idx[3*tri] == keep || idx[3*tri + 1] == keep ||
+			idx[3*tri + 2] == keep)
+			shared.push_back(tri);
+	}
+
+	if (shared.empty())
+		return false;
+
+	// Never remove the last triangles of a piece of the mesh
+	size_t remaining = 0;
+	const std::vector<uint32_t>& keep_list = vertexTriangles[keep];
+	for (size_t cnt = 0; cnt < keep_list.size(); cnt++)
+		if (!removedTriangles[keep_list[cnt]])
+			remaining++;
+	for (size_t cnt = 0; cnt < remove_tris.size(); cnt++)
+		if (!removedTriangles[remove_tris[cnt]])
+			remaining++;
+
+	// Shared triangles are in both lists
+	if (remaining - 2 * shared.size() == 0)
+		return false;
+
+	// Link condition: the only vertices next to both ends of the edge must
+	//  be the opposite corners of the triangles on it. Otherwise the
+	//  collapse would pinch the surface.
+	std::vector<uint32_t> keep_ring, remove_ring, common;
+
+	liveNeighbors(keep, keep_ring);
+	liveNeighbors(remove, remove_ring);
+	std::set_intersection(keep_ring.begin(), keep_ring.end(),
+		remove_ring.begin(), remove_ring.end(),
+		std::back_inserter(common));
+
+	if (common.size() != shared.size())
+		return false;
+
+	if (flips(remove, keep, candidate.position) ||
+		flips(keep, remove, candidate.position))
+		return false;
+
+	// Commit collapse
+	for (size_t cnt = 0; cnt < shared.size(); cnt++)
+	{
+		removedTriangles[shared[cnt]] = 1;
+		liveTriangles--;
+	}
+
+	std::vector<uint32_t>& keep_tris = vertexTriangles[keep];
+	std::vector<uint32_t> merged;
+
+	merged.reserve(keep_tris.size() + remove_tris.size());
+	for (size_t cnt = 0; cnt < keep_tris.size(); cnt++)
+		if (!removedTriangles[keep_tris[cnt]])
+			merged.push_back(keep_tris[cnt]);
+
+	for (size_t cnt = 0; cnt < remove_tris.size(); cnt++)
+	{
+		uint32_t tri = remove_tris[cnt];
+
+		if (removedTriangles[tri])
+			continue;
+
+		for (int vtx = 0; vtx < 3; vtx++)
+			if (idx[3*tri + vtx] == remove)
+				idx[3*tri + vtx] = keep;
+
+		merged.push_back(tri);
+	}
+
+	keep_tris.swap(merged);
+	std::vector<uint32_t>().swap(vertexTriangles[remove]);
+
+	for (int cnt = 0; cnt < 3; cnt++)
+		(*positions)[3 * (size_t)keep + cnt] = candidate.position[cnt];
+
+	addQuadric(quadrics[keep], quadrics[remove]);
+	removedVertices[remove] = 1;
+	moved[keep] = 1;
+	versions[keep]++;
+	versions[remove]++;
+
+	return true;
+}
+
+/**
+ * Check whether moving a vertex would flip or squash any triangle around it.
+ *  Triangles that also use other are ignored, as the collapse removes them.
+ *
+ * \param vertex Vertex being moved.
+ * \param other Other end of edge being collapsed.
+ * \param[in] pos New position of vertex.
+ *
+ * \return True if the move would damage a triangle.
+ */
+template <typename Real>
+bool Decimator<Real>::flips(uint32_t vertex, uint32_t other,
+	const Real pos[3]) const
+{
+	const std::vector<Real>& p = *positions;
+	const std::vector<uint32_t>& idx = *indices;
+	const std::vector<uint32_t>& tris = vertexTriangles[vertex];
+
+	for (size_t cnt = 0; cnt < tris.size(); cnt++)
+	{
+		uint32_t tri = tris[cnt];
+		double before[3][3], after[3][3];
+
+		if (removedTriangles[tri])
+			continue;
+
+		if (idx[3*tri] == other || idx[3*tri + 1] == other ||
+			idx[3*tri + 2] == other)
+			continue;
+
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			uint32_t id = idx[3*tri + vtx];
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				before[vtx][axis] = p[3 * (size_t)id + axis];
+				after[vtx][axis] = (id == vertex) ? pos[axis] :
+					before[vtx][axis];
+			}
+		}
+
+		double n[2][3];
+		double max_edge2 = 0;
+
+		for (int set = 0; set < 2; set++)
+		{
+			double (*v)[3] = set ? after : before;
+			double e1[3], e2[3];
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				e1[axis] = v[1][axis] - v[0][axis];
+				e2[axis] = v[2][axis] - v[0][axis];
+			}
+
+			n[set][0] = e1[1] * e2[2] - e1[2] * e2[1];
+			n[set][1] = e1[2] * e2[0] - e1[0] * e2[2];
+			n[set][2] = e1[0] * e2[1] - e1[1] * e2[0];
+		}
+
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			double len2 = 0;
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				double d = after[(vtx + 1) % 3][axis] -
+					after[vtx][axis];
+				len2 += d * d;
+			}
+
+			max_edge2 = std::max(max_edge2, len2);
+		}
+
+		double len_before = sqrt(n[0][0] * n[0][0] + n[0][1] * n[0][1] +
+			n[0][2] * n[0][2]);
+		double len_after = sqrt(n[1][0] * n[1][0] + n[1][1] * n[1][1] +
+			n[1][2] * n[1][2]);
+		double dot = n[0][0] * n[1][0] + n[0][1] * n[1][1] +
+			n[0][2] * n[1][2];
+
+		if (len_after <= DECIMATE_MIN_RATIO * max_edge2)
+			return true;
+
+		if (dot < DECIMATE_MIN_NORMAL_DOT * len_before * len_after)
+			return true;
+	}
+
+	return false;
+}
+
+/**
+ * Find vertices sharing a remaining triangle with a vertex.
+ *
+ * \param vertex Vertex to find neighbors of.
+ * \param[out] out Sorted unique neighbors.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Decimator<Real>::liveNeighbors(uint32_t vertex,
+	std::vector<uint32_t>& out) const
+{
+	const std::vector<uint32_t>& idx = *indices;
+	const std::vector<uint32_t>& tris = vertexTriangles[vertex];
+
+	out.clear();
+
+	for (size_t cnt = 0; cnt < tris.size(); cnt++)
+	{
+		uint32_t tri = tris[cnt];
+
+		if (removedTriangles[tri])
+			continue;
+
+		for (int vtx = 0; vtx < 3; vtx++)
+			if (idx[3*tri + vtx] != vertex)
+				out.push_back(idx[3*tri + vtx]);
+	}
+
+	std::sort(out.begin(), out.end());
+	out.erase(std::unique(out.begin(), out.end()), out.end());
+}
+
+template class Decimator<float>;
+template class Decimator<double>;
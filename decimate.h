@@ -0,0 +1,105 @@
+/**
+ * \file decimate.h
+ * \brief Mesh simplification by edge collapse ordered by quadric error.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _DECIMATE_
+#define _DECIMATE_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+#include <queue>
+
+/**
+ * Simplifies meshes with positions in Real, which is float or double, so
+ *  vertices are moved at the precision the model is processed in. Quadrics
+ *  are always accumulated in double.
+ */
+template <typename Real>
+class Decimator
+{
+public:
+	Decimator();
+
+	void decimate(std::vector<Real>& positions,
+		std::vector<uint32_t>& indices, float maxError,
+		size_t targetTriangles, bool keepBoundaries);
+
+	const std::vector<uint32_t>& getTriangleMap() const;
+	const std::vector<uint8_t>& getMovedVertices() const;
+	size_t getCollapseCount() const;
+
+private:
+	/**
+	 * Symmetric 4x4 matrix giving the area weighted sum of squared
+	 *  distances from a point to a set of planes. Only the upper triangle
+	 *  is stored, row by row.
+	 */
+	struct Quadric
+	{
+		double q[10];
+		double area; //!< Total area of planes, so sum can be turned
+			//!< into a mean.
+	};
+
+	/**
+	 * Edge collapse waiting in the queue. Versions are compared with
+	 *  the current versions of the vertices when popped, so entries made
+	 *  stale by earlier collapses are skipped rather than removed.
+	 */
+	struct Candidate
+	{
+		double cost; //!< Mean squared distance from collapsed vertex to
+			//!< planes of its original triangles.
+		double length2; //!< Squared length of edge. Shorter edges go
+			//!< first when costs tie, so flat areas shrink evenly
+			//!< rather than collapsing into a single vertex.
+		uint32_t keep; //!< Vertex that is moved and kept.
+		uint32_t remove; //!< Vertex that is merged into keep.
+		uint32_t keepVersion;
+		uint32_t removeVersion;
+		Real position[3]; //!< Where keep moves to.
+
+		// Reversed so std::priority_queue pops the cheapest collapse
+		bool operator<(const Candidate& rhs) const
+		{
+			if (cost != rhs.cost)
+				return cost > rhs.cost;
+			return length2 > rhs.length2;
+		}
+	};
+
+	void addBoundaryPlane(const Real p1[3], const Real p2[3],
+		const Real p3[3], uint32_t vtx1, uint32_t vtx2);
+	void addQuadric(Quadric& dst, const Quadric& src) const;
+	double evalQuadric(const Quadric& quadric, const double pos[3]) const;
+	bool evaluate(uint32_t first, uint32_t second, Candidate& candidate)
+		const;
+	void pushEdges(uint32_t vertex);
+	bool collapse(const Candidate& candidate);
+	bool flips(uint32_t vertex, uint32_t other, const Real pos[3]) const;
+	void liveNeighbors(uint32_t vertex, std::vector<uint32_t>& out) const;
+
+	std::vector<Real>* positions; //!< x, y, z of each vertex.
+	std::vector<uint32_t>* indices; //!< 3 vertex indices per triangle.
+
+	std::vector<Quadric> quadrics; //!< Error quadric of each vertex.
+	std::vector<std::vector<uint32_t> > vertexTriangles; //!< Triangles
+		//!< using each vertex. May include removed triangles.
+	std::vector<uint32_t> versions; //!< Bumped each time a vertex changes.
+	std::vector<uint8_t> locked; //!< Set for vertices that must not move.
+	std::vector<uint8_t> removedVertices;
+	std::vector<uint8_t> removedTriangles;
+	std::vector<uint8_t> moved; //!< Set for vertices that were moved.
+	std::vector<uint32_t> triangleMap; //!< Original index of each
+		//!< triangle remaining after decimation.
+
+	std::priority_queue<Candidate> queue; //!< Pending collapses.
+
+	size_t liveTriangles; //!< Triangles not yet removed.
+	size_t collapses; //!< Number of collapses made.
+};
+
+#endif /* _DECIMATE_ */
@@ -0,0 +1,491 @@
+/**
+ * \file image.cpp
+ * \brief Writing of RGB images to PPM and PNG files, without depending on
+ *	any image or compression libraries.
+ * \author Gregory Gluszek.
+ */
+
+#include "image.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <mutex>
+
+#define DEFLATE_WINDOW 32768 //!< Furthest back a match may start in bytes.
+#define DEFLATE_MIN_MATCH 3 //!< Shortest match worth coding.
+#define DEFLATE_MAX_MATCH 258 //!< Longest match deflate can code.
+#define DEFLATE_HASH_BITS 15 //!< Bits of hash of next three bytes used to
+	//!< find earlier matches.
+#define DEFLATE_MAX_CHAIN 16 //!< Most earlier positions with the same hash
+	//!< tried for each match. Thumbnails are mostly flat color, so the
+	//!< nearest few positions nearly always give the longest match.
+
+#define ADLER_MOD 65521 //!< Modulus of Adler-32 sums.
+#define ADLER_BLOCK 5552 //!< Most bytes summed before sums must be reduced
+	//!< to stay within 32 bits.
+
+/**
+ * Base match lengths of deflate length codes 257 to 285.
+ */
+static const uint16_t lengthBases[] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15,
+	17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227,
+	258};
+
+/**
+ * Extra bits after each deflate length code.
+ */
+static const uint8_t lengthExtraBits[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1,
+	2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+
+/**
+ * Base distances of deflate distance codes 0 to 29.
+ */
+static const uint16_t distBases[] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49,
+	65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+	8193, 12289, 16385, 24577};
+
+/**
+ * Extra bits after each deflate distance code.
+ */
+static const uint8_t distExtraBits[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4,
+	5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/**
+ * Packs bit fields into bytes least significant bit first, as deflate
+ *  streams are laid out.
+ */
+class BitWriter
+{
+public:
+	/**
+	 * Constructor.
+	 *
+	 * \param out Buffer to append bytes to.
+	 */
+	BitWriter(std::vector<uint8_t>& out)
+	: out(out)
+	, bits(0)
+	, numBits(0)
+	{
+	}
+
+	/**
+	 * Append bits, least significant first.
+	 *
+	 * \param value Bits to append.
+	 * \param count Number of bits of value to append. At most 32.
+	 *
+	 * \return None.
+	 */
+	void write(uint32_t value, unsigned count)
+	{
+		bits |= (uint64_t)value << numBits;
+		numBits += count;
+		while (numBits >= 8)
+		{
+			out.push_back((uint8_t)bits);
+			bits >>= 8;
+			numBits -= 8;
+		}
+	}
+
+	/**
+	 * Append a Huffman code, which deflate stores most significant bit
+	 *  first.
+	 *
+	 * \param code Huffman code.
+	 * \param length Number of bits of code.
+	 *
+	 * \return None.
+	 */
+	void writeCode(uint32_t code, unsigned length)
+	{
+		uint32_t reversed = 0;
+
+		for (unsigned bit = 0; bit < length; bit++)
+			reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+		write(reversed, length);
+	}
+
+	/**
+	 * Pad out the last byte with zeros.
+	 *
+	 * \return None.
+	 */
+	void flush()
+	{
+		if (numBits)
+			write(0, 8 - numBits);
+	}
+
+private:
+	std::vector<uint8_t>& out;
+	uint64_t bits; //!< Bits not yet appended to out.
+	unsigned numBits; //!< Number of bits held in bits.
+};
+
+/**
+ * Write a literal byte or end of block marker with deflate's fixed Huffman
+ *  codes.
+ *
+ * \param writer Stream to write to.
+ * \param symbol Literal byte, 256 for end of block, or length code.
+ *
+ * \return None.
+ */
+static void writeFixedSymbol(BitWriter& writer, unsigned symbol)
+{
+	if (symbol < 144)
+		writer.writeCode(0x30 + symbol, 8);
+	else if (symbol < 256)
+		writer.writeCode(0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		writer.writeCode(symbol - 256, 7);
+	else
+		writer.writeCode(0xC0 + symbol - 280, 8);
+}
+
+/**
+ * Write a match with deflate's fixed Huffman codes.
+ *
+ * \param writer Stream to write to.
+ * \param length Length of match, from DEFLATE_MIN_MATCH to
+ *	DEFLATE_MAX_MATCH.
+ * \param distance How far back match starts, from 1 to DEFLATE_WINDOW.
+ *
+ * \return None.
+ */
+static void writeFixedMatch(BitWriter& writer, unsigned length,
+	unsigned distance)
+{
+	unsigned code = 0;
+
+	while (code + 1 < sizeof(lengthBases) / sizeof(lengthBases[0]) &&
+		lengthBases[code + 1] <= length)
+		code++;
+	writeFixedSymbol(writer, 257 + code);
+	writer.write(length - lengthBases[code], lengthExtraBits[code]);
+
+	code = 0;
+	while (code + 1 < sizeof(distBases) / sizeof(distBases[0]) &&
+		distBases[code + 1] <= distance)
+		code++;
+	writer.writeCode(code, 5);
+	writer.write(distance - distBases[code], distExtraBits[code]);
+}
+
+/**
+ * Append a big endian 32 bit value.
+ *
+ * \param[out] out Buffer to append to.
+ * \param value
+ *
+ * \return None.
+ */
+static void appendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	for (int shift = 24; shift >= 0; shift -= 8)
+		out.push_back((uint8_t)(value >> shift));
+}
+
+/**
+ * Compress data into a zlib stream holding one deflate block with fixed
+ *  Huffman codes. Repeats are found greedily by hashing the next three bytes
+ *  and trying the most recent earlier positions with the same hash.
+ *
+ * \param[in] data Data to compress.
+ * \param size Size of data in bytes.
+ * \param[out] out Buffer to append zlib stream to.
+ *
+ * \return None.
+ */
+static void compress(const uint8_t* data, size_t size,
+	std::vector<uint8_t>& out)
+{
+	std::vector<int64_t> head(1 << DEFLATE_HASH_BITS, -1);
+	std::vector<int64_t> prev(DEFLATE_WINDOW, -1);
+	BitWriter writer(out);
+	uint32_t adler_a = 1;
+	uint32_t adler_b = 0;
+	size_t pos = 0;
+
+	// zlib header: deflate with 32K window, no dictionary, fastest
+	out.push_back(0x78);
+	out.push_back(0x01);
+
+	// Final block with fixed Huffman codes
+	writer.write(1, 1);
+	writer.write(1, 2);
+
+	while (pos < size)
+	{
+		unsigned best_length = 0;
+		size_t best_distance = 0;
+
+		if (pos + DEFLATE_MIN_MATCH <= size)
+		{
+			uint32_t hash = ((uint32_t)data[pos] << 16 |
+				(uint32_t)data[pos + 1] << 8 | data[pos + 2]) *
+				2654435761u >> (32 - DEFLATE_HASH_BITS);
+			size_t max_length = size - pos;
+			int64_t candidate = head[hash];
+
+			if (max_length > DEFLATE_MAX_MATCH)
+				max_length = DEFLATE_MAX_MATCH;
+
+			for (int chain = 0; chain < DEFLATE_MAX_CHAIN &&
+				candidate >= 0 && pos - (size_t)candidate <=
+				DEFLATE_WINDOW; chain++)
+			{
+				const uint8_t* match = &data[candidate];
+				unsigned length = 0;
+
+				while (length < max_length &&
+					match[length] == data[pos + length])
+					length++;
+				if (length > best_length)
+				{
+					best_length = length;
+					best_distance = pos - (size_t)candidate;
+					if (length == max_length)
+						break;
+				}
+				candidate = prev[(size_t)candidate % DEFLATE_WINDOW];
+			}
+
+			prev[pos % DEFLATE_WINDOW] = head[hash];
+			head[hash] = (int64_t)pos;
+		}
+
+		if (best_length >= DEFLATE_MIN_MATCH)
+		{
+			writeFixedMatch(writer, best_length, (unsigned)best_distance);
+
+			// Positions within the match can still start later matches
+			for (size_t skip = pos + 1; skip < pos + best_length &&
+				skip + DEFLATE_MIN_MATCH <= size; skip++)
+			{
+				uint32_t hash = ((uint32_t)data[skip] << 16 |
+					(uint32_t)data[skip + 1] << 8 | data[skip + 2]) *
+					2654435761u >> (32 - DEFLATE_HASH_BITS);
+
+				prev[skip % DEFLATE_WINDOW] = head[hash];
+				head[hash] = (int64_t)skip;
+			}
+			pos += best_length;
+		}
+		else
+		{
+			writeFixedSymbol(writer, data[pos]);
+			pos++;
+		}
+	}
+
+	writeFixedSymbol(writer, 256);
+	writer.flush();
+
+	for (size_t start = 0; start < size; start += ADLER_BLOCK)
+	{
+		size_t end = start + ADLER_BLOCK < size ? start + ADLER_BLOCK : size;
+
+		for (size_t cnt = start; cnt < end; cnt++)
+		{
+			adler_a += data[cnt];
+			adler_b += adler_a;
+		}
+		adler_a %= ADLER_MOD;
+		adler_b %= ADLER_MOD;
+	}
+
+	appendBigEndian(out, adler_b << 16 | adler_a);
+}
+
+/**
+ * Build table of CRC-32 of each byte value, for crc32().
+ *
+ * \param[out] table 256 entries.
+ *
+ * \return None.
+ */
+static void buildCrcTable(uint32_t* table)
+{
+	for (uint32_t entry = 0; entry < 256; entry++)
+	{
+		uint32_t value = entry;
+
+		for (int bit = 0; bit < 8; bit++)
+			value = value & 1 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+		table[entry] = value;
+	}
+}
+
+/**
+ * Compute CRC-32 of data, as used by PNG chunks.
+ *
+ * \param[in] data
+ * \param size Size of data in bytes.
+ *
+ * \return CRC-32 of data.
+ */
+static uint32_t crc32(const uint8_t* data, size_t size)
+{
+	static std::once_flag table_built;
+	static uint32_t table[256];
+	uint32_t crc = 0xFFFFFFFF;
+
+	std::call_once(table_built, buildCrcTable, table);
+
+	for (size_t cnt = 0; cnt < size; cnt++)
+		crc = table[(crc ^ data[cnt]) & 0xFF] ^ (crc >> 8);
+
+	return crc ^ 0xFFFFFFFF;
+}
+
+/**
+ * Append a PNG chunk with its length and CRC.
+ *
+ * \param[out] out Buffer to append to.
+ * \param[in] type Four letter chunk type.
+ * \param[in] data Contents of chunk.
+ * \param size Size of contents in bytes.
+ *
+ * \return None.
+ */
+static void appendChunk(std::vector<uint8_t>& out, const char* type,
+	const uint8_t* data, size_t size)
+{
+	size_t start = 0;
+
+	appendBigEndian(out, (uint32_t)size);
+	start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data, data + size);
+	appendBigEndian(out, crc32(&out[start], out.size() - start));
+}
+
+/**
+ * Write whole buffer to a file.
+ *
+ * \param[in] filename
+ * \param[in] data
+ * \param size Size of data in bytes.
+ *
+ * \return True if file was written, false otherwise.
+ */
+static bool writeFile(const char* filename, const uint8_t* data, size_t size)
+{
+	FILE* file = fopen(filename, "w");
+	bool written = false;
+
+	if (!file)
+		return false;
+
+	written = fwrite(data, 1, size, file) == size;
+	if (fclose(file))
+		written = false;
+
+	return written;
+}
+
+/**
+ * Write an image to a binary PPM file.
+ *
+ * \param[in] filename
+ * \param width Width of image in pixels.
+ * \param height Height of image in pixels.
+ * \param[in] rgb Red, green and blue of each pixel, row by row from the top.
+ *
+ * \return True if file was written, false otherwise.
+ */
+bool writePpm(const char* filename, int width, int height,
+	const uint8_t* rgb)
+{
+	char header[64];
+	int header_size = snprintf(header, sizeof(header), "P6\n%d %d\n255\n",
+		width, height);
+	std::vector<uint8_t> out(header, header + header_size);
+
+	out.insert(out.end(), rgb, rgb + 3 * (size_t)width * (size_t)height);
+
+	return writeFile(filename, out.data(), out.size());
+}
+
+/**
+ * Write an image to a PNG file. Each row is filtered with whichever of the
+ *  None, Sub and Up filters leaves the smallest values, then the image is
+ *  compressed with compress().
+ *
+ * \param[in] filename
+ * \param width Width of image in pixels.
+ * \param height Height of image in pixels.
+ * \param[in] rgb Red, green and blue of each pixel, row by row from the top.
+ *
+ * \return True if file was written, false otherwise.
+ */
+bool writePng(const char* filename, int width, int height,
+	const uint8_t* rgb)
+{
+	static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A,
+		'\n'};
+	size_t stride = 3 * (size_t)width;
+	std::vector<uint8_t> filtered((stride + 1) * (size_t)height);
+	std::vector<uint8_t> candidates[3];
+	std::vector<uint8_t> header;
+	std::vector<uint8_t> compressed;
+	std::vector<uint8_t> out(signature, signature + sizeof(signature));
+
+	for (int filter = 0; filter < 3; filter++)
+		candidates[filter].resize(stride);
+
+	for (size_t row = 0; row < (size_t)height; row++)
+	{
+		const uint8_t* line = &rgb[row * stride];
+		const uint8_t* above = row ? &rgb[(row - 1) * stride] : NULL;
+		uint64_t best_sum = UINT64_MAX;
+		int best_filter = 0;
+
+		for (size_t cnt = 0; cnt < stride; cnt++)
+		{
+			candidates[0][cnt] = line[cnt];
+			candidates[1][cnt] = (uint8_t)(line[cnt] -
+				(cnt >= 3 ? line[cnt - 3] : 0));
+			candidates[2][cnt] = (uint8_t)(line[cnt] -
+				(above ? above[cnt] : 0));
+		}
+
+		// Smallest sum of values taken as signed bytes
+		for (int filter = 0; filter < 3; filter++)
+		{
+			uint64_t sum = 0;
+
+			for (size_t cnt = 0; cnt < stride; cnt++)
+				sum += (uint64_t)abs((int8_t)candidates[filter][cnt]);
+			if (sum < best_sum)
+			{
+				best_sum = sum;
+				best_filter = filter;
+			}
+		}
+
+		filtered[row * (stride + 1)] = (uint8_t)best_filter;
+		memcpy(&filtered[row * (stride + 1) + 1],
+			candidates[best_filter].data(), stride);
+	}
+
+	appendBigEndian(header, (uint32_t)width);
+	appendBigEndian(header, (uint32_t)height);
+	header.push_back(8); // Bit depth
+	header.push_back(2); // Truecolor
+	header.push_back(0); // Deflate
+	header.push_back(0); // Adaptive filtering
+	header.push_back(0); // Not interlaced
+	appendChunk(out, "IHDR", header.data(), header.size());
+
+	compress(filtered.data(), filtered.size(), compressed);
+	appendChunk(out, "IDAT", compressed.data(), compressed.size());
+	appendChunk(out, "IEND", NULL, 0);
+
+	return writeFile(filename, out.data(), out.size());
+}
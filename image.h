@@ -0,0 +1,18 @@
+/**
+ * \file image.h
+ * \brief Writing of RGB images to PPM and PNG files, without depending on
+ *	any image or compression libraries.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _IMAGE_
+#define _IMAGE_
+
+#include <stdint.h>
+
+bool writePpm(const char* filename, int width, int height,
+	const uint8_t* rgb);
+bool writePng(const char* filename, int width, int height,
+	const uint8_t* rgb);
+
+#endif /* _IMAGE_ */
@@ -0,0 +1,193 @@
+/**
+ * \file joinery.cpp
+ * \brief Finger joint patterns cut into the edges of faces, so that faces cut
+ *	from sheet material interlock where they meet.
+ * \author Gregory Gluszek.
+ */
+
+#include "joinery.h"
+
+#include <math.h>
+
+#define JOINT_MIN_FINGERS 3 //!< Fewest fingers an edge is split into. Edges
+	//!< too short for this many are left straight.
+#define JOINT_CORNER_LIMIT 4.0 //!< Furthest a corner is moved, as a multiple of
+	//!< thickness. Sharper corners are notched straight in instead.
+
+/**
+ * Constructor.
+ *
+ * \param thickness Thickness of the material, which is how deep notches are
+ *	cut.
+ * \param tabWidth Width to aim for each finger to be.
+ */
+FingerJoint::FingerJoint(double thickness, double tabWidth)
+: thickness(thickness)
+, tabWidth(tabWidth)
+{
+}
+
+/**
+ * \param length Length of edge.
+ *
+ * \return Number of fingers edge is split into, odd so that both ends of
+ *	the edge are alike. 0 if edge is left straight.
+ */
+uint32_t FingerJoint::getFingers(double length) const
+{
+	if (!(thickness > 0 && tabWidth > 0 && length > 0))
+		return 0;
+
+	double fingers = floor(length / tabWidth);
+
+	if (fingers < JOINT_MIN_FINGERS)
+		return 0;
+
+	// Fingers cannot be narrower than the notches are deep, or they
+	//  would snap off
+	fingers = fmin(fingers, floor(length / thickness));
+	if (fingers >= (double)UINT32_MAX)
+		fingers = (double)(UINT32_MAX - 1);
+
+	uint32_t count = (uint32_t)fingers;
+
+	if (!(count & 1))
+		count--;
+
+	return count < JOINT_MIN_FINGERS ? 0 : count;
+}
+
+/**
+ * \param length Length of edge.
+ *
+ * \return Number of points cut() writes for the edge, two where each finger
+ *	meets the next.
+ */
+uint32_t FingerJoint::getPointCount(double length) const
+{
+	uint32_t fingers = getFingers(length);
+
+	return fingers ? 2 * (fingers - 1) : 0;
+}
+
+/**
+ * Cut fingers into an edge.
+ *
+ * \param fromX Start of edge.
+ * \param fromY
+ * \param toX End of edge.
+ * \param toY
+ * \param notchEnds True for the face that has even fingers cut back.
+ * \param[out] out x, y pairs of points between the ends of the edge. Must
+ *	have room for getPointCount() points.
+ *
+ * \return Number of points written.
+ */
+uint32_t FingerJoint::cut(double fromX, double fromY, double toX, double toY,
+	bool notchEnds, double* out) const
+{
+	double dx = toX - fromX;
+	double dy = toY - fromY;
+	double length = hypot(dx, dy);
+	uint32_t fingers = getFingers(length);
+	uint32_t num_pts = 0;
+
+	if (!fingers)
+		return 0;
+
+	// Step along the edge per finger, and into the face by the thickness
+	double step_x = dx / fingers;
+	double step_y = dy / fingers;
+	double in_x = -dy / length * thickness;
+	double in_y = dx / length * thickness;
+
+	for (uint32_t finger = 1; finger < fingers; finger++)
+	{
+		double x = fromX + step_x * finger;
+		double y = fromY + step_y * finger;
+
+		bool was_notched = isNotched(finger - 1, notchEnds);
+
+		out[2*num_pts] = was_notched ? x + in_x : x;
+		out[2*num_pts + 1] = was_notched ? y + in_y : y;
+		num_pts++;
+		out[2*num_pts] = was_notched ? x : x + in_x;
+		out[2*num_pts + 1] = was_notched ? y : y + in_y;
+		num_pts++;
+	}
+
+	return num_pts;
+}
+
+/**
+ * \param finger Index of finger along edge, from its start.
+ * \param notchEnds As for cut().
+ *
+ * \return True if finger is cut back into the face. Notched is the even 
+ *	fingers for notchEnds, else the odd ones.
+ */
+bool FingerJoint::isNotched(uint32_t finger, bool notchEnds) const
+{
+	return ((finger & 1) != 0) != notchEnds;
+}
+
+/**
+ * Find where a corner of a face ends up once notches at the ends of the two
+ *  edges meeting there are cut. Each notched edge is moved in by the 
+ *  thickness and the corner is where the two edge lines cross.
+ *
+ * \param[in] prev x, y of start of edge coming in to corner.
+ * \param[in] vertex x, y of corner.
+ * \param[in] next x, y of end of edge leaving corner.
+ * \param prevNotched True if edge coming in has a notch at its end.
+ * \param nextNotched True if edge leaving has a notch at its start.
+ * \param[out] out x, y of moved corner.
+ *
+ * \return None.
+ */
+void FingerJoint::corner(const double prev[2], const double vertex[2], 
+	const double next[2], bool prevNotched, bool nextNotched, 
+	double out[2]) const
+{
+	out[0] = vertex[0];
+	out[1] = vertex[1];
+
+	if (!prevNotched && !nextNotched)
+		return;
+
+	double prev_dir[2] = {vertex[0] - prev[0], vertex[1] - prev[1]};
+	double next_dir[2] = {next[0] - vertex[0], next[1] - vertex[1]};
+	double prev_len = hypot(prev_dir[0], prev_dir[1]);
+	double next_len = hypot(next_dir[0], next_dir[1]);
+
+	if (!(prev_len > 0 && next_len > 0))
+		return;
+
+	// Inward normals and how far each edge line moves along them
+	double prev_in[2] = {-prev_dir[1] / prev_len, prev_dir[0] / prev_len};
+	double next_in[2] = {-next_dir[1] / next_len, next_dir[0] / next_len};
+	double prev_shift = prevNotched ? thickness : 0;
+	double next_shift = nextNotched ? thickness : 0;
+	double det = prev_in[0] * next_in[1] - prev_in[1] * next_in[0];
+
+	if (fabs(det) > 1e-9)
+	{
+		double x = (prev_shift * next_in[1] - next_shift * prev_in[1]) / 
+			det;
+		double y = (next_shift * prev_in[0] - prev_shift * next_in[0]) / 
+			det;
+
+		if (hypot(x, y) <= JOINT_CORNER_LIMIT * thickness)
+		{
+			out[0] += x;
+			out[1] += y;
+			return;
+		}
+	}
+
+	// Edges almost in line, or corner too sharp to move
+	const double* in = nextNotched ? next_in : prev_in;
+
+	out[0] += in[0] * thickness;
+	out[1] += in[1] * thickness;
+}
@@ -0,0 +1,47 @@
+/**
+ * \file joinery.h
+ * \brief Finger joint patterns cut into the edges of faces, so that faces cut
+ *	from sheet material interlock where they meet.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _JOINERY_
+#define _JOINERY_
+
+#include <stdint.h>
+
+/**
+ * Splits an edge into an odd number of equal fingers, about the tab width
+ *  each, and cuts alternate fingers back into the face by the material
+ *  thickness. The two faces on an edge get complementary patterns: one has
+ *  the even fingers cut back, including both ends, and the other the odd
+ *  ones, so that each face's fingers fill the other's notches. Edges too
+ *  short for three fingers are left straight.
+ *
+ * Points are written for the edge as seen from one face, with the face on
+ *  the left of the edge, and do not include the ends of the edge. Notches
+ *  at the ends of an edge are finished by moving the corner of the face,
+ *  see corner(). How many points an edge gets only depends on its length,
+ *  so space for all edges can be allocated up front and edges filled in on
+ *  any thread.
+ */
+class FingerJoint
+{
+public:
+	FingerJoint(double thickness, double tabWidth);
+
+	uint32_t getFingers(double length) const;
+	uint32_t getPointCount(double length) const;
+	uint32_t cut(double fromX, double fromY, double toX, double toY,
+		bool notchEnds, double* out) const;
+	bool isNotched(uint32_t finger, bool notchEnds) const;
+	void corner(const double prev[2], const double vertex[2], 
+		const double next[2], bool prevNotched, bool nextNotched, 
+		double out[2]) const;
+
+private:
+	double thickness; //!< Depth of notches.
+	double tabWidth; //!< Width fingers are aimed at.
+};
+
+#endif /* _JOINERY_ */
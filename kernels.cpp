@@ -0,0 +1,1575 @@
+/**
+ * \file kernels.cpp
+ * \brief Batched geometry kernels used on hot paths of model conversion.
+ *
+ * One binary has to run well across CPU generations, so instead of picking an
+ *  instruction set at compile time each kernel is built several times with
+ *  GCC target attributes and the best version the CPU supports is picked on
+ *  first use. Setting MDLCONV_KERNELS to scalar, sse4.2, avx2 or avx512
+ *  caps the choice, which is handy for comparing versions.
+ *
+ * All versions give bit identical results. This relies on the Makefile
+ *  turning off floating point contraction, as otherwise the compiler may use
+ *  fused multiply-add in some versions and not others.
+ *
+ * \author Gregory Gluszek.
+ */
+
+#include "kernels.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERNELS_X86
+#include <immintrin.h>
+
+// Some GCC versions warn about the deliberately undefined vectors AVX-512
+//  intrinsics start from
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f")))
+#endif
+
+#define HASH_SEED 2166136261u //!< Starting value of vertex hash.
+#define HASH_PRIME 16777619u //!< Multiplier of vertex hash.
+
+/**
+ * Recompute normals for a range of triangles one at a time. Used on its own
+ *  when no SIMD instructions are available and for leftover triangles that
+ *  do not fill a full SIMD register.
+ *
+ * \param[in] in Triangle data.
+ * \param[out] out Recomputed normals, areas and mismatch flags.
+ * \param begin First triangle to process.
+ * \param end One past last triangle to process.
+ * \param maxError2 Square of the maximum allowed distance between the stored
+ *	and recomputed unit normals.
+ *
+ * \return Number of triangles flagged as mismatched.
+ */
+static size_t recomputeNormalsScalar(const TriangleArrays& in,
+	const NormalArrays& out, size_t begin, size_t end, float maxError2)
+{
+	size_t mismatched = 0;
+
+	for (size_t cnt = begin; cnt < end; cnt++)
+	{
+		float ax = in.x[1][cnt] - in.x[0][cnt];
+		float ay = in.y[1][cnt] - in.y[0][cnt];
+		float az = in.z[1][cnt] - in.z[0][cnt];
+		float bx = in.x[2][cnt] - in.x[0][cnt];
+		float by = in.y[2][cnt] - in.y[0][cnt];
+		float bz = in.z[2][cnt] - in.z[0][cnt];
+		float ni = ay*bz - az*by;
+		float nj = az*bx - ax*bz;
+		float nk = ax*by - ay*bx;
+		float len = sqrtf(ni*ni + nj*nj + nk*nk);
+		float inv = len > 0 ? 1.0f / len : 0;
+		float di, dj, dk;
+
+		ni *= inv;
+		nj *= inv;
+		nk *= inv;
+
+		di = in.ni[cnt] - ni;
+		dj = in.nj[cnt] - nj;
+		dk = in.nk[cnt] - nk;
+
+		out.ni[cnt] = ni;
+		out.nj[cnt] = nj;
+		out.nk[cnt] = nk;
+		out.area2[cnt] = len;
+		out.mismatch[cnt] = (di*di + dj*dj + dk*dk) > maxError2;
+		mismatched += out.mismatch[cnt];
+	}
+
+	return mismatched;
+}
+
+/**
+ * Scalar version of recomputeNormals() with the signature used for dispatch.
+ *
+ * \param[in] in Triangle data.
+ * \param[out] out Recomputed normals, areas and mismatch flags.
+ * \param count Number of triangles.
+ * \param maxError2 See recomputeNormalsScalar().
+ *
+ * \return Number of triangles flagged as mismatched.
+ */
+static size_t recomputeNormalsAllScalar(const TriangleArrays& in,
+	const NormalArrays& out, size_t count, float maxError2)
+{
+	return recomputeNormalsScalar(in, out, 0, count, maxError2);
+}
+
+/**
+ * Flag degenerate triangles one at a time. Used on its own when no SIMD
+ *  instructions are available and for leftover triangles.
+ *
+ * \param[in] in Triangle data. Only vertices are used.
+ * \param[in] area2 Twice the area of each triangle.
+ * \param[out] degenerate Set to 1 for degenerate triangles, otherwise 0.
+ * \param begin First triangle to process.
+ * \param end One past last triangle to process.
+ * \param minRatio See flagDegenerate().
+ *
+ * \return Number of triangles flagged as degenerate.
+ */
+static size_t flagDegenerateScalar(const TriangleArrays& in,
+	const float* area2, uint8_t* degenerate, size_t begin, size_t end,
+	float minRatio)
+{
+	size_t flagged = 0;
+
+	for (size_t cnt = begin; cnt < end; cnt++)
+	{
+		float max_edge2 = 0;
+
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			int next = (vtx + 1) % 3;
+			float dx = in.x[next][cnt] - in.x[vtx][cnt];
+			float dy = in.y[next][cnt] - in.y[vtx][cnt];
+			float dz = in.z[next][cnt] - in.z[vtx][cnt];
+			float edge2 = dx*dx + dy*dy + dz*dz;
+
+			if (edge2 > max_edge2)
+				max_edge2 = edge2;
+		}
+
+		// Not greater than (rather than less than or equal) so NaN
+		//  coordinates are flagged too
+		degenerate[cnt] = !(area2[cnt] > minRatio * max_edge2);
+		flagged += degenerate[cnt];
+	}
+
+	return flagged;
+}
+
+/**
+ * Scalar version of flagDegenerate() with the signature used for dispatch.
+ *
+ * \return Number of triangles flagged as degenerate.
+ */
+static size_t flagDegenerateAllScalar(const TriangleArrays& in,
+	const float* area2, uint8_t* degenerate, size_t count, float minRatio)
+{
+	return flagDegenerateScalar(in, area2, degenerate, 0, count, minRatio);
+}
+
+/**
+ * Hash a range of vertices one at a time.
+ *
+ * \param[in] x x coordinate of each vertex.
+ * \param[in] y y coordinate of each vertex.
+ * \param[in] z z coordinate of each vertex.
+ * \param[out] hashes Hash of each vertex.
+ * \param begin First vertex to process.
+ * \param end One past last vertex to process.
+ *
+ * \return None.
+ */
+static void hashVerticesScalar(const float* x, const float* y, const float* z,
+	uint32_t* hashes, size_t begin, size_t end)
+{
+	for (size_t cnt = begin; cnt < end; cnt++)
+		hashes[cnt] = hashVertex(x[cnt], y[cnt], z[cnt]);
+}
+
+/**
+ * Scalar version of hashVertices() with the signature used for dispatch.
+ *
+ * \return None.
+ */
+static void hashVerticesAllScalar(const float* x, const float* y,
+	const float* z, uint32_t* hashes, size_t count)
+{
+	hashVerticesScalar(x, y, z, hashes, 0, count);
+}
+
+/**
+ * Project a range of points one at a time.
+ *
+ * \param[in] x x coordinate of each point.
+ * \param[in] y y coordinate of each point.
+ * \param[in] z z coordinate of each point.
+ * \param[in] axes Unit vectors to project onto.
+ * \param[out] u Coordinate of each point along first axis.
+ * \param[out] v Coordinate of each point along second axis.
+ * \param begin First point to process.
+ * \param end One past last point to process.
+ *
+ * \return None.
+ */
+static void projectPointsScalar(const float* x, const float* y,
+	const float* z, const float axes[2][3], float* u, float* v,
+	size_t begin, size_t end)
+{
+	for (size_t cnt = begin; cnt < end; cnt++)
+	{
+		u[cnt] = x[cnt] * axes[0][0] + y[cnt] * axes[0][1] +
+			z[cnt] * axes[0][2];
+		v[cnt] = x[cnt] * axes[1][0] + y[cnt] * axes[1][1] +
+			z[cnt] * axes[1][2];
+	}
+}
+
+/**
+ * Scalar version of projectPoints() with the signature used for dispatch.
+ *
+ * \return None.
+ */
+static void projectPointsAllScalar(const float* x, const float* y,
+	const float* z, size_t count, const float axes[2][3], float* u,
+	float* v)
+{
+	projectPointsScalar(x, y, z, axes, u, v, 0, count);
+}
+
+/**
+ * Grow bounds to include a range of points one at a time. NaN coordinates are
+ *  ignored.
+ *
+ * \param[in] x x coordinate of each point.
+ * \param[in] y y coordinate of each point.
+ * \param[in] z z coordinate of each point.
+ * \param[inout] min Minimum corner of bounds.
+ * \param[inout] max Maximum corner of bounds.
+ * \param begin First point to process.
+ * \param end One past last point to process.
+ *
+ * \return None.
+ */
+static void computeBoundsScalar(const float* x, const float* y,
+	const float* z, float min[3], float max[3], size_t begin, size_t end)
+{
+	const float* coords[3] = {x, y, z};
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		for (size_t cnt = begin; cnt < end; cnt++)
+		{
+			float value = coords[axis][cnt];
+
+			min[axis] = value < min[axis] ? value : min[axis];
+			max[axis] = value > max[axis] ? value : max[axis];
+		}
+	}
+}
+
+/**
+ * Scalar version of computeBounds() with the signature used for dispatch.
+ *
+ * \return None.
+ */
+static void computeBoundsAllScalar(const float* x, const float* y,
+	const float* z, size_t count, float min[3], float max[3])
+{
+	computeBoundsScalar(x, y, z, min, max, 0, count);
+}
+
+/**
+ * Clip the pixels a triangle may cover to a tile.
+ *
+ * \param[in] triangle Triangle to clip.
+ * \param[in] tile Tile to clip to.
+ * \param[out] range First and last column, then first and last row, of 
+ *	pixels of tile the triangle may cover.
+ *
+ * \return False if triangle covers no pixels of tile.
+ */
+static inline bool clipToTile(const RasterTriangle& triangle, 
+	const RasterTile& tile, int range[4])
+{
+	range[0] = triangle.bounds[0] > tile.x ? triangle.bounds[0] : tile.x;
+	range[1] = triangle.bounds[1] < tile.x + tile.width - 1 ? 
+		triangle.bounds[1] : tile.x + tile.width - 1;
+	range[2] = triangle.bounds[2] > tile.y ? triangle.bounds[2] : tile.y;
+	range[3] = triangle.bounds[3] < tile.y + tile.height - 1 ? 
+		triangle.bounds[3] : tile.y + tile.height - 1;
+
+	return range[0] <= range[1] && range[2] <= range[3];
+}
+
+/**
+ * Rasterize triangles one pixel at a time. Used on its own when no SIMD 
+ *  instructions are available.
+ *
+ * \param[in] triangles Triangles set up for rasterizing.
+ * \param[in] ids Index into triangles of each triangle to draw, in order.
+ * \param count Number of triangles to draw.
+ * \param[in] tile Tile to draw into.
+ *
+ * \return None.
+ */
+static void rasterizeTrianglesScalar(const RasterTriangle* triangles,
+	const uint32_t* ids, size_t count, const RasterTile& tile)
+{
+	int range[4];
+
+	for (size_t cnt = 0; cnt < count; cnt++)
+	{
+		const RasterTriangle& tri = triangles[ids[cnt]];
+
+		if (!clipToTile(tri, tile, range))
+			continue;
+
+		for (int y = range[2]; y <= range[3]; y++)
+		{
+			float py = (float)y + 0.5f;
+			size_t row = (size_t)(y - tile.y) * (size_t)tile.width;
+
+			for (int x = range[0]; x <= range[1]; x++)
+			{
+				float px = (float)x + 0.5f;
+				size_t pixel = row + (size_t)(x - tile.x);
+				float w0 = tri.edges[0][0]*px + tri.edges[0][1]*py + 
+					tri.edges[0][2];
+				float w1 = tri.edges[1][0]*px + tri.edges[1][1]*py + 
+					tri.edges[1][2];
+				float w2 = tri.edges[2][0]*px + tri.edges[2][1]*py + 
+					tri.edges[2][2];
+				float z = tri.depth[0]*px + tri.depth[1]*py + 
+					tri.depth[2];
+
+				if (w0 >= 0 && w1 >= 0 && w2 >= 0 && 
+					z < tile.depth[pixel])
+				{
+					tile.depth[pixel] = z;
+					tile.color[pixel] = tri.color;
+				}
+			}
+		}
+	}
+}
+
+#ifdef KERNELS_X86
+
+/**
+ * Recompute normals four triangles at a time using SSE4.2.
+ *
+ * \param[in] in Triangle data.
+ * \param[out] out Recomputed normals, areas and mismatch flags.
+ * \param count Number of triangles.
+ * \param maxError2 See recomputeNormalsScalar().
+ *
+ * \return Number of triangles flagged as mismatched.
+ */
+TARGET_SSE42 static size_t recomputeNormalsSse42(const TriangleArrays& in,
+	const NormalArrays& out, size_t count, float maxError2)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 max_err = _mm_set1_ps(maxError2);
+	size_t mismatched = 0;
+	size_t cnt = 0;
+
+	for (; cnt + 4 <= count; cnt += 4)
+	{
+		__m128 x0 = _mm_loadu_ps(in.x[0] + cnt);
+		__m128 y0 = _mm_loadu_ps(in.y[0] + cnt);
+		__m128 z0 = _mm_loadu_ps(in.z[0] + cnt);
+		__m128 ax = _mm_sub_ps(_mm_loadu_ps(in.x[1] + cnt), x0);
+		__m128 ay = _mm_sub_ps(_mm_loadu_ps(in.y[1] + cnt), y0);
+		__m128 az = _mm_sub_ps(_mm_loadu_ps(in.z[1] + cnt), z0);
+		__m128 bx = _mm_sub_ps(_mm_loadu_ps(in.x[2] + cnt), x0);
+		__m128 by = _mm_sub_ps(_mm_loadu_ps(in.y[2] + cnt), y0);
+		__m128 bz = _mm_sub_ps(_mm_loadu_ps(in.z[2] + cnt), z0);
+		__m128 ni = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(az, by));
+		__m128 nj = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(ax, bz));
+		__m128 nk = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(ay, bx));
+		__m128 len = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(
+			_mm_mul_ps(ni, ni), _mm_mul_ps(nj, nj)),
+			_mm_mul_ps(nk, nk)));
+		// Degenerate triangles get a zero normal rather than NaN
+		__m128 inv = _mm_and_ps(_mm_div_ps(one, len),
+			_mm_cmpgt_ps(len, zero));
+		__m128 di, dj, dk, err, flag;
+
+		ni = _mm_mul_ps(ni, inv);
+		nj = _mm_mul_ps(nj, inv);
+		nk = _mm_mul_ps(nk, inv);
+
+		di = _mm_sub_ps(_mm_loadu_ps(in.ni + cnt), ni);
+		dj = _mm_sub_ps(_mm_loadu_ps(in.nj + cnt), nj);
+		dk = _mm_sub_ps(_mm_loadu_ps(in.nk + cnt), nk);
+		err = _mm_add_ps(_mm_add_ps(_mm_mul_ps(di, di),
+			_mm_mul_ps(dj, dj)), _mm_mul_ps(dk, dk));
+		flag = _mm_cmpgt_ps(err, max_err);
+
+		_mm_storeu_ps(out.ni + cnt, ni);
+		_mm_storeu_ps(out.nj + cnt, nj);
+		_mm_storeu_ps(out.nk + cnt, nk);
+		_mm_storeu_ps(out.area2 + cnt, len);
+
+		int mask = _mm_movemask_ps(flag);
+		for (int lane = 0; lane < 4; lane++)
+			out.mismatch[cnt + lane] = (uint8_t)((mask >> lane) & 1);
+		mismatched += (size_t)__builtin_popcount((unsigned)mask);
+	}
+
+	return mismatched + recomputeNormalsScalar(in, out, cnt, count,
+		maxError2);
+}
+
+/**
+ * Recompute normals eight triangles at a time using AVX2.
+ *
+ * \param[in] in Triangle data.
+ * \param[out] out Recomputed normals, areas and mismatch flags.
+ * \param count Number of triangles.
+ * \param maxError2 See recomputeNormalsScalar().
+ *
+ * \return Number of triangles flagged as mismatched.
+ */
+TARGET_AVX2 static size_t recomputeNormalsAvx2(const TriangleArrays& in,
+	const NormalArrays& out, size_t count, float maxError2)
+{
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 max_err = _mm256_set1_ps(maxError2);
+	size_t mismatched = 0;
+	size_t cnt = 0;
+
+	for (; cnt + 8 <= count; cnt += 8)
+	{
+		__m256 x0 = _mm256_loadu_ps(in.x[0] + cnt);
+		__m256 y0 = _mm256_loadu_ps(in.y[0] + cnt);
+		__m256 z0 = _mm256_loadu_ps(in.z[0] + cnt);
+		__m256 ax = _mm256_sub_ps(_mm256_loadu_ps(in.x[1] + cnt), x0);
+		__m256 ay = _mm256_sub_ps(_mm256_loadu_ps(in.y[1] + cnt), y0);
+		__m256 az = _mm256_sub_ps(_mm256_loadu_ps(in.z[1] + cnt), z0);
+		__m256 bx = _mm256_sub_ps(_mm256_loadu_ps(in.x[2] + cnt), x0);
+		__m256 by = _mm256_sub_ps(_mm256_loadu_ps(in.y[2] + cnt), y0);
+		__m256 bz = _mm256_sub_ps(_mm256_loadu_ps(in.z[2] + cnt), z0);
+		__m256 ni = _mm256_sub_ps(_mm256_mul_ps(ay, bz),
+			_mm256_mul_ps(az, by));
+		__m256 nj = _mm256_sub_ps(_mm256_mul_ps(az, bx),
+			_mm256_mul_ps(ax, bz));
+		__m256 nk = _mm256_sub_ps(_mm256_mul_ps(ax, by),
+			_mm256_mul_ps(ay, bx));
+		__m256 len = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(ni, ni), _mm256_mul_ps(nj, nj)),
+			_mm256_mul_ps(nk, nk)));
+		// Degenerate triangles get a zero normal rather than NaN
+		__m256 inv = _mm256_and_ps(_mm256_div_ps(one, len),
+			_mm256_cmp_ps(len, zero, _CMP_GT_OQ));
+		__m256 di, dj, dk, err, flag;
+
+		ni = _mm256_mul_ps(ni, inv);
+		nj = _mm256_mul_ps(nj, inv);
+		nk = _mm256_mul_ps(nk, inv);
+
+		di = _mm256_sub_ps(_mm256_loadu_ps(in.ni + cnt), ni);
+		dj = _mm256_sub_ps(_mm256_loadu_ps(in.nj + cnt), nj);
+		dk = _mm256_sub_ps(_mm256_loadu_ps(in.nk + cnt), nk);
+		err = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(di, di),
+			_mm256_mul_ps(dj, dj)), _mm256_mul_ps(dk, dk));
+		flag = _mm256_cmp_ps(err, max_err, _CMP_GT_OQ);
+
+		_mm256_storeu_ps(out.ni + cnt, ni);
+		_mm256_storeu_ps(out.nj + cnt, nj);
+		_mm256_storeu_ps(out.nk + cnt, nk);
+		_mm256_storeu_ps(out.area2 + cnt, len);
+
+		int mask = _mm256_movemask_ps(flag);
+		for (int lane = 0; lane < 8; lane++)
+			out.mismatch[cnt + lane] = (uint8_t)((mask >> lane) & 1);
+		mismatched += (size_t)__builtin_popcount((unsigned)mask);
+	}
+
+	return mismatched + recomputeNormalsScalar(in, out, cnt, count,
+		maxError2);
+}
+
+/**
+ * Recompute normals sixteen triangles at a time using AVX-512.
+ *
+ * \param[in] in Triangle data.
+ * \param[out] out Recomputed normals, areas and mismatch flags.
+ * \param count Number of triangles.
+ * \param maxError2 See recomputeNormalsScalar().
+ *
+ * \return Number of triangles flagged as mismatched.
+ */
+TARGET_AVX512 static size_t recomputeNormalsAvx512(const TriangleArrays& in,
+	const NormalArrays& out, size_t count, float maxError2)
+{
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512 one = _mm512_set1_ps(1.0f);
+	const __m512 max_err = _mm512_set1_ps(maxError2);
+	size_t mismatched = 0;
+	size_t cnt = 0;
+
+	for (; cnt + 16 <= count; cnt += 16)
+	{
+		__m512 x0 = _mm512_loadu_ps(in.x[0] + cnt);
+		__m512 y0 = _mm512_loadu_ps(in.y[0] + cnt);
+		__m512 z0 = _mm512_loadu_ps(in.z[0] + cnt);
+		__m512 ax = _mm512_sub_ps(_mm512_loadu_ps(in.x[1] + cnt), x0);
+		__m512 ay = _mm512_sub_ps(_mm512_loadu_ps(in.y[1] + cnt), y0);
+		__m512 az = _mm512_sub_ps(_mm512_loadu_ps(in.z[1] + cnt), z0);
+		__m512 bx = _mm512_sub_ps(_mm512_loadu_ps(in.x[2] + cnt), x0);
+		__m512 by = _mm512_sub_ps(_mm512_loadu_ps(in.y[2] + cnt), y0);
+		__m512 bz = _mm512_sub_ps(_mm512_loadu_ps(in.z[2] + cnt), z0);
+		__m512 ni = _mm512_sub_ps(_mm512_mul_ps(ay, bz),
+			_mm512_mul_ps(az, by));
+		__m512 nj = _mm512_sub_ps(_mm512_mul_ps(az, bx),
+			_mm512_mul_ps(ax, bz));
+		__m512 nk = _mm512_sub_ps(_mm512_mul_ps(ax, by),
+			_mm512_mul_ps(ay, bx));
+		__m512 len = _mm512_sqrt_ps(_mm512_add_ps(_mm512_add_ps(
+			_mm512_mul_ps(ni, ni), _mm512_mul_ps(nj, nj)),
+			_mm512_mul_ps(nk, nk)));
+		// Degenerate triangles get a zero normal rather than NaN
+		__m512 inv = _mm512_maskz_div_ps(_mm512_cmp_ps_mask(len, zero,
+			_CMP_GT_OQ), one, len);
+		__m512 di, dj, dk, err;
+
+		ni = _mm512_mul_ps(ni, inv);
+		nj = _mm512_mul_ps(nj, inv);
+		nk = _mm512_mul_ps(nk, inv);
+
+		di = _mm512_sub_ps(_mm512_loadu_ps(in.ni + cnt), ni);
+		dj = _mm512_sub_ps(_mm512_loadu_ps(in.nj + cnt), nj);
+		dk = _mm512_sub_ps(_mm512_loadu_ps(in.nk + cnt), nk);
+		err = _mm512_add_ps(_mm512_add_ps(_mm512_mul_ps(di, di),
+			_mm512_mul_ps(dj, dj)), _mm512_mul_ps(dk, dk));
+
+		_mm512_storeu_ps(out.ni + cnt, ni);
+		_mm512_storeu_ps(out.nj + cnt, nj);
+		_mm512_storeu_ps(out.nk + cnt, nk);
+		_mm512_storeu_ps(out.area2 + cnt, len);
+
+		unsigned mask = _mm512_cmp_ps_mask(err, max_err, _CMP_GT_OQ);
+		for (int lane = 0; lane < 16; lane++)
+			out.mismatch[cnt + lane] = (uint8_t)((mask >> lane) & 1);
+		mismatched += (size_t)__builtin_popcount(mask);
+	}
+
+	return mismatched + recomputeNormalsScalar(in, out, cnt, count,
+		maxError2);
+}
+
+/**
+ * Flag degenerate triangles four at a time using SSE4.2.
+ *
+ * \param[in] in Triangle data. Only vertices are used.
+ * \param[in] area2 Twice the area of each triangle.
+ * \param[out] degenerate Set to 1 for degenerate triangles, otherwise 0.
+ * \param count Number of triangles.
+ * \param minRatio See flagDegenerate().
+ *
+ * \return Number of triangles flagged as degenerate.
+ */
+TARGET_SSE42 static size_t flagDegenerateSse42(const TriangleArrays& in,
+	const float* area2, uint8_t* degenerate, size_t count, float minRatio)
+{
+	const __m128 ratio = _mm_set1_ps(minRatio);
+	size_t flagged = 0;
+	size_t cnt = 0;
+
+	for (; cnt + 4 <= count; cnt += 4)
+	{
+		__m128 max_edge2 = _mm_setzero_ps();
+
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			int next = (vtx + 1) % 3;
+			__m128 dx = _mm_sub_ps(_mm_loadu_ps(in.x[next] + cnt),
+				_mm_loadu_ps(in.x[vtx] + cnt));
+			__m128 dy = _mm_sub_ps(_mm_loadu_ps(in.y[next] + cnt),
+				_mm_loadu_ps(in.y[vtx] + cnt));
+			__m128 dz = _mm_sub_ps(_mm_loadu_ps(in.z[next] + cnt),
+				_mm_loadu_ps(in.z[vtx] + cnt));
+
+			max_edge2 = _mm_max_ps(max_edge2, _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+				_mm_mul_ps(dz, dz)));
+		}
+
+		int mask = ~_mm_movemask_ps(_mm_cmpgt_ps(
+			_mm_loadu_ps(area2 + cnt),
+			_mm_mul_ps(ratio, max_edge2))) & 0xf;
+
+		for (int lane = 0; lane < 4; lane++)
+			degenerate[cnt + lane] = (uint8_t)((mask >> lane) & 1);
+		flagged += (size_t)__builtin_popcount((unsigned)mask);
+	}
+
+	return flagged + flagDegenerateScalar(in, area2, degenerate, cnt,
+		count, minRatio);
+}
+
+/**
+ * Flag degenerate triangles eight at a time using AVX2.
+ *
+ * \param[in] in Triangle data. Only vertices are used.
+ * \param[in] area2 Twice the area of each triangle.
+ * \param[out] degenerate Set to 1 for degenerate triangles, otherwise 0.
+ * \param count Number of triangles.
+ * \param minRatio See flagDegenerate().
+ *
+ * \return Number of triangles flagged as degenerate.
+ */
+TARGET_AVX2 static size_t flagDegenerateAvx2(const TriangleArrays& in,
+	const float* area2, uint8_t* degenerate, size_t count, float minRatio)
+{
+	const __m256 ratio = _mm256_set1_ps(minRatio);
+	size_t flagged = 0;
+	size_t cnt = 0;
+
+	for (; cnt + 8 <= count; cnt += 8)
+	{
+		__m256 max_edge2 = _mm256_setzero_ps();
+
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			int next = (vtx + 1) % 3;
+			__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(in.x[next] + cnt),
+				_mm256_loadu_ps(in.x[vtx] + cnt));
+			__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(in.y[next] + cnt),
+				_mm256_loadu_ps(in.y[vtx] + cnt));
+			__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(in.z[next] + cnt),
+				_mm256_loadu_ps(in.z[vtx] + cnt));
+
+			max_edge2 = _mm256_max_ps(max_edge2, _mm256_add_ps(
+				_mm256_add_ps(_mm256_mul_ps(dx, dx),
+				_mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz)));
+		}
+
+		int mask = ~_mm256_movemask_ps(_mm256_cmp_ps(
+			_mm256_loadu_ps(area2 + cnt),
+			_mm256_mul_ps(ratio, max_edge2), _CMP_GT_OQ)) & 0xff;
+
+		for (int lane = 0; lane < 8; lane++)
+			degenerate[cnt + lane] = (uint8_t)((mask >> lane) & 1);
+		flagged += (size_t)__builtin_popcount((unsigned)mask);
+	}
+
+	return flagged + flagDegenerateScalar(in, area2, degenerate, cnt,
+		count, minRatio);
+}
+
+/**
+ * Flag degenerate triangles sixteen at a time using AVX-512.
+ *
+ * \param[in] in Triangle data. Only vertices are used.
+ * \param[in] area2 Twice the area of each triangle.
+ * \param[out] degenerate Set to 1 for degenerate triangles, otherwise 0.
+ * \param count Number of triangles.
+ * \param minRatio See flagDegenerate().
+ *
+ * \return Number of triangles flagged as degenerate.
+ */
+TARGET_AVX512 static size_t flagDegenerateAvx512(const TriangleArrays& in,
+	const float* area2, uint8_t* degenerate, size_t count, float minRatio)
+{
+	const __m512 ratio = _mm512_set1_ps(minRatio);
+	size_t flagged = 0;
+	size_t cnt = 0;
+
+	for (; cnt + 16 <= count; cnt += 16)
+	{
+		__m512 max_edge2 = _mm512_setzero_ps();
+
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			int next = (vtx + 1) % 3;
+			__m512 dx = _mm512_sub_ps(_mm512_loadu_ps(in.x[next] + cnt),
+				_mm512_loadu_ps(in.x[vtx] + cnt));
+			__m512 dy = _mm512_sub_ps(_mm512_loadu_ps(in.y[next] + cnt),
+				_mm512_loadu_ps(in.y[vtx] + cnt));
+			__m512 dz = _mm512_sub_ps(_mm512_loadu_ps(in.z[next] + cnt),
+				_mm512_loadu_ps(in.z[vtx] + cnt));
+
+			max_edge2 = _mm512_max_ps(max_edge2, _mm512_add_ps(
+				_mm512_add_ps(_mm512_mul_ps(dx, dx),
+				_mm512_mul_ps(dy, dy)), _mm512_mul_ps(dz, dz)));
+		}
+
+		unsigned mask = ~(unsigned)_mm512_cmp_ps_mask(
+			_mm512_loadu_ps(area2 + cnt),
+			_mm512_mul_ps(ratio, max_edge2), _CMP_GT_OQ) & 0xffff;
+
+		for (int lane = 0; lane < 16; lane++)
+			degenerate[cnt + lane] = (uint8_t)((mask >> lane) & 1);
+		flagged += (size_t)__builtin_popcount(mask);
+	}
+
+	return flagged + flagDegenerateScalar(in, area2, degenerate, cnt,
+		count, minRatio);
+}
+
+/**
+ * Hash vertices four at a time using SSE4.2. See hashVertex().
+ *
+ * \return None.
+ */
+TARGET_SSE42 static void hashVerticesSse42(const float* x, const float* y,
+	const float* z, uint32_t* hashes, size_t count)
+{
+	const float* coords[3] = {x, y, z};
+	const __m128 zero = _mm_setzero_ps();
+	const __m128i prime = _mm_set1_epi32((int)HASH_PRIME);
+	size_t cnt = 0;
+
+	for (; cnt + 4 <= count; cnt += 4)
+	{
+		__m128i hash = _mm_set1_epi32((int)HASH_SEED);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m128i bits = _mm_castps_si128(_mm_add_ps(
+				_mm_loadu_ps(coords[axis] + cnt), zero));
+
+			hash = _mm_xor_si128(hash, bits);
+			hash = _mm_mullo_epi32(hash, prime);
+			hash = _mm_xor_si128(hash, _mm_srli_epi32(hash, 15));
+		}
+
+		_mm_storeu_si128((__m128i*)(hashes + cnt), hash);
+	}
+
+	hashVerticesScalar(x, y, z, hashes, cnt, count);
+}
+
+/**
+ * Hash vertices eight at a time using AVX2. See hashVertex().
+ *
+ * \return None.
+ */
+TARGET_AVX2 static void hashVerticesAvx2(const float* x, const float* y,
+	const float* z, uint32_t* hashes, size_t count)
+{
+	const float* coords[3] = {x, y, z};
+	const __m256 zero = _mm256_setzero_ps();
+	const __m256i prime = _mm256_set1_epi32((int)HASH_PRIME);
+	size_t cnt = 0;
+
+	for (; cnt + 8 <= count; cnt += 8)
+	{
+		__m256i hash = _mm256_set1_epi32((int)HASH_SEED);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m256i bits = _mm256_castps_si256(_mm256_add_ps(
+				_mm256_loadu_ps(coords[axis] + cnt), zero));
+
+			hash = _mm256_xor_si256(hash, bits);
+			hash = _mm256_mullo_epi32(hash, prime);
+			hash = _mm256_xor_si256(hash, _mm256_srli_epi32(hash, 15));
+		}
+
+		_mm256_storeu_si256((__m256i*)(hashes + cnt), hash);
+	}
+
+	hashVerticesScalar(x, y, z, hashes, cnt, count);
+}
+
+/**
+ * Hash vertices sixteen at a time using AVX-512. See hashVertex().
+ *
+ * \return None.
+ */
+TARGET_AVX512 static void hashVerticesAvx512(const float* x, const float* y,
+	const float* z, uint32_t* hashes, size_t count)
+{
+	const float* coords[3] = {x, y, z};
+	const __m512 zero = _mm512_setzero_ps();
+	const __m512i prime = _mm512_set1_epi32((int)HASH_PRIME);
+	size_t cnt = 0;
+
+	for (; cnt + 16 <= count; cnt += 16)
+	{
+		__m512i hash = _mm512_set1_epi32((int)HASH_SEED);
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m512i bits = _mm512_castps_si512(_mm512_add_ps(
+				_mm512_loadu_ps(coords[axis] + cnt), zero));
+
+			hash = _mm512_xor_si512(hash, bits);
+			hash = _mm512_mullo_epi32(hash, prime);
+			hash = _mm512_xor_si512(hash, _mm512_srli_epi32(hash, 15));
+		}
+
+		_mm512_storeu_si512(hashes + cnt, hash);
+	}
+
+	hashVerticesScalar(x, y, z, hashes, cnt, count);
+}
+
+/**
+ * Project points four at a time using SSE4.2. See projectPoints().
+ *
+ * \return None.
+ */
+TARGET_SSE42 static void projectPointsSse42(const float* x, const float* y,
+	const float* z, size_t count, const float axes[2][3], float* u,
+	float* v)
+{
+	const __m128 ux = _mm_set1_ps(axes[0][0]);
+	const __m128 uy = _mm_set1_ps(axes[0][1]);
+	const __m128 uz = _mm_set1_ps(axes[0][2]);
+	const __m128 vx = _mm_set1_ps(axes[1][0]);
+	const __m128 vy = _mm_set1_ps(axes[1][1]);
+	const __m128 vz = _mm_set1_ps(axes[1][2]);
+	size_t cnt = 0;
+
+	for (; cnt + 4 <= count; cnt += 4)
+	{
+		__m128 px = _mm_loadu_ps(x + cnt);
+		__m128 py = _mm_loadu_ps(y + cnt);
+		__m128 pz = _mm_loadu_ps(z + cnt);
+
+		_mm_storeu_ps(u + cnt, _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, ux),
+			_mm_mul_ps(py, uy)), _mm_mul_ps(pz, uz)));
+		_mm_storeu_ps(v + cnt, _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, vx),
+			_mm_mul_ps(py, vy)), _mm_mul_ps(pz, vz)));
+	}
+
+	projectPointsScalar(x, y, z, axes, u, v, cnt, count);
+}
+
+/**
+ * Project points eight at a time using AVX2. See projectPoints().
+ *
+ * \return None.
+ */
+TARGET_AVX2 static void projectPointsAvx2(const float* x, const float* y,
+	const float* z, size_t count, const float axes[2][3], float* u,
+	float* v)
+{
+	const __m256 ux = _mm256_set1_ps(axes[0][0]);
+	const __m256 uy = _mm256_set1_ps(axes[0][1]);
+	const __m256 uz = _mm256_set1_ps(axes[0][2]);
+	const __m256 vx = _mm256_set1_ps(axes[1][0]);
+	const __m256 vy = _mm256_set1_ps(axes[1][1]);
+	const __m256 vz = _mm256_set1_ps(axes[1][2]);
+	size_t cnt = 0;
+
+	for (; cnt + 8 <= count; cnt += 8)
+	{
+		__m256 px = _mm256_loadu_ps(x + cnt);
+		__m256 py = _mm256_loadu_ps(y + cnt);
+		__m256 pz = _mm256_loadu_ps(z + cnt);
+
+		_mm256_storeu_ps(u + cnt, _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(px, ux), _mm256_mul_ps(py, uy)),
+			_mm256_mul_ps(pz, uz)));
+		_mm256_storeu_ps(v + cnt, _mm256_add_ps(_mm256_add_ps(
+			_mm256_mul_ps(px, vx), _mm256_mul_ps(py, vy)),
+			_mm256_mul_ps(pz, vz)));
+	}
+
+	projectPointsScalar(x, y, z, axes, u, v, cnt, count);
+}
+
+/**
+ * Project points sixteen at a time using AVX-512. See projectPoints().
+ *
+ * \return None.
+ */
+TARGET_AVX512 static void projectPointsAvx512(const float* x, const float* y,
+	const float* z, size_t count, const float axes[2][3], float* u,
+	float* v)
+{
+	const __m512 ux = _mm512_set1_ps(axes[0][0]);
+	const __m512 uy = _mm512_set1_ps(axes[0][1]);
+	const __m512 uz = _mm512_set1_ps(axes[0][2]);
+	const __m512 vx = _mm512_set1_ps(axes[1][0]);
+	const __m512 vy = _mm512_set1_ps(axes[1][1]);
+	const __m512 vz = _mm512_set1_ps(axes[1][2]);
+	size_t cnt = 0;
+
+	for (; cnt + 16 <= count; cnt += 16)
+	{
+		__m512 px = _mm512_loadu_ps(x + cnt);
+		__m512 py = _mm512_loadu_ps(y + cnt);
+		__m512 pz = _mm512_loadu_ps(z + cnt);
+
+		_mm512_storeu_ps(u + cnt, _mm512_add_ps(_mm512_add_ps(
+			_mm512_mul_ps(px, ux), _mm512_mul_ps(py, uy)),
+			_mm512_mul_ps(pz, uz)));
+		_mm512_storeu_ps(v + cnt, _mm512_add_ps(_mm512_add_ps(
+			_mm512_mul_ps(px, vx), _mm512_mul_ps(py, vy)),
+			_mm512_mul_ps(pz, vz)));
+	}
+
+	projectPointsScalar(x, y, z, axes, u, v, cnt, count);
+}
+
+/**
+ * Grow bounds four points at a time using SSE4.2. See computeBounds().
+ *
+ * \return None.
+ */
+TARGET_SSE42 static void computeBoundsSse42(const float* x, const float* y,
+	const float* z, size_t count, float min[3], float max[3])
+{
+	const float* coords[3] = {x, y, z};
+	size_t end = count & ~(size_t)3;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		__m128 lo = _mm_set1_ps(min[axis]);
+		__m128 hi = _mm_set1_ps(max[axis]);
+		float lanes[2][4];
+
+		// New value goes first so NaN keeps the running bound
+		for (size_t cnt = 0; cnt < end; cnt += 4)
+		{
+			__m128 value = _mm_loadu_ps(coords[axis] + cnt);
+
+			lo = _mm_min_ps(value, lo);
+			hi = _mm_max_ps(value, hi);
+		}
+
+		_mm_storeu_ps(lanes[0], lo);
+		_mm_storeu_ps(lanes[1], hi);
+		for (int lane = 0; lane < 4; lane++)
+		{
+			min[axis] = lanes[0][lane] < min[axis] ? lanes[0][lane] :
+				min[axis];
+			max[axis] = lanes[1][lane] > max[axis] ? lanes[1][lane] :
+				max[axis];
+		}
+	}
+
+	computeBoundsScalar(x, y, z, min, max, end, count);
+}
+
+/**
+ * Grow bounds eight points at a time using AVX2. See computeBounds().
+ *
+ * \return None.
+ */
+TARGET_AVX2 static void computeBoundsAvx2(const float* x, const float* y,
+	const float* z, size_t count, float min[3], float max[3])
+{
+	const float* coords[3] = {x, y, z};
+	size_t end = count & ~(size_t)7;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		__m256 lo = _mm256_set1_ps(min[axis]);
+		__m256 hi = _mm256_set1_ps(max[axis]);
+		float lanes[2][8];
+
+		// New value goes first so NaN keeps the running bound
+		for (size_t cnt = 0; cnt < end; cnt += 8)
+		{
+			__m256 value = _mm256_loadu_ps(coords[axis] + cnt);
+
+			lo = _mm256_min_ps(value, lo);
+			hi = _mm256_max_ps(value, hi);
+		}
+
+		_mm256_storeu_ps(lanes[0], lo);
+		_mm256_storeu_ps(lanes[1], hi);
+		for (int lane = 0; lane < 8; lane++)
+		{
+			min[axis] = lanes[0][lane] < min[axis] ? lanes[0][lane] :
+				min[axis];
+			max[axis] = lanes[1][lane] > max[axis] ? lanes[1][lane] :
+				max[axis];
+		}
+	}
+
+	computeBoundsScalar(x, y, z, min, max, end, count);
+}
+
+/**
+ * Grow bounds sixteen points at a time using AVX-512. See computeBounds().
+ *
+ * \return None.
+ */
+TARGET_AVX512 static void computeBoundsAvx512(const float* x, const float* y,
+	const float* z, size_t count, float min[3], float max[3])
+{
+	const float* coords[3] = {x, y, z};
+	size_t end = count & ~(size_t)15;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		__m512 lo = _mm512_set1_ps(min[axis]);
+		__m512 hi = _mm512_set1_ps(max[axis]);
+		float lanes[2][16];
+
+		// New value goes first so NaN keeps the running bound
+		for (size_t cnt = 0; cnt < end; cnt += 16)
+		{
+			__m512 value = _mm512_loadu_ps(coords[axis] + cnt);
+
+			lo = _mm512_min_ps(value, lo);
+			hi = _mm512_max_ps(value, hi);
+		}
+
+		_mm512_storeu_ps(lanes[0], lo);
+		_mm512_storeu_ps(lanes[1], hi);
+		for (int lane = 0; lane < 16; lane++)
+		{
+			min[axis] = lanes[0][lane] < min[axis] ? lanes[0][lane] :
+				min[axis];
+			max[axis] = lanes[1][lane] > max[axis] ? lanes[1][lane] :
+				max[axis];
+		}
+	}
+
+	computeBoundsScalar(x, y, z, min, max, end, count);
+}
+
+/**
+ * Rasterize triangles four pixels at a time using SSE4.2. See 
+ *  rasterizeTriangles().
+ *
+ * \return None.
+ */
+TARGET_SSE42 static void rasterizeTrianglesSse42(
+	const RasterTriangle* triangles, const uint32_t* ids, size_t count,
+	const RasterTile& tile)
+{
+	const __m128 centers = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 zero = _mm_setzero_ps();
+	int range[4];
+
+	for (size_t cnt = 0; cnt < count; cnt++)
+	{
+		const RasterTriangle& tri = triangles[ids[cnt]];
+
+		if (!clipToTile(tri, tile, range))
+			continue;
+
+		const __m128 a0 = _mm_set1_ps(tri.edges[0][0]);
+		const __m128 a1 = _mm_set1_ps(tri.edges[1][0]);
+		const __m128 a2 = _mm_set1_ps(tri.edges[2][0]);
+		const __m128 c0 = _mm_set1_ps(tri.edges[0][2]);
+		const __m128 c1 = _mm_set1_ps(tri.edges[1][2]);
+		const __m128 c2 = _mm_set1_ps(tri.edges[2][2]);
+		const __m128 az = _mm_set1_ps(tri.depth[0]);
+		const __m128 cz = _mm_set1_ps(tri.depth[2]);
+		const __m128 color = _mm_castsi128_ps(_mm_set1_epi32(
+			(int)tri.color));
+		const __m128 end = _mm_set1_ps((float)range[1] + 1);
+
+		for (int y = range[2]; y <= range[3]; y++)
+		{
+			float py = (float)y + 0.5f;
+			size_t row = (size_t)(y - tile.y) * (size_t)tile.width;
+			const __m128 b0 = _mm_set1_ps(tri.edges[0][1] * py);
+			const __m128 b1 = _mm_set1_ps(tri.edges[1][1] * py);
+			const __m128 b2 = _mm_set1_ps(tri.edges[2][1] * py);
+			const __m128 bz = _mm_set1_ps(tri.depth[1] * py);
+
+			for (int x = range[0]; x <= range[1]; x += 4)
+			{
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)x), centers);
+				float* depth = tile.depth + row + (x - tile.x);
+				float* pixels = (float*)tile.color + row + 
+					(x - tile.x);
+				__m128 w0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a0, px),
+					b0), c0);
+				__m128 w1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a1, px),
+					b1), c1);
+				__m128 w2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(a2, px),
+					b2), c2);
+				__m128 z = _mm_add_ps(_mm_add_ps(_mm_mul_ps(az, px),
+					bz), cz);
+				__m128 old_depth = _mm_loadu_ps(depth);
+				__m128 mask = _mm_and_ps(_mm_and_ps(
+					_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)),
+					_mm_and_ps(_mm_cmpge_ps(w2, zero), 
+					_mm_and_ps(_mm_cmplt_ps(px, end), 
+					_mm_cmplt_ps(z, old_depth))));
+
+				_mm_storeu_ps(depth, _mm_blendv_ps(old_depth, z, mask));
+				_mm_storeu_ps(pixels, _mm_blendv_ps(
+					_mm_loadu_ps(pixels), color, mask));
+			}
+		}
+	}
+}
+
+/**
+ * Rasterize triangles eight pixels at a time using AVX2. See 
+ *  rasterizeTriangles().
+ *
+ * \return None.
+ */
+TARGET_AVX2 static void rasterizeTrianglesAvx2(
+	const RasterTriangle* triangles, const uint32_t* ids, size_t count,
+	const RasterTile& tile)
+{
+	const __m256 centers = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 
+		5.5f, 6.5f, 7.5f);
+	const __m256 zero = _mm256_setzero_ps();
+	int range[4];
+
+	for (size_t cnt = 0; cnt < count; cnt++)
+	{
+		const RasterTriangle& tri = triangles[ids[cnt]];
+
+		if (!clipToTile(tri, tile, range))
+			continue;
+
+		const __m256 a0 = _mm256_set1_ps(tri.edges[0][0]);
+		const __m256 a1 = _mm256_set1_ps(tri.edges[1][0]);
+		const __m256 a2 = _mm256_set1_ps(tri.edges[2][0]);
+		const __m256 c0 = _mm256_set1_ps(tri.edges[0][2]);
+		const __m256 c1 = _mm256_set1_ps(tri.edges[1][2]);
+		const __m256 c2 = _mm256_set1_ps(tri.edges[2][2]);
+		const __m256 az = _mm256_set1_ps(tri.depth[0]);
+		const __m256 cz = _mm256_set1_ps(tri.depth[2]);
+		const __m256 color = _mm256_castsi256_ps(_mm256_set1_epi32(
+			(int)tri.color));
+		const __m256 end = _mm256_set1_ps((float)range[1] + 1);
+
+		for (int y = range[2]; y <= range[3]; y++)
+		{
+			float py = (float)y + 0.5f;
+			size_t row = (size_t)(y - tile.y) * (size_t)tile.width;
+			const __m256 b0 = _mm256_set1_ps(tri.edges[0][1] * py);
+			const __m256 b1 = _mm256_set1_ps(tri.edges[1][1] * py);
+			const __m256 b2 = _mm256_set1_ps(tri.edges[2][1] * py);
+			const __m256 bz = _mm256_set1_ps(tri.depth[1] * py);
+
+			for (int x = range[0]; x <= range[1]; x += 8)
+			{
+				__m256 px = _mm256_add_ps(_mm256_set1_ps((float)x), 
+					centers);
+				float* depth = tile.depth + row + (x - tile.x);
+				float* pixels = (float*)tile.color + row + 
+					(x - tile.x);
+				__m256 w0 = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(a0, px), b0), c0);
+				__m256 w1 = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(a1, px), b1), c1);
+				__m256 w2 = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(a2, px), b2), c2);
+				__m256 z = _mm256_add_ps(_mm256_add_ps(
+					_mm256_mul_ps(az, px), bz), cz);
+				__m256 old_depth = _mm256_loadu_ps(depth);
+				__m256 mask = _mm256_and_ps(_mm256_and_ps(
+					_mm256_cmp_ps(w0, zero, _CMP_GE_OQ),
+					_mm256_cmp_ps(w1, zero, _CMP_GE_OQ)),
+					_mm256_and_ps(_mm256_cmp_ps(w2, zero, _CMP_GE_OQ),
+					_mm256_and_ps(_mm256_cmp_ps(px, end, _CMP_LT_OQ),
+					_mm256_cmp_ps(z, old_depth, _CMP_LT_OQ))));
+
+				_mm256_storeu_ps(depth, _mm256_blendv_ps(old_depth, z,
+					mask));
+				_mm256_storeu_ps(pixels, _mm256_blendv_ps(
+					_mm256_loadu_ps(pixels), color, mask));
+			}
+		}
+	}
+}
+
+/**
+ * Rasterize triangles sixteen pixels at a time using AVX-512. See 
+ *  rasterizeTriangles().
+ *
+ * \return None.
+ */
+TARGET_AVX512 static void rasterizeTrianglesAvx512(
+	const RasterTriangle* triangles, const uint32_t* ids, size_t count,
+	const RasterTile& tile)
+{
+	const __m512 centers = _mm512_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 
+		5.5f, 6.5f, 7.5f, 8.5f, 9.5f, 10.5f, 11.5f, 12.5f, 13.5f, 14.5f,
+		15.5f);
+	const __m512 zero = _mm512_setzero_ps();
+	int range[4];
+
+	for (size_t cnt = 0; cnt < count; cnt++)
+	{
+		const RasterTriangle& tri = triangles[ids[cnt]];
+
+		if (!clipToTile(tri, tile, range))
+			continue;
+
+		const __m512 a0 = _mm512_set1_ps(tri.edges[0][0]);
+		const __m512 a1 = _mm512_set1_ps(tri.edges[1][0]);
+		const __m512 a2 = _mm512_set1_ps(tri.edges[2][0]);
+		const __m512 c0 = _mm512_set1_ps(tri.edges[0][2]);
+		const __m512 c1 = _mm512_set1_ps(tri.edges[1][2]);
+		const __m512 c2 = _mm512_set1_ps(tri.edges[2][2]);
+		const __m512 az = _mm512_set1_ps(tri.depth[0]);
+		const __m512 cz = _mm512_set1_ps(tri.depth[2]);
+		const __m512i color = _mm512_set1_epi32((int)tri.color);
+		const __m512 end = _mm512_set1_ps((float)range[1] + 1);
+
+		for (int y = range[2]; y <= range[3]; y++)
+		{
+			float py = (float)y + 0.5f;
+			size_t row = (size_t)(y - tile.y) * (size_t)tile.width;
+			const __m512 b0 = _mm512_set1_ps(tri.edges[0][1] * py);
+			const __m512 b1 = _mm512_set1_ps(tri.edges[1][1] * py);
+			const __m512 b2 = _mm512_set1_ps(tri.edges[2][1] * py);
+			const __m512 bz = _mm512_set1_ps(tri.depth[1] * py);
+
+			for (int x = range[0]; x <= range[1]; x += 16)
+			{
+				__m512 px = _mm512_add_ps(_mm512_set1_ps((float)x), 
+					centers);
+				float* depth = tile.depth + row + (x - tile.x);
+				uint32_t* pixels = tile.color + row + (x - tile.x);
+				__m512 w0 = _mm512_add_ps(_mm512_add_ps(
+					_mm512_mul_ps(a0, px), b0), c0);
+				__m512 w1 = _mm512_add_ps(_mm512_add_ps(
+					_mm512_mul_ps(a1, px), b1), c1);
+				__m512 w2 = _mm512_add_ps(_mm512_add_ps(
+					_mm512_mul_ps(a2, px), b2), c2);
+				__m512 z = _mm512_add_ps(_mm512_add_ps(
+					_mm512_mul_ps(az, px), bz), cz);
+				__mmask16 mask = _mm512_cmp_ps_mask(px, end, 
+					_CMP_LT_OQ);
+
+				mask = _mm512_mask_cmp_ps_mask(mask, w0, zero, 
+					_CMP_GE_OQ);
+				mask = _mm512_mask_cmp_ps_mask(mask, w1, zero, 
+					_CMP_GE_OQ);
+				mask = _mm512_mask_cmp_ps_mask(mask, w2, zero, 
+					_CMP_GE_OQ);
+				mask = _mm512_mask_cmp_ps_mask(mask, z, 
+					_mm512_maskz_loadu_ps(mask, depth), _CMP_LT_OQ);
+
+				_mm512_mask_storeu_ps(depth, mask, z);
+				_mm512_mask_storeu_epi32(pixels, mask, color);
+			}
+		}
+	}
+}
+
+#endif /* KERNELS_X86 */
+
+/**
+ * Version of each kernel chosen for this CPU.
+ */
+struct KernelTable
+{
+	size_t (*normals)(const TriangleArrays&, const NormalArrays&, size_t,
+		float);
+	size_t (*degenerate)(const TriangleArrays&, const float*, uint8_t*,
+		size_t, float);
+	void (*hash)(const float*, const float*, const float*, uint32_t*,
+		size_t);
+	void (*project)(const float*, const float*, const float*, size_t,
+		const float[2][3], float*, float*);
+	void (*bounds)(const float*, const float*, const float*, size_t,
+		float[3], float[3]);
+	void (*raster)(const RasterTriangle*, const uint32_t*, size_t,
+		const RasterTile&);
+	KernelVariant variants[NUM_KERNELS]; //!< Variant picked for each.
+};
+
+/**
+ * \return Name of instruction set variant.
+ */
+static const char* getVariantName(KernelVariant variant)
+{
+	switch (variant)
+	{
+		case KERNEL_SCALAR:
+			return "scalar";
+		case KERNEL_SSE42:
+			return "sse4.2";
+		case KERNEL_AVX2:
+			return "avx2";
+		case KERNEL_AVX512:
+			return "avx512";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * \return Best variant supported by this CPU, capped by the MDLCONV_KERNELS
+ *	environment variable if set.
+ */
+static KernelVariant detectVariant()
+{
+	KernelVariant best = KERNEL_SCALAR;
+	const char* limit = getenv("MDLCONV_KERNELS");
+
+#ifdef KERNELS_X86
+	__builtin_cpu_init();
+
+	if (__builtin_cpu_supports("avx512f"))
+		best = KERNEL_AVX512;
+	else if (__builtin_cpu_supports("avx2"))
+		best = KERNEL_AVX2;
+	else if (__builtin_cpu_supports("sse4.2"))
+		best = KERNEL_SSE42;
+#endif
+
+	if (!limit || !*limit)
+		return best;
+
+	for (int variant = 0; variant < NUM_KERNEL_VARIANTS; variant++)
+	{
+		if (strcmp(limit, getVariantName((KernelVariant)variant)))
+			continue;
+
+		if (variant < best)
+			best = (KernelVariant)variant;
+
+		return best;
+	}
+
+	fprintf(stderr, "Ignoring unknown MDLCONV_KERNELS value \"%s\".\n",
+		limit);
+
+	return best;
+}
+
+/**
+ * Fill in kernel table for the detected CPU.
+ *
+ * \return Table of kernels to use.
+ */
+static KernelTable selectKernels()
+{
+	KernelTable table;
+	KernelVariant variant = detectVariant();
+
+	table.normals = recomputeNormalsAllScalar;
+	table.degenerate = flagDegenerateAllScalar;
+	table.hash = hashVerticesAllScalar;
+	table.project = projectPointsAllScalar;
+	table.bounds = computeBoundsAllScalar;
+	table.raster = rasterizeTrianglesScalar;
+
+#ifdef KERNELS_X86
+	switch (variant)
+	{
+		case KERNEL_AVX512:
+			table.normals = recomputeNormalsAvx512;
+			table.degenerate = flagDegenerateAvx512;
+			table.hash = hashVerticesAvx512;
+			table.project = projectPointsAvx512;
+			table.bounds = computeBoundsAvx512;
+			table.raster = rasterizeTrianglesAvx512;
+			break;
+		case KERNEL_AVX2:
+			table.normals = recomputeNormalsAvx2;
+			table.degenerate = flagDegenerateAvx2;
+			table.hash = hashVerticesAvx2;
+			table.project = projectPointsAvx2;
+			table.bounds = computeBoundsAvx2;
+			table.raster = rasterizeTrianglesAvx2;
+			break;
+		case KERNEL_SSE42:
+			table.normals = recomputeNormalsSse42;
+			table.degenerate = flagDegenerateSse42;
+			table.hash = hashVerticesSse42;
+			table.project = projectPointsSse42;
+			table.bounds = computeBoundsSse42;
+			table.raster = rasterizeTrianglesSse42;
+			break;
+		default:
+			break;
+	}
+#endif
+
+	for (int kernel = 0; kernel < NUM_KERNELS; kernel++)
+		table.variants[kernel] = variant;
+
+	return table;
+}
+
+/**
+ * \return Kernel table, selecting kernels the first time it is called.
+ */
+static const KernelTable& getKernels()
+{
+	static const KernelTable table = selectKernels();
+
+	return table;
+}
+
+/**
+ * Recompute unit normal of each triangle from its vertices and check it
+ *  against the normal that was stored with the triangle.
+ *
+ * \param[in] in Triangle data.
+ * \param[out] out Recomputed normals, areas and mismatch flags. Arrays must
+ *	hold count elements.
+ * \param count Number of triangles.
+ * \param maxError Maximum distance between stored and recomputed unit normals
+ *	before the stored normal is flagged as a mismatch. Zero length stored
+ *	normals are always flagged on triangles with non-zero area.
+ *
+ * \return Number of triangles flagged as mismatched.
+ */
+size_t recomputeNormals(const TriangleArrays& in, const NormalArrays& out,
+	size_t count, float maxError)
+{
+	return getKernels().normals(in, out, count, maxError * maxError);
+}
+
+/**
+ * Flag zero area triangles and slivers (i.e. triangles whose vertices are
+ *  collinear to within float precision).
+ *
+ * \param[in] in Triangle data. Only vertices are used.
+ * \param[in] area2 Twice the area of each triangle, as computed by
+ *	recomputeNormals().
+ * \param[out] degenerate Set to 1 for degenerate triangles, otherwise 0.
+ *	Must hold count elements.
+ * \param count Number of triangles.
+ * \param minRatio Triangles are degenerate when twice their area is not
+ *	greater than this times the square of their longest edge.
+ *
+ * \return Number of triangles flagged as degenerate.
+ */
+size_t flagDegenerate(const TriangleArrays& in, const float* area2,
+	uint8_t* degenerate, size_t count, float minRatio)
+{
+	return getKernels().degenerate(in, area2, degenerate, count, minRatio);
+}
+
+/**
+ * Compute hash of vertex coordinates for use in weld tables. Vertices that
+ *  compare equal hash the same.
+ *
+ * \param x Coordinates of vertex.
+ * \param y
+ * \param z
+ *
+ * \return Hash of vertex coordinates.
+ */
+uint32_t hashVertex(float x, float y, float z)
+{
+	// Adding zero turns -0.0 into 0.0 so that vertices that compare equal
+	//  also hash the same
+	float coords[3] = {x + 0.0f, y + 0.0f, z + 0.0f};
+	uint32_t bits[3];
+	uint32_t hash = HASH_SEED;
+
+	memcpy(bits, coords, sizeof(bits));
+
+	for (int cnt = 0; cnt < 3; cnt++)
+	{
+		hash ^= bits[cnt];
+		hash *= HASH_PRIME;
+		hash ^= hash >> 15;
+	}
+
+	return hash;
+}
+
+/**
+ * Hash many vertices at once. Gives the same results as hashVertex().
+ *
+ * \param[in] x x coordinate of each vertex.
+ * \param[in] y y coordinate of each vertex.
+ * \param[in] z z coordinate of each vertex.
+ * \param[out] hashes Hash of each vertex. Must hold count elements.
+ * \param count Number of vertices.
+ *
+ * \return None.
+ */
+void hashVertices(const float* x, const float* y, const float* z,
+	uint32_t* hashes, size_t count)
+{
+	getKernels().hash(x, y, z, hashes, count);
+}
+
+/**
+ * Project points onto a plane given by two axes.
+ *
+ * \param[in] x x coordinate of each point.
+ * \param[in] y y coordinate of each point.
+ * \param[in] z z coordinate of each point.
+ * \param count Number of points.
+ * \param[in] axes Unit vectors to project onto.
+ * \param[out] u Coordinate of each point along first axis. Must hold count
+ *	elements.
+ * \param[out] v Coordinate of each point along second axis. Must hold count
+ *	elements.
+ *
+ * \return None.
+ */
+void projectPoints(const float* x, const float* y, const float* z,
+	size_t count, const float axes[2][3], float* u, float* v)
+{
+	getKernels().project(x, y, z, count, axes, u, v);
+}
+
+/**
+ * Grow an axis aligned bounding box to contain a set of points. NaN
+ *  coordinates are ignored. Start with min at INFINITY and max at -INFINITY
+ *  to find bounds of just these points.
+ *
+ * \param[in] x x coordinate of each point.
+ * \param[in] y y coordinate of each point.
+ * \param[in] z z coordinate of each point.
+ * \param count Number of points.
+ * \param[inout] min Minimum corner of bounds.
+ * \param[inout] max Maximum corner of bounds.
+ *
+ * \return None.
+ */
+void computeBounds(const float* x, const float* y, const float* z,
+	size_t count, float min[3], float max[3])
+{
+	getKernels().bounds(x, y, z, count, min, max);
+}
+
+/**
+ * Draw triangles into a tile of an image, keeping the nearest triangle at 
+ *  each pixel. A pixel is covered when its center is inside or on the edge
+ *  of a triangle. Where triangles are equally near, the first one drawn is
+ *  kept.
+ *
+ * \param[in] triangles Triangles set up for rasterizing.
+ * \param[in] ids Index into triangles of each triangle to draw, in order.
+ * \param count Number of triangles to draw.
+ * \param[in] tile Tile to draw into. Only its buffers are modified.
+ *
+ * \return None.
+ */
+void rasterizeTriangles(const RasterTriangle* triangles, const uint32_t* ids,
+	size_t count, const RasterTile& tile)
+{
+	getKernels().raster(triangles, ids, count, tile);
+}
+
+/**
+ * \return Name used to identify kernel in reports.
+ */
+const char* getKernelName(Kernel kernel)
+{
+	switch (kernel)
+	{
+		case KERNEL_NORMALS:
+			return "normals";
+		case KERNEL_DEGENERATE:
+			return "degenerate";
+		case KERNEL_VERTEX_HASH:
+			return "vertex_hash";
+		case KERNEL_PROJECT:
+			return "project";
+		case KERNEL_BOUNDS:
+			return "bounds";
+		case KERNEL_RASTER:
+			return "raster";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * \return Name of instruction set variant picked for kernel.
+ */
+const char* getKernelVariantName(Kernel kernel)
+{
+	return getVariantName(getKernels().variants[kernel]);
+}
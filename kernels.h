@@ -0,0 +1,125 @@
+/**
+ * \file kernels.h
+ * \brief Batched geometry kernels used on hot paths of model conversion.
+ *	Each kernel has scalar, SSE4.2, AVX2 and AVX-512 versions and the best
+ *	one the CPU supports is picked the first time any kernel is used.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _KERNELS_
+#define _KERNELS_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RASTER_TILE_PAD 16 //!< Extra elements at the end of RasterTile 
+	//!< buffers, so that whole SIMD registers can be loaded at row ends.
+
+/**
+ * Structure of arrays view of triangle data. Element n of each array belongs
+ *  to triangle n.
+ */
+struct TriangleArrays
+{
+	const float* x[3]; //!< x coordinate of each of the three vertices.
+	const float* y[3]; //!< y coordinate of each of the three vertices.
+	const float* z[3]; //!< z coordinate of each of the three vertices.
+	const float* ni; //!< i component of normal stored in file.
+	const float* nj; //!< j component of normal stored in file.
+	const float* nk; //!< k component of normal stored in file.
+};
+
+/**
+ * Outputs of recomputeNormals(). Element n of each array belongs to
+ *  triangle n.
+ */
+struct NormalArrays
+{
+	float* ni; //!< i component of recomputed unit normal.
+	float* nj; //!< j component of recomputed unit normal.
+	float* nk; //!< k component of recomputed unit normal.
+	float* area2; //!< Twice the area of the triangle (i.e. length of
+		//!< cross product before normalization).
+	uint8_t* mismatch; //!< Set to 1 if stored normal disagrees with
+		//!< recomputed normal, otherwise 0.
+};
+
+/**
+ * Triangle set up for rasterizeTriangles(), in pixel coordinates with the 
+ *  center of pixel (x, y) at (x + 0.5, y + 0.5).
+ */
+struct RasterTriangle
+{
+	float edges[3][3]; //!< a, b and c of each edge function a*x + b*y + c,
+		//!< which is not negative inside the triangle.
+	float depth[3]; //!< a, b and c of depth across the triangle, in the
+		//!< same form as edges.
+	int32_t bounds[4]; //!< First and last column, then first and last 
+		//!< row, of pixels whose centers the triangle may cover.
+	uint32_t color; //!< Red, green and blue in the low three bytes.
+};
+
+/**
+ * Block of an image being rasterized, with its own buffers so that it stays
+ *  in cache while triangles are drawn into it. Buffers are stored row by row
+ *  and must have RASTER_TILE_PAD elements to spare at the end.
+ */
+struct RasterTile
+{
+	int x; //!< Left column of tile in image.
+	int y; //!< Top row of tile in image.
+	int width;
+	int height;
+	float* depth; //!< Depth of nearest triangle drawn at each pixel.
+	uint32_t* color; //!< Color of nearest triangle drawn at each pixel.
+};
+
+/**
+ * Kernels that are dispatched at runtime.
+ */
+enum Kernel
+{
+	KERNEL_NORMALS = 0,
+	KERNEL_DEGENERATE,
+	KERNEL_VERTEX_HASH,
+	KERNEL_PROJECT,
+	KERNEL_BOUNDS,
+	KERNEL_RASTER,
+	NUM_KERNELS
+};
+
+/**
+ * Instruction sets kernels are built for, in order of preference.
+ */
+enum KernelVariant
+{
+	KERNEL_SCALAR = 0,
+	KERNEL_SSE42,
+	KERNEL_AVX2,
+	KERNEL_AVX512,
+	NUM_KERNEL_VARIANTS
+};
+
+size_t recomputeNormals(const TriangleArrays& in, const NormalArrays& out,
+	size_t count, float maxError);
+
+size_t flagDegenerate(const TriangleArrays& in, const float* area2,
+	uint8_t* degenerate, size_t count, float minRatio);
+
+uint32_t hashVertex(float x, float y, float z);
+void hashVertices(const float* x, const float* y, const float* z,
+	uint32_t* hashes, size_t count);
+
+void projectPoints(const float* x, const float* y, const float* z,
+	size_t count, const float axes[2][3], float* u, float* v);
+
+void computeBounds(const float* x, const float* y, const float* z,
+	size_t count, float min[3], float max[3]);
+
+void rasterizeTriangles(const RasterTriangle* triangles, 
+	const uint32_t* ids, size_t count, const RasterTile& tile);
+
+const char* getKernelName(Kernel kernel);
+const char* getKernelVariantName(Kernel kernel);
+
+#endif /* _KERNELS_ */
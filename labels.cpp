@@ -0,0 +1,607 @@
+/**
+ * \file labels.cpp
+ * \brief Placement of numbered labels along the edges of 2D polygons, i.e.
+ *	assembly marks on faces cut from flat material.
+ * \author Gregory Gluszek.
+ */
+
+#include "labels.h"
+
+#include <math.h>
+#include <algorithm>
+
+#define LABEL_DEFAULT_MIN_SCALE 0.5 //!< Default smallest labels are shrunk to,
+	//!< as a fraction of their full height.
+#define LABEL_SHRINK 0.8 //!< Each size a label is tried at is this fraction of
+	//!< the one before.
+#define LABEL_CHAR_WIDTH 0.6 //!< Width of a digit, as a fraction of text
+	//!< height. Digits are the same width in most fonts.
+#define LABEL_MARGIN 0.2 //!< Space kept clear around text, as a fraction of
+	//!< text height.
+#define LABEL_ITEMS_PER_CELL 2 //!< Grid is sized for about this many edges or
+	//!< labels per cell.
+
+const uint32_t EdgeLabeler::NO_BOX;
+
+/**
+ * Points along an edge label centers are tried at, as a fraction of edge
+ *  length, in order of preference.
+ */
+static const double LABEL_POSITIONS[] = {0.5, 0.3, 0.7, 0.15, 0.85};
+
+/**
+ * Constructor.
+ */
+EdgeLabeler::EdgeLabeler()
+: height(1)
+, minScale(LABEL_DEFAULT_MIN_SCALE)
+, inset(0)
+, columns(1)
+, rows(1)
+, stamp(0)
+{
+	gridMin[0] = gridMin[1] = 0;
+	cellSize[0] = cellSize[1] = 1;
+}
+
+/**
+ * Set the height of text on labels that fit at full size.
+ *
+ * \param height Height of text, in the units of the loops.
+ *
+ * \return None.
+ */
+void EdgeLabeler::setHeight(double height)
+{
+	this->height = height;
+}
+
+/**
+ * Set how far labels can be shrunk to fit before they are left out.
+ *
+ * \param scale Smallest size as a fraction of full height, 0 to 1.
+ *
+ * \return None.
+ */
+void EdgeLabeler::setMinScale(double scale)
+{
+	minScale = std::min(1.0, std::max(0.0, scale));
+}
+
+/**
+ * Set how far labels are kept from every edge, on top of the space kept 
+ *  around text, i.e. to stay clear of joints cut into edges.
+ *
+ * \param inset Distance to keep, in the units of the loops.
+ *
+ * \return None.
+ */
+void EdgeLabeler::setInset(double inset)
+{
+	this->inset = std::max(0.0, inset);
+}
+
+/**
+ * \param id Number written on a label.
+ *
+ * \return Number of digits in id.
+ */
+uint32_t EdgeLabeler::getDigits(uint32_t id)
+{
+	uint32_t digits = 1;
+
+	for (; id >= 10; id /= 10)
+		digits++;
+
+	return digits;
+}
+
+/**
+ * Place labels on edges of a polygon. Labels on the shortest edges are
+ *  placed first, since they have the fewest spots to choose from.
+ *
+ * \param[in] loops x, y pairs of points of each loop, with the filled region
+ *	on the left.
+ * \param[in] requests Edges to label.
+ * \param[out] out Labels that could be placed, in the order they were
+ *	placed.
+ *
+ * \return None.
+ */
+void EdgeLabeler::place(const std::vector<std::vector<double> >& loops,
+	const std::vector<Request>& requests, std::vector<Label>& out)
+{
+	out.clear();
+	edges.clear();
+	loopStarts.clear();
+	boxes.clear();
+	boxNodes.clear();
+
+	if (requests.empty() || !(height > 0))
+		return;
+
+	for (size_t loop_cnt = 0; loop_cnt < loops.size(); loop_cnt++)
+	{
+		const std::vector<double>& loop = loops[loop_cnt];
+		size_t num_pts = loop.size() / 2;
+
+		loopStarts.push_back((uint32_t)edges.size());
+
+		for (size_t cnt = 0; cnt < num_pts; cnt++)
+		{
+			size_t next = (cnt + 1) % num_pts;
+			Edge edge = {{loop[2*cnt], loop[2*cnt + 1]},
+				{loop[2*next], loop[2*next + 1]}};
+
+			edges.push_back(edge);
+		}
+	}
+
+	order.clear();
+	lengths.assign(requests.size(), 0);
+
+	for (uint32_t cnt = 0; cnt < requests.size(); cnt++)
+	{
+		const Request& request = requests[cnt];
+		uint32_t num_edges = 0;
+
+		if (request.loop < loops.size())
+			num_edges = (uint32_t)(loops[request.loop].size() / 2);
+
+		if (request.edge >= num_edges || request.count > num_edges)
+			continue;
+
+		uint32_t last = (request.edge + std::max(request.count, 1u) - 1) %
+			num_edges;
+		const Edge& first_edge = edges[loopStarts[request.loop] + 
+			request.edge];
+		const Edge& last_edge = edges[loopStarts[request.loop] + last];
+
+		lengths[cnt] = hypot(last_edge.to[0] - first_edge.from[0],
+			last_edge.to[1] - first_edge.from[1]);
+		if (lengths[cnt] > 0)
+			order.push_back(cnt);
+	}
+
+	std::stable_sort(order.begin(), order.end(),
+		[this](uint32_t lhs, uint32_t rhs)
+		{
+			return lengths[lhs] < lengths[rhs];
+		});
+
+	double max_height = 0;
+	for (size_t cnt = 0; cnt < order.size(); cnt++)
+	{
+		const Request& request = requests[order[cnt]];
+
+		max_height = std::max(max_height, request.height > 0 ? 
+			request.height : height);
+	}
+
+	buildGrid(loops, max_height);
+	edgeStamps.assign(edges.size(), 0);
+	boxStamps.clear();
+	stamp = 0;
+
+	for (size_t cnt = 0; cnt < order.size(); cnt++)
+	{
+		const Request& request = requests[order[cnt]];
+		double len = lengths[order[cnt]];
+		double full_height = request.height > 0 ? request.height : height;
+		Box box;
+
+		box.loop = request.loop;
+		box.edge = loopStarts[request.loop] + request.edge;
+		box.count = std::max(request.count, 1u);
+
+		// Baseline runs straight from the start of the first edge to the
+		//  end of the last
+		const Edge& edge = edges[box.edge];
+		const std::vector<double>& loop = loops[request.loop];
+		size_t end = 2 * ((request.edge + box.count) % (loop.size() / 2));
+
+		box.origin[0] = edge.from[0];
+		box.origin[1] = edge.from[1];
+		box.dir[0] = (loop[end] - edge.from[0]) / len;
+		box.dir[1] = (loop[end + 1] - edge.from[1]) / len;
+		box.minV = inset;
+
+		double digits = (double)getDigits(request.id);
+		bool placed = false;
+
+		for (double scale = 1; !placed && scale >= minScale;
+			scale *= LABEL_SHRINK)
+		{
+			double text_height = full_height * scale;
+			double margin = LABEL_MARGIN * text_height;
+			double half_width = 0.5 * digits * LABEL_CHAR_WIDTH *
+				text_height + margin;
+			double reach = half_width + inset;
+
+			// Keep clear of the corners at each end of the edge
+			if (2 * reach >= len)
+				continue;
+
+			box.maxV = inset + text_height + 2 * margin;
+
+			for (size_t pos = 0; !placed && pos <
+				sizeof(LABEL_POSITIONS) / sizeof(*LABEL_POSITIONS);
+				pos++)
+			{
+				double center = std::min(len - reach,
+					std::max(reach, LABEL_POSITIONS[pos] * len));
+
+				box.minU = center - half_width;
+				box.maxU = center + half_width;
+
+				if (!fits(box))
+					continue;
+
+				Label label;
+
+				label.id = request.id;
+				label.x = box.origin[0] + box.dir[0] * center -
+					box.dir[1] * (inset + margin);
+				label.y = box.origin[1] + box.dir[1] * center +
+					box.dir[0] * (inset + margin);
+				label.dirX = box.dir[0];
+				label.dirY = box.dir[1];
+				label.height = text_height;
+				out.push_back(label);
+
+				addBox(box);
+				placed = true;
+			}
+		}
+	}
+}
+
+/**
+ * Sort edges into a uniform grid by their bounding boxes, and clear the
+ *  grid's lists of placed labels. Cells are never smaller than the largest
+ *  label so that each label only covers a few of them.
+ *
+ * \param[in] loops Loops edges were taken from.
+ * \param minCell Smallest width and height of a cell.
+ *
+ * \return None.
+ */
+void EdgeLabeler::buildGrid(const std::vector<std::vector<double> >& loops,
+	double minCell)
+{
+	double max[2] = {-INFINITY, -INFINITY};
+	double extent[2];
+
+	gridMin[0] = gridMin[1] = INFINITY;
+	for (size_t loop_cnt = 0; loop_cnt < loops.size(); loop_cnt++)
+	{
+		const std::vector<double>& loop = loops[loop_cnt];
+
+		for (size_t cnt = 0; cnt + 1 < loop.size(); cnt += 2)
+		{
+			for (int axis = 0; axis < 2; axis++)
+			{
+				gridMin[axis] = std::min(gridMin[axis],
+					loop[cnt + axis]);
+				max[axis] = std::max(max[axis], loop[cnt + axis]);
+			}
+		}
+	}
+
+	extent[0] = std::max(max[0] - gridMin[0], 1e-300);
+	extent[1] = std::max(max[1] - gridMin[1], 1e-300);
+	double cell = std::max(minCell, sqrt(extent[0] * extent[1] *
+		LABEL_ITEMS_PER_CELL / (double)std::max((size_t)1, edges.size())));
+
+	columns = (int)std::min(4096.0, std::max(1.0, ceil(extent[0] / cell)));
+	rows = (int)std::min(4096.0, std::max(1.0, ceil(extent[1] / cell)));
+	cellSize[0] = extent[0] / columns;
+	cellSize[1] = extent[1] / rows;
+
+	cellOffsets.assign((size_t)columns * rows + 1, 0);
+	cellBoxes.assign((size_t)columns * rows, NO_BOX);
+
+	// Count, then fill, edges in each cell
+	for (int pass = 0; pass < 2; pass++)
+	{
+		std::vector<uint32_t> fill;
+
+		if (pass)
+		{
+			for (size_t cnt = 1; cnt < cellOffsets.size(); cnt++)
+				cellOffsets[cnt] += cellOffsets[cnt - 1];
+			cellEdges.resize(cellOffsets.back());
+			fill.assign(cellOffsets.begin(), cellOffsets.end() - 1);
+		}
+
+		for (uint32_t cnt = 0; cnt < edges.size(); cnt++)
+		{
+			const Edge& edge = edges[cnt];
+			int col_end = getColumn(std::max(edge.from[0], edge.to[0]));
+			int row_end = getRow(std::max(edge.from[1], edge.to[1]));
+
+			for (int row = getRow(std::min(edge.from[1], edge.to[1]));
+				row <= row_end; row++)
+			{
+				for (int col = getColumn(std::min(edge.from[0],
+					edge.to[0])); col <= col_end; col++)
+				{
+					size_t cell = (size_t)row * columns + col;
+
+					if (pass)
+						cellEdges[fill[cell]++] = cnt;
+					else
+						cellOffsets[cell + 1]++;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * \return Grid column containing x, clamped to the grid.
+ */
+int EdgeLabeler::getColumn(double x) const
+{
+	double col = floor((x - gridMin[0]) / cellSize[0]);
+
+	if (!(col > 0))
+		return 0;
+
+	return (int)std::min(col, (double)columns - 1);
+}
+
+/**
+ * \return Grid row containing y, clamped to the grid.
+ */
+int EdgeLabeler::getRow(double y) const
+{
+	double row = floor((y - gridMin[1]) / cellSize[1]);
+
+	if (!(row > 0))
+		return 0;
+
+	return (int)std::min(row, (double)rows - 1);
+}
+
+/**
+ * Find the axis aligned box around a label's box.
+ *
+ * \param[in] box Label's box.
+ * \param[out] min Minimum corner.
+ * \param[out] max Maximum corner.
+ *
+ * \return None.
+ */
+void EdgeLabeler::getBounds(const Box& box, double min[2], double max[2]) const
+{
+	min[0] = min[1] = INFINITY;
+	max[0] = max[1] = -INFINITY;
+
+	for (int corner = 0; corner < 4; corner++)
+	{
+		double u = corner & 1 ? box.maxU : box.minU;
+		double v = corner & 2 ? box.maxV : box.minV;
+		double x = box.origin[0] + box.dir[0] * u - box.dir[1] * v;
+		double y = box.origin[1] + box.dir[1] * u + box.dir[0] * v;
+
+		min[0] = std::min(min[0], x);
+		min[1] = std::min(min[1], y);
+		max[0] = std::max(max[0], x);
+		max[1] = std::max(max[1], y);
+	}
+}
+
+/**
+ * Check whether a label can go in a spot. Edges are tested against the box
+ *  grown by the inset, which then sits on the box's own edge, on the filled
+ *  side. So it is inside the polygon as long as no other edge crosses into
+ *  it.
+ *
+ * \param[in] box Spot to check.
+ *
+ * \return True if no edge other than the box's own and no placed label
+ *	overlaps the box.
+ */
+bool EdgeLabeler::fits(const Box& box)
+{
+	Box grown = box;
+	double min[2], max[2];
+
+	grown.minU -= inset;
+	grown.maxU += inset;
+	grown.minV -= inset;
+	grown.maxV += inset;
+	getBounds(grown, min, max);
+
+	// Restart stamps rather than let them wrap around onto old ones
+	if (++stamp == 0)
+	{
+		std::fill(edgeStamps.begin(), edgeStamps.end(), 0);
+		std::fill(boxStamps.begin(), boxStamps.end(), 0);
+		stamp = 1;
+	}
+
+	int col_end = getColumn(max[0]);
+	int row_end = getRow(max[1]);
+
+	for (int row = getRow(min[1]); row <= row_end; row++)
+	{
+		for (int col = getColumn(min[0]); col <= col_end; col++)
+		{
+			size_t cell = (size_t)row * columns + col;
+
+			for (uint32_t cnt = cellOffsets[cell];
+				cnt < cellOffsets[cell + 1]; cnt++)
+			{
+				uint32_t edge = cellEdges[cnt];
+
+				if (edgeStamps[edge] == stamp)
+					continue;
+				edgeStamps[edge] = stamp;
+
+				if (!isOwnEdge(box, edge) && 
+					crossesEdge(grown, edges[edge]))
+					return false;
+			}
+
+			for (uint32_t node = cellBoxes[cell]; node != NO_BOX;
+				node = boxNodes[2*node + 1])
+			{
+				uint32_t other = boxNodes[2*node];
+
+				if (boxStamps[other] == stamp)
+					continue;
+				boxStamps[other] = stamp;
+
+				if (overlaps(box, boxes[other]))
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * \param[in] box Label's box.
+ * \param edge Index into edges of edge to check.
+ *
+ * \return True if the label runs along the edge.
+ */
+bool EdgeLabeler::isOwnEdge(const Box& box, uint32_t edge) const
+{
+	uint32_t start = loopStarts[box.loop];
+	uint32_t end = box.loop + 1 < loopStarts.size() ? 
+		loopStarts[box.loop + 1] : (uint32_t)edges.size();
+
+	if (edge < start || edge >= end)
+		return false;
+
+	// Edges of the box may wrap around the end of the loop
+	return (edge + (end - start) - box.edge) % (end - start) < box.count;
+}
+
+/**
+ * \param[in] box Label's box.
+ * \param[in] edge Edge to check.
+ *
+ * \return True if any part of the edge is inside the box. Edges only 
+ *	touching its sides, i.e. at the corners of the box's own edge, do not
+ *	count.
+ */
+bool EdgeLabeler::crossesEdge(const Box& box, const Edge& edge) const
+{
+	double from_x = edge.from[0] - box.origin[0];
+	double from_y = edge.from[1] - box.origin[1];
+	double to_x = edge.to[0] - box.origin[0];
+	double to_y = edge.to[1] - box.origin[1];
+
+	// Edge in frame of box
+	double u0 = from_x * box.dir[0] + from_y * box.dir[1];
+	double v0 = from_y * box.dir[0] - from_x * box.dir[1];
+	double du = to_x * box.dir[0] + to_y * box.dir[1] - u0;
+	double dv = to_y * box.dir[0] - to_x * box.dir[1] - v0;
+
+	// Clip edge parameter range to each side of the box in turn
+	double start = 0, end = 1;
+	const double deltas[4] = {-du, du, -dv, dv};
+	const double dists[4] = {u0 - box.minU, box.maxU - u0, v0 - box.minV,
+		box.maxV - v0};
+
+	for (int side = 0; side < 4; side++)
+	{
+		if (deltas[side] == 0)
+		{
+			if (dists[side] <= 0)
+				return false;
+			continue;
+		}
+
+		double t = dists[side] / deltas[side];
+
+		if (deltas[side] < 0)
+			start = std::max(start, t);
+		else
+			end = std::min(end, t);
+
+		if (start >= end)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * \param[in] lhs Boxes to check.
+ * \param[in] rhs
+ *
+ * \return True if boxes overlap, tested along the sides of both of them.
+ */
+bool EdgeLabeler::overlaps(const Box& lhs, const Box& rhs)
+{
+	const Box* pair[2] = {&lhs, &rhs};
+
+	for (int cnt = 0; cnt < 2; cnt++)
+	{
+		const Box& frame = *pair[cnt];
+		const Box& other = *pair[1 - cnt];
+		double min[2] = {INFINITY, INFINITY};
+		double max[2] = {-INFINITY, -INFINITY};
+
+		for (int corner = 0; corner < 4; corner++)
+		{
+			double u = corner & 1 ? other.maxU : other.minU;
+			double v = corner & 2 ? other.maxV : other.minV;
+			double x = other.origin[0] + other.dir[0] * u -
+				other.dir[1] * v - frame.origin[0];
+			double y = other.origin[1] + other.dir[1] * u +
+				other.dir[0] * v - frame.origin[1];
+			double frame_u = x * frame.dir[0] + y * frame.dir[1];
+			double frame_v = y * frame.dir[0] - x * frame.dir[1];
+
+			min[0] = std::min(min[0], frame_u);
+			min[1] = std::min(min[1], frame_v);
+			max[0] = std::max(max[0], frame_u);
+			max[1] = std::max(max[1], frame_v);
+		}
+
+		if (max[0] <= frame.minU || min[0] >= frame.maxU ||
+			max[1] <= frame.minV || min[1] >= frame.maxV)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Add a placed label to every grid cell its box overlaps.
+ *
+ * \param[in] box Label's box.
+ *
+ * \return None.
+ */
+void EdgeLabeler::addBox(const Box& box)
+{
+	uint32_t index = (uint32_t)boxes.size();
+	double min[2], max[2];
+
+	boxes.push_back(box);
+	boxStamps.push_back(0);
+	getBounds(box, min, max);
+
+	int col_end = getColumn(max[0]);
+	int row_end = getRow(max[1]);
+
+	for (int row = getRow(min[1]); row <= row_end; row++)
+	{
+		for (int col = getColumn(min[0]); col <= col_end; col++)
+		{
+			size_t cell = (size_t)row * columns + col;
+
+			boxNodes.push_back(index);
+			boxNodes.push_back(cellBoxes[cell]);
+			cellBoxes[cell] = (uint32_t)(boxNodes.size() / 2 - 1);
+		}
+	}
+}
@@ -0,0 +1,149 @@
+/**
+ * \file labels.h
+ * \brief Placement of numbered labels along the edges of 2D polygons, i.e.
+ *	assembly marks on faces cut from flat material.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _LABELS_
+#define _LABELS_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Places numbered labels inside a polygon with holes, each running along one
+ *  of its edges with the bottom of the text towards the edge. Loops must have
+ *  the filled region on their left, as for Offsetter, so that labels end up
+ *  inside. Each label is tried at several points along its edge and at
+ *  several sizes, and the first spot that stays inside the polygon and does
+ *  not overlap a label already placed is taken. Labels that fit nowhere are
+ *  left out.
+ *
+ * Edges and placed labels are kept in a uniform grid so that each spot is
+ *  only tested against what is near it, keeping placement close to linear in
+ *  the number of edges.
+ *
+ * Not thread safe, but separate instances can be used on separate threads.
+ */
+class EdgeLabeler
+{
+public:
+	/**
+	 * Edge to be labelled.
+	 */
+	struct Request
+	{
+		uint32_t loop; //!< Index of loop edge is on.
+		uint32_t edge; //!< Edge n runs from point n to point n+1 of loop.
+		uint32_t id; //!< Number written on label.
+		uint32_t count; //!< Number of edges, from edge on and wrapping
+			//!< around the loop, that the label runs along as one.
+			//!< They should lie close to a straight line.
+		double height; //!< Height of text at full size. 0 for the
+			//!< height given to setHeight().
+	};
+
+	/**
+	 * Label as placed. Text is centered on (x, y) along its baseline and
+	 *  runs in direction (dirX, dirY), with the filled region above it.
+	 */
+	struct Label
+	{
+		uint32_t id; //!< Number written on label.
+		double x;
+		double y;
+		double dirX; //!< Unit vector along baseline.
+		double dirY;
+		double height; //!< Height of text.
+	};
+
+	EdgeLabeler();
+
+	void setHeight(double height);
+	void setMinScale(double scale);
+	void setInset(double inset);
+
+	void place(const std::vector<std::vector<double> >& loops,
+		const std::vector<Request>& requests, std::vector<Label>& out);
+
+	static uint32_t getDigits(uint32_t id);
+
+private:
+	static const uint32_t NO_BOX = 0xFFFFFFFF; //!< Marks end of a cell's
+		//!< list of placed labels.
+
+	/**
+	 * Straight edge of the polygon.
+	 */
+	struct Edge
+	{
+		double from[2];
+		double to[2];
+	};
+
+	/**
+	 * Rectangle a label takes up, in the frame of the edge it is on: u
+	 *  along the edge from its start, v in towards the filled region.
+	 */
+	struct Box
+	{
+		uint32_t loop; //!< Index of loop box's edges are on.
+		uint32_t edge; //!< Index into edges of first edge box is on.
+		uint32_t count; //!< Number of edges box is on.
+		double origin[2]; //!< Start of edge.
+		double dir[2]; //!< Unit vector along edge.
+		double minU;
+		double maxU;
+		double minV;
+		double maxV;
+	};
+
+	void buildGrid(const std::vector<std::vector<double> >& loops,
+		double minCell);
+	int getColumn(double x) const;
+	int getRow(double y) const;
+	void getBounds(const Box& box, double min[2], double max[2]) const;
+	bool fits(const Box& box);
+	bool crossesEdge(const Box& box, const Edge& edge) const;
+	bool isOwnEdge(const Box& box, uint32_t edge) const;
+	static bool overlaps(const Box& lhs, const Box& rhs);
+	void addBox(const Box& box);
+
+	double height; //!< Height of text at full size, unless a request
+		//!< gives its own.
+	double minScale; //!< Smallest labels are shrunk to, as a fraction of
+		//!< height, before they are left out.
+	double inset; //!< Distance labels are kept from every edge.
+
+	std::vector<Edge> edges; //!< Every edge of every loop, in order.
+	std::vector<uint32_t> loopStarts; //!< Index into edges of first edge of
+		//!< each loop.
+	std::vector<double> lengths; //!< Distance between the ends of each
+		//!< request's edges.
+	std::vector<uint32_t> order; //!< Index into requests of each request
+		//!< with an edge to label, in the order they are placed.
+
+	double gridMin[2]; //!< Minimum corner of grid.
+	double cellSize[2]; //!< Width and height of each grid cell.
+	int columns; //!< Number of grid cells across.
+	int rows; //!< Number of grid cells down.
+	std::vector<uint32_t> cellOffsets; //!< Start of each cell's entries in
+		//!< cellEdges, row by row, plus one extra entry marking the end.
+	std::vector<uint32_t> cellEdges; //!< Index into edges of every edge
+		//!< whose bounding box overlaps each cell, grouped by cell.
+	std::vector<uint32_t> cellBoxes; //!< Index into boxNodes of first
+		//!< placed label overlapping each cell, NO_BOX if none.
+	std::vector<Box> boxes; //!< Labels placed so far.
+	std::vector<uint32_t> boxNodes; //!< Index into boxes and index into
+		//!< boxNodes of the next entry in the same cell, in pairs.
+	std::vector<uint32_t> edgeStamps; //!< Last test each edge was
+		//!< checked in, so edges spanning several cells are checked
+		//!< once.
+	std::vector<uint32_t> boxStamps; //!< Last test each placed label was
+		//!< checked in.
+	uint32_t stamp; //!< Number of current test.
+};
+
+#endif /* _LABELS_ */
@@ -7,10 +7,46 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <dirent.h>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 #include <getopt.h>
 
 #include "modelconv.h"
+#include "trace.h"
+#include "kernels.h"
+#include "svgpath.h"
+#include "cache.h"
+#include "parallel.h"
+#include "prefetch.h"
+
+#define CACHE_VERSION 9 //!< Changes whenever output for the same input and
+	//!< settings changes, so results cached by older builds are not reused.
+#define PREFETCH_DEFAULT_IN_FLIGHT 16 //!< Files read ahead in batch mode when
+	//!< not set.
+#define PREFETCH_MAX_IN_FLIGHT 4096 //!< Most files that may be read ahead.
+#define THUMBNAIL_MAX_SIZE 16384 //!< Largest thumbnail width and height.
+
+/**
+ * Outputs a model may be written to.
+ */
+enum Output
+{
+	OUTPUT_STL = 0, //!< Entire model as binary STL.
+	OUTPUT_PLY, //!< Entire model as binary PLY, colored by face.
+	OUTPUT_THUMBNAIL, //!< Image of model, colored by face.
+	OUTPUT_FACES, //!< Prefix of binary STL per face.
+	OUTPUT_BODIES, //!< Prefix of binary STL per body.
+	OUTPUT_SVG, //!< Outline of each face as SVG.
+	OUTPUT_SHEETS, //!< Prefix of SVG sheets and manifest.
+	NUM_OUTPUTS
+};
 
 /**
  * Print application usage to stderr.
@@ -21,7 +57,431 @@
  */
 void print_usage(const char* apExeName)
 {
-	//TODO
+	fprintf(stderr, "Usage: %s -i <input file> [options]\n"
+		"       %s -D <input dir> [options]\n"
+		"\n"
+		"Options:\n"
+		"  -i, --input-file <file>   3D model to convert (binary STL or\n"
+		"                            binary little endian PLY).\n"
+		"  -D, --batch-dir <dir>     Convert every .stl and .ply file in\n"
+		"                            <dir>.\n"
+		"                            Each output name is used as a\n"
+		"                            prefix for the model's name, so\n"
+		"                            -o out/ writes out/<name>.stl.\n"
+		"  -R, --prefetch <n>        Read up to <n> files of a batch\n"
+		"                            ahead of conversion (default 16).\n"
+		"                            Set MDLCONV_READER to threads to\n"
+		"                            read without io_uring.\n"
+		"  -o, --output-file <file>  Write entire model to binary STL.\n"
+		"  -y, --ply-file <file>     Write entire model to binary PLY with\n"
+		"                            each face in its own color.\n"
+		"  -m, --thumbnail <file>    Draw model with each face in its own\n"
+		"                            color to PNG, or PPM if <file> ends\n"
+		"                            in .ppm.\n"
+		"  -M, --thumbnail-size <n>  Width and height of thumbnail in\n"
+		"                            pixels (default 512).\n"
+		"  -f, --face-prefix <pre>   Write each face to <pre><N>.stl.\n"
+		"  -b, --body-prefix <pre>   Write each disconnected body to\n"
+		"                            <pre><N>.stl.\n"
+		"  -d, --decimate-error <e>  Simplify mesh before finding faces,\n"
+		"                            moving surfaces by up to about <e>.\n"
+		"  -n, --triangle-budget <n> Simplify mesh before finding faces\n"
+		"                            until at most <n> triangles remain.\n"
+		"  -B, --free-boundaries     Allow simplification to move open\n"
+		"                            edges.\n"
+		"  -q, --quantize <step>     Snap vertices to a grid with this\n"
+		"                            spacing before welding.\n"
+		"  -j, --threads <n>         Process with at most <n> threads.\n"
+		"                            Default (0) uses one per core.\n"
+		"  -z, --morton-order        Sort vertices and triangles into\n"
+		"                            spatial order before finding faces.\n"
+		"  -a, --coplanar-angle <a>  Join neighboring triangles into one\n"
+		"                            face when their normals are at most\n"
+		"                            <a> degrees apart, and from the\n"
+		"                            face's first triangle (default\n"
+		"                            0.01).\n"
+		"  -p, --precision <p>       Process model in float or double\n"
+		"                            precision. Default (auto) uses\n"
+		"                            double for models far from origin.\n"
+		"  -g, --svg-file <file>     Write outline of each face to SVG.\n"
+		"  -u, --unfold              Join faces into foldable nets in SVG\n"
+		"                            output.\n"
+		"  -K, --kerf <width>        Move SVG outlines out by half of\n"
+		"                            <width> to make up for material\n"
+		"                            removed by the cutter.\n"
+		"  -J, --kerf-join <j>       Join kerf outlines at convex corners\n"
+		"                            with mitre (default) or round.\n"
+		"  -P, --svg-precision <n>   Write SVG as compact paths with\n"
+		"                            coordinates rounded to <n> (0-9)\n"
+		"                            decimal places.\n"
+		"  -G, --sheet-prefix <pre>  Write SVG split across sheets to\n"
+		"                            <pre>sheet_<N>.svg, with where each\n"
+		"                            face went in <pre>manifest.json.\n"
+		"  -S, --sheet-size <w>x<h>  Size of sheets for -G.\n"
+		"  -L, --label-edges         Number matching cut edges of faces\n"
+		"                            in SVG output to aid assembly.\n"
+		"  -H, --label-height <h>    Height of edge labels. Default (0)\n"
+		"                            sizes them from edge length.\n"
+		"  -T, --thickness <t>       Cut interlocking fingers <t> deep\n"
+		"                            into matching cut edges of faces\n"
+		"                            in SVG output, for material <t>\n"
+		"                            thick.\n"
+		"  -W, --tab-width <w>       Width of fingers for -T. Default (0)\n"
+		"                            is three times the thickness.\n"
+		"  -c, --cache-dir <dir>     Reuse results from <dir> when the\n"
+		"                            input and settings match an earlier\n"
+		"                            run, and add results there if not.\n"
+		"  -C, --cache-size <mb>     Evict least recently used results\n"
+		"                            to keep cache under <mb> megabytes\n"
+		"                            (default 1024).\n"
+		"  -s, --stats=json          Print phase timings and counters\n"
+		"                            as JSON to stdout. With -D, one\n"
+		"                            array holds an object per model.\n"
+		"  -t, --trace=<file>        Write Chrome/Perfetto trace of "
+		"internal\n"
+		"                            phases to <file>.\n"
+		"  -k, --kernels             Print SIMD variant chosen for each\n"
+		"                            kernel as JSON to stdout. Set\n"
+		"                            MDLCONV_KERNELS to scalar, sse4.2,\n"
+		"                            avx2 or avx512 to limit the choice.\n"
+		"                            Given in the stats instead with\n"
+		"                            --stats=json.\n"
+		"  -h, --help                Print this message.\n",
+		apExeName, apExeName);
+}
+
+/**
+ * Describe everything besides the input that affects what a run writes, so
+ *  that runs can be told apart in the result cache.
+ *
+ * \param[in] options Settings model is converted with.
+ * \param[in] outputs Name or prefix of each output, empty if not written.
+ * \param unfold True if faces are unfolded into nets.
+ * \param[in] statsFormat Format stats are printed in, empty for none.
+ *
+ * \return Recipe for ResultCache.
+ */
+static std::string get_recipe(const ModelConv::Options& options,
+	const std::vector<std::string>& outputs, bool unfold, 
+	const std::string& statsFormat)
+{
+	std::string recipe = "version=" + std::to_string(CACHE_VERSION) + ";" +
+		options.toString() + ";unfold=" + (unfold ? "1" : "0") +
+		";stats=" + statsFormat;
+
+	for (size_t cnt = 0; cnt < outputs.size(); cnt++)
+		recipe += ";output=" + outputs[cnt];
+
+	return recipe;
+}
+
+/**
+ * Write each output asked for of a loaded model.
+ *
+ * \param modelConv Model to write outputs of.
+ * \param[in] outputs Name or prefix of each output, indexed by Output, empty
+ *	if not written.
+ * \param unfold True if faces are unfolded into nets.
+ *
+ * \return None.
+ *
+ * \throw ModelConv::Error if an output cannot be written.
+ */
+static void write_outputs(ModelConv* modelConv, 
+	const std::vector<std::string>& outputs, bool unfold)
+{
+	fprintf(stderr, "Precision = %s\n", modelConv->getPrecision() ==
+		ModelConv::PRECISION_DOUBLE ? "double" : "float");
+
+//	modelConv->debugPrint();
+
+	if (!outputs[OUTPUT_STL].empty())
+		modelConv->exportBinStl(outputs[OUTPUT_STL].c_str());
+
+	if (!outputs[OUTPUT_PLY].empty())
+		modelConv->exportPly(outputs[OUTPUT_PLY].c_str());
+
+	if (!outputs[OUTPUT_THUMBNAIL].empty())
+		modelConv->exportThumbnail(outputs[OUTPUT_THUMBNAIL].c_str());
+
+	if (!outputs[OUTPUT_FACES].empty())
+		modelConv->exportFaces(outputs[OUTPUT_FACES].c_str());
+
+	if (!outputs[OUTPUT_BODIES].empty())
+		modelConv->exportBodies(outputs[OUTPUT_BODIES].c_str());
+
+	if (unfold)
+		modelConv->unfold();
+
+	if (!outputs[OUTPUT_SVG].empty())
+		modelConv->exportSvg(outputs[OUTPUT_SVG].c_str());
+
+	if (!outputs[OUTPUT_SHEETS].empty())
+		modelConv->exportSheets(outputs[OUTPUT_SHEETS].c_str());
+}
+
+/**
+ * Convert a model and write each output asked for, or put back the outputs of
+ *  an earlier conversion from the cache if the model and settings match.
+ *
+ * \param[in] name Name of model file.
+ * \param[in] data Contents of model file. NULL to read the file from name.
+ * \param size Size of data in bytes.
+ * \param[in] options Settings model is converted with.
+ * \param[in] outputs Name or prefix of each output, indexed by Output, empty
+ *	if not written.
+ * \param unfold True if faces are unfolded into nets.
+ * \param[in] statsFormat Format stats are printed in, empty for none.
+ * \param cache Cache of results. NULL to always convert.
+ * \param[out] report Text to print for model.
+ *
+ * \return True on success. On failure the reason has been printed and 
+ *	report is empty.
+ */
+static bool convert_model(const char* name, const uint8_t* data, size_t size,
+	const ModelConv::Options& options, const std::vector<std::string>& outputs,
+	bool unfold, const std::string& statsFormat, ResultCache* cache,
+	std::string& report)
+{
+	ModelConv* model_conv = NULL;
+	uint64_t cache_key = 0;
+	std::string recipe = "";
+
+	report = "";
+
+	if (cache)
+	{
+		bool hashed = true;
+
+		recipe = get_recipe(options, outputs, unfold, statsFormat);
+		if (data)
+			cache_key = ResultCache::makeKey(data, size, recipe);
+		else
+			cache_key = ResultCache::makeKey(name, recipe, hashed);
+
+		// Unreadable inputs are reported when loading is attempted
+		if (hashed && cache->restore(cache_key, recipe, report))
+		{
+			fprintf(stderr, "Reused cached results for \"%s\".\n",
+				name);
+			return true;
+		}
+		report = "";
+	}
+
+	try
+	{
+		// Create class to process 3D model data
+		if (data)
+			model_conv = ModelConv::load(name, data, size, options);
+		else
+			model_conv = ModelConv::load(name, options);
+
+		write_outputs(model_conv, outputs, unfold);
+	}
+	catch (const ModelConv::Error&)
+	{
+		fprintf(stderr, "Failed to convert \"%s\".\n", name);
+		delete model_conv;
+		return false;
+	}
+	catch (const std::exception& e)
+	{
+		fprintf(stderr, "Failed to convert \"%s\": %s\n", name, 
+			e.what());
+		delete model_conv;
+		return false;
+	}
+
+	if (statsFormat == "json")
+		report = model_conv->getStats().toJson();
+
+	if (cache)
+		cache->store(cache_key, recipe, model_conv->getOutputFiles(),
+			report);
+
+	delete model_conv;
+
+	return true;
+}
+
+/**
+ * List the models in a directory.
+ *
+ * \param[in] dir Directory to search.
+ *
+ * \return Path of each file ending in .stl or .ply, in any case, sorted by
+ *	name.
+ */
+static std::vector<std::string> list_models(const std::string& dir)
+{
+	std::vector<std::string> filenames;
+	DIR* dir_stream = opendir(dir.c_str());
+	struct dirent* entry = NULL;
+
+	if (!dir_stream)
+	{
+		fprintf(stderr, "Failed to open directory \"%s\": %s\n",
+			dir.c_str(), strerror(errno));
+		//TODO: add proper exception throwing
+		exit(EXIT_FAILURE);
+	}
+
+	while ((entry = readdir(dir_stream)) != NULL)
+	{
+		size_t len = strlen(entry->d_name);
+
+		if (len > 4 && (!strcasecmp(entry->d_name + len - 4, ".stl") ||
+			!strcasecmp(entry->d_name + len - 4, ".ply")))
+			filenames.push_back(dir + "/" + entry->d_name);
+	}
+
+	closedir(dir_stream);
+
+	std::sort(filenames.begin(), filenames.end());
+
+	return filenames;
+}
+
+/**
+ * Name the outputs of one model in a batch, using each output given on the
+ *  command line as a prefix for the model's name.
+ *
+ * \param[in] outputs Name or prefix of each output, indexed by Output, empty
+ *	if not written.
+ * \param[in] filename Path of model file.
+ *
+ * \return Name or prefix of each output of the model.
+ */
+static std::vector<std::string> get_batch_outputs(
+	const std::vector<std::string>& outputs, const std::string& filename)
+{
+	std::vector<std::string> named(outputs.size());
+	size_t start = filename.find_last_of('/');
+	size_t end = filename.find_last_of('.');
+	std::string model_name = "";
+
+	start = (start == std::string::npos) ? 0 : start + 1;
+	if (end == std::string::npos || end < start)
+		end = filename.size();
+	model_name = filename.substr(start, end - start);
+
+	for (size_t cnt = 0; cnt < outputs.size(); cnt++)
+	{
+		if (outputs[cnt].empty())
+			continue;
+
+		if (cnt == OUTPUT_STL)
+			named[cnt] = outputs[cnt] + model_name + ".stl";
+		else if (cnt == OUTPUT_PLY)
+			named[cnt] = outputs[cnt] + model_name + ".ply";
+		else if (cnt == OUTPUT_THUMBNAIL)
+			named[cnt] = outputs[cnt] + model_name + ".png";
+		else if (cnt == OUTPUT_SVG)
+			named[cnt] = outputs[cnt] + model_name + ".svg";
+		else
+			named[cnt] = outputs[cnt] + model_name + "_";
+	}
+
+	return named;
+}
+
+/**
+ * Convert every model in a directory. Files are read ahead of conversion so
+ *  that workers are not left waiting on storage, and each worker converts a
+ *  whole model at a time. Models that fail to read or convert are reported
+ *  and skipped. JSON stats of all models are printed as one array.
+ *
+ * \param[in] dir Directory of models.
+ * \param inFlight Most files to read ahead.
+ * \param[in] options Settings models are converted with.
+ * \param[in] outputs Name or prefix of each output, indexed by Output, empty
+ *	if not written.
+ * \param unfold True if faces are unfolded into nets.
+ * \param[in] statsFormat Format stats are printed in, empty for none.
+ * \param cache Cache of results. NULL to always convert.
+ *
+ * \return True if every model was read and converted.
+ */
+static bool convert_batch(const std::string& dir, unsigned inFlight,
+	const ModelConv::Options& options, const std::vector<std::string>& outputs,
+	bool unfold, const std::string& statsFormat, ResultCache* cache)
+{
+	std::vector<std::string> filenames = list_models(dir);
+	ModelConv::Options worker_options = options;
+	unsigned num_workers = getThreadCount(options.threads);
+	std::mutex print_mutex;
+	std::atomic<uint32_t> num_failed(0);
+	bool first_report = true;
+
+	if (filenames.empty())
+	{
+		fprintf(stderr, "No .stl or .ply files found in \"%s\".\n",
+			dir.c_str());
+		return true;
+	}
+
+	Prefetcher prefetcher(filenames, inFlight);
+
+	fprintf(stderr, "Reading %u files with %s\n",
+		(unsigned)filenames.size(),
+		Prefetcher::getName(prefetcher.getBackend()));
+
+	// Models are converted side by side rather than each being split up
+	num_workers = std::min(num_workers, (unsigned)filenames.size());
+	if (num_workers > 1)
+		worker_options.threads = 1;
+
+	runThreads(num_workers, [&](unsigned)
+	{
+		Prefetcher::File file;
+		std::string report = "";
+
+		while (prefetcher.next(file))
+		{
+			const std::string& filename = filenames[file.index];
+
+			if (file.error)
+			{
+				std::lock_guard<std::mutex> lock(print_mutex);
+				fprintf(stderr, "Failed to read \"%s\": %s\n",
+					filename.c_str(), strerror(file.error));
+				num_failed++;
+				continue;
+			}
+
+			if (!convert_model(filename.c_str(), file.data.data(),
+				file.data.size(), worker_options,
+				get_batch_outputs(outputs, filename), unfold,
+				statsFormat, cache, report))
+				num_failed++;
+
+			// Free model before waiting on the next one
+			std::vector<uint8_t>().swap(file.data);
+
+			if (report.empty())
+				continue;
+
+			std::lock_guard<std::mutex> lock(print_mutex);
+
+			// Objects end in a newline, which the separator goes before
+			if (report.back() == '\n')
+				report.erase(report.size() - 1);
+			printf("%s%s", first_report ? "[\n" : ",\n", report.c_str());
+			first_report = false;
+		}
+	});
+
+	if (!first_report)
+		printf("\n]\n");
+	else if (statsFormat == "json")
+		printf("[]\n");
+
+	if (num_failed)
+		fprintf(stderr, "Failed to convert %u of %u models.\n", 
+			(uint32_t)num_failed, (uint32_t)filenames.size());
+
+	return !num_failed;
 }
 
 /**
@@ -35,7 +495,27 @@ void print_usage(const char* apExeName)
 int main(int argc, char* argv[])
 {
 	std::string input_file = "";
-	ModelConv* model_conv = NULL; 
+	std::string output_file = "";
+	std::string ply_file = "";
+	std::string thumbnail_file = "";
+	std::string face_prefix = "";
+	std::string body_prefix = "";
+	std::string svg_file = "";
+	std::string sheet_prefix = "";
+	bool unfold = false;
+	std::string stats_format = "";
+	std::string trace_file = "";
+	bool print_kernels = false;
+	std::string cache_dir = "";
+	double cache_mb = CACHE_DEFAULT_MAX_MB;
+	std::string batch_dir = "";
+	unsigned long in_flight = PREFETCH_DEFAULT_IN_FLIGHT;
+	bool all_converted = true;
+	ModelConv::Options options;
+	std::vector<std::string> outputs(NUM_OUTPUTS);
+	ResultCache* cache = NULL;
+	std::string report = "";
+	char* end = NULL;
 
 	// For command line arg parsing
 	int opt;
@@ -43,17 +523,313 @@ int main(int argc, char* argv[])
 	static struct option long_options[] =
 	{
 		{"input-file", required_argument, 0, 'i'},
-		{"help", no_argument, 0, 'h'}
+		{"batch-dir", required_argument, 0, 'D'},
+		{"prefetch", required_argument, 0, 'R'},
+		{"output-file", required_argument, 0, 'o'},
+		{"ply-file", required_argument, 0, 'y'},
+		{"thumbnail", required_argument, 0, 'm'},
+		{"thumbnail-size", required_argument, 0, 'M'},
+		{"face-prefix", required_argument, 0, 'f'},
+		{"body-prefix", required_argument, 0, 'b'},
+		{"decimate-error", required_argument, 0, 'd'},
+		{"triangle-budget", required_argument, 0, 'n'},
+		{"free-boundaries", no_argument, 0, 'B'},
+		{"precision", required_argument, 0, 'p'},
+		{"quantize", required_argument, 0, 'q'},
+		{"threads", required_argument, 0, 'j'},
+		{"morton-order", no_argument, 0, 'z'},
+		{"coplanar-angle", required_argument, 0, 'a'},
+		{"svg-file", required_argument, 0, 'g'},
+		{"unfold", no_argument, 0, 'u'},
+		{"kerf", required_argument, 0, 'K'},
+		{"kerf-join", required_argument, 0, 'J'},
+		{"svg-precision", required_argument, 0, 'P'},
+		{"sheet-prefix", required_argument, 0, 'G'},
+		{"sheet-size", required_argument, 0, 'S'},
+		{"label-edges", no_argument, 0, 'L'},
+		{"label-height", required_argument, 0, 'H'},
+		{"thickness", required_argument, 0, 'T'},
+		{"tab-width", required_argument, 0, 'W'},
+		{"cache-dir", required_argument, 0, 'c'},
+		{"cache-size", required_argument, 0, 'C'},
+		{"stats", required_argument, 0, 's'},
+		{"trace", required_argument, 0, 't'},
+		{"kernels", no_argument, 0, 'k'},
+		{"help", no_argument, 0, 'h'},
+		{0, 0, 0, 0}
 	};
 
 	// Parse command line arguments
-	while ((opt = getopt_long(argc, argv, "i:h", long_options,
+	while ((opt = getopt_long(argc, argv, "i:D:R:o:y:m:M:f:b:d:n:Bp:q:j:za:g:uK:J:P:G:S:LH:T:W:c:C:s:t:kh", long_options,
 		&option_index)) != -1)
 	{
 		switch (opt) {
 			case 'i':
 				input_file = optarg;
-				printf("Input File = %s\n", input_file.c_str());
+				fprintf(stderr, "Input File = %s\n", 
+					input_file.c_str());
+				break;
+
+			case 'D':
+				batch_dir = optarg;
+				break;
+
+			case 'R':
+				in_flight = strtoul(optarg, &end, 10);
+				if (*end || !in_flight ||
+					in_flight > PREFETCH_MAX_IN_FLIGHT)
+				{
+					fprintf(stderr, "Invalid prefetch count \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'o':
+				output_file = optarg;
+				break;
+
+			case 'y':
+				ply_file = optarg;
+				break;
+
+			case 'm':
+				thumbnail_file = optarg;
+				break;
+
+			case 'M':
+				options.thumbnailSize = (unsigned)strtoul(optarg, &end,
+					10);
+				if (*end || !options.thumbnailSize ||
+					options.thumbnailSize > THUMBNAIL_MAX_SIZE)
+				{
+					fprintf(stderr, "Invalid thumbnail size \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'f':
+				face_prefix = optarg;
+				break;
+
+			case 'b':
+				body_prefix = optarg;
+				break;
+
+			case 'd':
+				options.decimateError = strtof(optarg, &end);
+				if (*end || options.decimateError < 0)
+				{
+					fprintf(stderr, "Invalid decimation error "
+						"\"%s\".\n", optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'n':
+				options.decimateTriangles = strtoul(optarg, &end, 
+					10);
+				if (*end || !*optarg)
+				{
+					fprintf(stderr, "Invalid triangle budget "
+						"\"%s\".\n", optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'B':
+				options.keepBoundaries = false;
+				break;
+
+			case 'p':
+				if (!strcmp(optarg, "auto"))
+					options.precision = ModelConv::PRECISION_AUTO;
+				else if (!strcmp(optarg, "float"))
+					options.precision = ModelConv::PRECISION_FLOAT;
+				else if (!strcmp(optarg, "double"))
+					options.precision = ModelConv::PRECISION_DOUBLE;
+				else
+				{
+					fprintf(stderr, "Invalid precision \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'q':
+				options.quantizeStep = strtof(optarg, &end);
+				if (*end || !(options.quantizeStep > 0))
+				{
+					fprintf(stderr, "Invalid quantization step "
+						"\"%s\".\n", optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'j':
+				options.threads = (unsigned)strtoul(optarg, &end, 0);
+				if (*end)
+				{
+					fprintf(stderr, "Invalid thread count \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'z':
+				options.reorder = true;
+				break;
+
+			case 'a':
+				options.coplanarAngle = strtof(optarg, &end);
+				if (*end || !(options.coplanarAngle >= 0))
+				{
+					fprintf(stderr, "Invalid coplanar angle "
+						"\"%s\".\n", optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'g':
+				svg_file = optarg;
+				break;
+
+			case 'u':
+				unfold = true;
+				break;
+
+			case 'K':
+				options.kerf = strtof(optarg, &end);
+				if (*end || !(options.kerf >= 0))
+				{
+					fprintf(stderr, "Invalid kerf \"%s\".\n", optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'J':
+				if (!strcmp(optarg, "mitre"))
+					options.kerfJoin = Offsetter::JOIN_MITRE;
+				else if (!strcmp(optarg, "round"))
+					options.kerfJoin = Offsetter::JOIN_ROUND;
+				else
+				{
+					fprintf(stderr, "Invalid kerf join \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'P':
+				options.svgPrecision = (int)strtol(optarg, &end, 0);
+				if (*end || options.svgPrecision < 0 || 
+					options.svgPrecision > SvgPath::MAX_PRECISION)
+				{
+					fprintf(stderr, "Invalid SVG precision \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'G':
+				sheet_prefix = optarg;
+				break;
+
+			case 'S':
+				options.sheetWidth = strtof(optarg, &end);
+				if (*end == 'x')
+					options.sheetHeight = strtof(end + 1, &end);
+				if (*end || !(options.sheetWidth > 0) || 
+					!(options.sheetHeight > 0))
+				{
+					fprintf(stderr, "Invalid sheet size \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'L':
+				options.labelEdges = true;
+				break;
+
+			case 'H':
+				options.labelHeight = strtof(optarg, &end);
+				if (*end || !(options.labelHeight >= 0))
+				{
+					fprintf(stderr, "Invalid label height \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'T':
+				options.thickness = strtof(optarg, &end);
+				if (*end || !(options.thickness >= 0))
+				{
+					fprintf(stderr, "Invalid thickness \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'W':
+				options.tabWidth = strtof(optarg, &end);
+				if (*end || !(options.tabWidth >= 0))
+				{
+					fprintf(stderr, "Invalid tab width \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 'c':
+				cache_dir = optarg;
+				break;
+
+			case 'C':
+				cache_mb = strtod(optarg, &end);
+				if (*end || !(cache_mb > 0))
+				{
+					fprintf(stderr, "Invalid cache size \"%s\".\n",
+						optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 's':
+				stats_format = optarg;
+				if (stats_format != "json")
+				{
+					fprintf(stderr, "Unsupported stats format "
+						"\"%s\".\n", optarg);
+					print_usage(argv[0]);
+					exit(EXIT_FAILURE);
+				}
+				break;
+
+			case 't':
+				trace_file = optarg;
+				break;
+
+			case 'k':
+				print_kernels = true;
 				break;
 
 			case 'h':
@@ -68,18 +844,70 @@ int main(int argc, char* argv[])
 		}
 	}
 
-	printf("Hello Wurld\n");
+	// Stats JSON has its own kernels member, so stdout stays one object
+	if (print_kernels && (stats_format != "json" || (input_file.empty() &&
+		batch_dir.empty())))
+	{
+		printf("{\n");
+		for (int cnt = 0; cnt < NUM_KERNELS; cnt++)
+		{
+			printf("  \"%s\": \"%s\"%s\n", 
+				getKernelName((Kernel)cnt), 
+				getKernelVariantName((Kernel)cnt), 
+				cnt + 1 < NUM_KERNELS ? "," : "");
+		}
+		printf("}\n");
+
+		// Kernel report does not need a model
+		if (input_file.empty())
+			exit(EXIT_SUCCESS);
+	}
+
+	if (input_file.empty() == batch_dir.empty())
+	{
+		fprintf(stderr, "Give either an input file or a batch "
+			"directory.\n");
+		print_usage(argv[0]);
+		exit(EXIT_FAILURE);
+	}
 
-	// Create class to process 3D model data
-	model_conv = new ModelConv(input_file.c_str());
-	if (!model_conv)
+	if (!sheet_prefix.empty() && !(options.sheetWidth > 0))
 	{
-		fprintf(stderr, "Failed to allocate memory for model_conv. "
-			"Exiting.\n");
+		fprintf(stderr, "No sheet size given for sheet output.\n");
+		print_usage(argv[0]);
 		exit(EXIT_FAILURE);
 	}
 
-//	model_conv->debugPrint();
+	outputs[OUTPUT_STL] = output_file;
+	outputs[OUTPUT_PLY] = ply_file;
+	outputs[OUTPUT_THUMBNAIL] = thumbnail_file;
+	outputs[OUTPUT_FACES] = face_prefix;
+	outputs[OUTPUT_BODIES] = body_prefix;
+	outputs[OUTPUT_SVG] = svg_file;
+	outputs[OUTPUT_SHEETS] = sheet_prefix;
+
+	if (!cache_dir.empty())
+		cache = new ResultCache(cache_dir, 
+			(uint64_t)(cache_mb * 1024 * 1024));
+
+	if (!trace_file.empty())
+		Trace::start(trace_file.c_str());
+
+	if (!batch_dir.empty())
+	{
+		all_converted = convert_batch(batch_dir, (unsigned)in_flight, options,
+			outputs, unfold, stats_format, cache);
+	}
+	else
+	{
+		all_converted = convert_model(input_file.c_str(), NULL, 0, 
+			options, outputs, unfold, stats_format, cache, report);
+		printf("%s", report.c_str());
+	}
+
+	delete cache;
+
+	Trace::stop();
 
-	exit(EXIT_SUCCESS);
+	exit(all_converted ? EXIT_SUCCESS : EXIT_FAILURE);
 }
@@ -5,532 +5,4676 @@
  */
 
 #include "modelconv.h"
+#include "trace.h"
+#include "kernels.h"
+#include "morton.h"
+#include "weld.h"
+#include "parallel.h"
+#include "svgpath.h"
+#include "ply.h"
+#include "raster.h"
+#include "image.h"
+#include "simple_svg_1.0.0.hpp"
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
 //TODO: Added for use of exit() which is cheap way around not using exceptions for initial work on this class. FIXME
 #include <stdlib.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof(*(x))) //!< Used for calculating      
 	//!< static array sizes
 
+#define NORMAL_MAX_ERROR 0.001f //!< Maximum distance between normal stored
+	//!< in file and normal computed from vertices before the stored normal
+	//!< is considered wrong.
+
+#define TRACE_FACE_SAMPLE 16 //!< One in this many faces gets trace zones for
+	//!< building it and its border. Zones on every face of a model with
+	//!< many small faces slow face building by several percent.
+
+#define DEGENERATE_MIN_RATIO 1e-6f //!< Triangles whose doubled area is not
+	//!< more than this times the square of their longest edge are 
+	//!< considered degenerate and removed.
+
+#define SVG_STROKE_WIDTH 0.1 //!< Width of lines in SVG output, in model units.
+	//!< Thin enough for laser cutters to treat as a hairline.
+
+#define SVG_NET_GAP_RATIO 0.1 //!< Gap left between nets in SVG output, as a
+	//!< fraction of average border edge length.
+
+#define SVG_LABEL_HEIGHT_RATIO 0.15 //!< Height of edge labels in SVG output
+	//!< when not set, as a fraction of the length of the edge labelled.
+
+#define SVG_STRAIGHT_SINE 1e-4 //!< Border vertices where the border bends by
+	//!< less than this (sine of angle) are inside one straight edge when
+	//!< numbering edges and cutting joints. Tessellation often leaves a
+	//!< long straight edge in many short pieces.
+
+#define SVG_TAB_WIDTH_RATIO 3 //!< Width of finger joint tabs when not set, as
+	//!< a multiple of material thickness.
+
+#define SVG_JOINT_BATCH 256 //!< Faces given to a thread at a time when cutting
+	//!< finger joints.
+
+#define OFFSET_ARC_TOLERANCE 0.05 //!< Furthest round kerf joins can be from a
+	//!< true arc, as a fraction of half the kerf. Well under a laser's 
+	//!< positioning accuracy for any practical kerf.
+
+#define AUTO_DOUBLE_MAGNITUDE 65536.0f //!< Models with any coordinate at least
+	//!< this far from the origin are processed in double precision when 
+	//!< precision is left to be detected. Beyond this float spacing is 
+	//!< coarser than 1/128 of a unit.
+
+#define QUANTIZE_BITS 21 //!< Bits per axis of quantized vertex keys, so that
+	//!< all three fit in 64 bits. Models with more steps than this
+	//!< along an axis use 32 bits per axis in a 96 bit key.
+
+#define DETECT_CHUNK_TRIANGLES 4096 //!< Triangles read at a time when
+	//!< scanning a file for its largest coordinate.
+
+#define FACE_COLOR_HUE_STEP 0.6180339887 //!< Step in hue between colors of
+	//!< consecutive faces, as a fraction of the color wheel. The golden 
+	//!< ratio keeps any run of faces well spread around the wheel.
+
+#define FACE_COLOR_SATURATION 0.65f //!< Saturation of face colors.
+
+#define FACE_COLOR_VALUE 0.95f //!< Brightness of face colors.
+
+#define PLY_WRITE_BATCH 4096 //!< Faces packed at a time when writing PLY.
+
+#define THUMBNAIL_MARGIN 0.05f //!< Space left around model in thumbnails, as
+	//!< a fraction of their size.
+
+#define THUMBNAIL_AMBIENT 0.35f //!< Brightness of faces in thumbnails lit
+	//!< edge on. Faces facing the light are at full brightness.
+
+#define THUMBNAIL_BACKGROUND 0xFFFFFF //!< Color of thumbnail background, with
+	//!< red in the low byte.
+
+#define THUMBNAIL_THREAD_MIN 65536 //!< Fewest vertices or triangles worth 
+	//!< giving a thread of its own when preparing a thumbnail.
+
+#define LINK_ANGLE_THREAD_MIN 65536 //!< Fewest triangles worth giving a thread
+	//!< of its own when finding angles between neighbors.
+
+const uint32_t ModelConv::NO_FACE;
+
 /**
- * Constructor.
+ * Order of arrays in structure of arrays copy of triangle data.
+ */
+enum TriangleSoaArray
+{
+	SOA_NI = 0,
+	SOA_NJ,
+	SOA_NK,
+	SOA_X0,
+	SOA_Y0,
+	SOA_Z0,
+	// x, y, z of vertices 1 and 2 follow
+	SOA_COUNT = SOA_X0 + 9
+};
+
+/**
+ * Constructor. Defaults leave the mesh as it was loaded.
+ */
+ModelConv::Options::Options()
+: decimateError(0)
+, decimateTriangles(0)
+, keepBoundaries(true)
+, precision(PRECISION_AUTO)
+, quantizeStep(0)
+, reorder(false)
+, coplanarAngle(0.01f)
+, threads(0)
+, kerf(0)
+, kerfJoin(Offsetter::JOIN_MITRE)
+, svgPrecision(-1)
+, sheetWidth(0)
+, sheetHeight(0)
+, labelEdges(false)
+, labelHeight(0)
+, thickness(0)
+, tabWidth(0)
+, thumbnailSize(512)
+{
+}
+
+/**
+ * \return Every setting that affects results as name=value pairs separated
+ *	by semicolons, on one line, for telling apart results converted with
+ *	different settings. threads only affects speed and is left out.
+ */
+std::string ModelConv::Options::toString() const
+{
+	char text[512];
+
+	snprintf(text, sizeof(text), "decimateError=%.9g;decimateTriangles=%lu;"
+		"keepBoundaries=%d;precision=%d;quantizeStep=%.9g;reorder=%d;"
+		"coplanarAngle=%.9g;kerf=%.9g;kerfJoin=%d;svgPrecision=%d;"
+		"sheetWidth=%.9g;sheetHeight=%.9g;labelEdges=%d;"
+		"labelHeight=%.9g;thickness=%.9g;tabWidth=%.9g;"
+		"thumbnailSize=%u", 
+		decimateError, (unsigned long)decimateTriangles, 
+		(int)keepBoundaries, (int)precision, quantizeStep, (int)reorder,
+		coplanarAngle, kerf, (int)kerfJoin, svgPrecision, sheetWidth,
+		sheetHeight, (int)labelEdges, labelHeight, thickness, tabWidth,
+		thumbnailSize);
+
+	return text;
+}
+
+/**
+ * Load and process a model in the precision given by options, detecting it
+ *  from the file if it is PRECISION_AUTO.
+ *
+ * \param[in] filename File containing 3D model data.
+ * \param[in] options Settings controlling how model is processed.
+ *
+ * \return Newly allocated model. Caller must delete it.
+ */
+ModelConv* ModelConv::load(const char* filename, const Options& options)
+{
+	Precision precision = options.precision;
+
+	if (precision == PRECISION_AUTO)
+		precision = detectPrecision(filename);
+
+	if (precision == PRECISION_DOUBLE)
+		return new ModelConvImpl<double>(filename, options);
+
+	return new ModelConvImpl<float>(filename, options);
+}
+
+/**
+ * Load and process a model already read into memory, i.e. by a reader that
+ *  fetches files ahead of time, as load() would from a file.
+ *
+ * \param[in] name Name of model, used in messages and as the stats label.
+ * \param[in] data Contents of binary STL or PLY file. Only needs to stay 
+ *	valid until this returns.
+ * \param size Number of bytes in data.
+ * \param[in] options Settings controlling how model is processed.
+ *
+ * \return Newly allocated model. Caller must delete it.
+ */
+ModelConv* ModelConv::load(const char* name, const uint8_t* data, size_t size,
+	const Options& options)
+{
+	Precision precision = options.precision;
+
+	if (precision == PRECISION_AUTO)
+		precision = detectPrecision(data, size);
+
+	if (precision == PRECISION_DOUBLE)
+		return new ModelConvImpl<double>(name, options, data, size);
+
+	return new ModelConvImpl<float>(name, options, data, size);
+}
+
+/**
+ * Choose precision for a model by scanning its coordinates. Single precision
+ *  is used unless some coordinate is at least AUTO_DOUBLE_MAGNITUDE from the
+ *  origin. Files that cannot be read get single precision and are reported
+ *  when they are loaded.
  *
  * \param[in] filename File containing 3D model data.
+ *
+ * \return PRECISION_FLOAT or PRECISION_DOUBLE.
+ */
+ModelConv::Precision ModelConv::detectPrecision(const char* filename)
+{
+	std::vector<BinStlTriangle> chunk(DETECT_CHUNK_TRIANGLES);
+	uint8_t header[80];
+	uint32_t num_triangles = 0;
+	FILE* file = NULL;
+
+	if (isPlyFile(filename))
+	{
+		MappedFile mapped;
+
+		if (!mapped.map(filename))
+			return PRECISION_FLOAT;
+
+		return detectPrecision(mapped.getData(), mapped.getSize());
+	}
+
+	file = fopen(filename, "r");
+	if (!file)
+		return PRECISION_FLOAT;
+
+	if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+		fread(&num_triangles, 1, sizeof(num_triangles), file) != 
+		sizeof(num_triangles))
+	{
+		fclose(file);
+		return PRECISION_FLOAT;
+	}
+
+	while (num_triangles)
+	{
+		size_t count = std::min((size_t)num_triangles, chunk.size());
+		size_t elem_read = fread(chunk.data(), sizeof(BinStlTriangle), 
+			count, file);
+
+		if (needsDouble(chunk.data(), elem_read))
+		{
+			fclose(file);
+			return PRECISION_DOUBLE;
+		}
+
+		if (elem_read != count)
+			break;
+
+		num_triangles -= (uint32_t)count;
+	}
+
+	fclose(file);
+
+	return PRECISION_FLOAT;
+}
+
+/**
+ * Choose precision for a model already read into memory, as 
+ *  detectPrecision() does for a file.
+ *
+ * \param[in] data Contents of binary STL or PLY file.
+ * \param size Number of bytes in data.
+ *
+ * \return PRECISION_FLOAT or PRECISION_DOUBLE.
+ */
+ModelConv::Precision ModelConv::detectPrecision(const uint8_t* data, 
+	size_t size)
+{
+	uint32_t num_triangles = 0;
+	// 80 byte header, then the triangle count
+	size_t header_size = 80 + sizeof(num_triangles);
+
+	if (isPly(data, size))
+	{
+		PlyReader reader;
+		std::string error;
+
+		if (!reader.parse(data, size, error))
+			return PRECISION_FLOAT;
+
+		return reader.hasCoordBeyond(AUTO_DOUBLE_MAGNITUDE) ?
+			PRECISION_DOUBLE : PRECISION_FLOAT;
+	}
+
+	if (size < header_size)
+		return PRECISION_FLOAT;
+
+	memcpy(&num_triangles, data + 80, sizeof(num_triangles));
+
+	size_t count = std::min((size_t)num_triangles, 
+		(size - header_size) / sizeof(BinStlTriangle));
+
+	return needsDouble((const BinStlTriangle*)(data + header_size), count) ?
+		PRECISION_DOUBLE : PRECISION_FLOAT;
+}
+
+/**
+ * \param[in] triangles Triangles as stored in a binary STL file.
+ * \param count Number of triangles.
+ *
+ * \return True if any coordinate is at least AUTO_DOUBLE_MAGNITUDE from the
+ *	origin.
+ */
+bool ModelConv::needsDouble(const BinStlTriangle* triangles, size_t count)
+{
+	for (size_t cnt = 0; cnt < count; cnt++)
+	{
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			const BinStlVector& vertex = triangles[cnt].vertices[vtx];
+
+			if (fabsf(vertex.x) >= AUTO_DOUBLE_MAGNITUDE || 
+				fabsf(vertex.y) >= AUTO_DOUBLE_MAGNITUDE || 
+				fabsf(vertex.z) >= AUTO_DOUBLE_MAGNITUDE)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Pick a color for a face, so that neighboring faces can be told apart when
+ *  exported or drawn.
+ *
+ * \param face Index into faces of face.
+ * \param[out] rgb Red, green and blue of color.
+ *
+ * \return None.
+ */
+void ModelConv::getFaceColor(uint32_t face, uint8_t rgb[3])
+{
+	double turns = face * FACE_COLOR_HUE_STEP;
+	// Same as fmod() for positive values, and far quicker when coloring
+	//  millions of faces
+	float hue = 6 * (float)(turns - floor(turns));
+	int sector = std::min((int)hue, 5);
+	float frac = hue - (float)sector;
+	float v = FACE_COLOR_VALUE;
+	float p = v * (1 - FACE_COLOR_SATURATION);
+	float q = v * (1 - FACE_COLOR_SATURATION * frac);
+	float t = v * (1 - FACE_COLOR_SATURATION * (1 - frac));
+	// Red, green and blue for each sixth of the color wheel
+	const float sectors[6][3] =
+	{
+		{v, t, p}, {q, v, p}, {p, v, t}, {p, q, v}, {t, p, v}, {v, p, q}
+	};
+
+	for (int cnt = 0; cnt < 3; cnt++)
+		rgb[cnt] = (uint8_t)(sectors[sector][cnt] * 255 + 0.5f);
+}
+
+/**
+ * Destructor.
+ */
+ModelConv::~ModelConv()
+{
+}
+
+/**
+ * Constructor for an empty model. Loading constructors delegate to this one
+ *  so that, once it returns, the destructor frees whatever was allocated if
+ *  loading throws.
+ *
+ * \param[in] options Settings controlling how model is processed.
  */
-ModelConv::ModelConv(const char* filename)
-: vertices({})
+template <typename Real>
+ModelConvImpl<Real>::ModelConvImpl(const Options& options)
+: options(options)
+, vertices({})
 , triangles({})
 , faces({})
+, bvh()
+, stats()
+{
+}
+
+/**
+ * Constructor.
+ *
+ * \param[in] filename File containing 3D model data, in binary STL or PLY
+ *	format. Only used as a name if data is given.
+ * \param[in] options Settings controlling how model is processed.
+ * \param[in] data Contents of file if already read into memory, NULL to read
+ *	the file.
+ * \param size Number of bytes in data.
+ *
+ * \throw ModelConv::Error if the model cannot be loaded.
+ */
+template <typename Real>
+ModelConvImpl<Real>::ModelConvImpl(const char* filename, 
+	const Options& options, const uint8_t* data, size_t size)
+: ModelConvImpl(options)
 {
 	FILE* file = NULL;
 	// Number of elements read by fread
 	size_t elem_read = 0;
 	uint32_t num_triangles = 0;
-	// Used when building faces to know if we've already included a triangle in a face
-	std::unordered_map<const Triangle*, int> tri_face_map = {};
-	// Used when building a face to not repeat visits for that particular face.
-	std::unordered_map<const Triangle*, int> tri_trav_map = {};
+	// Raw triangle data as read from the file
+	std::vector<BinStlTriangle> bin_stl_triangles = {};
+	// Packed triangle records, either read into above or in data
+	const BinStlTriangle* records = NULL;
+	// Triangle data transposed to structure of arrays for batched kernels.
+	//  Array n (see SOA_* below) starts at element n * num_triangles.
+	std::vector<float> tri_soa = {};
+	// Recomputed normal components, doubled areas and mismatch flags
+	std::vector<float> normal_soa = {};
+	std::vector<uint8_t> normal_mismatch = {};
+	// Views of above arrays for batched kernels
+	TriangleArrays tri_arrays;
+	NormalArrays normal_arrays;
+	// Set for triangles with (close to) zero area
+	std::vector<uint8_t> degenerate = {};
+	// Index into vertices for each vertex of each triangle
+	std::vector<uint32_t> vertex_ids = {};
+	// Open addressing hash table used to find unique vertices
+	std::vector<uint32_t> weld_table = {};
+	// Hash of each vertex of each triangle, laid out like tri_soa
+	std::vector<uint32_t> vertex_hashes = {};
+	// PLY file mapped into memory, if not given in data
+	MappedFile mapped;
+	// Set if model is in PLY rather than binary STL format
+	bool ply = false;
 
 //TODO: Add code to check file type, etc. For now only support binary STL. Will add functions for parsing different file types later?
 
-	BinStlTriangle bin_stl_triangle;
+	stats.setLabel(filename);
 
 	memset(binStlHeader, 0, ARRAY_SIZE(binStlHeader));
 
-	// Open file for reading
-	file = fopen(filename, "r");	
-	if (!file)
+	// PLY records can be copied out where they lie, so the file is mapped
+	//  rather than read
+	if (!data && isPlyFile(filename))
 	{
-		fprintf(stderr, "Failed to open file \"%s\"\n", filename);
-		//TODO: add proper exception throwing
-		exit(EXIT_FAILURE);
-	}	
+		if (!mapped.map(filename))
+		{
+			fprintf(stderr, "Failed to open file \"%s\"\n", filename);
+			throw ModelConv::Error();
+		}
 
-	// Read header data from STL file
-	elem_read = fread(binStlHeader, sizeof(binStlHeader[0]), 
-		ARRAY_SIZE(binStlHeader), file);
-	if (ARRAY_SIZE(binStlHeader) != elem_read)
+		data = mapped.getData();
+		size = mapped.getSize();
+	}
+
+	ply = data && isPly(data, size);
+	if (ply)
+		loadPly(filename, data, size, vertex_ids, degenerate);
+
+	if (!ply)
 	{
-		fprintf(stderr, "Only able to read %lu of %lu header bytes from"
-			" file \"%s\"\n", elem_read, ARRAY_SIZE(binStlHeader),
-			filename);
-		fclose(file);
-		//TODO: add proper exception throwing
-		exit(EXIT_FAILURE);
+		Stats::ScopedTimer timer(stats, Stats::HEADER_READ);
+		TRACE_ZONE("read_header");
+
+		if (data)
+		{
+			if (size < sizeof(binStlHeader) + sizeof(num_triangles))
+			{
+				fprintf(stderr, "Only %lu header bytes in \"%s\"\n",
+					(unsigned long)size, filename);
+				throw ModelConv::Error();
+			}
+
+			memcpy(binStlHeader, data, sizeof(binStlHeader));
+			memcpy(&num_triangles, data + sizeof(binStlHeader), 
+				sizeof(num_triangles));
+		}
+		else
+		{
+			// Open file for reading
+			file = fopen(filename, "r");	
+			if (!file)
+			{
+				fprintf(stderr, "Failed to open file \"%s\"\n", 
+					filename);
+				throw ModelConv::Error();
+			}	
+
+			// Read header data from STL file
+			elem_read = fread(binStlHeader, sizeof(binStlHeader[0]),
+				ARRAY_SIZE(binStlHeader), file);
+			if (ARRAY_SIZE(binStlHeader) != elem_read)
+			{
+				fprintf(stderr, "Only able to read %lu of %lu header "
+					"bytes from file \"%s\"\n", elem_read, 
+					ARRAY_SIZE(binStlHeader), filename);
+				fclose(file);
+				throw ModelConv::Error();
+			}
+
+			// Read number of triangles in file from the STL file
+			elem_read = fread(&num_triangles, 1, 
+				sizeof(num_triangles), file);
+			if (sizeof(num_triangles) != elem_read)
+			{
+				fprintf(stderr, "Only able to read %lu of %lu num "
+					"triangle field bytes from file \"%s\"\n", 
+					elem_read, sizeof(num_triangles), filename);
+				fclose(file);
+				throw ModelConv::Error();
+			}
+		}
 	}
 
-	// Read number of triangles in file from the STL file
-	elem_read = fread(&num_triangles, 1, sizeof(num_triangles), file);
-	if (sizeof(num_triangles) != elem_read)
+	if (!ply)
 	{
-		fprintf(stderr, "Only able to read %lu of %lu num triangle "
-			"field bytes from file \"%s\"\n", elem_read, 
-			ARRAY_SIZE(binStlHeader), filename);
-		fclose(file);
-		//TODO: add proper exception throwing
-		exit(EXIT_FAILURE);
+		Stats::ScopedTimer timer(stats, Stats::TRIANGLE_DECODE);
+		TRACE_ZONE("decode_triangles");
+
+		if (data)
+		{
+			// Records are packed, so can be used where they are
+			size_t header_size = sizeof(binStlHeader) + 
+				sizeof(num_triangles);
+
+			elem_read = (size - header_size) / sizeof(BinStlTriangle);
+			if (num_triangles > elem_read)
+			{
+				fprintf(stderr, "Only read %lu of %u triangles from "
+					"\"%s\" file.\n", elem_read, num_triangles, 
+					filename);
+				throw ModelConv::Error();
+			}
+
+			records = (const BinStlTriangle*)(data + header_size);
+		}
+		else
+		{
+			// Check the count against the file's size before 
+			//  allocating for it, as a text STL or corrupt header can
+			//  claim billions of triangles
+			struct stat info;
+			size_t header_size = sizeof(binStlHeader) + 
+				sizeof(num_triangles);
+
+			if (!fstat(fileno(file), &info) && S_ISREG(info.st_mode))
+				elem_read = (uint64_t)info.st_size < header_size ? 0 :
+					(size_t)(((uint64_t)info.st_size - header_size) / 
+					sizeof(BinStlTriangle));
+			else
+				elem_read = num_triangles;
+			if (num_triangles > elem_read)
+			{
+				fprintf(stderr, "Only read %lu of %u triangles from "
+					"\"%s\" file.\n", elem_read, num_triangles, 
+					filename);
+				fclose(file);
+				throw ModelConv::Error();
+			}
+
+			// Read the triangle data from the STL file in one go
+			bin_stl_triangles.resize(num_triangles);
+			elem_read = fread(bin_stl_triangles.data(), 
+				sizeof(BinStlTriangle), num_triangles, file);
+			if (num_triangles != elem_read)
+			{
+				fprintf(stderr, "Only read %lu of %u triangles from "
+					"\"%s\" file.\n", elem_read, num_triangles, 
+					filename);
+				fclose(file);
+				throw ModelConv::Error();
+			}
+
+			if (fclose(file))
+			{
+				fprintf(stderr, "Failed to close file \"%s\" after "
+					"reading data.\n", filename);
+				throw ModelConv::Error();
+			}
+
+			records = bin_stl_triangles.data();
+		}
+
+		// Transpose packed records so each coordinate is contiguous
+		tri_soa.resize(SOA_COUNT * (size_t)num_triangles);
+		for (uint32_t cnt = 0; cnt < num_triangles; cnt++)
+		{
+			const BinStlTriangle& bin = records[cnt];
+
+			tri_soa[SOA_NI * num_triangles + cnt] = bin.normal.x;
+			tri_soa[SOA_NJ * num_triangles + cnt] = bin.normal.y;
+			tri_soa[SOA_NK * num_triangles + cnt] = bin.normal.z;
+
+			for (int vtx = 0; vtx < 3; vtx++)
+			{
+				tri_soa[(SOA_X0 + 3*vtx) * num_triangles + cnt] = 
+					bin.vertices[vtx].x;
+				tri_soa[(SOA_Y0 + 3*vtx) * num_triangles + cnt] = 
+					bin.vertices[vtx].y;
+				tri_soa[(SOA_Z0 + 3*vtx) * num_triangles + cnt] = 
+					bin.vertices[vtx].z;
+			}
+		}
+
+		// Packed records are no longer needed
+		std::vector<BinStlTriangle>().swap(bin_stl_triangles);
 	}
-	
-	// If object is closed, there will be at one vertex per triangle. 
-	//  Start off with vector of this size to minimize dynamic resizing.
-	vertices.reserve(num_triangles);
 
-	// We know exactly how many triangle there are and this should make sure
-	//  we allocate entries for all of them now
-	triangles.resize(num_triangles);
-	
-	// Read the triangle data from the STL file
-	for (uint32_t newest_idx = 0; newest_idx < num_triangles; newest_idx++)
+	if (!ply)
+	{
+		Stats::ScopedTimer timer(stats, Stats::NORMAL_COMPUTE);
+		TRACE_ZONE("recompute_normals");
+
+		normal_soa.resize(4 * (size_t)num_triangles);
+		normal_mismatch.resize(num_triangles);
+
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			tri_arrays.x[vtx] = 
+				&tri_soa[(SOA_X0 + 3*vtx) * num_triangles];
+			tri_arrays.y[vtx] = 
+				&tri_soa[(SOA_Y0 + 3*vtx) * num_triangles];
+			tri_arrays.z[vtx] = 
+				&tri_soa[(SOA_Z0 + 3*vtx) * num_triangles];
+		}
+		tri_arrays.ni = &tri_soa[SOA_NI * num_triangles];
+		tri_arrays.nj = &tri_soa[SOA_NJ * num_triangles];
+		tri_arrays.nk = &tri_soa[SOA_NK * num_triangles];
+
+		normal_arrays.ni = &normal_soa[0];
+		normal_arrays.nj = &normal_soa[(size_t)num_triangles];
+		normal_arrays.nk = &normal_soa[2 * (size_t)num_triangles];
+		normal_arrays.area2 = &normal_soa[3 * (size_t)num_triangles];
+		normal_arrays.mismatch = normal_mismatch.data();
+
+		stats.increment(Stats::NORMAL_MISMATCHES, recomputeNormals(
+			tri_arrays, normal_arrays, num_triangles, 
+			NORMAL_MAX_ERROR));
+
+		// We know exactly how many triangle there are and this should 
+		//  make sure we allocate entries for all of them now
+		triangles.resize(num_triangles);
+
+		for (uint32_t cnt = 0; cnt < num_triangles; cnt++)
+		{
+			triangles[cnt] = new Triangle();
+
+			// Faces are built from normals of the vertices, as in PLY
+			//  files, so a file's normals only matter where the 
+			//  triangle is too small to have one of its own
+			triangles[cnt]->normalMismatch = normal_mismatch[cnt];
+			if (normal_arrays.area2[cnt] > 0)
+			{
+				triangles[cnt]->normal.i = normal_arrays.ni[cnt];
+				triangles[cnt]->normal.j = normal_arrays.nj[cnt];
+				triangles[cnt]->normal.k = normal_arrays.nk[cnt];
+			}
+			else
+			{
+				triangles[cnt]->normal.i = tri_arrays.ni[cnt];
+				triangles[cnt]->normal.j = tri_arrays.nj[cnt];
+				triangles[cnt]->normal.k = tri_arrays.nk[cnt];
+			}
+
+			// Start off assuming new triangle has no neighbors
+			triangles[cnt]->neighbors[0] = NULL;
+			triangles[cnt]->neighbors[1] = NULL;
+			triangles[cnt]->neighbors[2] = NULL;
+		}
+	}
+
+	if (!ply)
+	{
+		Stats::ScopedTimer timer(stats, Stats::VERTEX_WELD);
+		TRACE_ZONE("weld_vertices");
+
+		// If object is closed, there will be roughly one vertex per two
+		//  triangles. Start off with tables of this size to minimize 
+		//  dynamic resizing.
+		vertices.reserve(num_triangles / 2 + 1);
+		vertex_ids.resize(3 * (size_t)num_triangles);
+
+		bounds[0][0] = bounds[0][1] = bounds[0][2] = INFINITY;
+		bounds[1][0] = bounds[1][1] = bounds[1][2] = -INFINITY;
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			computeBounds(tri_arrays.x[vtx], tri_arrays.y[vtx], 
+				tri_arrays.z[vtx], num_triangles, bounds[0], 
+				bounds[1]);
+		}
+
+		if (options.quantizeStep > 0)
+			weldQuantized(tri_arrays, num_triangles, vertex_ids);
+		else
+		{
+			// Hash all vertex slots up front so the SIMD kernel can be
+			//  used
+			vertex_hashes.resize(3 * (size_t)num_triangles);
+			for (int vtx = 0; vtx < 3; vtx++)
+			{
+				hashVertices(tri_arrays.x[vtx], tri_arrays.y[vtx], 
+					tri_arrays.z[vtx], 
+					&vertex_hashes[vtx * (size_t)num_triangles], 
+					num_triangles);
+			}
+
+			unsigned weld_threads = getWeldThreadCount(options.threads,
+				num_triangles);
+
+			// Both give the same ids, but the concurrent table needs 
+			//  extra passes to get them and only pays off when split
+			if (weld_threads > 1)
+			{
+				std::vector<uint32_t> first_slots;
+				uint64_t probes = 0;
+
+				weldVertices(tri_arrays, vertex_hashes.data(), 
+					num_triangles, weld_threads, vertex_ids.data(),
+					first_slots, probes);
+
+				vertices.resize(first_slots.size());
+				for (size_t cnt = 0; cnt < first_slots.size(); cnt++)
+				{
+					uint32_t tri = first_slots[cnt] / 3;
+					uint32_t vtx = first_slots[cnt] % 3;
+
+					vertices[cnt].x = tri_arrays.x[vtx][tri];
+					vertices[cnt].y = tri_arrays.y[vtx][tri];
+					vertices[cnt].z = tri_arrays.z[vtx][tri];
+				}
+
+				stats.increment(Stats::HASH_PROBES, probes);
+			}
+			else
+			{
+				weld_table.assign(16, 0);
+				while (weld_table.size() < num_triangles)
+					weld_table.resize(weld_table.size() * 2);
+
+				for (uint32_t cnt = 0; cnt < num_triangles; cnt++)
+				{
+					for (int vtx = 0; vtx < 3; vtx++)
+					{
+						Vertex vertex;
+
+						vertex.x = tri_arrays.x[vtx][cnt];
+						vertex.y = tri_arrays.y[vtx][cnt];
+						vertex.z = tri_arrays.z[vtx][cnt];
+
+						vertex_ids[3*cnt + vtx] = addVertex(
+							vertex, vertex_hashes[vtx * 
+							(size_t)num_triangles + cnt], 
+							weld_table);
+					}
+				}
+			}
+
+			std::vector<uint32_t>().swap(vertex_hashes);
+		}
+
+		// vertices is complete, so it is now safe to point into it
+		for (uint32_t cnt = 0; cnt < num_triangles; cnt++)
+		{
+			for (int vtx = 0; vtx < 3; vtx++)
+			{
+				triangles[cnt]->vertices[vtx] = 
+					&vertices[vertex_ids[3*cnt + vtx]];
+			}
+		}
+	}
+
+	{
+		Stats::ScopedTimer timer(stats, Stats::CLEANUP);
+		TRACE_ZONE("cleanup_triangles");
+
+		// PLY loading flags degenerates as it goes
+		if (!ply)
+		{
+			degenerate.resize(num_triangles);
+			flagDegenerate(tri_arrays, normal_arrays.area2, 
+				degenerate.data(), num_triangles, 
+				DEGENERATE_MIN_RATIO);
+		}
+
+		removeBadTriangles(vertex_ids, degenerate);
+
+		if (stats.getCount(Stats::DUPLICATES_REMOVED) || 
+			stats.getCount(Stats::DEGENERATES_REMOVED))
+		{
+			fprintf(stderr, "Removed %lu duplicate and %lu degenerate "
+				"triangles from \"%s\".\n", (unsigned long)
+				stats.getCount(Stats::DUPLICATES_REMOVED), 
+				(unsigned long)
+				stats.getCount(Stats::DEGENERATES_REMOVED), 
+				filename);
+		}
+	}
+
+	if (options.decimateError > 0 || options.decimateTriangles)
+	{
+		Stats::ScopedTimer timer(stats, Stats::DECIMATE);
+		TRACE_ZONE("decimate");
+
+		decimate(vertex_ids);
+	}
+
+	if (options.reorder)
+	{
+		Stats::ScopedTimer timer(stats, Stats::REORDER);
+		TRACE_ZONE("reorder");
+
+		reorder(vertex_ids);
+	}
+
+	{
+		Stats::ScopedTimer timer(stats, Stats::ADJACENCY);
+		TRACE_ZONE("find_adjacency");
+
+		buildAdjacency(vertex_ids);
+	}
+
+	{
+		Stats::ScopedTimer timer(stats, Stats::FACE_BUILD);
+		TRACE_ZONE("build_faces");
+
+		// Create faces now that we have graph representing all triangles
+		findBodies();
+		computeLinkAngles();
+		buildFaces();
+	}
+
+	stats.set(Stats::TRIANGLES, triangles.size());
+	stats.set(Stats::VERTICES, vertices.size());
+	stats.set(Stats::FACES, faces.size());
+	stats.set(Stats::BODIES, bodies.size());
+}
+
+/**
+ * Destructor.
+ */
+template <typename Real>
+ModelConvImpl<Real>::~ModelConvImpl()
+{
+	for (typename std::vector<Triangle*>::iterator itr = triangles.begin();
+		itr != triangles.end(); itr++)
+		delete(*itr);
+	
+	for (typename std::vector<Face*>::iterator itr = faces.begin();
+		itr != faces.end(); itr++)
+		delete(*itr);
+}
+
+/**
+ * Load vertices and triangles from a binary PLY file. PLY vertices are
+ *  already shared between faces, so they are used as they are rather than
+ *  welded again. Normals are computed from vertices, since PLY faces do not
+ *  store them.
+ *
+ * \param[in] filename Name of model, used in messages.
+ * \param[in] data Contents of PLY file.
+ * \param size Number of bytes in data.
+ * \param[out] vertexIds Index into vertices for each vertex of each
+ *	triangle.
+ * \param[out] degenerate Set for triangles with (close to) zero area.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::loadPly(const char* filename, const uint8_t* data,
+	size_t size, std::vector<uint32_t>& vertexIds,
+	std::vector<uint8_t>& degenerate)
+{
+	PlyReader reader;
+	std::string error = "";
+	size_t num_triangles = 0;
+
+	{
+		Stats::ScopedTimer timer(stats, Stats::HEADER_READ);
+		TRACE_ZONE("read_header");
+
+		if (!reader.parse(data, size, error))
+		{
+			fprintf(stderr, "Failed to read PLY file \"%s\": %s\n",
+				filename, error.c_str());
+			throw ModelConv::Error();
+		}
+	}
+
+	{
+		Stats::ScopedTimer timer(stats, Stats::TRIANGLE_DECODE);
+		TRACE_ZONE("decode_triangles");
+
+		// Vertex is three packed coordinates, as readVertices() writes
+		vertices.resize(reader.getNumVertices());
+		if (!vertices.empty())
+			reader.readVertices(&vertices[0].x);
+
+		if (!reader.readTriangles(vertexIds, error))
+		{
+			fprintf(stderr, "Failed to read PLY file \"%s\": %s\n",
+				filename, error.c_str());
+			throw ModelConv::Error();
+		}
+
+		num_triangles = vertexIds.size() / 3;
+		if (num_triangles > UINT32_MAX)
+		{
+			fprintf(stderr, "Too many triangles in \"%s\".\n",
+				filename);
+			throw ModelConv::Error();
+		}
+
+		bounds[0][0] = bounds[0][1] = bounds[0][2] = INFINITY;
+		bounds[1][0] = bounds[1][1] = bounds[1][2] = -INFINITY;
+		for (size_t cnt = 0; cnt < vertices.size(); cnt++)
+		{
+			const Real coords[3] = {vertices[cnt].x, vertices[cnt].y,
+				vertices[cnt].z};
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				bounds[0][axis] = std::min(bounds[0][axis],
+					(float)coords[axis]);
+				bounds[1][axis] = std::max(bounds[1][axis],
+					(float)coords[axis]);
+			}
+		}
+	}
+
+	{
+		Stats::ScopedTimer timer(stats, Stats::NORMAL_COMPUTE);
+		TRACE_ZONE("recompute_normals");
+
+		triangles.resize(num_triangles);
+		degenerate.resize(num_triangles);
+
+		for (size_t cnt = 0; cnt < num_triangles; cnt++)
+		{
+			Triangle* triangle = new Triangle();
+			Real max_edge2 = 0;
+
+			for (int vtx = 0; vtx < 3; vtx++)
+			{
+				triangle->vertices[vtx] =
+					&vertices[vertexIds[3*cnt + vtx]];
+				triangle->neighbors[vtx] = NULL;
+			}
+
+			for (int vtx = 0; vtx < 3; vtx++)
+			{
+				const Vertex& from = *triangle->vertices[vtx];
+				const Vertex& to = *triangle->vertices[(vtx + 1) % 3];
+				Real dx = to.x - from.x;
+				Real dy = to.y - from.y;
+				Real dz = to.z - from.z;
+
+				max_edge2 = std::max(max_edge2, dx*dx + dy*dy + dz*dz);
+			}
+
+			const Vertex& v0 = *triangle->vertices[0];
+			const Vertex& v1 = *triangle->vertices[1];
+			const Vertex& v2 = *triangle->vertices[2];
+			Real ax = v1.x - v0.x, ay = v1.y - v0.y, az = v1.z - v0.z;
+			Real bx = v2.x - v0.x, by = v2.y - v0.y, bz = v2.z - v0.z;
+			Real ni = ay*bz - az*by;
+			Real nj = az*bx - ax*bz;
+			Real nk = ax*by - ay*bx;
+			Real area2 = std::sqrt(ni*ni + nj*nj + nk*nk);
+
+			triangle->normal.i = area2 > 0 ? ni / area2 : 0;
+			triangle->normal.j = area2 > 0 ? nj / area2 : 0;
+			triangle->normal.k = area2 > 0 ? nk / area2 : 0;
+			triangle->normalMismatch = false;
+
+			// Not greater than (rather than less than or equal) so NaN
+			//  coordinates are flagged too
+			degenerate[cnt] = !(area2 > DEGENERATE_MIN_RATIO * max_edge2);
+
+			triangles[cnt] = triangle;
+		}
+	}
+}
+
+/**
+ * Double precision version of the projectPoints() kernel, so that buildBorder()
+ *  can call either. Left to the compiler to vectorize.
+ *
+ * \return None.
+ */
+static void projectPoints(const double* x, const double* y, const double* z,
+	size_t count, const double axes[2][3], double* u, double* v)
+{
+	for (size_t cnt = 0; cnt < count; cnt++)
+	{
+		u[cnt] = x[cnt] * axes[0][0] + y[cnt] * axes[0][1] + 
+			z[cnt] * axes[0][2];
+		v[cnt] = x[cnt] * axes[1][0] + y[cnt] * axes[1][1] + 
+			z[cnt] * axes[1][2];
+	}
+}
+
+/**
+ * Map a point from face coordinates into its net and then move it by an 
+ *  offset. Same as Unfolder::transform() with the offset added to the
+ *  placement's translation.
+ *
+ * \param[in] placement Where face was placed in its net.
+ * \param offsetX Added to translation of placement.
+ * \param offsetY
+ * \param x Point in face coordinates.
+ * \param y
+ * \param[out] outX Point in net coordinates.
+ * \param[out] outY
+ *
+ * \return None.
+ */
+template <typename Real>
+static void placePoint(const typename Unfolder<Real>::Placement& placement,
+	Real offsetX, Real offsetY, Real x, Real y, Real& outX, Real& outY)
+{
+	Real translate_x = placement.x + offsetX;
+	Real translate_y = placement.y + offsetY;
+
+	outX = placement.cosAngle * x - placement.sinAngle * y + translate_x;
+	outY = placement.sinAngle * x + placement.cosAngle * y + translate_y;
+}
+
+/**
+ * Export entire model data to single STL file format with binary data.
+ *
+ * \param[in] filename Filename to write STL data to.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::exportBinStl(const char* filename)
+{
+	Stats::ScopedTimer timer(stats, Stats::EXPORT);
+	std::vector<const Triangle*> all_triangles(triangles.begin(), 
+		triangles.end());
+
+	exportBinStl(filename, all_triangles);	
+	outputFiles.push_back(filename);
+}
+
+/**
+ * Export entire model to a binary PLY file with each face in its own color,
+ *  for checking how the model was split into faces in a mesh viewer.
+ *  Vertices are written once and shared, as they are held.
+ *
+ * \param[in] filename Name of file to write.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::exportPly(const char* filename)
+{
+	Stats::ScopedTimer timer(stats, Stats::EXPORT);
+	TRACE_ZONE("export_ply");
+	FILE* file = NULL;
+	// Number of elements written by fwrite
+	size_t elem_wr = 0;
+	std::vector<PlyFace> batch(PLY_WRITE_BATCH);
+	const char* coord_type = sizeof(Real) == sizeof(double) ? "double" :
+		"float";
+
+	file = fopen(filename, "w");
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open file \"%s\" for writing.\n",
+			filename);
+		throw ModelConv::Error();
+	}
+
+	if (fprintf(file, "ply\n"
+		"format binary_little_endian 1.0\n"
+		"comment Triangles colored by face\n"
+		"element vertex %lu\n"
+		"property %s x\n"
+		"property %s y\n"
+		"property %s z\n"
+		"element face %lu\n"
+		"property list uchar uint vertex_indices\n"
+		"property uchar red\n"
+		"property uchar green\n"
+		"property uchar blue\n"
+		"end_header\n", (unsigned long)vertices.size(), coord_type,
+		coord_type, coord_type, (unsigned long)triangles.size()) < 0)
+	{
+		fprintf(stderr, "Failed to write header to file \"%s\"\n",
+			filename);
+		fclose(file);
+		throw ModelConv::Error();
+	}
+
+	// Vertex is three packed coordinates, as PLY stores them
+	elem_wr = fwrite(vertices.data(), sizeof(Vertex), vertices.size(), file);
+	if (vertices.size() != elem_wr)
+	{
+		fprintf(stderr, "Only wrote %lu of %lu vertices to file "
+			"\"%s\"\n", elem_wr, vertices.size(), filename);
+		fclose(file);
+		throw ModelConv::Error();
+	}
+
+	for (size_t start = 0; start < triangles.size(); start += batch.size())
+	{
+		size_t count = std::min(batch.size(), triangles.size() - start);
+
+		for (size_t cnt = 0; cnt < count; cnt++)
+		{
+			const Triangle* triangle = triangles[start + cnt];
+			PlyFace& face = batch[cnt];
+
+			face.numVertices = 3;
+			for (int vtx = 0; vtx < 3; vtx++)
+			{
+				face.vertices[vtx] = (uint32_t)
+					(triangle->vertices[vtx] - vertices.data());
+			}
+			getFaceColor(triangle->face, face.color);
+		}
+
+		elem_wr = fwrite(batch.data(), sizeof(PlyFace), count, file);
+		if (count != elem_wr)
+		{
+			fprintf(stderr, "Only wrote %lu of %lu faces to file "
+				"\"%s\"\n", start + elem_wr, triangles.size(),
+				filename);
+			fclose(file);
+			throw ModelConv::Error();
+		}
+	}
+
+	if (fclose(file))
+	{
+		fprintf(stderr, "Failed to close file \"%s\" after writing "
+			"data.\n", filename);
+		throw ModelConv::Error();
+	}
+
+	outputFiles.push_back(filename);
+}
+
+/**
+ * Draw the model, with each face in its own color, to a square image for 
+ *  previewing how it was split into faces. The model is viewed along a 
+ *  diagonal of its bounds, from above and in front on the right, fitted to
+ *  the image and lit from the viewer's upper left. Written as PPM if 
+ *  filename ends in ".ppm", otherwise as PNG. Size is Options::thumbnailSize.
+ *
+ * \param[in] filename Name of file to write.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::exportThumbnail(const char* filename)
+{
+	Stats::ScopedTimer timer(stats, Stats::EXPORT);
+	TRACE_ZONE("export_thumbnail");
+	// right x up points back towards the viewer, so image is not mirrored
+	const float axes[2][3] = {
+		{(float)M_SQRT1_2, (float)M_SQRT1_2, 0},
+		{-1 / sqrtf(6), 1 / sqrtf(6), 2 / sqrtf(6)}};
+	const float forward[2][3] = {
+		{-1 / sqrtf(3), 1 / sqrtf(3), -1 / sqrtf(3)},
+		{-1 / sqrtf(3), 1 / sqrtf(3), -1 / sqrtf(3)}};
+	float light[3];
+	float light_length = 0;
+	int size = (int)options.thumbnailSize;
+	size_t num_vertices = vertices.size();
+	size_t num_triangles = triangles.size();
+	unsigned max_threads = getThreadCount(options.threads);
+	unsigned num_threads = (unsigned)std::max((size_t)1, std::min(
+		num_vertices / THUMBNAIL_THREAD_MIN, (size_t)max_threads));
+	size_t chunk = (num_vertices + num_threads - 1) / num_threads;
+	std::vector<float> coords(3 * num_vertices);
+	float* x = coords.data();
+	float* y = x + num_vertices;
+	float* z = y + num_vertices;
+	std::vector<float> u(num_vertices);
+	std::vector<float> v(num_vertices);
+	std::vector<float> depth(num_vertices);
+	std::vector<float> thread_bounds(6 * num_threads);
+	float min[3] = {INFINITY, INFINITY, INFINITY};
+	float max[3] = {-INFINITY, -INFINITY, -INFINITY};
+	std::vector<uint32_t> vertex_ids(3 * num_triangles);
+	std::vector<uint32_t> colors(num_triangles);
+	std::vector<uint8_t> rgb;
+	Rasterizer rasterizer(size, size, THUMBNAIL_BACKGROUND);
+	size_t length = strlen(filename);
+	bool ppm = length >= 4 && !strcasecmp(&filename[length - 4], ".ppm");
+
+	// Towards the viewer, up and to the left
+	for (int axis = 0; axis < 3; axis++)
+	{
+		light[axis] = 0.6f * axes[1][axis] - 0.3f * axes[0][axis] - 
+			forward[0][axis];
+		light_length += light[axis] * light[axis];
+	}
+	for (int axis = 0; axis < 3; axis++)
+		light[axis] /= sqrtf(light_length);
+
+	// Project relative to center of bounds so float keeps the detail of
+	//  models far from the origin
+	runThreads(num_threads, [&](unsigned thread)
+	{
+		size_t begin = std::min(num_vertices, thread * chunk);
+		size_t end = std::min(num_vertices, begin + chunk);
+		Real center[3];
+		float* min = &thread_bounds[6 * thread];
+		float* max = min + 3;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			center[axis] = ((Real)bounds[0][axis] + 
+				(Real)bounds[1][axis]) / 2;
+			min[axis] = INFINITY;
+			max[axis] = -INFINITY;
+		}
+
+		for (size_t cnt = begin; cnt < end; cnt++)
+		{
+			x[cnt] = (float)(vertices[cnt].x - center[0]);
+			y[cnt] = (float)(vertices[cnt].y - center[1]);
+			z[cnt] = (float)(vertices[cnt].z - center[2]);
+		}
+
+		projectPoints(&x[begin], &y[begin], &z[begin], end - begin, axes,
+			&u[begin], &v[begin]);
+		// Second output is the same, so written over the now unneeded x
+		projectPoints(&x[begin], &y[begin], &z[begin], end - begin, 
+			forward, &depth[begin], &x[begin]);
+		computeBounds(&u[begin], &v[begin], &depth[begin], end - begin,
+			min, max);
+	});
+
+	for (unsigned thread = 0; thread < num_threads; thread++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			min[axis] = std::min(min[axis], 
+				thread_bounds[6 * thread + axis]);
+			max[axis] = std::max(max[axis],
+				thread_bounds[6 * thread + 3 + axis]);
+		}
+	}
+
+	if (num_vertices)
+	{
+		float extent = std::max(max[0] - min[0], max[1] - min[1]);
+		float scale = extent > 0 ? (1 - 2 * THUMBNAIL_MARGIN) * 
+			(float)size / extent : 0;
+		float offset_u = ((float)size - scale * (max[0] - min[0])) / 2;
+		float offset_v = ((float)size - scale * (max[1] - min[1])) / 2;
+
+		// Rows go down the image, so v is flipped
+		runThreads(num_threads, [&](unsigned thread)
+		{
+			size_t begin = std::min(num_vertices, thread * chunk);
+			size_t end = std::min(num_vertices, begin + chunk);
+
+			for (size_t cnt = begin; cnt < end; cnt++)
+			{
+				u[cnt] = offset_u + scale * (u[cnt] - min[0]);
+				v[cnt] = (float)size - offset_v - 
+					scale * (v[cnt] - min[1]);
+			}
+		});
+	}
+
+	num_threads = (unsigned)std::max((size_t)1, std::min(
+		num_triangles / THUMBNAIL_THREAD_MIN, (size_t)max_threads));
+	chunk = (num_triangles + num_threads - 1) / num_threads;
+
+	runThreads(num_threads, [&](unsigned thread)
+	{
+		size_t end = std::min(num_triangles, (thread + 1) * chunk);
+
+		for (size_t tri = thread * chunk; tri < end; tri++)
+		{
+			const Triangle* triangle = triangles[tri];
+			const Normal& normal = triangle->normal;
+			float shade = fabsf((float)normal.i * light[0] + 
+				(float)normal.j * light[1] + (float)normal.k * light[2]);
+			uint8_t face_rgb[3];
+			uint32_t color = 0;
+
+			for (int vtx = 0; vtx < 3; vtx++)
+			{
+				vertex_ids[3 * tri + vtx] = (uint32_t)
+					(triangle->vertices[vtx] - vertices.data());
+			}
+
+			shade = THUMBNAIL_AMBIENT + (1 - THUMBNAIL_AMBIENT) * 
+				std::min(shade, 1.0f);
+			getFaceColor(triangle->face, face_rgb);
+			for (int channel = 0; channel < 3; channel++)
+			{
+				color |= (uint32_t)(shade * face_rgb[channel] + 0.5f) <<
+					(8 * channel);
+			}
+			colors[tri] = color;
+		}
+	});
+
+	rasterizer.draw(u.data(), v.data(), depth.data(), vertex_ids.data(),
+		colors.data(), num_triangles, max_threads);
+	rasterizer.getImage(rgb);
+
+	if (!(ppm ? writePpm(filename, size, size, rgb.data()) :
+		writePng(filename, size, size, rgb.data())))
+	{
+		fprintf(stderr, "Failed to write image file \"%s\".\n", filename);
+		throw ModelConv::Error();
+	}
+
+	outputFiles.push_back(filename);
+}
+
+/**
+ * Export each face to its own binary STL file. Mostly for verifying that 
+ *  faces were isolated correctly.
+ *
+ * \param[in] prefix Prefix of filenames to write. Face number and ".stl" are
+ *	appended to this.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::exportFaces(const char* prefix)
+{
+	Stats::ScopedTimer timer(stats, Stats::EXPORT);
+	TRACE_ZONE("export_faces");
+
+	forEachBody([&](size_t bodyId)
+	{
+		const Body& body = bodies[bodyId];
+
+		for (size_t cnt = 0; cnt < body.faces.size(); cnt++)
+		{
+			std::string filename = prefix;
+			filename.append(std::to_string(body.faces[cnt]));
+			filename.append(".stl");
+
+			exportBinStl(filename.c_str(), 
+				faces[body.faces[cnt]]->triangles);
+		}
+	});
+
+	for (size_t face = 0; face < faces.size(); face++)
+		outputFiles.push_back(prefix + std::to_string(face) + ".stl");
+}
+
+/**
+ * Export each disconnected body of the model to its own binary STL file, so
+ *  that a file holding a kit of parts can be split into one file per part.
+ *
+ * \param[in] prefix Prefix of filenames to write. Body number and ".stl" are
+ *	appended to this.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::exportBodies(const char* prefix)
+{
+	Stats::ScopedTimer timer(stats, Stats::EXPORT);
+	TRACE_ZONE("export_bodies");
+
+	forEachBody([&](size_t bodyId)
+	{
+		const Body& body = bodies[bodyId];
+		std::vector<const Triangle*> body_triangles(body.triangles.size());
+		std::string filename = prefix;
+
+		for (size_t cnt = 0; cnt < body.triangles.size(); cnt++)
+			body_triangles[cnt] = triangles[body.triangles[cnt]];
+
+		filename.append(std::to_string(bodyId));
+		filename.append(".stl");
+
+		exportBinStl(filename.c_str(), body_triangles);
+	});
+
+	for (size_t body = 0; body < bodies.size(); body++)
+		outputFiles.push_back(prefix + std::to_string(body) + ".stl");
+}
+
+/**
+ * Rebuild faces for a new coplanar tolerance without reloading the model. 
+ *  Only links whose angle is between the old and new tolerance change, so
+ *  only faces on those links are rebuilt: faces containing one when the 
+ *  tolerance tightens, as they may split, and faces on either side of one
+ *  when it loosens, as they may merge. So are faces with a triangle they 
+ *  reach whose angle to the face's seed is between the tolerances, and 
+ *  then any face linked within tolerance to a rebuilt face, as it may take
+ *  triangles a rebuilt face gives up. Triangles of those faces are grouped
+ *  again from scratch and the rest keep their faces. Faces end up numbered
+ *  by their first triangle, as buildFaces() numbers them, so the result is
+ *  the same as loading the model with the new tolerance, apart from which
+ *  face takes a triangle on some non-manifold edges.
+ *
+ * Borders are rebuilt for new faces and for faces next to them. Other faces
+ *  only have the ids of their neighbors updated. Any unfolding is dropped,
+ *  so unfold() must be called again for nets.
+ *
+ * \param coplanarAngle Largest angle, in degrees, between the normals of 
+ *	two neighboring triangles for them to be part of the same face.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::resegment(float coplanarAngle)
+{
+	Stats::ScopedTimer timer(stats, Stats::FACE_BUILD);
+	TRACE_ZONE("resegment");
+	bool tighten = coplanarAngle < options.coplanarAngle;
+	float low = std::min(coplanarAngle, options.coplanarAngle);
+	float high = std::max(coplanarAngle, options.coplanarAngle);
+	uint32_t num_faces = (uint32_t)faces.size();
+	std::vector<uint8_t> dirty(num_faces, 0);
+	std::vector<uint32_t> dirty_tris;
+
+	options.coplanarAngle = coplanarAngle;
+
+	size_t num_triangles = triangles.size();
+	unsigned num_threads = (unsigned)std::max((size_t)1, std::min(
+		num_triangles / LINK_ANGLE_THREAD_MIN, 
+		(size_t)getThreadCount(options.threads)));
+	size_t chunk = (num_triangles + num_threads - 1) / num_threads;
+	// Faces each thread found to rebuild, marked once all are done
+	std::vector<std::vector<uint32_t> > thread_dirty(num_threads);
+
+	runThreads(num_threads, [&](unsigned thread)
+	{
+		std::vector<uint32_t>& found = thread_dirty[thread];
+		size_t end = std::min(num_triangles, (thread + 1) * chunk);
+
+		for (size_t tri = thread * chunk; tri < end; tri++)
+		{
+			const Triangle* triangle = triangles[tri];
+			uint32_t face = triangle->face;
+
+			// A triangle may come within or go past the tolerance of
+			//  its face's seed. Seeds themselves are at 0.
+			if (seedAngles[tri] > low && seedAngles[tri] <= high)
+				found.push_back(face);
+
+			for (int cnt = 0; cnt < 3; cnt++)
+			{
+				const Triangle* neighbor = triangle->neighbors[cnt];
+				float angle = linkAngles[3 * tri + cnt];
+
+				// Links steeper than both tolerances never matter,
+				//  and are most links on curved models
+				if (!neighbor || !(angle <= high))
+					continue;
+
+				// Links within a face can only split it, and links
+				//  between faces can only merge them
+				bool same = face == neighbor->face;
+
+				if (angle > low && tighten == same)
+				{
+					found.push_back(face);
+					if (!same)
+						found.push_back(neighbor->face);
+					continue;
+				}
+
+				// A triangle of another face the face reaches may 
+				//  come within or go past the tolerance of its seed.
+				//  Triangles of the same face were checked above.
+				if (same)
+					continue;
+
+				float seed_angle = getLinkAngle(neighbor->normal, 
+					faces[face]->normal);
+
+				if (seed_angle > low && seed_angle <= high)
+				{
+					found.push_back(face);
+					found.push_back(neighbor->face);
+				}
+			}
+		}
+	});
+
+	for (unsigned thread = 0; thread < num_threads; thread++)
+		for (size_t cnt = 0; cnt < thread_dirty[thread].size(); cnt++)
+			dirty[thread_dirty[thread][cnt]] = 1;
+
+	// Triangles a rebuilt face gives up can go to any face that reaches 
+	//  them, so faces linked within tolerance to a rebuilt face are 
+	//  rebuilt too
+	std::vector<uint32_t> pending;
+
+	for (uint32_t face = 0; face < num_faces; face++)
+		if (dirty[face])
+			pending.push_back(face);
+
+	while (!pending.empty())
+	{
+		uint32_t face = pending.back();
+
+		pending.pop_back();
+		for (size_t tri = 0; tri < faces[face]->triangles.size(); tri++)
+		{
+			const Triangle* triangle = faces[face]->triangles[tri];
+
+			dirty_tris.push_back(triangle->index);
+			for (int cnt = 0; cnt < 3; cnt++)
+			{
+				const Triangle* neighbor = triangle->neighbors[cnt];
+
+				if (!neighbor || dirty[neighbor->face] || 
+					!(linkAngles[3 * triangle->index + cnt] <= high))
+					continue;
+
+				dirty[neighbor->face] = 1;
+				pending.push_back(neighbor->face);
+			}
+		}
+	}
+
+	if (dirty_tris.empty())
+		return;
+
+	std::sort(dirty_tris.begin(), dirty_tris.end());
+	for (size_t cnt = 0; cnt < dirty_tris.size(); cnt++)
+		triangles[dirty_tris[cnt]]->face = NO_FACE;
+
+	// Regroup freed triangles in ascending order, as buildFaces() would.
+	//  New faces get ids after the old ones until everything is 
+	//  renumbered.
+	std::vector<Face*> new_faces;
+	std::vector<std::pair<Triangle*, int> > stack;
+
+	for (size_t cnt = 0; cnt < dirty_tris.size(); cnt++)
+	{
+		Triangle* triangle = triangles[dirty_tris[cnt]];
+
+		if (triangle->face != NO_FACE)
+			continue;
+
+		Face* face = new Face();
+		face->normal = triangle->normal;
+
+		buildFace(*triangle, *face, num_faces + 
+			(uint32_t)new_faces.size(), stack);
+
+		new_faces.push_back(face);
+	}
+
+	// Merge kept and new faces, both already in order of first triangle
+	std::vector<uint32_t> remap(num_faces + new_faces.size(), NO_FACE);
+	std::vector<Face*> merged;
+	size_t new_cnt = 0;
+
+	merged.reserve(num_faces + new_faces.size());
+	for (uint32_t face = 0; face <= num_faces; face++)
+	{
+		uint32_t seed = face < num_faces ? 
+			faces[face]->triangles[0]->index : UINT32_MAX;
+
+		while (new_cnt < new_faces.size() && 
+			new_faces[new_cnt]->triangles[0]->index < seed)
+		{
+			remap[num_faces + new_cnt] = (uint32_t)merged.size();
+			merged.push_back(new_faces[new_cnt++]);
+		}
+
+		if (face == num_faces)
+			break;
+
+		if (dirty[face])
+		{
+			delete faces[face];
+			continue;
+		}
+
+		remap[face] = (uint32_t)merged.size();
+		merged.push_back(faces[face]);
+	}
+
+	for (size_t tri = 0; tri < triangles.size(); tri++)
+		triangles[tri]->face = remap[triangles[tri]->face];
+
+	// Kept faces only need new borders where they meet a rebuilt face
+	std::vector<uint32_t> rebuild;
+
+	for (uint32_t face = 0; face < remap.size(); face++)
+	{
+		if (face < num_faces && dirty[face])
+			continue;
+
+		Face& entry = *merged[remap[face]];
+		bool rebuilt = face >= num_faces;
+
+		for (size_t loop = 0; loop < entry.loops.size() && !rebuilt; 
+			loop++)
+		{
+			const std::vector<uint32_t>& neighbors = 
+				entry.loops[loop].neighbors;
+
+			for (size_t cnt = 0; cnt < neighbors.size(); cnt++)
+			{
+				if (neighbors[cnt] != NO_FACE && 
+					dirty[neighbors[cnt]])
+				{
+					rebuilt = true;
+					break;
+				}
+			}
+		}
+
+		if (rebuilt)
+		{
+			entry.loops.clear();
+			rebuild.push_back(remap[face]);
+			continue;
+		}
+
+		for (size_t loop = 0; loop < entry.loops.size(); loop++)
+		{
+			std::vector<uint32_t>& neighbors = 
+				entry.loops[loop].neighbors;
+
+			for (size_t cnt = 0; cnt < neighbors.size(); cnt++)
+				if (neighbors[cnt] != NO_FACE)
+					neighbors[cnt] = remap[neighbors[cnt]];
+		}
+	}
+
+	faces.swap(merged);
+
+	std::atomic<size_t> next(0);
+
+	num_threads = (unsigned)std::max((size_t)1, std::min(rebuild.size(), 
+		(size_t)getThreadCount(options.threads)));
+	runThreads(num_threads, [&](unsigned)
+	{
+		size_t cnt;
+
+		while ((cnt = next++) < rebuild.size())
+			buildBorder(*faces[rebuild[cnt]], rebuild[cnt]);
+	});
+
+	// Each face of a body is found at its first triangle
+	forEachBody([&](size_t bodyId)
+	{
+		Body& body = bodies[bodyId];
+
+		body.faces.clear();
+		for (size_t cnt = 0; cnt < body.triangles.size(); cnt++)
+		{
+			uint32_t face = triangles[body.triangles[cnt]]->face;
+
+			if (faces[face]->triangles[0]->index == body.triangles[cnt])
+				body.faces.push_back(face);
+		}
+	});
+
+	uint64_t border_points = 0;
+
+	for (size_t face = 0; face < faces.size(); face++)
+		for (size_t loop = 0; loop < faces[face]->loops.size(); loop++)
+			border_points += faces[face]->loops[loop].points.size();
+
+	unfolder = Unfolder<Real>();
+
+	stats.set(Stats::FACES, faces.size());
+	stats.set(Stats::BORDER_POINTS, border_points);
+	stats.set(Stats::NETS, 0);
+}
+
+/**
+ * Unfold faces into nets of faces joined along shared edges, so that each net
+ *  can be cut out in one piece and folded back up. Faces are only joined
+ *  where they would not overlap once flat. Affects the output of 
+ *  exportSvg().
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::unfold()
+{
+	Stats::ScopedTimer timer(stats, Stats::UNFOLD);
+	TRACE_ZONE("unfold");
+	std::vector<typename Unfolder<Real>::Face> descs(faces.size());
+
+	for (size_t face_cnt = 0; face_cnt < faces.size(); face_cnt++)
+	{
+		const Face& face = *faces[face_cnt];
+		typename Unfolder<Real>::Face& desc = descs[face_cnt];
+
+		desc.points.resize(face.loops.size());
+		desc.vertexIds.resize(face.loops.size());
+		desc.neighbors.resize(face.loops.size());
+
+		for (size_t loop_cnt = 0; loop_cnt < face.loops.size(); loop_cnt++)
+		{
+			const Loop& loop = face.loops[loop_cnt];
+
+			for (size_t cnt = 0; cnt < loop.vertices.size(); cnt++)
+			{
+				desc.points[loop_cnt].push_back(loop.points[cnt].x);
+				desc.points[loop_cnt].push_back(loop.points[cnt].y);
+				desc.vertexIds[loop_cnt].push_back(
+					(uint32_t)(loop.vertices[cnt] - vertices.data()));
+				desc.neighbors[loop_cnt].push_back(
+					loop.neighbors[cnt] == NO_FACE ? 
+					Unfolder<Real>::NO_FACE : loop.neighbors[cnt]);
+			}
+		}
+
+		desc.interior[0] = face.interior.x;
+		desc.interior[1] = face.interior.y;
+		desc.area = face.area;
+	}
+
+	unfolder.unfold(descs);
+
+	stats.set(Stats::NETS, unfolder.getNetCount());
+}
+
+/**
+ * Move the outline of each net out by half the kerf. Cut edges of each net
+ *  are chained into loops first, crossing folds by turning around the 
+ *  shared vertex into the next face, so only the outside of the net (and its
+ *  holes) is offset rather than every face. Nets are offset in parallel.
+ *
+ * \param[in,out] nets Nets to offset. Sets SvgNets::outlines.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::offsetNets(SvgNets& nets)
+{
+	TRACE_ZONE("kerf_offset");
+	std::atomic<uint32_t> next(0);
+	unsigned num_threads = std::max(1u, std::min(nets.numNets, 
+		getThreadCount(options.threads)));
+
+	nets.outlines.clear();
+	nets.outlines.resize(nets.numNets);
+
+	// Border edge of a face in the net being offset
+	struct NetEdge
+	{
+		uint32_t face;
+		uint32_t loop;
+		uint32_t edge;
+		uint32_t next; //!< Next edge around the same loop.
+		bool cut;
+	};
+
+	runThreads(num_threads, [&](unsigned)
+	{
+		Offsetter offsetter;
+		std::vector<std::vector<double> > loops;
+		std::vector<NetEdge> edges;
+		std::vector<uint8_t> visited;
+		std::unordered_map<uint64_t, uint32_t> edge_ids;
+		uint32_t net;
+
+		offsetter.setArcTolerance(OFFSET_ARC_TOLERANCE);
+
+		while ((net = next++) < nets.numNets)
+		{
+			loops.clear();
+			edges.clear();
+			edge_ids.clear();
+
+			for (size_t cnt = 0; cnt < nets.netFaces[net].size(); cnt++)
+			{
+				uint32_t face_cnt = nets.netFaces[net][cnt];
+				const Face& face = *faces[face_cnt];
+
+				for (uint32_t loop_cnt = 0; loop_cnt < face.loops.size();
+					loop_cnt++)
+				{
+					const Loop& loop = face.loops[loop_cnt];
+					uint32_t base = (uint32_t)edges.size();
+					uint32_t num = (uint32_t)loop.vertices.size();
+
+					for (uint32_t edge = 0; edge < num; edge++)
+					{
+						NetEdge net_edge = {face_cnt, loop_cnt, edge,
+							base + (edge + 1) % num, !nets.useNets || 
+							!unfolder.isFold(face_cnt, loop_cnt, edge)};
+						uint64_t from = (uint64_t)(loop.vertices[edge] -
+							vertices.data());
+						uint64_t to = (uint64_t)(loop.vertices[
+							(edge + 1) % num] - vertices.data());
+
+						if (!net_edge.cut)
+							edge_ids[from << 32 | to] = base + edge;
+						edges.push_back(net_edge);
+					}
+				}
+			}
+
+			visited.assign(edges.size(), 0);
+
+			for (uint32_t first = 0; first < edges.size(); first++)
+			{
+				if (!edges[first].cut || visited[first])
+					continue;
+
+				loops.push_back(std::vector<double>());
+
+				for (uint32_t edge = first; !visited[edge];)
+				{
+					const NetEdge& net_edge = edges[edge];
+					const Point2& pt = faces[net_edge.face]->loops[
+						net_edge.loop].points[net_edge.edge];
+					Real x, y;
+
+					uint32_t num_joint_pts;
+					const double* joint_pts = getJointPoints(nets, 
+						net_edge.face, net_edge.loop, net_edge.edge, 
+						num_joint_pts);
+
+					visited[edge] = 1;
+					if (!num_joint_pts)
+					{
+						placePoint(nets.placements[net_edge.face], 
+							(Real)0, (Real)0, pt.x, pt.y, x, y);
+						loops.back().push_back(x);
+						loops.back().push_back(y);
+					}
+
+					// Moved corner and finger joint, if cut
+					for (uint32_t cnt = 0; cnt < num_joint_pts; cnt++)
+					{
+						placePoint(nets.placements[net_edge.face], 
+							(Real)0, (Real)0, (Real)joint_pts[2*cnt], 
+							(Real)joint_pts[2*cnt + 1], x, y);
+						loops.back().push_back(x);
+						loops.back().push_back(y);
+					}
+
+					// Turn around the end vertex through any faces
+					//  folded onto this one until reaching a cut
+					edge = net_edge.next;
+					for (size_t turns = 0; !edges[edge].cut && 
+						turns < edges.size(); turns++)
+					{
+						const NetEdge& fold = edges[edge];
+						const Loop& loop = 
+							faces[fold.face]->loops[fold.loop];
+						uint64_t from = (uint64_t)(loop.vertices[
+							fold.edge] - vertices.data());
+						uint64_t to = (uint64_t)(loop.vertices[
+							(fold.edge + 1) % loop.vertices.size()] -
+							vertices.data());
+						std::unordered_map<uint64_t, uint32_t>::
+							const_iterator twin = 
+							edge_ids.find(to << 32 | from);
+
+						if (twin == edge_ids.end())
+							break;
+						edge = edges[twin->second].next;
+					}
+
+					// Fold without a matching edge on the other face,
+					//  close the loop here
+					if (!edges[edge].cut)
+						break;
+				}
+			}
+
+			offsetter.offset(loops, 0.5 * options.kerf, options.kerfJoin,
+				nets.outlines[net]);
+		}
+	});
+}
+
+/**
+ * Number each edge that is cut apart but joins two faces in the model, and
+ *  place a label with its number inside each of the two faces along the 
+ *  edge, so that parts can be matched up in assembly. Labels are kept clear
+ *  of any finger joints. Folds are not labelled, nor are open edges. 
+ *  Numbers are given in order of first use by face. Faces are labelled in
+ *  parallel, each on its own, since labels never leave their face. Edges
+ *  are logical edges from findLogicalEdges(), so a straight edge 
+ *  tessellated into pieces gets one number, and each label is sized from 
+ *  the length of its edge unless Options::labelHeight is set.
+ *
+ * \param[in,out] nets Nets to label. Sets SvgNets::labels and 
+ *	SvgNets::labelHeight.
+ * \param edgeLength Average border edge length, to size the group of 
+ *	labels from if Options::labelHeight is not set.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::labelNets(SvgNets& nets, double edgeLength)
+{
+	TRACE_ZONE("edge_labels");
+	uint32_t num_faces = (uint32_t)faces.size();
+	std::vector<uint32_t> label_offsets(num_faces + 1, 0);
+	std::vector<EdgeLabeler::Request> requests;
+	std::unordered_map<uint64_t, uint32_t> edge_ids;
+	std::vector<uint32_t> starts;
+
+	nets.labelHeight = options.labelHeight > 0 ? (Real)options.labelHeight :
+		(Real)(SVG_LABEL_HEIGHT_RATIO * edgeLength);
+
+	// Shared edges are found by the vertices at their ends, which are 
+	//  the same objects in both faces
+	for (uint32_t face_cnt = 0; face_cnt < num_faces; face_cnt++)
+	{
+		const Face& face = *faces[face_cnt];
+
+		for (uint32_t loop_cnt = 0; loop_cnt < face.loops.size(); 
+			loop_cnt++)
+		{
+			const Loop& loop = face.loops[loop_cnt];
+			uint32_t num = (uint32_t)loop.vertices.size();
+
+			findLogicalEdges(nets, face_cnt, loop_cnt, starts);
+			for (size_t cnt = 0; cnt < starts.size(); cnt++)
+			{
+				uint32_t edge = starts[cnt];
+				uint32_t end = cnt + 1 < starts.size() ? 
+					starts[cnt + 1] : starts[0] + num;
+
+				if (!isJoinedCut(nets, face_cnt, loop_cnt, edge))
+					continue;
+
+				const Vertex* from = loop.vertices[edge];
+				const Vertex* to = loop.vertices[end % num];
+				uint64_t from_id = (uint64_t)(from - vertices.data());
+				uint64_t to_id = (uint64_t)(to - vertices.data());
+				uint64_t key = from_id < to_id ? 
+					(from_id << 32 | to_id) : (to_id << 32 | from_id);
+				double length = sqrt(((double)to->x - from->x) * 
+					((double)to->x - from->x) + ((double)to->y - 
+					from->y) * ((double)to->y - from->y) + 
+					((double)to->z - from->z) * ((double)to->z - 
+					from->z));
+				EdgeLabeler::Request request = {loop_cnt, edge, 
+					(uint32_t)edge_ids.size() + 1, end - edge, 
+					options.labelHeight > 0 ? options.labelHeight : 
+					SVG_LABEL_HEIGHT_RATIO * length};
+
+				request.id = edge_ids.insert(std::make_pair(key, 
+					request.id)).first->second;
+				requests.push_back(request);
+			}
+		}
+
+		label_offsets[face_cnt + 1] = (uint32_t)requests.size();
+	}
+
+	std::atomic<uint32_t> next(0);
+	std::atomic<uint64_t> num_placed(0);
+	unsigned num_threads = std::max(1u, std::min(num_faces, 
+		getThreadCount(options.threads)));
+
+	nets.labels.clear();
+	nets.labels.resize(num_faces);
+
+	runThreads(num_threads, [&](unsigned)
+	{
+		EdgeLabeler labeler;
+		std::vector<std::vector<double> > loops;
+		std::vector<EdgeLabeler::Request> face_requests;
+		uint64_t placed = 0;
+		uint32_t face_cnt;
+
+		labeler.setHeight((double)nets.labelHeight);
+		labeler.setInset(options.thickness);
+
+		while ((face_cnt = next++) < num_faces)
+		{
+			uint32_t first = label_offsets[face_cnt];
+			uint32_t last = label_offsets[face_cnt + 1];
+			const Face& face = *faces[face_cnt];
+
+			if (first == last)
+				continue;
+
+			loops.resize(face.loops.size());
+			for (size_t loop_cnt = 0; loop_cnt < face.loops.size();
+				loop_cnt++)
+			{
+				const std::vector<Point2>& pts = 
+					face.loops[loop_cnt].points;
+
+				loops[loop_cnt].resize(2 * pts.size());
+				for (size_t cnt = 0; cnt < pts.size(); cnt++)
+				{
+					loops[loop_cnt][2*cnt] = (double)pts[cnt].x;
+					loops[loop_cnt][2*cnt + 1] = (double)pts[cnt].y;
+				}
+			}
+
+			face_requests.assign(requests.begin() + first, 
+				requests.begin() + last);
+			labeler.place(loops, face_requests, nets.labels[face_cnt]);
+			placed += nets.labels[face_cnt].size();
+		}
+
+		num_placed += placed;
+	});
+
+	stats.set(Stats::LABELS, num_placed);
+
+	if (num_placed < requests.size())
+		fprintf(stderr, "%u edge labels did not fit in their face and "
+			"were left out.\n", (uint32_t)(requests.size() - 
+			num_placed));
+}
+
+/**
+ * \param[in] nets Nets edge is drawn in.
+ * \param face Index into faces of face edge is on.
+ * \param loop Index into face's loops of loop edge is on.
+ * \param edge Index of edge in loop.
+ *
+ * \return True if edge is cut but joins another face in the model, so it is
+ *	labelled and gets a finger joint.
+ */
+template <typename Real>
+bool ModelConvImpl<Real>::isJoinedCut(const SvgNets& nets, uint32_t face, 
+	uint32_t loop, uint32_t edge) const
+{
+	return faces[face]->loops[loop].neighbors[edge] != NO_FACE && 
+		!(nets.useNets && unfolder.isFold(face, loop, edge));
+}
+
+/**
+ * Split a loop into logical edges, each a run of consecutive border edges
+ *  that are shared with the same face, are all cut or all folded, and carry
+ *  on in a straight line. These are the edges a person assembling the model
+ *  sees, so they are what get numbered and jointed. Runs only depend on the
+ *  two faces and the vertices along them, so both faces on an edge split it
+ *  the same way, and a run can be matched up by the vertices at its ends.
+ *
+ * \param[in] nets Nets loop is drawn in.
+ * \param face Index into faces of face loop is on.
+ * \param loop Index into face's loops of loop.
+ * \param[out] starts Index of first edge of each logical edge, in order.
+ *	Each runs up to the start of the next, the last wrapping around to the
+ *	first.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::findLogicalEdges(const SvgNets& nets, 
+	uint32_t face, uint32_t loop, std::vector<uint32_t>& starts) const
+{
+	const Loop& border = faces[face]->loops[loop];
+	uint32_t num = (uint32_t)border.vertices.size();
+
+	starts.clear();
+	for (uint32_t edge = 0; edge < num; edge++)
+	{
+		uint32_t prev = (edge + num - 1) % num;
+
+		if (border.neighbors[prev] != border.neighbors[edge] || 
+			isJoinedCut(nets, face, loop, prev) != 
+			isJoinedCut(nets, face, loop, edge) ||
+			!isStraight(border.vertices[prev], border.vertices[edge], 
+			border.vertices[(edge + 1) % num]))
+			starts.push_back(edge);
+	}
+
+	// Nowhere to start a run that both faces would agree on
+	if (starts.empty())
+		for (uint32_t edge = 0; edge < num; edge++)
+			starts.push_back(edge);
+}
+
+/**
+ * \param[in] prev Vertex before vertex on a border.
+ * \param[in] vertex Vertex to check.
+ * \param[in] next Vertex after vertex.
+ *
+ * \return True if the border carries straight on through vertex, to within
+ *	SVG_STRAIGHT_SINE. The same whichever way the border is followed.
+ */
+template <typename Real>
+bool ModelConvImpl<Real>::isStraight(const Vertex* prev, const Vertex* vertex,
+	const Vertex* next)
+{
+	double in[3] = {(double)vertex->x - prev->x, (double)vertex->y - prev->y,
+		(double)vertex->z - prev->z};
+	double out[3] = {(double)next->x - vertex->x, 
+		(double)next->y - vertex->y, (double)next->z - vertex->z};
+	double cross[3] = {in[1] * out[2] - in[2] * out[1], 
+		in[2] * out[0] - in[0] * out[2], in[0] * out[1] - in[1] * out[0]};
+	double dot = in[0] * out[0] + in[1] * out[1] + in[2] * out[2];
+	double in_len = sqrt(in[0] * in[0] + in[1] * in[1] + in[2] * in[2]);
+	double out_len = sqrt(out[0] * out[0] + out[1] * out[1] + 
+		out[2] * out[2]);
+
+	return dot > 0 && sqrt(cross[0] * cross[0] + cross[1] * cross[1] + 
+		cross[2] * cross[2]) <= SVG_STRAIGHT_SINE * in_len * out_len;
+}
+
+/**
+ * Cut finger joints into every edge that is cut but joins two faces, see 
+ *  FingerJoint, so the faces interlock when assembled. Joints run along 
+ *  logical edges, see findLogicalEdges(), so a straight edge tessellated 
+ *  into short pieces still gets fingers. Of the two faces on an edge, the
+ *  one with the higher index has notches at the ends, which move the 
+ *  corners of the face. Points of all edges are counted first so that one
+ *  buffer can be allocated for all faces, then faces are cut in parallel 
+ *  in batches, each writing to its own part of the buffer.
+ *
+ * \param[in,out] nets Nets to cut joints in. Sets SvgNets::edgeStarts, 
+ *	SvgNets::jointOffsets and SvgNets::jointPoints.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::cutJoints(SvgNets& nets)
+{
+	TRACE_ZONE("finger_joints");
+	uint32_t num_faces = (uint32_t)faces.size();
+	double tab_width = options.tabWidth > 0 ? options.tabWidth : 
+		SVG_TAB_WIDTH_RATIO * options.thickness;
+	FingerJoint joint(options.thickness, tab_width);
+
+	nets.edgeStarts.resize(num_faces + 1);
+	nets.edgeStarts[0] = 0;
+	for (uint32_t face_cnt = 0; face_cnt < num_faces; face_cnt++)
+	{
+		uint32_t num_edges = 0;
+
+		for (size_t loop_cnt = 0; loop_cnt < faces[face_cnt]->loops.size();
+			loop_cnt++)
+			num_edges += (uint32_t)faces[face_cnt]->loops[loop_cnt].
+				points.size();
+		nets.edgeStarts[face_cnt + 1] = nets.edgeStarts[face_cnt] + 
+			num_edges;
+	}
+
+	nets.jointOffsets.assign(nets.edgeStarts.back() + 1, 0);
+
+	unsigned num_threads = std::max(1u, std::min((num_faces + 
+		SVG_JOINT_BATCH - 1) / SVG_JOINT_BATCH, 
+		getThreadCount(options.threads)));
+	std::atomic<uint32_t> num_joints(0);
+	// Edges to be jointed that are too short for the fewest fingers
+	std::atomic<uint32_t> num_short(0);
+
+	// Count points of each edge, then fill them in
+	for (int pass = 0; pass < 2; pass++)
+	{
+		std::atomic<uint32_t> next(0);
+
+		if (pass)
+		{
+			for (size_t cnt = 1; cnt < nets.jointOffsets.size(); cnt++)
+				nets.jointOffsets[cnt] += nets.jointOffsets[cnt - 1];
+			nets.jointPoints.resize(2 * (size_t)nets.jointOffsets.back());
+		}
+
+		runThreads(num_threads, [&](unsigned)
+		{
+			std::vector<uint32_t> starts;
+			std::vector<double> scratch;
+			uint32_t first;
+			uint32_t joints = 0;
+			uint32_t short_edges = 0;
+
+			while ((first = next.fetch_add(SVG_JOINT_BATCH)) < num_faces)
+			{
+				uint32_t last = std::min(num_faces, first + 
+					SVG_JOINT_BATCH);
+
+				for (uint32_t face_cnt = first; face_cnt < last; face_cnt++)
+				{
+					const Face& face = *faces[face_cnt];
+					uint32_t index = nets.edgeStarts[face_cnt];
+
+					for (uint32_t loop_cnt = 0; loop_cnt < 
+						face.loops.size(); loop_cnt++)
+					{
+						findLogicalEdges(nets, face_cnt, loop_cnt, starts);
+						for (size_t run = 0; run < starts.size(); run++)
+						{
+							if (cutEdgeJoint(nets, joint, face_cnt, 
+								loop_cnt, index, starts, run, scratch, 
+								pass != 0))
+								joints++;
+							else if (isJoinedCut(nets, face_cnt, loop_cnt,
+								starts[run]))
+								short_edges++;
+						}
+						index += (uint32_t)face.loops[loop_cnt].
+							points.size();
+					}
+				}
+			}
+
+			if (pass)
+			{
+				num_joints += joints;
+				num_short += short_edges;
+			}
+		});
+	}
+
+	stats.set(Stats::JOINTS, num_joints);
+
+	if (num_short)
+		fprintf(stderr, "%u of %u joined edges are too short for finger "
+			"joints %g thick and were left straight.\n", 
+			(uint32_t)num_short, (uint32_t)(num_joints + num_short), 
+			options.thickness);
+}
+
+/**
+ * Cut the finger joint along one logical edge of a loop, or count the 
+ *  points it takes. The joint is laid out along the straight line between
+ *  the ends of the logical edge, and each border edge in it gets the points
+ *  of the joint that fall within it, after the corner at its start. Corners
+ *  inside the logical edge are moved in with the finger they fall in.
+ *
+ * \param[in,out] nets Nets to cut joint in. Sets the counts in 
+ *	SvgNets::jointOffsets when counting, else fills SvgNets::jointPoints.
+ * \param[in] joint Finger joint pattern to cut.
+ * \param face Index into faces of face loop is on.
+ * \param loop Index into face's loops of loop.
+ * \param index Index into SvgNets::jointOffsets of first edge of loop.
+ * \param[in] starts Logical edges of loop, from findLogicalEdges().
+ * \param run Index into starts of logical edge to cut.
+ * \param scratch Buffer for points of the whole joint.
+ * \param fill False to count points, true to fill them in.
+ *
+ * \return 1 if a joint was cut along the edge, else 0.
+ */
+template <typename Real>
+uint32_t ModelConvImpl<Real>::cutEdgeJoint(SvgNets& nets, 
+	const FingerJoint& joint, uint32_t face, uint32_t loop, uint32_t index,
+	const std::vector<uint32_t>& starts, size_t run, 
+	std::vector<double>& scratch, bool fill)
+{
+	const Loop& border = faces[face]->loops[loop];
+	const std::vector<Point2>& pts = border.points;
+	uint32_t num = (uint32_t)pts.size();
+	size_t num_runs = starts.size();
+	uint32_t first = starts[run];
+	uint32_t last = run + 1 < num_runs ? starts[run + 1] : starts[0] + num;
+	uint32_t prev_first = starts[(run + num_runs - 1) % num_runs];
+	uint32_t fingers = getEdgeFingers(nets, joint, face, loop, first, last);
+	bool notch_ends = face > border.neighbors[first];
+	bool prev_notched = face > border.neighbors[prev_first] && 
+		getEdgeFingers(nets, joint, face, loop, prev_first, first) > 0;
+
+	const Point2& from = pts[first];
+	const Point2& to = pts[last % num];
+	double dx = (double)to.x - (double)from.x;
+	double dy = (double)to.y - (double)from.y;
+	double length = hypot(dx, dy);
+	double in_x = fingers ? -dy / length * options.thickness : 0;
+	double in_y = fingers ? dx / length * options.thickness : 0;
+
+	if (fill && fingers)
+	{
+		scratch.resize(2 * (size_t)joint.getPointCount(length));
+		joint.cut(from.x, from.y, to.x, to.y, notch_ends, scratch.data());
+	}
+
+	// Position along the joint in fingers, kept from going backwards
+	double pos = 0;
+	uint32_t boundary = 1;
+
+	for (uint32_t edge = first; edge < last; edge++)
+	{
+		uint32_t cur = edge % num;
+		uint32_t count = 1;
+		double* out = fill ? &nets.jointPoints[2 * 
+			(size_t)nets.jointOffsets[index + cur]] : NULL;
+
+		if (fill && edge == first)
+		{
+			double prev_pt[2] = {pts[prev_first].x, pts[prev_first].y};
+			double cur_pt[2] = {from.x, from.y};
+			double to_pt[2] = {to.x, to.y};
+
+			joint.corner(prev_pt, cur_pt, to_pt, prev_notched, 
+				fingers && notch_ends, out);
+		}
+		else if (fill)
+		{
+			bool notched = fingers && joint.isNotched(std::min(
+				(uint32_t)pos, fingers - 1), notch_ends);
+
+			out[0] = (double)pts[cur].x + (notched ? in_x : 0);
+			out[1] = (double)pts[cur].y + (notched ? in_y : 0);
+		}
+
+		if (fingers)
+		{
+			const Point2& end = pts[(edge + 1) % num];
+			double end_pos = edge + 1 == last ? (double)fingers : 
+				std::max(pos, (((double)end.x - from.x) * dx + 
+				((double)end.y - from.y) * dy) / (length * length) * 
+				fingers);
+
+			// Two points where each finger meets the next
+			for (; boundary < fingers && boundary <= end_pos; boundary++)
+			{
+				if (fill)
+					memcpy(out + 2 * count, &scratch[4 * (boundary - 1)],
+						4 * sizeof(double));
+				count += 2;
+			}
+			pos = end_pos;
+		}
+
+		if (!fill)
+			nets.jointOffsets[index + cur + 1] = count;
+	}
+
+	return fingers ? 1 : 0;
+}
+
+/**
+ * \param[in] nets Nets joints are cut in.
+ * \param[in] joint Finger joint pattern.
+ * \param face Index into faces of face loop is on.
+ * \param loop Index into face's loops of loop.
+ * \param first Index of first border edge of logical edge.
+ * \param last One past index of last border edge, which may be past the
+ *	end of the loop if the logical edge wraps around.
+ *
+ * \return Number of fingers cut along the logical edge, 0 if it is not
+ *	jointed.
+ */
+template <typename Real>
+uint32_t ModelConvImpl<Real>::getEdgeFingers(const SvgNets& nets, 
+	const FingerJoint& joint, uint32_t face, uint32_t loop, uint32_t first,
+	uint32_t last) const
+{
+	const std::vector<Point2>& pts = faces[face]->loops[loop].points;
+	uint32_t num = (uint32_t)pts.size();
+	const Point2& from = pts[first % num];
+	const Point2& to = pts[last % num];
+
+	if (!isJoinedCut(nets, face, loop, first % num))
+		return 0;
+
+	return joint.getFingers(hypot((double)to.x - (double)from.x, 
+		(double)to.y - (double)from.y));
+}
+
+/**
+ * \param[in] nets Nets joints were cut in.
+ * \param face Index into faces of face edge is on.
+ * \param loop Index into face's loops of loop edge is on.
+ * \param edge Index of edge in loop.
+ * \param[out] numPoints Number of points returned. 0 if joints were not
+ *	cut.
+ *
+ * \return x, y pairs, in face coordinates, of the corner at the start of 
+ *	the edge, moved by any notches there, followed by the points of the 
+ *	edge's finger joint.
+ */
+template <typename Real>
+const double* ModelConvImpl<Real>::getJointPoints(const SvgNets& nets, 
+	uint32_t face, uint32_t loop, uint32_t edge, uint32_t& numPoints) const
+{
+	numPoints = 0;
+	if (nets.edgeStarts.empty())
+		return NULL;
+
+	uint32_t index = nets.edgeStarts[face] + edge;
+
+	for (uint32_t cnt = 0; cnt < loop; cnt++)
+		index += (uint32_t)faces[face]->loops[cnt].points.size();
+
+	numPoints = nets.jointOffsets[index + 1] - nets.jointOffsets[index];
+
+	return nets.jointPoints.data() + 2 * (size_t)nets.jointOffsets[index];
+}
+
+/**
+ * Gather what is needed to draw faces to SVG: where each face is placed in 
+ *  its net, the faces of each net, finger joints if Options::thickness is
+ *  set, each net's kerf outline, the box around each net and, if 
+ *  Options::labelEdges is set, each face's edge labels. 
+ *  If unfold() has not been called each face is a net of its own.
+ *
+ * \param[out] nets Nets ready to be packed and drawn.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::prepareSvgNets(SvgNets& nets)
+{
+	const std::vector<typename Unfolder<Real>::Placement>& placements = 
+		unfolder.getPlacements();
+
+	nets.useNets = !faces.empty() && placements.size() == faces.size();
+	nets.numNets = nets.useNets ? unfolder.getNetCount() : 
+		(uint32_t)faces.size();
+	nets.placements.resize(faces.size());
+	nets.netFaces.assign(nets.numNets, std::vector<uint32_t>());
+
+	uint32_t num_borderless = 0;
+
+	// Each face is a net of its own if model was not unfolded
+	for (uint32_t cnt = 0; cnt < faces.size(); cnt++)
+	{
+		typename Unfolder<Real>::Placement& placement = 
+			nets.placements[cnt];
+
+		if (faces[cnt]->loops.empty())
+			num_borderless++;
+
+		if (nets.useNets)
+		{
+			placement = placements[cnt];
+		}
+		else
+		{
+			placement.net = cnt;
+			placement.parent = Unfolder<Real>::NO_FACE;
+			placement.cosAngle = 1;
+			placement.sinAngle = 0;
+			placement.x = 0;
+			placement.y = 0;
+		}
+
+		nets.netFaces[placement.net].push_back(cnt);
+	}
+
+	// Closed surfaces all within the coplanar tolerance, which there is
+	//  nothing to draw for
+	if (num_borderless)
+		fprintf(stderr, "%u faces have no border and were left out of the "
+			"drawing. Try a smaller coplanar angle.\n", num_borderless);
+
+	bool use_kerf = options.kerf > 0;
+
+	nets.edgeStarts.clear();
+	nets.jointOffsets.clear();
+	nets.jointPoints.clear();
+	if (options.thickness > 0)
+		cutJoints(nets);
+
+	nets.outlines.clear();
+	if (use_kerf)
+		offsetNets(nets);
+
+	// Bounding box of each net (min x, min y, max x, max y)
+	std::vector<Real>& bounds = nets.bounds;
+	double edge_len_sum = 0;
+	size_t num_edges = 0;
+
+	bounds.resize(4 * nets.numNets);
+	for (uint32_t net = 0; net < nets.numNets; net++)
+	{
+		bounds[4*net] = bounds[4*net + 1] = INFINITY;
+		bounds[4*net + 2] = bounds[4*net + 3] = -INFINITY;
+
+		for (size_t loop_cnt = 0; use_kerf && 
+			loop_cnt < nets.outlines[net].size(); loop_cnt++)
+		{
+			const std::vector<double>& loop = nets.outlines[net][loop_cnt];
+
+			for (size_t cnt = 0; cnt + 1 < loop.size(); cnt += 2)
+			{
+				bounds[4*net] = std::min(bounds[4*net], (Real)loop[cnt]);
+				bounds[4*net + 1] = std::min(bounds[4*net + 1], 
+					(Real)loop[cnt + 1]);
+				bounds[4*net + 2] = std::max(bounds[4*net + 2], 
+					(Real)loop[cnt]);
+				bounds[4*net + 3] = std::max(bounds[4*net + 3], 
+					(Real)loop[cnt + 1]);
+			}
+		}
+	}
+
+	for (uint32_t face_cnt = 0; face_cnt < faces.size(); face_cnt++)
+	{
+		const typename Unfolder<Real>::Placement& placement = 
+			nets.placements[face_cnt];
+		Real* net_bounds = &bounds[4 * placement.net];
+
+		if (faces[face_cnt]->loops.empty())
+			continue;
+
+		const std::vector<Point2>& pts = faces[face_cnt]->loops[0].points;
+
+		for (size_t cnt = 0; cnt < pts.size(); cnt++)
+		{
+			const Point2& next = pts[(cnt + 1) % pts.size()];
+			Real x, y;
+
+			edge_len_sum += hypot(next.x - pts[cnt].x, next.y - pts[cnt].y);
+			num_edges++;
+
+			if (use_kerf)
+				continue;
+
+			placePoint(placement, (Real)0, (Real)0, pts[cnt].x, pts[cnt].y, 
+				x, y);
+			net_bounds[0] = std::min(net_bounds[0], x);
+			net_bounds[1] = std::min(net_bounds[1], y);
+			net_bounds[2] = std::max(net_bounds[2], x);
+			net_bounds[3] = std::max(net_bounds[3], y);
+		}
+	}
+
+	nets.gap = num_edges ? (Real)(SVG_NET_GAP_RATIO * edge_len_sum / 
+		(double)num_edges) : 1;
+
+	nets.labels.clear();
+	if (options.labelEdges)
+		labelNets(nets, num_edges ? edge_len_sum / (double)num_edges : 1);
+}
+
+/**
+ * \param[in] nets Nets to sort.
+ *
+ * \return Index of each net, tallest first.
+ */
+template <typename Real>
+std::vector<uint32_t> ModelConvImpl<Real>::sortNetsByHeight(
+	const SvgNets& nets)
+{
+	const std::vector<Real>& bounds = nets.bounds;
+	std::vector<uint32_t> order(nets.numNets);
+
+	for (uint32_t net = 0; net < nets.numNets; net++)
+		order[net] = net;
+
+	std::stable_sort(order.begin(), order.end(), 
+		[&bounds](uint32_t lhs, uint32_t rhs)
+		{
+			return bounds[4*lhs + 3] - bounds[4*lhs + 1] > 
+				bounds[4*rhs + 3] - bounds[4*rhs + 1];
+		});
+
+	return order;
+}
+
+/**
+ * Pack nets into rows on one page, tallest first. Aim for a roughly square
+ *  page but never narrower than the widest net.
+ *
+ * \param[in] nets Nets to pack.
+ * \param[out] offsets x, y pairs added to each net's coordinates to place it
+ *	on the page.
+ * \param[out] width Size of page.
+ * \param[out] height
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::packPage(const SvgNets& nets, 
+	std::vector<Real>& offsets, Real& width, Real& height)
+{
+	const std::vector<Real>& bounds = nets.bounds;
+	Real gap = nets.gap;
+	std::vector<uint32_t> order = sortNetsByHeight(nets);
+	double total_area = 0;
+	Real row_width = 0;
+
+	offsets.resize(2 * nets.numNets);
+
+	for (uint32_t net = 0; net < nets.numNets; net++)
+	{
+		Real net_width = bounds[4*net + 2] - bounds[4*net];
+		Real net_height = bounds[4*net + 3] - bounds[4*net + 1];
+
+		total_area += (double)(net_width + gap) * (net_height + gap);
+		row_width = std::max(row_width, net_width);
+	}
+
+	row_width = std::max(row_width, (Real)sqrt(total_area));
+
+	Real x = gap;
+	Real y = gap;
+	Real row_height = 0;
+
+	width = gap;
+
+	for (uint32_t cnt = 0; cnt < nets.numNets; cnt++)
+	{
+		uint32_t net = order[cnt];
+		Real net_width = bounds[4*net + 2] - bounds[4*net];
+		Real net_height = bounds[4*net + 3] - bounds[4*net + 1];
+
+		if (x > gap && x + net_width > row_width + gap)
+		{
+			x = gap;
+			y += row_height + gap;
+			row_height = 0;
+		}
+
+		offsets[2*net] = x - bounds[4*net];
+		offsets[2*net + 1] = y - bounds[4*net + 1];
+
+		x += net_width + gap;
+		row_height = std::max(row_height, net_height);
+		width = std::max(width, x);
+	}
+
+	height = y + row_height + gap;
+}
+
+/**
+ * Pack nets into rows, tallest first, across as many sheets of a fixed size
+ *  as it takes. Each net goes on the current sheet if it fits, otherwise a
+ *  new sheet is started. Nets too big for any sheet get a sheet of their own
+ *  and hang off its edges.
+ *
+ * \param[in] nets Nets to pack.
+ * \param sheetWidth Size of each sheet.
+ * \param sheetHeight
+ * \param[out] offsets x, y pairs added to each net's coordinates to place it
+ *	on its sheet.
+ * \param[out] sheets Index of each net on each sheet.
+ *
+ * \return Number of nets too big for a sheet.
+ */
+template <typename Real>
+uint32_t ModelConvImpl<Real>::packSheets(const SvgNets& nets, 
+	Real sheetWidth, Real sheetHeight, std::vector<Real>& offsets,
+	std::vector<std::vector<uint32_t> >& sheets)
+{
+	const std::vector<Real>& bounds = nets.bounds;
+	Real gap = nets.gap;
+	std::vector<uint32_t> order = sortNetsByHeight(nets);
+	const size_t NO_SHEET = (size_t)-1;
+	size_t current = NO_SHEET; // Sheet rows are being added to
+	uint32_t num_oversize = 0;
+	Real x = gap;
+	Real y = gap;
+	Real row_height = 0;
+
+	offsets.resize(2 * nets.numNets);
+	sheets.clear();
+
+	for (uint32_t cnt = 0; cnt < nets.numNets; cnt++)
+	{
+		uint32_t net = order[cnt];
+		Real net_width = bounds[4*net + 2] - bounds[4*net];
+		Real net_height = bounds[4*net + 3] - bounds[4*net + 1];
+
+		offsets[2*net] = gap - bounds[4*net];
+		offsets[2*net + 1] = gap - bounds[4*net + 1];
+
+		if (net_width + 2 * gap > sheetWidth || 
+			net_height + 2 * gap > sheetHeight)
+		{
+			sheets.push_back(std::vector<uint32_t>(1, net));
+			num_oversize++;
+			continue;
+		}
+
+		if (current != NO_SHEET && x + net_width + gap > sheetWidth)
+		{
+			x = gap;
+			y += row_height + gap;
+			row_height = 0;
+		}
+
+		if (current == NO_SHEET || y + net_height + gap > sheetHeight)
+		{
+			current = sheets.size();
+			sheets.push_back(std::vector<uint32_t>());
+			x = gap;
+			y = gap;
+			row_height = 0;
+		}
+
+		offsets[2*net] = x - bounds[4*net];
+		offsets[2*net + 1] = y - bounds[4*net + 1];
+		sheets[current].push_back(net);
+
+		x += net_width + gap;
+		row_height = std::max(row_height, net_height);
+	}
+
+	return num_oversize;
+}
+
+/**
+ * Draw nets to an SVG document, with edges to cut in red, fold edges in
+ *  blue and any edge labels in black. If Options::kerf is set, each net is
+ *  cut along its outline moved out by half the kerf instead of along its 
+ *  face borders. If 
+ *  Options::svgPrecision is set, all cuts and all folds are written as two
+ *  compact path elements rather than a shape per loop or run of edges.
+ *
+ * \param[in] nets Nets to draw from.
+ * \param[in] netIds Index of each net to draw.
+ * \param[in] offsets x, y pairs added to each net's coordinates to place it
+ *	in the document.
+ * \param[in,out] doc Document to draw to.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::drawNets(const SvgNets& nets, 
+	const std::vector<uint32_t>& netIds, const std::vector<Real>& offsets,
+	svg::Document& doc)
+{
+	svg::Stroke cut_stroke(SVG_STROKE_WIDTH, svg::Color::Red);
+	svg::Stroke fold_stroke(SVG_STROKE_WIDTH, svg::Color::Blue);
+	bool use_kerf = !nets.outlines.empty();
+
+	// Compact output draws everything with each stroke as one path, since
+	//  the attributes of each element would take up more space than most
+	//  faces do
+	bool compact = options.svgPrecision >= 0;
+	SvgPath all_cuts(cut_stroke, options.svgPrecision);
+	SvgPath all_folds(fold_stroke, options.svgPrecision);
+	SvgLabels labels(svg::Fill(svg::Color::Black), (double)nets.labelHeight,
+		options.svgPrecision);
+	std::vector<svg::Point> pts;
+	std::vector<svg::Point> corners;
+
+	for (size_t net_cnt = 0; net_cnt < netIds.size(); net_cnt++)
+	{
+		uint32_t net = netIds[net_cnt];
+		Real offset_x = offsets[2*net];
+		Real offset_y = offsets[2*net + 1];
+		SvgPath net_outline(cut_stroke, options.svgPrecision);
+		SvgPath& outline = compact ? all_cuts : net_outline;
+
+		for (size_t loop_cnt = 0; use_kerf && 
+			loop_cnt < nets.outlines[net].size(); loop_cnt++)
+		{
+			const std::vector<double>& loop = nets.outlines[net][loop_cnt];
+
+			for (size_t cnt = 0; cnt + 1 < loop.size(); cnt += 2)
+			{
+				if (!cnt)
+					outline.moveTo(loop[cnt] + offset_x, 
+						loop[cnt + 1] + offset_y);
+				else
+					outline.lineTo(loop[cnt] + offset_x, 
+						loop[cnt + 1] + offset_y);
+			}
+			outline.close();
+		}
+
+		if (!compact)
+			doc << outline;
+
+		for (size_t face_idx = 0; face_idx < nets.netFaces[net].size();
+			face_idx++)
+		{
+			uint32_t face_cnt = nets.netFaces[net][face_idx];
+			const Face& face = *faces[face_cnt];
+			const typename Unfolder<Real>::Placement& placement = 
+				nets.placements[face_cnt];
+			SvgPath face_cuts(cut_stroke, options.svgPrecision);
+			SvgPath face_folds(fold_stroke, options.svgPrecision);
+			SvgPath& cuts = compact ? all_cuts : face_cuts;
+			SvgPath& folds = compact ? all_folds : face_folds;
+
+			for (uint32_t loop_cnt = 0; loop_cnt < face.loops.size(); 
+				loop_cnt++)
+			{
+				const Loop& loop = face.loops[loop_cnt];
+				uint32_t num_pts = (uint32_t)loop.points.size();
+				uint32_t first_fold = num_pts;
+
+				pts.resize(num_pts);
+				corners.resize(num_pts);
+				for (uint32_t cnt = 0; cnt < num_pts; cnt++)
+				{
+					uint32_t num_joint_pts;
+					const double* joint_pts = getJointPoints(nets, 
+						face_cnt, loop_cnt, cnt, num_joint_pts);
+					Real px, py;
+
+					placePoint(placement, offset_x, offset_y, 
+						loop.points[cnt].x, loop.points[cnt].y, px, 
+						py);
+					pts[cnt] = svg::Point(px, py);
+
+					// Cuts go around corners moved by finger joints
+					if (num_joint_pts)
+						placePoint(placement, offset_x, offset_y, 
+							(Real)joint_pts[0], (Real)joint_pts[1], px,
+							py);
+					corners[cnt] = svg::Point(px, py);
+
+					if (first_fold == num_pts && nets.useNets && 
+						unfolder.isFold(face_cnt, loop_cnt, cnt))
+						first_fold = cnt;
+				}
+
+				// Outline is already drawn if kerf is set
+				if (first_fold == num_pts && use_kerf)
+					continue;
+
+				// Cut along an edge from its start through any finger
+				//  joint, and on to its end unless the path is closed
+				//  there
+				auto cut_edge = [&](uint32_t edge, bool to_end)
+				{
+					uint32_t num_joint_pts;
+					const double* joint_pts = getJointPoints(nets, 
+						face_cnt, loop_cnt, edge, num_joint_pts);
+
+					for (uint32_t cnt = 1; cnt < num_joint_pts; cnt++)
+					{
+						Real px, py;
+
+						placePoint(placement, offset_x, offset_y, 
+							(Real)joint_pts[2*cnt], 
+							(Real)joint_pts[2*cnt + 1], px, py);
+						cuts.lineTo(px, py);
+					}
+					if (to_end)
+						cuts.lineTo(corners[(edge + 1) % num_pts].x, 
+							corners[(edge + 1) % num_pts].y);
+				};
+
+				if (first_fold == num_pts)
+				{
+					cuts.moveTo(corners[0].x, corners[0].y);
+					for (uint32_t cnt = 0; cnt < num_pts; cnt++)
+						cut_edge(cnt, cnt + 1 < num_pts);
+					cuts.close();
+					continue;
+				}
+
+				// Break loop into runs of cut edges and runs of fold 
+				//  edges, starting just after a fold so no run of cuts
+				//  wraps around
+				bool in_cut = false;
+				bool in_fold = false;
+
+				for (uint32_t step = 1; step <= num_pts; step++)
+				{
+					uint32_t edge = (first_fold + step) % num_pts;
+					uint32_t next = (edge + 1) % num_pts;
+
+					if (!unfolder.isFold(face_cnt, loop_cnt, edge))
+					{
+						in_fold = false;
+						if (use_kerf)
+							continue;
+
+						if (!in_cut)
+							cuts.moveTo(corners[edge].x, 
+								corners[edge].y);
+						cut_edge(edge, true);
+						in_cut = true;
+						continue;
+					}
+
+					in_cut = false;
+
+					// Both faces on a fold have the edge, only draw it
+					//  once
+					if (face_cnt > loop.neighbors[edge])
+					{
+						in_fold = false;
+						continue;
+					}
+
+					if (!in_fold)
+						folds.moveTo(pts[edge].x, pts[edge].y);
+					folds.lineTo(pts[next].x, pts[next].y);
+					in_fold = true;
+				}
+			}
+
+			if (!compact)
+				doc << cuts << folds;
+
+			for (size_t cnt = 0; !nets.labels.empty() && 
+				cnt < nets.labels[face_cnt].size(); cnt++)
+			{
+				const EdgeLabeler::Label& label = 
+					nets.labels[face_cnt][cnt];
+				Real x, y;
+
+				placePoint(placement, offset_x, offset_y, (Real)label.x,
+					(Real)label.y, x, y);
+				labels.add(label.id, x, y, placement.cosAngle * 
+					label.dirX - placement.sinAngle * label.dirY,
+					placement.sinAngle * label.dirX + 
+					placement.cosAngle * label.dirY, label.height);
+			}
+		}
+	}
+
+	if (compact)
+		doc << all_cuts << all_folds;
+	doc << labels;
+}
+
+/**
+ * Output Scalable Vector Graphics with the border of each face as an outlined
+ *  object, ready for cutting. If unfold() has been called faces are grouped
+ *  into nets, with fold edges drawn in blue and edges to cut in red. 
+ *  Otherwise each face is drawn on its own. Nets are packed into rows in 
+ *  order of decreasing height on a single page. Units are the same as the 
+ *  model's. See drawNets() for how Options change what is drawn.
+ *
+ * \param[in] filename Filename to write SVG data to.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::exportSvg(const char* filename)
+{
+	Stats::ScopedTimer timer(stats, Stats::EXPORT);
+	TRACE_ZONE("export_svg");
+	SvgNets nets;
+	std::vector<Real> offsets;
+	Real page_width, page_height;
+
+	prepareSvgNets(nets);
+	packPage(nets, offsets, page_width, page_height);
+
+	std::vector<uint32_t> net_ids(nets.numNets);
+
+	for (uint32_t net = 0; net < nets.numNets; net++)
+		net_ids[net] = net;
+
+	svg::Document doc(filename, svg::Layout(svg::Dimensions(page_width, 
+		page_height), svg::Layout::BottomLeft));
+
+	drawNets(nets, net_ids, offsets, doc);
+
+	if (!doc.save())
+	{
+		fprintf(stderr, "Failed to write SVG file \"%s\".\n", filename);
+		throw ModelConv::Error();
+	}
+
+	outputFiles.push_back(filename);
+}
+
+/**
+ * Output the same drawing as exportSvg(), split across sheets of material of
+ *  size Options::sheetWidth by Options::sheetHeight. Sheets are written to
+ *  <prefix>sheet_000.svg, <prefix>sheet_001.svg, ... in parallel, each by
+ *  one thread. <prefix>manifest.json lists which sheet each face ended up
+ *  on and where.
+ *
+ * \param[in] prefix Prepended to the name of each file written.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::exportSheets(const char* prefix)
+{
+	Stats::ScopedTimer timer(stats, Stats::EXPORT);
+	TRACE_ZONE("export_sheets");
+
+	if (!(options.sheetWidth > 0 && options.sheetHeight > 0))
+	{
+		fprintf(stderr, "Sheet size must be set to export sheets.\n");
+		throw ModelConv::Error();
+	}
+
+	SvgNets nets;
+	std::vector<Real> offsets;
+	std::vector<std::vector<uint32_t> > sheets;
+	Real sheet_width = (Real)options.sheetWidth;
+	Real sheet_height = (Real)options.sheetHeight;
+
+	prepareSvgNets(nets);
+
+	uint32_t num_oversize = packSheets(nets, sheet_width, sheet_height, 
+		offsets, sheets);
+
+	if (num_oversize)
+		fprintf(stderr, "%u nets do not fit on a %gx%g sheet and were "
+			"given a sheet of their own.\n", num_oversize, 
+			(double)sheet_width, (double)sheet_height);
+
+	uint32_t num_sheets = (uint32_t)sheets.size();
+	std::atomic<uint32_t> next(0);
+	std::atomic<uint32_t> failed(num_sheets);
+	unsigned num_threads = std::max(1u, std::min(num_sheets, 
+		getThreadCount(options.threads)));
+
+	runThreads(num_threads, [&](unsigned)
+	{
+		uint32_t sheet;
+
+		while ((sheet = next++) < num_sheets)
+		{
+			svg::Document doc(getSheetFilename(prefix, sheet), 
+				svg::Layout(svg::Dimensions(sheet_width, sheet_height),
+				svg::Layout::BottomLeft));
+
+			drawNets(nets, sheets[sheet], offsets, doc);
+
+			if (!doc.save())
+			{
+				uint32_t none = num_sheets;
+
+				failed.compare_exchange_strong(none, sheet);
+			}
+		}
+	});
+
+	if (failed < num_sheets)
+	{
+		fprintf(stderr, "Failed to write SVG file \"%s\".\n", 
+			getSheetFilename(prefix, failed).c_str());
+		throw ModelConv::Error();
+	}
+
+	writeSheetManifest(prefix, nets, offsets, sheets);
+	stats.set(Stats::SHEETS, num_sheets);
+
+	for (uint32_t sheet = 0; sheet < num_sheets; sheet++)
+		outputFiles.push_back(getSheetFilename(prefix, sheet));
+	outputFiles.push_back(std::string(prefix) + "manifest.json");
+}
+
+/**
+ * \param[in] prefix Prepended to file name.
+ * \param sheet Index of sheet.
+ *
+ * \return Name of SVG file sheet is written to.
+ */
+template <typename Real>
+std::string ModelConvImpl<Real>::getSheetFilename(const char* prefix,
+	uint32_t sheet)
+{
+	char name[32];
+
+	snprintf(name, sizeof(name), "sheet_%03u.svg", sheet);
+
+	return std::string(prefix) + name;
+}
+
+/**
+ * Write <prefix>manifest.json, giving the file of each sheet and, for each
+ *  face, its net, its sheet and where its interior point landed on the sheet
+ *  (from the bottom left corner, in model units) along with how far it was
+ *  rotated counter clockwise, in degrees.
+ *
+ * \param[in] prefix Prepended to file name.
+ * \param[in] nets Nets that were drawn.
+ * \param[in] offsets x, y pairs added to each net's coordinates to place it
+ *	on its sheet.
+ * \param[in] sheets Index of each net on each sheet.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::writeSheetManifest(const char* prefix, 
+	const SvgNets& nets, const std::vector<Real>& offsets,
+	const std::vector<std::vector<uint32_t> >& sheets)
+{
+	std::string filename = std::string(prefix) + "manifest.json";
+	std::vector<uint32_t> net_sheets(nets.numNets, 0);
+	FILE* file = fopen(filename.c_str(), "w");
+
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open file \"%s\" for writing.\n",
+			filename.c_str());
+		throw ModelConv::Error();
+	}
+
+	fprintf(file, "{\n  \"sheet_width\": %.9g,\n  \"sheet_height\": %.9g,\n"
+		"  \"sheets\": [\n", options.sheetWidth, options.sheetHeight);
+
+	for (uint32_t sheet = 0; sheet < sheets.size(); sheet++)
+	{
+		std::string sheet_file = getSheetFilename("", sheet);
+
+		fprintf(file, "    \"%s\"%s\n", sheet_file.c_str(), 
+			sheet + 1 < sheets.size() ? "," : "");
+
+		for (size_t cnt = 0; cnt < sheets[sheet].size(); cnt++)
+			net_sheets[sheets[sheet][cnt]] = sheet;
+	}
+
+	fprintf(file, "  ],\n  \"faces\": [\n");
+
+	for (uint32_t face_cnt = 0; face_cnt < faces.size(); face_cnt++)
+	{
+		const typename Unfolder<Real>::Placement& placement = 
+			nets.placements[face_cnt];
+		const Point2& interior = faces[face_cnt]->interior;
+		Real x, y;
+
+		placePoint(placement, offsets[2 * placement.net], 
+			offsets[2 * placement.net + 1], interior.x, interior.y, x, y);
+
+		fprintf(file, "    {\"face\": %u, \"net\": %u, \"sheet\": %u, "
+			"\"x\": %.9g, \"y\": %.9g, \"angle\": %.9g}%s\n", face_cnt, 
+			placement.net, net_sheets[placement.net], (double)x, 
+			(double)y, atan2(placement.sinAngle, placement.cosAngle) * 
+			180 / M_PI, face_cnt + 1 < faces.size() ? "," : "");
+	}
+
+	fprintf(file, "  ]\n}\n");
+
+	bool write_failed = ferror(file) != 0;
+
+	if (fclose(file) || write_failed)
+	{
+		fprintf(stderr, "Failed to write file \"%s\".\n", filename.c_str());
+		throw ModelConv::Error();
+	}
+}
+
+/**
+ * Build bounding volume hierarchy over all triangles so that spatial queries
+ *  can be made. Queries call this automatically the first time, but it can
+ *  be called up front to keep build time out of the first query.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::buildBvh()
+{
+	Stats::ScopedTimer timer(stats, Stats::BVH_BUILD);
+	TRACE_ZONE("build_bvh");
+	std::vector<Real> coords(9 * triangles.size());
+
+	for (size_t tri = 0; tri < triangles.size(); tri++)
+	{
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			const Vertex* vertex = triangles[tri]->vertices[vtx];
+
+			coords[9*tri + 3*vtx] = vertex->x;
+			coords[9*tri + 3*vtx + 1] = vertex->y;
+			coords[9*tri + 3*vtx + 2] = vertex->z;
+		}
+	}
+
+	bvh.build(coords.data(), triangles.size(), options.threads);
+}
+
+/**
+ * Find the closest triangle, and the face it is in, hit by a ray. For 
+ *  picking faces in a UI.
+ *
+ * \param[in] origin Start of ray.
+ * \param[in] dir Direction of ray.
+ * \param[out] triangle Index in triangles of triangle that was hit.
+ * \param[out] face Index in faces of face that was hit.
+ * \param[out] dist Distance along ray to hit, in multiples of dir's length.
+ *
+ * \return True if something was hit.
+ */
+template <typename Real>
+bool ModelConvImpl<Real>::pickFace(const double origin[3],
+	const double dir[3], uint32_t& triangle, uint32_t& face, double& dist)
+{
+	Real ray_origin[3] = {(Real)origin[0], (Real)origin[1],
+		(Real)origin[2]};
+	Real ray_dir[3] = {(Real)dir[0], (Real)dir[1], (Real)dir[2]};
+	Real hit_dist = 0;
+
+	if (!bvh.isBuilt())
+		buildBvh();
+
+	if (!bvh.intersectRay(ray_origin, ray_dir, INFINITY, triangle,
+		hit_dist))
+		return false;
+
+	face = triangles[triangle]->face;
+	dist = hit_dist;
+
+	return true;
+}
+
+/**
+ * Find all triangles touching a box. For finding what touches a region or 
+ *  checking cut clearance.
+ *
+ * \param[in] min Minimum corner of box.
+ * \param[in] max Maximum corner of box.
+ * \param[out] triangleIds Indices in triangles of triangles touching box, in
+ *	no particular order.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::findTrianglesInBox(const double min[3],
+	const double max[3], std::vector<uint32_t>& triangleIds)
+{
+	Real box_min[3] = {(Real)min[0], (Real)min[1], (Real)min[2]};
+	Real box_max[3] = {(Real)max[0], (Real)max[1], (Real)max[2]};
+
+	if (!bvh.isBuilt())
+		buildBvh();
+
+	triangleIds.clear();
+	bvh.queryBox(box_min, box_max, triangleIds);
+}
+
+/**
+ * Find all faces touching a box.
+ *
+ * \param[in] min Minimum corner of box.
+ * \param[in] max Maximum corner of box.
+ * \param[out] faceIds Sorted indices in faces of faces touching box.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::findFacesInBox(const double min[3],
+	const double max[3], std::vector<uint32_t>& faceIds)
+{
+	std::vector<uint32_t> triangle_ids;
+
+	findTrianglesInBox(min, max, triangle_ids);
+	trianglesToFaces(triangle_ids, faceIds);
+}
+
+/**
+ * Find all triangles within a distance of a point.
+ *
+ * \param[in] point Point to search around.
+ * \param tolerance Maximum distance from point.
+ * \param[out] triangleIds Indices in triangles of triangles near point, in
+ *	no particular order.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::findTrianglesNearPoint(const double point[3],
+	double tolerance, std::vector<uint32_t>& triangleIds)
+{
+	Real center[3] = {(Real)point[0], (Real)point[1], (Real)point[2]};
+
+	if (!bvh.isBuilt())
+		buildBvh();
+
+	triangleIds.clear();
+	bvh.queryPoint(center, (Real)tolerance, triangleIds);
+}
+
+/**
+ * Find all faces within a distance of a point.
+ *
+ * \param[in] point Point to search around.
+ * \param tolerance Maximum distance from point.
+ * \param[out] faceIds Sorted indices in faces of faces near point.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::findFacesNearPoint(const double point[3],
+	double tolerance, std::vector<uint32_t>& faceIds)
+{
+	std::vector<uint32_t> triangle_ids;
+
+	findTrianglesNearPoint(point, tolerance, triangle_ids);
+	trianglesToFaces(triangle_ids, faceIds);
+}
+
+/**
+ * Convert triangle indices to the unique set of faces they are part of.
+ *
+ * \param[in] triangleIds Indices in triangles.
+ * \param[out] faceIds Sorted, unique indices in faces.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::trianglesToFaces(const std::vector<uint32_t>& triangleIds,
+	std::vector<uint32_t>& faceIds)
+{
+	faceIds.clear();
+
+	for (size_t cnt = 0; cnt < triangleIds.size(); cnt++)
+		faceIds.push_back(triangles[triangleIds[cnt]]->face);
+
+	std::sort(faceIds.begin(), faceIds.end());
+	faceIds.erase(std::unique(faceIds.begin(), faceIds.end()), 
+		faceIds.end());
+}
+
+/**
+ * \return Precision model geometry is stored and processed in.
+ */
+template <typename Real>
+ModelConv::Precision ModelConvImpl<Real>::getPrecision() const
+{
+	return sizeof(Real) == sizeof(double) ? PRECISION_DOUBLE : 
+		PRECISION_FLOAT;
+}
+
+/**
+ * \return Phase timings and counters gathered while processing this model.
+ */
+template <typename Real>
+const Stats& ModelConvImpl<Real>::getStats() const
+{
+	return stats;
+}
+
+/**
+ * \return Name of every file written by exports so far, in the order they 
+ *	were exported.
+ */
+template <typename Real>
+const std::vector<std::string>& ModelConvImpl<Real>::getOutputFiles() const
+{
+	return outputFiles;
+}
+
+/**
+ * Get axis aligned box around all vertices read from file.
+ *
+ * \param[out] min Minimum corner of box.
+ * \param[out] max Maximum corner of box.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::getBounds(float min[3], float max[3]) const
+{
+	memcpy(min, bounds[0], sizeof(bounds[0]));
+	memcpy(max, bounds[1], sizeof(bounds[1]));
+}
+
+/**
+ * TODO: want to print useful info. but shoudl this be to_string?
+ */
+template <typename Real>
+void ModelConvImpl<Real>::debugPrint()
+{
+	printf("%lu unique vertices found amongst %lu triangles.\n\n", 
+		vertices.size(), triangles.size());
+
+	uint32_t cnt = 0;
+	for (typename std::vector<Triangle*>::iterator itr = triangles.begin();
+		itr != triangles.end(); itr++) 
+	{
+		printf("Triangle %u (%p): %s\n", cnt++, (void*)*itr, to_string(**itr).c_str());
+		for (int n_cnt = 0; n_cnt < 3; n_cnt++)
+		{
+			printf("\tNeighbor %d = (%p)\n", n_cnt, (void*)(*itr)->neighbors[n_cnt]);
+		}
+	}
+	printf("\n");
+}
+
+/**
+ * \return The string representation of a Normal.
+ */
+template <typename Real>
+std::string ModelConvImpl<Real>::to_string(const Normal& normal)
+{
+	return "i = " + std::to_string(normal.i) + 
+		" j = " + std::to_string(normal.j) + 
+		" k = " + std::to_string(normal.k);	
+}
+
+/**
+ * \return The string representation of a Vertex.
+ */
+template <typename Real>
+std::string ModelConvImpl<Real>::to_string(const Vertex& vertex)
+{
+	return "x = " + std::to_string(vertex.x) + 
+		" y = " + std::to_string(vertex.y) + 
+		" z = " + std::to_string(vertex.z);	
+}
+
+/**
+ * \return The string representation of a Triangle.
+ */
+template <typename Real>
+std::string ModelConvImpl<Real>::to_string(const Triangle& triangle)
+{
+	return "Normal: (" + to_string(triangle.normal) + ") " + 
+		"Vertex 1: (" + to_string(*triangle.vertices[0]) + ") " + 
+		"Vertex 2: (" + to_string(*triangle.vertices[1]) + ") " + 
+		"Vertex 3: (" + to_string(*triangle.vertices[2]) + ") ";
+}
+
+/**
+ * Compute hash of vertex data for use in weld table. Coordinates are hashed 
+ *  at single precision, so vertices that are equal still hash the same in 
+ *  the double precision model.
+ *
+ * \param[in] vertex Vertex to hash.
+ *
+ * \return Hash of vertex coordinates.
+ */
+template <typename Real>
+uint32_t ModelConvImpl<Real>::hashVertex(const Vertex& vertex)
+{
+	return ::hashVertex((float)vertex.x, (float)vertex.y, (float)vertex.z);
+}
+
+/**
+ * Add the given vertex data to vertices and return its index. If the vertex 
+ *  data already exists in vertices, just return the index of that entry.
+ *
+ * \param[in] vertex Vertex data to be copied into element in vertices.
+ * \param hash Hash of vertex, as given by hashVertex().
+ * \param[inout] weldTable Open addressing hash table of vertices indices. 
+ *	0 indicates an empty slot, otherwise the entry is index + 1. Size must
+ *	be a power of two.
+ *
+ * \return Index of vertex data in vertices.
+ */
+template <typename Real>
+uint32_t ModelConvImpl<Real>::addVertex(const Vertex& vertex, uint32_t hash,
+	std::vector<uint32_t>& weldTable)
+{
+	// Keep load factor at or below one half so probe sequences stay short
+	if (2 * (vertices.size() + 1) > weldTable.size())
+		growWeldTable(weldTable);
+
+	size_t mask = weldTable.size() - 1;
+	size_t slot = hash & mask;
+
+	// Linear probe until we find vertex or an empty slot
+	while (weldTable[slot])
+	{
+		stats.increment(Stats::HASH_PROBES);
+
+		if (vertex == vertices[weldTable[slot] - 1])
+			return weldTable[slot] - 1;
+
+		slot = (slot + 1) & mask;
+	}
+	stats.increment(Stats::HASH_PROBES);
+
+	// If we made it out of the loop without exiting the function we did
+	//  did not find the vertex in the vector already and need to add it
+	vertices.push_back(vertex);
+	weldTable[slot] = (uint32_t)vertices.size();
+
+	return (uint32_t)vertices.size() - 1;
+}
+
+/**
+ * Double the size of the weld table and reinsert all vertices.
+ *
+ * \param[inout] weldTable Table to be grown. See addVertex().
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::growWeldTable(std::vector<uint32_t>& weldTable)
+{
+	size_t mask = weldTable.size() * 2 - 1;
+
+	weldTable.assign(weldTable.size() * 2, 0);
+
+	for (uint32_t cnt = 0; cnt < vertices.size(); cnt++)
+	{
+		size_t slot = hashVertex(vertices[cnt]) & mask;
+
+		while (weldTable[slot])
+			slot = (slot + 1) & mask;
+
+		weldTable[slot] = cnt + 1;
+	}
+}
+
+/**
+ * Hash a quantized vertex key for weldQuantized().
+ *
+ * \param key Key, or its lower 64 bits for 96 bit keys.
+ * \param highKey Upper 32 bits of 96 bit keys, otherwise 0.
+ *
+ * \return Hash. Mask to table size.
+ */
+static inline size_t hashQuantized(uint64_t key, uint32_t highKey)
+{
+	return (size_t)(((key ^ (uint64_t)highKey * 0xC2B2AE3D27D4EB4Full) * 
+		0x9E3779B97F4A7C15ull) >> 32);
+}
+
+/**
+ * Weld vertices by snapping them to a grid with spacing options.quantizeStep,
+ *  anchored at the minimum corner of bounds, so vertices that differ by
+ *  less than the noise in a file are still joined. Each grid point is
+ *  identified by a 64 bit key holding QUANTIZE_BITS bits per axis, or when
+ *  an axis spans more steps than that, by a 96 bit key holding 32 bits per
+ *  axis, so vertices are matched by exact integer comparison. Welded 
+ *  vertices are placed on their grid points and stored in Real like any
+ *  others; keys only live while welding. Vertices with any NaN coordinate
+ *  all share a key that no grid point uses and become one vertex with NaN
+ *  coordinates. Their triangles are flagged as degenerate and removed later.
+ *
+ * \param[in] triArrays Triangle data.
+ * \param numTriangles Number of triangles.
+ * \param[out] vertexIds Index into vertices for each vertex of each triangle.
+ *	Must hold 3 * numTriangles elements.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::weldQuantized(const TriangleArrays& triArrays,
+	uint32_t numTriangles, std::vector<uint32_t>& vertexIds)
+{
+	double step = options.quantizeStep;
+	double inv_step = 1.0 / step;
+	bool wide = false;
+	// Open addressing hash table of vertex indices, index + 1 with 0 
+	//  indicating an empty slot
+	std::vector<uint32_t> table(16, 0);
+	// Key of each vertex in vertices, with the upper 32 bits of wide keys
+	//  kept separately
+	std::vector<uint64_t> keys;
+	std::vector<uint32_t> high_keys;
+	uint64_t probes = 0;
+
+	if (!numTriangles)
+		return;
+
+	// Real cells stay below the axis mask, which is kept for NaN
+	for (int axis = 0; axis < 3; axis++)
+	{
+		double steps = (bounds[1][axis] - bounds[0][axis]) / step + 1;
+
+		if (steps >= (double)((1u << QUANTIZE_BITS) - 1))
+			wide = true;
+		if (steps < (double)UINT32_MAX)
+			continue;
+
+		fprintf(stderr, "Quantization step %g is too fine for model "
+			"extent of %g; at most %lu steps per axis are supported.\n",
+			step, (double)(bounds[1][axis] - bounds[0][axis]), 
+			(unsigned long)UINT32_MAX - 1);
+		throw ModelConv::Error();
+	}
+
+	const uint32_t axis_mask = wide ? UINT32_MAX : 
+		(1u << QUANTIZE_BITS) - 1;
+
+	// Closed models have about one vertex per two triangles, so this keeps
+	//  the load factor at or below one half without growing
+	keys.reserve(numTriangles / 2 + 1);
+	if (wide)
+		high_keys.reserve(numTriangles / 2 + 1);
+	while (table.size() < numTriangles)
+		table.resize(table.size() * 2);
+
+	for (uint32_t cnt = 0; cnt < numTriangles; cnt++)
+	{
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			const float coords[3] = {triArrays.x[vtx][cnt], 
+				triArrays.y[vtx][cnt], triArrays.z[vtx][cnt]};
+			uint32_t cells[3];
+			bool nan = false;
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				// Coordinates are never below the minimum, so 
+				//  truncating after adding a half rounds to nearest
+				//  and only NaN fails the comparison
+				double scaled = ((double)coords[axis] - 
+					bounds[0][axis]) * inv_step + 0.5;
+
+				if (!(scaled >= 0))
+					nan = true;
+				else
+					cells[axis] = (uint32_t)scaled;
+			}
+
+			if (nan)
+				cells[0] = cells[1] = cells[2] = axis_mask;
+
+			uint64_t key;
+			uint32_t high_key = 0;
+
+			if (wide)
+			{
+				key = (uint64_t)cells[0] << 32 | cells[1];
+				high_key = cells[2];
+			}
+			else
+			{
+				key = (uint64_t)cells[0] << 2 * QUANTIZE_BITS | 
+					(uint64_t)cells[1] << QUANTIZE_BITS | cells[2];
+			}
+
+			// Keep load factor at or below one half
+			if (2 * (keys.size() + 1) > table.size())
+			{
+				size_t grow_mask = table.size() * 2 - 1;
+
+				table.assign(table.size() * 2, 0);
+				for (uint32_t id = 0; id < keys.size(); id++)
+				{
+					size_t slot = hashQuantized(keys[id], 
+						wide ? high_keys[id] : 0) & grow_mask;
+
+					while (table[slot])
+						slot = (slot + 1) & grow_mask;
+
+					table[slot] = id + 1;
+				}
+			}
+
+			size_t mask = table.size() - 1;
+			size_t slot = hashQuantized(key, high_key) & mask;
+
+			// Linear probe until we find key or an empty slot
+			while (table[slot] && (keys[table[slot] - 1] != key || 
+				(wide && high_keys[table[slot] - 1] != high_key)))
+			{
+				probes++;
+				slot = (slot + 1) & mask;
+			}
+			probes++;
+
+			if (!table[slot])
+			{
+				Vertex vertex;
+
+				if (nan)
+					vertex.x = vertex.y = vertex.z = (Real)NAN;
+				else
+				{
+					vertex.x = (Real)(bounds[0][0] + step * 
+						(double)cells[0]);
+					vertex.y = (Real)(bounds[0][1] + step * 
+						(double)cells[1]);
+					vertex.z = (Real)(bounds[0][2] + step * 
+						(double)cells[2]);
+				}
+
+				keys.push_back(key);
+				if (wide)
+					high_keys.push_back(high_key);
+				vertices.push_back(vertex);
+				table[slot] = (uint32_t)keys.size();
+			}
+
+			vertexIds[3*cnt + vtx] = table[slot] - 1;
+		}
+	}
+
+	stats.increment(Stats::HASH_PROBES, probes);
+}
+
+/**
+ * Remove degenerate triangles and triangles made up of the same three 
+ *  vertices as an earlier triangle, so that adjacency does not have to deal
+ *  with them. Order of remaining triangles is preserved.
+ *
+ * \param[inout] vertexIds Index into vertices for each vertex of each 
+ *	triangle. Compacted along with triangles.
+ * \param[in] degenerate Non-zero for each triangle that has (close to) zero
+ *	area.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::removeBadTriangles(std::vector<uint32_t>& vertexIds,
+	const std::vector<uint8_t>& degenerate)
+{
+	// Open addressing hash table of sorted vertex index triples. Entries
+	//  are index + 1 of kept triangle, 0 indicates an empty slot.
+	std::vector<uint32_t> table(16, 0);
+	size_t kept = 0;
+
+	while (table.size() < 2 * triangles.size())
+		table.resize(table.size() * 2);
+
+	size_t mask = table.size() - 1;
+
+	for (size_t cnt = 0; cnt < triangles.size(); cnt++)
+	{
+		uint32_t ids[3] = {vertexIds[3*cnt], vertexIds[3*cnt + 1], 
+			vertexIds[3*cnt + 2]};
+		bool duplicate = false;
+
+		std::sort(ids, ids + 3);
+
+		if (ids[0] == ids[1] || ids[1] == ids[2] || degenerate[cnt])
+		{
+			stats.increment(Stats::DEGENERATES_REMOVED);
+			delete triangles[cnt];
+			continue;
+		}
+
+		size_t slot = (ids[0] * 0x9E3779B1u ^ ids[1] * 0x85EBCA77u ^ 
+			ids[2] * 0xC2B2AE3Du) & mask;
+
+		while (table[slot])
+		{
+			uint32_t* other = &vertexIds[3 * (table[slot] - 1)];
+			uint32_t other_ids[3] = {other[0], other[1], other[2]};
+
+			std::sort(other_ids, other_ids + 3);
+
+			if (std::equal(ids, ids + 3, other_ids))
+			{
+				duplicate = true;
+				break;
+			}
+
+			slot = (slot + 1) & mask;
+		}
+
+		if (duplicate)
+		{
+			stats.increment(Stats::DUPLICATES_REMOVED);
+			delete triangles[cnt];
+			continue;
+		}
+
+		// Keep triangle, moving it down to fill any removed entries
+		triangles[kept] = triangles[cnt];
+		for (int vtx = 0; vtx < 3; vtx++)
+			vertexIds[3*kept + vtx] = vertexIds[3*cnt + vtx];
+		kept++;
+		table[slot] = (uint32_t)kept;
+	}
+
+	triangles.resize(kept);
+	vertexIds.resize(3 * kept);
+}
+
+/**
+ * Simplify the mesh by collapsing edges whose removal changes the surface
+ *  least, so that noisy near-planar areas end up as a few large triangles.
+ *  Limits are taken from options.
+ *
+ * \param[inout] vertexIds Index into vertices for each vertex of each 
+ *	triangle. Compacted along with triangles.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::decimate(std::vector<uint32_t>& vertexIds)
+{
+	Decimator<Real> decimator;
+	std::vector<Real> positions(3 * vertices.size());
+
+	for (size_t cnt = 0; cnt < vertices.size(); cnt++)
+	{
+		positions[3*cnt] = vertices[cnt].x;
+		positions[3*cnt + 1] = vertices[cnt].y;
+		positions[3*cnt + 2] = vertices[cnt].z;
+	}
+
+	decimator.decimate(positions, vertexIds, options.decimateError,
+		options.decimateTriangles, options.keepBoundaries);
+
+	// Vertices are moved in place so existing pointers stay valid. Merged
+	//  away vertices are left unused.
+	const std::vector<uint8_t>& moved = decimator.getMovedVertices();
+	for (size_t cnt = 0; cnt < vertices.size(); cnt++)
+	{
+		if (!moved[cnt])
+			continue;
+
+		vertices[cnt].x = positions[3*cnt];
+		vertices[cnt].y = positions[3*cnt + 1];
+		vertices[cnt].z = positions[3*cnt + 2];
+	}
+
+	const std::vector<uint32_t>& map = decimator.getTriangleMap();
+	std::vector<Triangle*> kept(map.size());
+	std::vector<uint8_t> keep(triangles.size(), 0);
+
+	for (size_t cnt = 0; cnt < map.size(); cnt++)
+	{
+		Triangle* triangle = triangles[map[cnt]];
+		bool changed = false;
+
+		keep[map[cnt]] = 1;
+		kept[cnt] = triangle;
+
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			uint32_t id = vertexIds[3*cnt + vtx];
+
+			triangle->vertices[vtx] = &vertices[id];
+			if (moved[id])
+				changed = true;
+		}
+
+		if (!changed)
+			continue;
+
+		// Shape changed so stored normal no longer applies
+		const Vertex* v = triangle->vertices[0];
+		Real e1[3] = {triangle->vertices[1]->x - v->x, 
+			triangle->vertices[1]->y - v->y, 
+			triangle->vertices[1]->z - v->z};
+		Real e2[3] = {triangle->vertices[2]->x - v->x, 
+			triangle->vertices[2]->y - v->y, 
+			triangle->vertices[2]->z - v->z};
+		Normal normal;
+
+		normal.i = e1[1] * e2[2] - e1[2] * e2[1];
+		normal.j = e1[2] * e2[0] - e1[0] * e2[2];
+		normal.k = e1[0] * e2[1] - e1[1] * e2[0];
+
+		Real len = sqrt(normal.i * normal.i + normal.j * normal.j + 
+			normal.k * normal.k);
+		if (len > 0)
+		{
+			triangle->normal.i = normal.i / len;
+			triangle->normal.j = normal.j / len;
+			triangle->normal.k = normal.k / len;
+		}
+	}
+
+	for (size_t cnt = 0; cnt < triangles.size(); cnt++)
+		if (!keep[cnt])
+			delete triangles[cnt];
+
+	stats.set(Stats::DECIMATED_TRIANGLES, triangles.size() - kept.size());
+
+	triangles.swap(kept);
+}
+
+/**
+ * Put vertices and triangles in Morton (Z-order) order of their positions and
+ *  centroids, so that triangles near each other in space are near each other
+ *  in memory too. Files from many exporters are in effectively random order,
+ *  which makes the neighbor lookups of adjacency and face building miss cache
+ *  on almost every access. Triangles are reallocated in their new order.
+ *
+ * \param[inout] vertexIds Index into vertices for each vertex of each 
+ *	triangle. Reordered and remapped along with triangles.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::reorder(std::vector<uint32_t>& vertexIds)
+{
+	size_t num_vertices = vertices.size();
+	size_t num_triangles = triangles.size();
+	size_t max_count = std::max(num_vertices, num_triangles);
+	float extent = 0;
+	float scale = 0;
+	// x, y and z of points being ordered, each max_count long
+	std::vector<float> coords(3 * max_count);
+	std::vector<uint64_t> codes;
+	std::vector<uint32_t> order;
+
+	for (int axis = 0; axis < 3; axis++)
+		extent = std::max(extent, bounds[1][axis] - bounds[0][axis]);
+
+	// Same scale on every axis keeps cells cubic
+	if (extent > 0 && extent < INFINITY)
+		scale = (float)((1u << MORTON_BITS) - 1) / extent;
+
+	// Vertices
+	for (size_t cnt = 0; cnt < num_vertices; cnt++)
+	{
+		coords[cnt] = (float)vertices[cnt].x;
+		coords[max_count + cnt] = (float)vertices[cnt].y;
+		coords[2 * max_count + cnt] = (float)vertices[cnt].z;
+	}
+
+	codes.resize(num_vertices);
+	computeMortonCodes(&coords[0], &coords[max_count], 
+		&coords[2 * max_count], num_vertices, bounds[0], scale, 
+		codes.data());
+
+	order.resize(num_vertices);
+	for (size_t cnt = 0; cnt < num_vertices; cnt++)
+		order[cnt] = (uint32_t)cnt;
+
+	sortByKey(codes, order, options.threads);
+
+	std::vector<Vertex> sorted_vertices(num_vertices);
+	std::vector<uint32_t> remap(num_vertices);
+
+	for (size_t cnt = 0; cnt < num_vertices; cnt++)
+	{
+		sorted_vertices[cnt] = vertices[order[cnt]];
+		remap[order[cnt]] = (uint32_t)cnt;
+	}
+
+	vertices.swap(sorted_vertices);
+	std::vector<Vertex>().swap(sorted_vertices);
+
+	for (size_t cnt = 0; cnt < vertexIds.size(); cnt++)
+		vertexIds[cnt] = remap[vertexIds[cnt]];
+
+	// Triangles, by centroid
+	for (size_t tri = 0; tri < num_triangles; tri++)
+	{
+		const uint32_t* ids = &vertexIds[3*tri];
+
+		coords[tri] = (float)((vertices[ids[0]].x + vertices[ids[1]].x + 
+			vertices[ids[2]].x) / 3);
+		coords[max_count + tri] = (float)((vertices[ids[0]].y + 
+			vertices[ids[1]].y + vertices[ids[2]].y) / 3);
+		coords[2 * max_count + tri] = (float)((vertices[ids[0]].z + 
+			vertices[ids[1]].z + vertices[ids[2]].z) / 3);
+	}
+
+	codes.resize(num_triangles);
+	computeMortonCodes(&coords[0], &coords[max_count], 
+		&coords[2 * max_count], num_triangles, bounds[0], scale, 
+		codes.data());
+
+	order.resize(num_triangles);
+	for (size_t cnt = 0; cnt < num_triangles; cnt++)
+		order[cnt] = (uint32_t)cnt;
+
+	sortByKey(codes, order, options.threads);
+
+	// New copies are all allocated before old ones are freed, so they are
+	//  laid out in the new order rather than reusing scattered old blocks
+	std::vector<Triangle*> sorted_triangles(num_triangles);
+	std::vector<uint32_t> sorted_ids(vertexIds.size());
+
+	for (size_t tri = 0; tri < num_triangles; tri++)
 	{
-		elem_read = fread(&bin_stl_triangle, 1, 
-			sizeof(bin_stl_triangle), file);
-		if (sizeof(bin_stl_triangle) != elem_read)
+		Triangle* triangle = new Triangle(*triangles[order[tri]]);
+
+		for (int vtx = 0; vtx < 3; vtx++)
 		{
-			fprintf(stderr, "Only read %lu of %lu bytes for "
-				"triangle %u of %u from \"%s\" file.\n", 
-				elem_read, sizeof(bin_stl_triangle), newest_idx, 
-				num_triangles, filename);
-			fclose(file);
-			//TODO: add proper exception throw
-			exit(EXIT_FAILURE);
+			sorted_ids[3*tri + vtx] = vertexIds[3*order[tri] + vtx];
+			triangle->vertices[vtx] = &vertices[sorted_ids[3*tri + vtx]];
 		}
 
-		triangles[newest_idx] = new Triangle();
+		sorted_triangles[tri] = triangle;
+	}
+
+	for (size_t tri = 0; tri < num_triangles; tri++)
+		delete triangles[tri];
+
+	triangles.swap(sorted_triangles);
+	vertexIds.swap(sorted_ids);
+}
+
+/**
+ * Build edge table and link each triangle to its neighbors. The edge table
+ *  is stored in compressed sparse row form: the triangles on edge n are
+ *  edgeTriangles[edgeOffsets[n]] to edgeTriangles[edgeOffsets[n+1] - 1].
+ *  This supports any number of triangles meeting on an edge, while costing
+ *  memory proportional to the number of edges.
+ *
+ * \param[in] vertexIds Index into vertices for each vertex of each triangle.
+ *
+ * \return None.
+ */
+template <typename Real>
+void ModelConvImpl<Real>::buildAdjacency(const std::vector<uint32_t>& vertexIds)
+{
+	// Open addressing hash table of edge keys. Entries are edge index + 1,
+	//  0 indicates an empty slot.
+	std::vector<uint32_t> table(16, 0);
+	size_t num_triangles = triangles.size();
 
-		// Copy normal vector data
-		triangles[newest_idx]->normal = bin_stl_triangle.normal;
+	// Closed manifold meshes have 1.5 edges per triangle
+	while (table.size() < 3 * num_triangles)
+		table.resize(table.size() * 2);
 
-		// Potentially add vertex data to array and get pointer
-		//  to vertx data in vertices
-		triangles[newest_idx]->vertices[0] = 
-			&addVertex(bin_stl_triangle.vertices[0]);
-		triangles[newest_idx]->vertices[1] = 
-			&addVertex(bin_stl_triangle.vertices[1]);
-		triangles[newest_idx]->vertices[2] = 
-			&addVertex(bin_stl_triangle.vertices[2]);
+	size_t mask = table.size() - 1;
 
-		// Start off assuming new triangle has no neighbors
-		triangles[newest_idx]->neighbors[0] = NULL;
-		triangles[newest_idx]->neighbors[1] = NULL;
-		triangles[newest_idx]->neighbors[2] = NULL;
+	edgeKeys.clear();
+	edgeKeys.reserve(num_triangles * 3 / 2 + 1);
 
-		// Search for neighbors for newest triangle
-		for (uint32_t older_idx = 0; older_idx < newest_idx; 
-			older_idx++)
+	// Assign an index to each unique edge, in order of first use
+	for (size_t tri = 0; tri < num_triangles; tri++)
+	{
+		for (int cnt = 0; cnt < 3; cnt++)
 		{
-			checkAdjacent(*triangles[newest_idx], 
-				*triangles[older_idx]);
+			uint64_t vtx1 = vertexIds[3*tri + cnt];
+			uint64_t vtx2 = vertexIds[3*tri + (cnt + 1) % 3];
+			uint64_t key = vtx1 < vtx2 ? (vtx1 << 32 | vtx2) : 
+				(vtx2 << 32 | vtx1);
+			size_t slot = (size_t)((key * 0x9E3779B97F4A7C15ull) >> 
+				32) & mask;
+
+			while (table[slot] && edgeKeys[table[slot] - 1] != key)
+				slot = (slot + 1) & mask;
+
+			if (!table[slot])
+			{
+				edgeKeys.push_back(key);
+				table[slot] = (uint32_t)edgeKeys.size();
+			}
+
+			triangles[tri]->edges[cnt] = table[slot] - 1;
 		}
 	}
 
-	if (fclose(file))
-	{
-		fprintf(stderr, "Failed to close file \"%s\" after reading "
-			"data.\n", filename);
-		//TODO: add proper exception throwing
-		exit(EXIT_FAILURE);
-	}
+	std::vector<uint32_t>().swap(table);
 
+	// Count triangles on each edge and turn counts into offsets
+	edgeOffsets.assign(edgeKeys.size() + 1, 0);
+	for (size_t tri = 0; tri < num_triangles; tri++)
+		for (int cnt = 0; cnt < 3; cnt++)
+			edgeOffsets[triangles[tri]->edges[cnt] + 1]++;
 
-int cnt = 0;
-	// Create faces now that we have graph representing all triangles
-	for (std::vector<Triangle*>::iterator itr = triangles.begin();
-		itr != triangles.end(); itr++) 
-	{
-		Triangle* triangle = *itr;
-		Face* face = NULL;
+	for (size_t edge = 0; edge < edgeKeys.size(); edge++)
+		edgeOffsets[edge + 1] += edgeOffsets[edge];
 
-		// Skip constructing a face starting at this triangle, if it is
-		//  already in a face
-		if (tri_face_map[triangle])
-			continue;
+	// Fill in triangles on each edge. Going in triangle order keeps each
+	//  edge's list sorted, which makes neighbor selection deterministic.
+	std::vector<uint32_t> fill(edgeOffsets.begin(), edgeOffsets.end() - 1);
+	edgeTriangles.resize(3 * num_triangles);
+	for (size_t tri = 0; tri < num_triangles; tri++)
+		for (int cnt = 0; cnt < 3; cnt++)
+			edgeTriangles[fill[triangles[tri]->edges[cnt]]++] = 
+				(uint32_t)tri;
 
-		// Clear our traversal map for this face
-		tri_trav_map.clear();
+	stats.set(Stats::EDGES, edgeKeys.size());
 
-		face = new Face();
-		face->normal = triangle->normal;
-		face->triangles.clear();
-		face->border.clear();
+	for (size_t tri = 0; tri < num_triangles; tri++)
+	{
+		for (int cnt = 0; cnt < 3; cnt++)
+		{
+			uint32_t edge = triangles[tri]->edges[cnt];
+			uint32_t first = edgeOffsets[edge];
+			uint32_t last = edgeOffsets[edge + 1];
 
-printf("face %d\n\n", cnt++);
+			triangles[tri]->neighbors[cnt] = NULL;
 
-		// BFS finding edges where triangles are not on same plane
-		buildFace(*triangle, *face, tri_face_map, tri_trav_map);
+			// Fast path for manifold edges
+			if (last - first == 2)
+			{
+				uint32_t other = edgeTriangles[first] == tri ?
+					edgeTriangles[first + 1] : 
+					edgeTriangles[first];
 
-		faces.push_back(face);
-	}
+				triangles[tri]->neighbors[cnt] = triangles[other];
+				stats.increment(Stats::NEIGHBOR_LINKS);
+				continue;
+			}
 
-//TODO: debug
-	
-	int cntr = 0;
-	for (std::vector<Face*>::iterator itr = faces.begin();
-		itr != faces.end(); itr++)
-	{
-		std::string filename = "test";
-		filename.append(std::to_string(cntr++));
-		filename.append(".stl");
+			if (last - first < 2)
+				continue;
+
+			// Only count each non-manifold edge once
+			if (edgeTriangles[first] == tri)
+				stats.increment(Stats::NON_MANIFOLD_EDGES);
 
-		exportBinStl(filename.c_str(), (*itr)->triangles);
+			triangles[tri]->neighbors[cnt] = selectNeighbor(tri, 
+				first, last);
+			stats.increment(Stats::NEIGHBOR_LINKS);
+		}
 	}
 }
 
 /**
- * Destructor.
+ * Find the angle between the normals of two neighboring triangles. atan2 of
+ *  the cross and dot products stays accurate for tiny angles, unlike acos.
+ *
+ * \param[in] lhs Normal of one triangle.
+ * \param[in] rhs Normal of the other.
+ *
+ * \return Angle in degrees, from 0 to 180.
  */
-ModelConv::~ModelConv()
+template <typename Real>
+float ModelConvImpl<Real>::getLinkAngle(const Normal& lhs, const Normal& rhs)
 {
-	for (std::vector<Vertex*>::iterator itr = vertices.begin();
-		itr != vertices.end(); itr++)
-		delete(*itr);
+	double cross[3] = {
+		(double)lhs.j * rhs.k - (double)lhs.k * rhs.j,
+		(double)lhs.k * rhs.i - (double)lhs.i * rhs.k,
+		(double)lhs.i * rhs.j - (double)lhs.j * rhs.i};
+	double dot = (double)lhs.i * rhs.i + (double)lhs.j * rhs.j + 
+		(double)lhs.k * rhs.k;
 
-	for (std::vector<Triangle*>::iterator itr = triangles.begin();
-		itr != triangles.end(); itr++)
-		delete(*itr);
-	
-	for (std::vector<Face*>::iterator itr = faces.begin();
-		itr != faces.end(); itr++)
-		delete(*itr);
+	return (float)(atan2(sqrt(cross[0] * cross[0] + cross[1] * cross[1] + 
+		cross[2] * cross[2]), dot) * 180 / M_PI);
 }
 
 /**
- * Export entire model data to single STL file format with binary data.
+ * Choose which of the triangles sharing a non-manifold edge is treated as
+ *  the neighbor of a triangle. The triangle whose normal is closest to the
+ *  triangle's own is chosen, the first in triangle order on ties, so that
+ *  faces continue across the edge whenever any triangle on it is within the
+ *  coplanar tolerance, and the edge becomes a border of the face otherwise.
+ *  The choice does not depend on the tolerance, so it stays right for any
+ *  tolerance resegment() moves to.
  *
- * \param[in] filename Filename to write STL data to.
+ * \param tri Index of triangle a neighbor is being chosen for.
+ * \param first Index in edgeTriangles of first triangle on the edge.
+ * \param last One past index in edgeTriangles of last triangle on the edge.
  *
- * \return None.
+ * \return The chosen neighbor.
  */
-void ModelConv::exportBinStl(const char* filename)
+template <typename Real>
+typename ModelConvImpl<Real>::Triangle* ModelConvImpl<Real>::selectNeighbor(
+	size_t tri, uint32_t first, uint32_t last)
 {
-//TODO: want to make generic export, but we have vector of Triangle* in one case, and Triangle in other...
-//	Could build from triangles... Do we really care about time that takes?
-	//exportBinStl(filename, this->triangles);	
-	fprintf(stderr, "%s: Not implemented yet.\n", __func__);
-	//TODO: add proper exception throwing
-	exit(EXIT_FAILURE);
+	Triangle* best = NULL;
+	float best_angle = INFINITY;
+
+	for (uint32_t cnt = first; cnt < last; cnt++)
+	{
+		Triangle* other = triangles[edgeTriangles[cnt]];
+
+		if (edgeTriangles[cnt] == tri)
+			continue;
+
+		float angle = getLinkAngle(triangles[tri]->normal, other->normal);
+
+		if (!best || angle < best_angle)
+		{
+			best = other;
+			best_angle = angle;
+		}
+	}
+
+	return best;
 }
 
 /**
- * Output Scalable Vector Graphs with each face as an outlined object.
+ * Find the root of the set an item is in, halving the path to it on the way.
  *
- * \param[in] filename Filename to write SVG data to.
+ * \param[inout] parent Parent of each item. Roots are their own parent.
+ * \param item Item to find root of.
  *
- * \return 0 on success.
+ * \return Root item.
  */
-void ModelConv::exportSvg(const char* filename)
+static uint32_t findRoot(std::vector<uint32_t>& parent, uint32_t item)
 {
-//TODO: what if there are no faces created, or will they be created as soon as data is imported??
-//TODO: don't forget we need to map to from X,Y,Z to X,Y plane
+	while (parent[item] != item)
+	{
+		parent[item] = parent[parent[item]];
+		item = parent[item];
+	}
 
-	fprintf(stderr, "%s: Not implemented yet.\n", __func__);
-	//TODO: add proper exception throwing
-	exit(EXIT_FAILURE);
+	return item;
 }
 
 /**
- * TODO: want to print useful info. but shoudl this be to_string?
+ * Split triangles into bodies that are not connected to each other through
+ *  neighbors. Also numbers triangles and marks them as not yet in a face.
+ *
+ * \return None.
  */
-void ModelConv::debugPrint()
+template <typename Real>
+void ModelConvImpl<Real>::findBodies()
 {
-	printf("%lu unique vertices found amongst %lu triangles.\n\n", 
-		vertices.size(), triangles.size());
+	TRACE_ZONE("find_bodies");
+	uint32_t num_triangles = (uint32_t)triangles.size();
+	// Union-find parent of each triangle. The root of each set is its lowest
+	//  index triangle.
+	std::vector<uint32_t> parent(num_triangles);
+	// Index into bodies of body rooted at each triangle
+	std::vector<uint32_t> body_ids(num_triangles);
 
-	uint32_t cnt = 0;
-	for (std::vector<Triangle*>::iterator itr = triangles.begin();
-		itr != triangles.end(); itr++) 
+	for (uint32_t tri = 0; tri < num_triangles; tri++)
 	{
-		printf("Triangle %u (%p): %s\n", cnt++, (void*)*itr, to_string(**itr).c_str());
-		for (int n_cnt = 0; n_cnt < 3; n_cnt++)
+		triangles[tri]->index = tri;
+		triangles[tri]->face = NO_FACE;
+		parent[tri] = tri;
+	}
+
+	// Neighbors are not symmetric on non-manifold edges, so every link is
+	//  joined rather than searching outward from each triangle
+	for (uint32_t tri = 0; tri < num_triangles; tri++)
+	{
+		for (int cnt = 0; cnt < 3; cnt++)
 		{
-			printf("\tNeighbor %d = (%p)\n", n_cnt, (void*)(*itr)->neighbors[n_cnt]);
+			const Triangle* neighbor = triangles[tri]->neighbors[cnt];
+
+			if (!neighbor)
+				continue;
+
+			uint32_t root = findRoot(parent, tri);
+			uint32_t other = findRoot(parent, neighbor->index);
+
+			if (root < other)
+				parent[other] = root;
+			else
+				parent[root] = other;
 		}
 	}
-	printf("\n");
-}
 
-/**
- * \return The string representation of a Normal.
- */
-std::string ModelConv::to_string(const Normal& normal)
-{
-	return "i = " + std::to_string(normal.i) + 
-		" j = " + std::to_string(normal.j) + 
-		" k = " + std::to_string(normal.k);	
-}
+	bodies.clear();
+	for (uint32_t tri = 0; tri < num_triangles; tri++)
+	{
+		uint32_t root = findRoot(parent, tri);
 
-/**
- * \return The string representation of a Vertex.
- */
-std::string ModelConv::to_string(const Vertex& vertex)
-{
-	return "x = " + std::to_string(vertex.x) + 
-		" y = " + std::to_string(vertex.y) + 
-		" z = " + std::to_string(vertex.z);	
+		// Roots come before the rest of their body
+		if (root == tri)
+		{
+			body_ids[tri] = (uint32_t)bodies.size();
+			bodies.push_back(Body());
+		}
+
+		bodies[body_ids[root]].triangles.push_back(tri);
+	}
 }
 
 /**
- * \return The string representation of a Triangle.
+ * Find the angle between the normals across every link between neighbors,
+ *  for buildFace() to compare against the coplanar tolerance. Triangles must
+ *  be numbered by findBodies().
+ *
+ * \return None.
  */
-std::string ModelConv::to_string(const Triangle& triangle)
+template <typename Real>
+void ModelConvImpl<Real>::computeLinkAngles()
 {
-	return "Normal: (" + to_string(triangle.normal) + ") " + 
-		"Vertex 1: (" + to_string(*triangle.vertices[0]) + ") " + 
-		"Vertex 2: (" + to_string(*triangle.vertices[1]) + ") " + 
-		"Vertex 3: (" + to_string(*triangle.vertices[2]) + ") ";
+	TRACE_ZONE("link_angles");
+	size_t num_triangles = triangles.size();
+	unsigned num_threads = (unsigned)std::max((size_t)1, std::min(
+		num_triangles / LINK_ANGLE_THREAD_MIN, 
+		(size_t)getThreadCount(options.threads)));
+	size_t chunk = (num_triangles + num_threads - 1) / num_threads;
+
+	linkAngles.assign(3 * num_triangles, 0);
+
+	runThreads(num_threads, [&](unsigned thread)
+	{
+		size_t end = std::min(num_triangles, (thread + 1) * chunk);
+
+		for (size_t tri = thread * chunk; tri < end; tri++)
+		{
+			const Normal& normal = triangles[tri]->normal;
+
+			for (int cnt = 0; cnt < 3; cnt++)
+			{
+				const Triangle* neighbor = 
+					triangles[tri]->neighbors[cnt];
+
+				if (!neighbor)
+					continue;
+
+				linkAngles[3 * tri + cnt] = getLinkAngle(normal, 
+					neighbor->normal);
+			}
+		}
+	});
 }
 
 /**
- * Add the given vertex data to vertices and return a pointer to that vertex.
- *  If the vertex data already exists in vertices, just return a pointer.
+ * Call a function once for each body, spread across one thread per core.
+ *  Bodies are handed out largest first so that a large body picked up last
+ *  does not leave the other threads idle.
  *
- * \param[in] vertex Vertex data to be copied into element in 
+ * \param func Called with index into bodies of each body. Must only modify
+ *	that body and its triangles and faces.
  *
- * \return Reference to vertex data in vertices.
+ * \return None.
  */
-ModelConv::Vertex& ModelConv::addVertex(const Vertex& vertex)
+template <typename Real>
+template <typename Func>
+void ModelConvImpl<Real>::forEachBody(const Func& func)
 {
-	Vertex* new_vertex = NULL;
+	std::vector<uint32_t> order(bodies.size());
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> threads;
+	size_t num_threads = std::min(bodies.size(), 
+		(size_t)getThreadCount(options.threads));
 
-//TODO: it would be more efficient to use a map here, so we don't iterate over everything we have each time we add
-//	need to define hash function for vertex in order to use map
+	for (size_t cnt = 0; cnt < order.size(); cnt++)
+		order[cnt] = (uint32_t)cnt;
 
-	// Search to see if vertex already exists in vector
-	for (std::vector<Vertex*>::iterator itr = vertices.begin();
-		itr != vertices.end(); itr++)
-	{
-		// Compare vertex 
-		if (vertex == **itr)
+	std::stable_sort(order.begin(), order.end(), 
+		[&](uint32_t lhs, uint32_t rhs)
 		{
-			return **itr;
-		}
-	}
+			return bodies[lhs].triangles.size() > 
+				bodies[rhs].triangles.size();
+		});
 
-	new_vertex = new Vertex(vertex);
+	auto worker = [&]()
+	{
+		size_t cnt;
 
-	// If we made it out of the loop without exiting the function we did
-	//  did not find the vertex in the vector already and need to add it
-	vertices.push_back(new_vertex);
+		while ((cnt = next++) < order.size())
+			func(order[cnt]);
+	};
+
+	for (size_t cnt = 1; cnt < num_threads; cnt++)
+		threads.push_back(std::thread(worker));
 
-	// Return pointer to newly added element
-	return *new_vertex;
+	worker();
+
+	for (size_t cnt = 0; cnt < threads.size(); cnt++)
+		threads[cnt].join();
 }
 
 /**
- * Check if the two triangle are adjacent (i.e. shares two vertices, also known
- *  as an edge). If they are, add them to each others neighbors list.
- *
- * \param[inout] tri1 First triangle given for check.
- * \param[inout] tri2 Second triangle given for check.
+ * Build faces and their borders, with bodies processed in parallel. Faces
+ *  are numbered by their first triangle, which gives the same faces in the
+ *  same order as building them one body at a time.
  *
  * \return None.
  */
-void ModelConv::checkAdjacent(Triangle& tri1, Triangle& tri2)
+template <typename Real>
+void ModelConvImpl<Real>::buildFaces()
 {
-	// Bits 0-2 indicates which verticies are shared for each triangle.
-	//  Used for knowing where to position triangle as neighbor.
-	uint8_t tri1_shared = 0;
-	uint8_t tri2_shared = 0;
-	uint8_t matches_found = 0;
+	/**
+	 * Face found in a body, before it is given its final index.
+	 */
+	struct FoundFace
+	{
+		uint32_t seed; //!< Index of first triangle of face.
+		uint32_t body; //!< Index into bodies of body face is in.
+		Face* face;
+	};
+
+	// Faces found in each body, in the order they were found
+	std::vector<std::vector<Face*> > body_faces(bodies.size());
 
-	for (int t1_cnt = 0; t1_cnt < 3; t1_cnt++)
+	seedAngles.assign(triangles.size(), 0);
+
+	forEachBody([&](size_t bodyId)
 	{
-		for (int t2_cnt = 0; t2_cnt < 3; t2_cnt++)
+		TRACE_ZONE_ID("build_body_faces", bodyId);
+		const Body& body = bodies[bodyId];
+		std::vector<std::pair<Triangle*, int> > stack;
+
+		for (size_t cnt = 0; cnt < body.triangles.size(); cnt++)
 		{
-			// We can compare pointers here because vertices 
-			//  point to vertices which only has unique entries
-			//  for each point in space.
-			if (tri1.vertices[t1_cnt] == tri2.vertices[t2_cnt])
-			{
-				tri1_shared |= (uint8_t)(1 << t1_cnt);
-				tri2_shared |= (uint8_t)(1 << t2_cnt);
-				matches_found++;
-				break;
-			}
+			Triangle* triangle = triangles[body.triangles[cnt]];
+
+			// Skip constructing a face starting at this triangle, 
+			//  if it is already in a face
+			if (triangle->face != NO_FACE)
+				continue;
+
+			Face* face = new Face();
+			face->normal = triangle->normal;
+
+			// Face ids are local to body until all bodies are done
+			buildFace(*triangle, *face, 
+				(uint32_t)body_faces[bodyId].size(), stack);
+
+			body_faces[bodyId].push_back(face);
+		}
+	});
+
+	std::vector<FoundFace> found;
+
+	for (uint32_t body = 0; body < bodies.size(); body++)
+	{
+		for (size_t cnt = 0; cnt < body_faces[body].size(); cnt++)
+		{
+			FoundFace entry;
+
+			entry.face = body_faces[body][cnt];
+			entry.seed = entry.face->triangles[0]->index;
+			entry.body = body;
+			found.push_back(entry);
 		}
 	}
 
-	if (matches_found < 2)
-		return;
+	std::sort(found.begin(), found.end(), 
+		[](const FoundFace& lhs, const FoundFace& rhs)
+		{
+			return lhs.seed < rhs.seed;
+		});
 
-	if (matches_found > 2)
+	faces.resize(found.size());
+	for (uint32_t cnt = 0; cnt < found.size(); cnt++)
 	{
-		fprintf(stderr, "%s: Triangles have all the same vertices.\n", 
-			__func__);
-		//TODO: add exception throw
-		exit(EXIT_FAILURE);
+		faces[cnt] = found[cnt].face;
+		bodies[found[cnt].body].faces.push_back(cnt);
 	}
 
-	addNeighbor(tri1, tri2, tri1_shared);
-	addNeighbor(tri2, tri1, tri2_shared);
+	// Borders need face ids of neighbors, which are always in the same 
+	//  body, so wait until all of a body's faces are numbered
+	forEachBody([&](size_t bodyId)
+	{
+		TRACE_ZONE_ID("build_body_borders", bodyId);
+		const Body& body = bodies[bodyId];
+
+		for (size_t cnt = 0; cnt < body.faces.size(); cnt++)
+		{
+			const Face& face = *faces[body.faces[cnt]];
+
+			for (size_t tri = 0; tri < face.triangles.size(); tri++)
+				triangles[face.triangles[tri]->index]->face = 
+					body.faces[cnt];
+		}
+
+		for (size_t cnt = 0; cnt < body.faces.size(); cnt++)
+			buildBorder(*faces[body.faces[cnt]], body.faces[cnt]);
+	});
+
+	for (size_t face = 0; face < faces.size(); face++)
+		for (size_t loop = 0; loop < faces[face]->loops.size(); loop++)
+			stats.increment(Stats::BORDER_POINTS, 
+				faces[face]->loops[loop].points.size());
 }
 
 /**
- * Add in neighboring triangle. Triangles are added to into array based on
- *  which edge/vertices are shared.
+ * Find all triangles connected to a seed triangle through links no steeper
+ *  than the coplanar tolerance, depth first. Triangles also have to be 
+ *  within the tolerance of the seed itself, or a face would creep around 
+ *  curved surfaces a small step at a time. Neighbors of each triangle are
+ *  visited in order, the same order recursing into each in turn would visit
+ *  them. A triangle turned away across one steep link can still join through
+ *  another, so faces only depend on the seed, which triangles earlier faces
+ *  took and which links are within tolerance, and not on the order they are
+ *  searched in, which resegment() relies on. The angle of each triangle 
+ *  taken to the seed is kept in seedAngles.
+ *
+ * \param[inout] seed First triangle of face. Must not be in a face yet.
+ * \param[inout] face Face to add triangles to.
+ * \param faceId Id to mark triangles of face with.
+ * \param[inout] stack Scratch space for the search.
  *
- * \param[inout] tri The triangle who will have a neighbor slot filled in.
- * \param[in] neighbor The triangle who is a neighbor to tri. 
- * \param sharedVtxs Bits 0-2 designate which vertices are shared, and hence in
- *	which neighbor slot neighbor should be placed in tri.
- * 
  * \return None.
  */
-void ModelConv::addNeighbor(Triangle& tri, Triangle& neighbor, 
-	uint8_t sharedVtxs)
+template <typename Real>
+void ModelConvImpl<Real>::buildFace(Triangle& seed, Face& face, uint32_t faceId,
+	std::vector<std::pair<Triangle*, int> >& stack)
 {
-	switch (sharedVtxs)
+	// Face ids are not final yet, so zone is tagged with the seed, which
+	//  is what faces end up numbered by
+	TRACE_ZONE_SAMPLED("build_face", seed.index, faceId, 
+		TRACE_FACE_SAMPLE);
+
+	seed.face = faceId;
+	face.triangles.push_back(&seed);
+	seedAngles[seed.index] = 0;
+
+	stack.clear();
+	stack.push_back(std::make_pair(&seed, 0));
+
+	while (!stack.empty())
 	{
-		case 0x3:
-			if (tri.neighbors[0])
-			{
-				fprintf(stderr, "%s: Neighbor 0 not NULL\n", 
-					__func__);
-				//TODO: add proper exception throwing
-				exit(EXIT_FAILURE);
-			}
-			tri.neighbors[0] = &neighbor;
-			break;
-		case 0x5:
-			if (tri.neighbors[1])
-			{
-				fprintf(stderr, "%s: Neighbor 1 not NULL\n", 
-					__func__);
-				//TODO: add proper exception throwing
-				exit(EXIT_FAILURE);
-			}
-			tri.neighbors[1] = &neighbor;
-			break;
-		case 0x6:
-			if (tri.neighbors[2])
-			{
-				fprintf(stderr, "%s: Neighbor 2 not NULL\n", 
-					__func__);
-				fprintf(stderr, "Neighbor not NULL\n");
-				//TODO: add proper exception throwing
-				exit(EXIT_FAILURE);
-			}
-			tri.neighbors[2] = &neighbor;
-			break;
-		default:
-			fprintf(stderr, "%s: Invalid bit combination 0x%x\n", 
-				__func__, sharedVtxs);
-			//TODO: add proper exception throwing
-			exit(EXIT_FAILURE);
-			break;
+		Triangle* tri = stack.back().first;
+		int cnt = stack.back().second++;
+
+		if (cnt == 3)
+		{
+			stack.pop_back();
+			continue;
+		}
+
+		Triangle* neighbor = tri->neighbors[cnt];
+
+		// Skip neighbors already in this face, or that an earlier face
+		//  already took
+		if (!neighbor || neighbor->face != NO_FACE)
+			continue;
+
+		if (!(linkAngles[3 * tri->index + cnt] <= options.coplanarAngle))
+			continue;
+
+		float seed_angle = getLinkAngle(neighbor->normal, seed.normal);
+
+		if (seed_angle <= options.coplanarAngle)
+		{
+			neighbor->face = faceId;
+			seedAngles[neighbor->index] = seed_angle;
+			face.triangles.push_back(neighbor);
+			stack.push_back(std::make_pair(neighbor, 0));
+		}
 	}
 }
 
 /**
- * Find all connected triangle on the same plane. 
+ * Find the loops of edges around a face and project them onto the plane of
+ *  the face. An edge is on the border if there is no triangle on the other
+ *  side or that triangle is part of another face.
  *
- * \param[in] tri Triangle to add to face.
- * \param[inout] face Face that is in process of being built up.
- * \param[inout] faceMap Keeps track of triangles already part of a face.
- * \param[inout] travMap Keeps track of triangles already checked for building
- * 	this particular face.
+ * \param[inout] face Face to find border of. triangles must be filled in.
+ * \param faceId Index of face in faces.
  *
  * \return None.
  */
-void ModelConv::buildFace(const Triangle& tri, Face& face, 
-	std::unordered_map<const Triangle*, int>& faceMap,
-	std::unordered_map<const Triangle*, int>& travMap)
+template <typename Real>
+void ModelConvImpl<Real>::buildBorder(Face& face, uint32_t faceId)
 {
-	// Make sure we have no already added this face
-	if (faceMap[&tri])
-		return;
+	TRACE_ZONE_SAMPLED("build_border", faceId, faceId, TRACE_FACE_SAMPLE);
+	// Directed border edges, following triangle winding
+	std::vector<const Vertex*> edge_from;
+	std::vector<const Vertex*> edge_to;
+	std::vector<uint32_t> edge_neighbor;
+	std::unordered_map<const Vertex*, std::vector<uint32_t> > outgoing;
 
-	faceMap[&tri] = 1;
-	travMap[&tri] = 1;	
-	face.triangles.push_back(&tri);
-
-	for (int cnt = 0; cnt < 3; cnt++)
+	for (size_t tri = 0; tri < face.triangles.size(); tri++)
 	{
-		Triangle* neighbor = tri.neighbors[cnt];
+		const Triangle* triangle = face.triangles[tri];
 
-		if (!neighbor)
+		for (int cnt = 0; cnt < 3; cnt++)
 		{
-			insertVertex(face, tri, cnt);
+			const Triangle* neighbor = triangle->neighbors[cnt];
+
+			if (neighbor && neighbor->face == faceId)
+				continue;
+
+			outgoing[triangle->vertices[cnt]].push_back(
+				(uint32_t)edge_from.size());
+			edge_from.push_back(triangle->vertices[cnt]);
+			edge_to.push_back(triangle->vertices[(cnt + 1) % 3]);
+			edge_neighbor.push_back(neighbor ? neighbor->face : NO_FACE);
+		}
+	}
+
+	// Chain edges into loops by following each edge to one that starts 
+	//  where it ends
+	std::vector<uint8_t> used(edge_from.size(), 0);
+	for (size_t first = 0; first < edge_from.size(); first++)
+	{
+		size_t edge = first;
+		Loop loop;
+
+		if (used[first])
 			continue;
+
+		while (true)
+		{
+			used[edge] = 1;
+			loop.vertices.push_back(edge_from[edge]);
+			loop.neighbors.push_back(edge_neighbor[edge]);
+
+			if (edge_to[edge] == edge_from[first])
+				break;
+
+			std::vector<uint32_t>& next = outgoing[edge_to[edge]];
+			size_t cnt = 0;
+
+			while (cnt < next.size() && used[next[cnt]])
+				cnt++;
+
+			// Only happens if winding of triangles is inconsistent. Loop
+			//  is closed with a straight edge.
+			if (cnt == next.size())
+				break;
+
+			edge = next[cnt];
 		}
 
-		// Make sure we have not already visited this triangle for this
-		//  face construction
-		if (travMap[neighbor])
+		face.loops.push_back(loop);
+	}
+
+	// Build axes in plane of face. Crossing with the coordinate axis least
+	//  aligned with the normal keeps the result well conditioned. Axes and
+	//  normal form a right handed set, so counter clockwise triangles stay
+	//  counter clockwise once projected.
+	Real normal[3] = {face.normal.i, face.normal.j, face.normal.k};
+	Real len = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + 
+		normal[2] * normal[2]);
+	Real axis[3] = {0, 0, 0};
+	Real* u = face.axes[0];
+	Real* v = face.axes[1];
+
+	if (len > 0)
+		for (int cnt = 0; cnt < 3; cnt++)
+			normal[cnt] /= len;
+
+	if (fabs(normal[0]) <= fabs(normal[1]) && 
+		fabs(normal[0]) <= fabs(normal[2]))
+		axis[0] = 1;
+	else if (fabs(normal[1]) <= fabs(normal[2]))
+		axis[1] = 1;
+	else
+		axis[2] = 1;
+
+	u[0] = normal[1] * axis[2] - normal[2] * axis[1];
+	u[1] = normal[2] * axis[0] - normal[0] * axis[2];
+	u[2] = normal[0] * axis[1] - normal[1] * axis[0];
+	len = sqrt(u[0] * u[0] + u[1] * u[1] + u[2] * u[2]);
+	for (int cnt = 0; cnt < 3; cnt++)
+		u[cnt] /= len;
+
+	v[0] = normal[1] * u[2] - normal[2] * u[1];
+	v[1] = normal[2] * u[0] - normal[0] * u[2];
+	v[2] = normal[0] * u[1] - normal[1] * u[0];
+
+	// Project loops and find signed area of each. Coordinates are gathered
+	//  into x, y, z, u and v runs of scratch for the projection kernel.
+	std::vector<double> areas(face.loops.size(), 0);
+	std::vector<Real> scratch;
+	size_t outer = 0;
+
+	for (size_t loop_cnt = 0; loop_cnt < face.loops.size(); loop_cnt++)
+	{
+		Loop& loop = face.loops[loop_cnt];
+		size_t num_pts = loop.vertices.size();
+
+		scratch.resize(5 * num_pts);
+		for (size_t cnt = 0; cnt < num_pts; cnt++)
 		{
-			continue;
+			scratch[cnt] = loop.vertices[cnt]->x;
+			scratch[num_pts + cnt] = loop.vertices[cnt]->y;
+			scratch[2 * num_pts + cnt] = loop.vertices[cnt]->z;
 		}
 
+		projectPoints(&scratch[0], &scratch[num_pts], 
+			&scratch[2 * num_pts], num_pts, face.axes, 
+			&scratch[3 * num_pts], &scratch[4 * num_pts]);
+
+		loop.points.resize(num_pts);
+		for (size_t cnt = 0; cnt < num_pts; cnt++)
+		{
+			loop.points[cnt].x = scratch[3 * num_pts + cnt];
+			loop.points[cnt].y = scratch[4 * num_pts + cnt];
+		}
 
-/*
-printf("tri norm %s\n", to_string(tri.normal).c_str());
-printf("nei norm %s\n", to_string(neighbor->normal).c_str());
-printf("%d %d %d\n", tri.normal.i == neighbor->normal.i, tri.normal.j == neighbor->normal.j, tri.normal.k == neighbor->normal.k);
-printf("0x%x 0x%x\n", *(int*)(&tri.normal.i), *(int*)(&neighbor->normal.i));
-printf("0x%x 0x%x\n", *(int*)(&tri.normal.j), *(int*)(&neighbor->normal.j));
-printf("0x%x 0x%x\n", *(int*)(&tri.normal.k), *(int*)(&neighbor->normal.k));
-*/
+		// Relative to the first point, so that models far from the 
+		//  origin do not lose the area to cancellation
+		double origin_x = num_pts ? loop.points[0].x : 0;
+		double origin_y = num_pts ? loop.points[0].y : 0;
 
-	
-		if (tri.normal == neighbor->normal)
+		for (size_t cnt = 0, prev = num_pts - 1; cnt < num_pts; 
+			prev = cnt++)
 		{
-printf("MATCH\n");
-			// Neighbor is face of this face
-			buildFace(*neighbor, face, faceMap, travMap);
+			double prev_x = loop.points[prev].x - origin_x;
+			double prev_y = loop.points[prev].y - origin_y;
+			double cur_x = loop.points[cnt].x - origin_x;
+			double cur_y = loop.points[cnt].y - origin_y;
+
+			areas[loop_cnt] += (prev_x * cur_y - cur_x * prev_y) / 2;
 		}
-		else
+
+		if (fabs(areas[loop_cnt]) > fabs(areas[outer]))
+			outer = loop_cnt;
+
+	}
+
+	// Closed surfaces joined into a single face have no border at all
+	if (face.loops.empty())
+		areas.push_back(0);
+	else
+	{
+		std::swap(face.loops[0], face.loops[outer]);
+		std::swap(areas[0], areas[outer]);
+	}
+
+	// Triangles wound clockwise relative to their normal leave the outer 
+	//  loop clockwise. Mirror so that it is always counter clockwise.
+	if (areas[0] < 0)
+	{
+		for (int cnt = 0; cnt < 3; cnt++)
+			v[cnt] = -v[cnt];
+
+		for (size_t loop_cnt = 0; loop_cnt < face.loops.size(); loop_cnt++)
 		{
-			// neighbor is not on this face
-			travMap[neighbor] = 1;
-			insertVertex(face, tri, cnt);
+			Loop& loop = face.loops[loop_cnt];
+
+			for (size_t cnt = 0; cnt < loop.points.size(); cnt++)
+				loop.points[cnt].y = -loop.points[cnt].y;
 		}
-	}			
-}
+	}
 
-/**
- * Insert vertices common to triangles into border of face.
- *
- * \param[inout] face Face for which vertices are being inserted into border.
- * \param[in] tri Triangle in face that has a border edge.
- * \param[in] neighborIndex Index of neighbor in tri that is edge of face, 
- *	which indicates which vertices to add to face border.
- * 
- * \return None.
- */
-void ModelConv::insertVertex(Face& face, const Triangle& tri, int neighborIndex)
-{
-	Vertex* vtx1 = NULL;
-	Vertex* vtx2 = NULL;
-	
-	switch(neighborIndex)
+	face.area = (Real)fabs(areas[0]);
+	for (size_t loop_cnt = 1; loop_cnt < face.loops.size(); loop_cnt++)
+		face.area -= (Real)fabs(areas[loop_cnt]);
+
+	// Centroid of any triangle in face is strictly inside it
+	const Triangle* triangle = face.triangles[0];
+	Real centroid[3] = {0, 0, 0};
+
+	for (int vtx = 0; vtx < 3; vtx++)
 	{
-//TODO: could calc index with math instead of switch statement
-		case 0:
-			vtx1 = tri.vertices[0];
-			vtx2 = tri.vertices[1];
-			break;
-		case 1:
-			vtx1 = tri.vertices[1];
-			vtx2 = tri.vertices[2];
-			break;
-		case 2:
-			vtx1 = tri.vertices[2];
-			vtx2 = tri.vertices[0];
-			break;
-		default:
-			fprintf(stderr, "%s: Invalid bit neighbor index %d\n", 
-				__func__, neighborIndex);
-			//TODO: add proper exception throwing
-			exit(EXIT_FAILURE);
-			break;
+		centroid[0] += triangle->vertices[vtx]->x / 3;
+		centroid[1] += triangle->vertices[vtx]->y / 3;
+		centroid[2] += triangle->vertices[vtx]->z / 3;
 	}
 
-	// Insert into border in appropriate location
-//TODO
+	face.interior.x = centroid[0] * u[0] + centroid[1] * u[1] + 
+		centroid[2] * u[2];
+	face.interior.y = centroid[0] * v[0] + centroid[1] * v[1] + 
+		centroid[2] * v[2];
 }
 
-
 /**
  * Export given triangle data to binary STL file.
  *
@@ -539,9 +4683,11 @@ void ModelConv::insertVertex(Face& face, const Triangle& tri, int neighborIndex)
  *
  * \return None.
  */
-void ModelConv::exportBinStl(const char* filename, 
+template <typename Real>
+void ModelConvImpl<Real>::exportBinStl(const char* filename, 
 	const std::vector<const Triangle*>& triangles)
 {
+	TRACE_ZONE("export_bin_stl");
 	FILE* file = NULL;
 	// Number of elements written by fwrite
 	size_t elem_wr = 0;
@@ -553,8 +4699,7 @@ void ModelConv::exportBinStl(const char* filename,
 	{
 		fprintf(stderr, "Failed to open file \"%s\" for writing.\n",
 			filename);
-		//TODO: add proper exception throwing
-		exit(EXIT_FAILURE);
+		throw ModelConv::Error();
 	}
 
 	// Write header data
@@ -565,8 +4710,8 @@ void ModelConv::exportBinStl(const char* filename,
 		fprintf(stderr, "Only wrote %lu of %lu bytes from "
 			"binStlHeader to file \"%s\"\n", elem_wr, 
 			ARRAY_SIZE(binStlHeader), filename);
-		//TODO: add proper exception throwing
-		exit(EXIT_FAILURE);
+		fclose(file);
+		throw ModelConv::Error();
 	}
 
 	// Write number of triangle
@@ -576,18 +4721,25 @@ void ModelConv::exportBinStl(const char* filename,
 		fprintf(stderr, "Only wrote %lu of %lu bytes from "
 			"num_triangles to file \"%s\"\n", elem_wr, 
 			sizeof(num_triangles), filename);
-		//TODO: add proper exception throwing
-		exit(EXIT_FAILURE);
+		fclose(file);
+		throw ModelConv::Error();
 	}
 
 	// Write triangle data
 	for (uint32_t cnt = 0; cnt < num_triangles; cnt++)
 	{
 		// Copy trianlge data to struct for writing
-		bin_stl_triangle.normal = triangles[cnt]->normal;
-		bin_stl_triangle.vertices[0] = *(triangles[cnt]->vertices[0]);
-		bin_stl_triangle.vertices[1] = *(triangles[cnt]->vertices[1]);
-		bin_stl_triangle.vertices[2] = *(triangles[cnt]->vertices[2]);
+		bin_stl_triangle.normal.x = (float)triangles[cnt]->normal.i;
+		bin_stl_triangle.normal.y = (float)triangles[cnt]->normal.j;
+		bin_stl_triangle.normal.z = (float)triangles[cnt]->normal.k;
+		for (int vtx = 0; vtx < 3; vtx++)
+		{
+			const Vertex* vertex = triangles[cnt]->vertices[vtx];
+
+			bin_stl_triangle.vertices[vtx].x = (float)vertex->x;
+			bin_stl_triangle.vertices[vtx].y = (float)vertex->y;
+			bin_stl_triangle.vertices[vtx].z = (float)vertex->z;
+		}
 		bin_stl_triangle.attrByteCnt = 0;
 
 		// Write triangle data to file
@@ -599,8 +4751,8 @@ void ModelConv::exportBinStl(const char* filename,
 				"%u of %u triangle to file \"%s\"\n", elem_wr, 
 				sizeof(bin_stl_triangle), cnt, num_triangles,
 				filename);
-			//TODO: add proper exception throwing
-			exit(EXIT_FAILURE);
+			fclose(file);
+			throw ModelConv::Error();
 		}
 		
 	}
@@ -609,7 +4761,9 @@ void ModelConv::exportBinStl(const char* filename,
 	{
 		fprintf(stderr, "Failed to close file \"%s\" after writing "
 			"data.\n", filename);
-		//TODO: add proper exception throwing
-		exit(EXIT_FAILURE);
+		throw ModelConv::Error();
 	}
 }
+
+template class ModelConvImpl<float>;
+template class ModelConvImpl<double>;
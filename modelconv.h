@@ -9,31 +9,239 @@
 
 #include <stdint.h>
 #include <string>
+#include <stdexcept>
 #include <vector>
-#include <list>
 #include <unordered_map>
 #include <math.h>
 
+#include "stats.h"
+#include "bvh.h"
+#include "unfold.h"
+#include "decimate.h"
+#include "kernels.h"
+#include "offset.h"
+#include "labels.h"
+#include "joinery.h"
+
+namespace svg
+{
+	class Document;
+}
+
+/**
+ * Interface to a loaded model. Models are processed in either single or
+ *  double precision, see ModelConvImpl, and load() picks which one to use.
+ */
 class ModelConv
 {
 public:
-	ModelConv(const char* filename);
-	~ModelConv();
+	/**
+	 * Thrown when a model cannot be loaded or an output cannot be written,
+	 *  after the reason has been printed to stderr.
+	 */
+	class Error : public std::runtime_error
+	{
+	public:
+		Error() : std::runtime_error("model conversion failed") {}
+	};
+
+	/**
+	 * Scalar type model geometry is stored and processed in.
+	 */
+	enum Precision
+	{
+		PRECISION_AUTO = 0, //!< Pick from the magnitude of coordinates.
+		PRECISION_FLOAT,
+		PRECISION_DOUBLE
+	};
+
+	/**
+	 * Settings controlling how a model is processed.
+	 */
+	struct Options
+	{
+		Options();
+
+		float decimateError; //!< Simplify mesh before building faces,
+			//!< allowing surfaces to move up to about this far. 0 to
+			//!< not limit by error.
+		size_t decimateTriangles; //!< Simplify mesh before building
+			//!< faces until no more than this many triangles are
+			//!< left. 0 to not limit by count.
+		bool keepBoundaries; //!< Do not move vertices on open edges
+			//!< when simplifying.
+		Precision precision; //!< Precision to process model in.
+		float quantizeStep; //!< Snap vertices to a grid with this 
+			//!< spacing, anchored at the minimum corner of the 
+			//!< model's bounds, and weld on exact grid position. 0 to
+			//!< weld exactly equal coordinates instead.
+		bool reorder; //!< Sort vertices and triangles into Morton
+			//!< order before building adjacency, for better cache
+			//!< use on models stored in random order.
+		float coplanarAngle; //!< Largest angle, in degrees, between the
+			//!< normals of two neighboring triangles for them to be
+			//!< part of the same face, and between the normals of
+			//!< each triangle and the first triangle of its face.
+		unsigned threads; //!< Maximum number of threads to process
+			//!< model with. 0 to use one per core.
+		float kerf; //!< Width of material removed by the cutter. SVG
+			//!< outlines are moved out by half this so parts come
+			//!< out at their true size. 0 to draw borders as is.
+		Offsetter::Join kerfJoin; //!< How outlines moved out for kerf
+			//!< are joined around convex corners.
+		int svgPrecision; //!< Write SVG outlines as compact path 
+			//!< elements with coordinates rounded to this many
+			//!< decimal places. Negative for plain polygons and 
+			//!< lines at full precision.
+		float sheetWidth; //!< Size of sheets of material SVG output
+			//!< is split across by exportSheets().
+		float sheetHeight;
+		bool labelEdges; //!< Number each pair of cut edges that join
+			//!< two faces in SVG output, with the same number on
+			//!< both, to aid assembly.
+		float labelHeight; //!< Height of edge labels in model units. 0
+			//!< to size them from the average edge length.
+		float thickness; //!< Thickness of sheet material. Cut edges
+			//!< that join two faces get interlocking fingers this
+			//!< deep in SVG output. 0 to leave edges straight.
+		float tabWidth; //!< Width of fingers on joined edges. 0 for 
+			//!< three times the thickness.
+		unsigned thumbnailSize; //!< Width and height of thumbnail
+			//!< images in pixels.
+
+		std::string toString() const;
+	};
+
+	static ModelConv* load(const char* filename, 
+		const Options& options = Options());
+	static ModelConv* load(const char* name, const uint8_t* data, 
+		size_t size, const Options& options = Options());
+	static Precision detectPrecision(const char* filename);
+	static Precision detectPrecision(const uint8_t* data, size_t size);
+
+	virtual ~ModelConv();
+
+	virtual Precision getPrecision() const = 0;
+
+	virtual void exportBinStl(const char* filename) = 0;
+	virtual void exportPly(const char* filename) = 0;
+	virtual void exportThumbnail(const char* filename) = 0;
+
+	virtual void exportFaces(const char* prefix) = 0;
+	virtual void exportBodies(const char* prefix) = 0;
+
+	virtual void resegment(float coplanarAngle) = 0;
+
+	virtual void unfold() = 0;
+	virtual void exportSvg(const char* filename) = 0;
+	virtual void exportSheets(const char* prefix) = 0;
+
+	virtual void debugPrint() = 0;
+
+	virtual const Stats& getStats() const = 0;
+	virtual const std::vector<std::string>& getOutputFiles() const = 0;
+	virtual void getBounds(float min[3], float max[3]) const = 0;
+
+	virtual void buildBvh() = 0;
+	virtual bool pickFace(const double origin[3], const double dir[3], 
+		uint32_t& triangle, uint32_t& face, double& dist) = 0;
+	virtual void findTrianglesInBox(const double min[3],
+		const double max[3], std::vector<uint32_t>& triangleIds) = 0;
+	virtual void findFacesInBox(const double min[3], const double max[3],
+		std::vector<uint32_t>& faceIds) = 0;
+	virtual void findTrianglesNearPoint(const double point[3], 
+		double tolerance, std::vector<uint32_t>& triangleIds) = 0;
+	virtual void findFacesNearPoint(const double point[3],
+		double tolerance, std::vector<uint32_t>& faceIds) = 0;
+
+protected:
+	static const uint32_t NO_FACE = 0xFFFFFFFF; //!< Marks open edges.
+
+	// Since these structs are used to read from a packed file, we need to
+	//  compress data to match. Binary STL is always single precision.
+	#pragma pack(push, 1)
+	struct BinStlVector
+	{
+		float x;
+		float y;
+		float z;
+	};
+
+	struct BinStlTriangle
+	{
+		BinStlVector normal; //!< Normal vector of triangle.
+		BinStlVector vertices[3]; 
+		uint16_t attrByteCnt; //!< Attribute byte count. Unused.
+	};
+
+	struct PlyFace
+	{
+		uint8_t numVertices; //!< Length of vertex list. Always 3.
+		uint32_t vertices[3]; //!< Index of each vertex.
+		uint8_t color[3]; //!< Red, green and blue.
+	};
+	#pragma pack(pop)
+	// Back to default packing 
+
+	static bool needsDouble(const BinStlTriangle* triangles, size_t count);
+	static void getFaceColor(uint32_t face, uint8_t rgb[3]);
+};
+
+/**
+ * Model with geometry stored and processed in Real, which is float or double.
+ *  Single precision keeps vertices compact and uses the SIMD kernels. Double
+ *  precision keeps projected borders accurate on models far from the origin
+ *  or many orders of magnitude larger than their smallest details.
+ */
+template <typename Real>
+class ModelConvImpl : public ModelConv
+{
+public:
+	ModelConvImpl(const char* filename, const Options& options = Options(),
+		const uint8_t* data = NULL, size_t size = 0);
+	~ModelConvImpl();
+
+	Precision getPrecision() const;
 
 	void exportBinStl(const char* filename);
+	void exportPly(const char* filename);
+	void exportThumbnail(const char* filename);
+
+	void exportFaces(const char* prefix);
+	void exportBodies(const char* prefix);
+
+	void resegment(float coplanarAngle);
 
+	void unfold();
 	void exportSvg(const char* filename);
+	void exportSheets(const char* prefix);
 
 	void debugPrint();
 
+	const Stats& getStats() const;
+	const std::vector<std::string>& getOutputFiles() const;
+	void getBounds(float min[3], float max[3]) const;
+
+	void buildBvh();
+	bool pickFace(const double origin[3], const double dir[3], 
+		uint32_t& triangle, uint32_t& face, double& dist);
+	void findTrianglesInBox(const double min[3], const double max[3],
+		std::vector<uint32_t>& triangleIds);
+	void findFacesInBox(const double min[3], const double max[3],
+		std::vector<uint32_t>& faceIds);
+	void findTrianglesNearPoint(const double point[3], double tolerance,
+		std::vector<uint32_t>& triangleIds);
+	void findFacesNearPoint(const double point[3], double tolerance,
+		std::vector<uint32_t>& faceIds);
+
 protected:
 
 //TODO: make into class? construction and init being taken care of correctly in code?
 	struct Normal
 	{
-		float i;
-		float j;
-		float k;
+		Real i;
+		Real j;
+		Real k;
 
 		bool operator==(const Normal& rhs) const
 		{
@@ -47,9 +255,9 @@ protected:
 //TODO: make into class? construction and init being taken care of correctly in code?
 	struct Vertex
 	{
-		float x;
-		float y;
-		float z;
+		Real x;
+		Real y;
+		Real z;
 
 		bool operator==(const Vertex& rhs) const
 		{
@@ -57,22 +265,12 @@ protected:
 		}
 	};
 
-	// Since this struct is used to read from a packed file, we need to
-	//  compress data to match
-	#pragma pack(push, 1)
-	struct BinStlTriangle
-	{
-		Normal normal; //!< Normal vector of triangle.
-		Vertex vertices[3]; 
-		uint16_t attrByteCnt; //!< Attribute byte count. Unused.
-	};
-	#pragma pack(pop)
-	// Back to default packing 
-
 //TODO: make into class? construction and init being taken care of correctly in code?
 	struct Triangle
 	{
-		Normal normal; //!< Normal vector of triangle.
+		Normal normal; //!< Unit normal computed from the vertices,
+			//!< which faces are built from. The normal stored in
+			//!< the file for triangles with no area.
 		Vertex* vertices[3]; //!< A triangle is defined by three
 			//!< vertices. Each entry points to an object stored in
 			//!< vertices.
@@ -82,6 +280,42 @@ protected:
 			//!< neighbor[0] is on edge made by vertices 0 to 1
 			//!< neighbor[1] is on edge made by vertices 1 to 2
 			//!< neighbor[2] is on edge made by vertices 2 to 0
+			//!< Where more than two triangles share an edge, 
+			//!< this is the chosen continuation (see 
+			//!< selectNeighbor()) and edges has the rest.
+		uint32_t edges[3]; //!< Index into edge table of each edge,
+			//!< in the same order as neighbors.
+		uint32_t face; //!< Index into faces of face this triangle
+			//!< is part of.
+		uint32_t index; //!< Index of this triangle in triangles. Set
+			//!< once triangles stop moving, by findBodies().
+		bool normalMismatch; //!< True if the normal stored in the file
+			//!< disagreed with the normal computed from the 
+			//!< vertices. Only counted, as normal holds the 
+			//!< computed normal either way.
+	};
+
+	/**
+	 * Point projected onto the plane of a face.
+	 */
+	struct Point2
+	{
+		Real x;
+		Real y;
+	};
+
+	/**
+	 * Closed loop of edges around a face or one of its holes.
+	 */
+	struct Loop
+	{
+		std::vector<const Vertex*> vertices; //!< Vertices in order around
+			//!< the loop. Edge n runs from vertex n to vertex n+1,
+			//!< wrapping around at the end.
+		std::vector<uint32_t> neighbors; //!< Index into faces of face on
+			//!< the other side of each edge. NO_FACE for open edges.
+		std::vector<Point2> points; //!< vertices projected onto plane of
+			//!< face using Face::axes.
 	};
 
 //TODO: make into class? construction and init being taken care of correctly in code?
@@ -91,35 +325,183 @@ protected:
 		std::vector<const Triangle*> triangles; //!< All triangles that
 			//!< make up a face. Mostly included for debug or
 			//!< face to object export.
-		std::list<const Vertex*> border; //!< Vertices that define
-			//!< border of the face.
+		std::vector<Loop> loops; //!< Loops that define border of the 
+			//!< face. loops[0] is the outer border and runs counter
+			//!< clockwise in projected coordinates. Any others are
+			//!< holes.
+		Real axes[2][3]; //!< Unit vectors in plane of face that project
+			//!< vertices to 2D.
+		Point2 interior; //!< Projected point strictly inside the face.
+		Real area; //!< Area of face, not including holes.
+	};
+
+	/**
+	 * Faces laid out in nets, ready to be packed and drawn to SVG.
+	 */
+	struct SvgNets
+	{
+		bool useNets; //!< Faces were unfolded, so folds are drawn.
+		uint32_t numNets;
+		std::vector<typename Unfolder<Real>::Placement> placements; 
+			//!< Where each face is within its net.
+		std::vector<std::vector<uint32_t> > netFaces; //!< Index into 
+			//!< faces of each face of each net.
+		std::vector<std::vector<std::vector<double> > > outlines; //!< x,
+			//!< y pairs of each loop of each net's kerf outline. 
+			//!< Empty if Options::kerf is not set.
+		std::vector<Real> bounds; //!< Box around each net in its own
+			//!< coordinates (min x, min y, max x, max y).
+		Real gap; //!< Space to leave between nets.
+		std::vector<std::vector<EdgeLabeler::Label> > labels; //!< 
+			//!< Assembly labels of each face, in the face's own
+			//!< coordinates. Empty if Options::labelEdges is not set.
+		Real labelHeight; //!< Height of labels that fit at full size.
+		std::vector<uint32_t> edgeStarts; //!< Index of first border
+			//!< edge of each face, counting edges of every loop of
+			//!< every face in order, plus one extra entry marking the
+			//!< end. Empty if Options::thickness is not set.
+		std::vector<uint32_t> jointOffsets; //!< Start of each border
+			//!< edge's points in jointPoints, plus one extra entry
+			//!< marking the end.
+		std::vector<double> jointPoints; //!< x, y pairs, in face 
+			//!< coordinates, of the finger joint cut into each 
+			//!< border edge between its ends. Allocated for all 
+			//!< faces up front and filled in face by face.
+	};
+
+	/**
+	 * Set of triangles connected to each other through neighbors, and
+	 *  not to any others. Faces never cross bodies, so each body can be
+	 *  processed on its own.
+	 */
+	struct Body
+	{
+		std::vector<uint32_t> triangles; //!< Index into triangles of
+			//!< each triangle of body, in ascending order.
+		std::vector<uint32_t> faces; //!< Index into faces of each face
+			//!< of body, in ascending order.
 	};
 
+	explicit ModelConvImpl(const Options& options);
+
 	std::string to_string(const Normal& normal);
 	std::string to_string(const Vertex& vertex);
 	std::string to_string(const Triangle& triangle);
 
-	Vertex& addVertex(const Vertex& vertex);
-	void checkAdjacent(Triangle& tri1, Triangle& tri2);
-	void addNeighbor(Triangle& tri, Triangle& neighbor, 
-		uint8_t sharedVtxs);
-	void buildFace(const Triangle& tri, Face& face, 
-		std::unordered_map<const Triangle*, int>& faceMap,
-		std::unordered_map<const Triangle*, int>& travMap);
-	void insertVertex(Face& face, const Triangle& tri, int neighborIndex);
+	void loadPly(const char* filename, const uint8_t* data, size_t size,
+		std::vector<uint32_t>& vertexIds, std::vector<uint8_t>& degenerate);
+
+	static uint32_t hashVertex(const Vertex& vertex);
+	uint32_t addVertex(const Vertex& vertex, uint32_t hash,
+		std::vector<uint32_t>& weldTable);
+	void growWeldTable(std::vector<uint32_t>& weldTable);
+	void weldQuantized(const TriangleArrays& triArrays, 
+		uint32_t numTriangles, std::vector<uint32_t>& vertexIds);
+	void removeBadTriangles(std::vector<uint32_t>& vertexIds,
+		const std::vector<uint8_t>& degenerate);
+	void decimate(std::vector<uint32_t>& vertexIds);
+	void reorder(std::vector<uint32_t>& vertexIds);
+	void buildAdjacency(const std::vector<uint32_t>& vertexIds);
+	static float getLinkAngle(const Normal& lhs, const Normal& rhs);
+	Triangle* selectNeighbor(size_t tri, uint32_t first, uint32_t last);
+	void findBodies();
+	void computeLinkAngles();
+	template <typename Func>
+	void forEachBody(const Func& func);
+	void buildFaces();
+	void buildFace(Triangle& seed, Face& face, uint32_t faceId,
+		std::vector<std::pair<Triangle*, int> >& stack);
+	void buildBorder(Face& face, uint32_t faceId);
 
 	void exportBinStl(const char* filename, 
 		const std::vector<const Triangle*>& triangles);
+	void prepareSvgNets(SvgNets& nets);
+	void offsetNets(SvgNets& nets);
+	void labelNets(SvgNets& nets, double edgeLength);
+	bool isJoinedCut(const SvgNets& nets, uint32_t face, uint32_t loop,
+		uint32_t edge) const;
+	void findLogicalEdges(const SvgNets& nets, uint32_t face, 
+		uint32_t loop, std::vector<uint32_t>& starts) const;
+	static bool isStraight(const Vertex* prev, const Vertex* vertex,
+		const Vertex* next);
+	void cutJoints(SvgNets& nets);
+	uint32_t cutEdgeJoint(SvgNets& nets, const FingerJoint& joint, 
+		uint32_t face, uint32_t loop, uint32_t index, 
+		const std::vector<uint32_t>& starts, size_t run, 
+		std::vector<double>& scratch, bool fill);
+	uint32_t getEdgeFingers(const SvgNets& nets, const FingerJoint& joint,
+		uint32_t face, uint32_t loop, uint32_t first, uint32_t last) const;
+	const double* getJointPoints(const SvgNets& nets, uint32_t face,
+		uint32_t loop, uint32_t edge, uint32_t& numPoints) const;
+	std::vector<uint32_t> sortNetsByHeight(const SvgNets& nets);
+	void packPage(const SvgNets& nets, std::vector<Real>& offsets,
+		Real& width, Real& height);
+	uint32_t packSheets(const SvgNets& nets, Real sheetWidth, 
+		Real sheetHeight, std::vector<Real>& offsets,
+		std::vector<std::vector<uint32_t> >& sheets);
+	void drawNets(const SvgNets& nets, const std::vector<uint32_t>& netIds,
+		const std::vector<Real>& offsets, svg::Document& doc);
+	std::string getSheetFilename(const char* prefix, uint32_t sheet);
+	void writeSheetManifest(const char* prefix, const SvgNets& nets,
+		const std::vector<Real>& offsets,
+		const std::vector<std::vector<uint32_t> >& sheets);
+
+	void trianglesToFaces(const std::vector<uint32_t>& triangleIds,
+		std::vector<uint32_t>& faceIds);
+
+	Options options; //!< Settings model was loaded with.
+
+	uint8_t binStlHeader[80]; //!< Header read from binary STL file. Zero
+		//!< for models read from PLY.
 
-	uint8_t binStlHeader[80]; //!< Header read from binary STL file.
+	std::vector<Vertex> vertices; //!< Unique entry for each vertex in
+		//!< object. Triangles point into this, so it must not be
+		//!< resized once welding has completed.
 
-	std::vector<Vertex*> vertices; //!< Unique entry for each vertex in
-		//!< object. 
+	float bounds[2][3]; //!< Minimum and maximum corners of box around
+		//!< all vertices read from file.
 
 	std::vector<Triangle*> triangles; //!< Unique entry for each trianlge 
 		//!< in the object.
 
 	std::vector<Face*> faces; //!< Unique entry for each face of the object.
+
+	std::vector<Body> bodies; //!< Disconnected parts of the object, in order
+		//!< of their first triangle.
+
+	std::vector<uint64_t> edgeKeys; //!< Indices of the two vertices of 
+		//!< each edge. Lower index in upper 32 bits.
+
+	std::vector<uint32_t> edgeOffsets; //!< Start of each edge's entries
+		//!< in edgeTriangles, plus one extra entry marking the end.
+
+	std::vector<uint32_t> edgeTriangles; //!< Index into triangles of 
+		//!< every triangle on each edge, grouped by edge.
+
+	std::vector<float> linkAngles; //!< Angle in degrees between the normal
+		//!< of each triangle and each of its neighbors, three per
+		//!< triangle in the same order as Triangle::neighbors. Kept so
+		//!< that resegment() only has to revisit links whose angle is
+		//!< between the old and new tolerance.
+
+	std::vector<float> seedAngles; //!< Angle in degrees between the normal
+		//!< of each triangle and the normal of its face's seed, as
+		//!< buildFace() found it, so resegment() can tell which 
+		//!< triangles a new tolerance takes out of or lets into a face.
+
+	Bvh<Real> bvh; //!< Spatial index over triangles. Built on first query.
+
+	Unfolder<Real> unfolder; //!< Nets faces are unfolded into. Empty until
+		//!< unfold() is called.
+
+	Stats stats; //!< Phase timings and counters for this model.
+
+	std::vector<std::string> outputFiles; //!< Every file written by 
+		//!< exports, in order.
 };
 
+// Both precisions are instantiated in modelconv.cpp
+extern template class ModelConvImpl<float>;
+extern template class ModelConvImpl<double>;
+
 #endif /* _MODEL_CONV_ */
@@ -0,0 +1,183 @@
+/**
+ * \file morton.cpp
+ * \brief Morton (Z-order) codes and a parallel radix sort for putting
+ *	geometry in spatially coherent order.
+ * \author Gregory Gluszek.
+ */
+
+#include "morton.h"
+#include "parallel.h"
+
+#include <algorithm>
+
+#define RADIX_BITS 11 //!< Bits of key sorted per pass. 63 bit Morton codes
+	//!< take 6 passes, and counts for one pass fit in L1 cache.
+#define RADIX_SIZE (1 << RADIX_BITS) //!< Buckets per pass.
+#define RADIX_THREAD_MIN 65536 //!< Minimum keys per thread before sorting
+	//!< is split across threads.
+
+/**
+ * Spread the low MORTON_BITS bits of a value out so there are two zero bits
+ *  between each of them.
+ *
+ * \param value Value to spread.
+ *
+ * \return Spread bits.
+ */
+static uint64_t spreadBits(uint64_t value)
+{
+	value &= (1ull << MORTON_BITS) - 1;
+	value = (value | value << 32) & 0x001f00000000ffffull;
+	value = (value | value << 16) & 0x001f0000ff0000ffull;
+	value = (value | value << 8) & 0x100f00f00f00f00full;
+	value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+	value = (value | value << 2) & 0x1249249249249249ull;
+
+	return value;
+}
+
+/**
+ * Interleave the bits of three grid coordinates so that points close in
+ *  space tend to have close codes.
+ *
+ * \param x Grid coordinates. Only the low MORTON_BITS bits are used.
+ * \param y
+ * \param z
+ *
+ * \return Morton code.
+ */
+uint64_t mortonCode(uint32_t x, uint32_t y, uint32_t z)
+{
+	return spreadBits(x) << 2 | spreadBits(y) << 1 | spreadBits(z);
+}
+
+/**
+ * Compute Morton codes of many points.
+ *
+ * \param[in] x x coordinate of each point.
+ * \param[in] y y coordinate of each point.
+ * \param[in] z z coordinate of each point.
+ * \param count Number of points.
+ * \param[in] min Minimum corner of grid.
+ * \param scale Grid cells per unit. Points beyond the grid are clamped to it
+ *	and NaN coordinates are treated as being at min.
+ * \param[out] codes Code of each point. Must hold count elements.
+ *
+ * \return None.
+ */
+void computeMortonCodes(const float* x, const float* y, const float* z,
+	size_t count, const float min[3], float scale, uint64_t* codes)
+{
+	const float max_cell = (float)((1u << MORTON_BITS) - 1);
+	const float* coords[3] = {x, y, z};
+
+	for (size_t cnt = 0; cnt < count; cnt++)
+	{
+		uint32_t cells[3];
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			float cell = (coords[axis][cnt] - min[axis]) * scale;
+
+			cell = cell >= 0 ? cell : 0;
+			cell = cell <= max_cell ? cell : max_cell;
+			cells[axis] = (uint32_t)cell;
+		}
+
+		codes[cnt] = mortonCode(cells[0], cells[1], cells[2]);
+	}
+}
+
+/**
+ * Stable sort of keys with values carried along, by least significant digit
+ *  radix sort. Each thread counts and then scatters its own contiguous range
+ *  of the input, so threads write to disjoint parts of the output. Passes are
+ *  skipped where every key has the same digit, and above the highest set bit.
+ *
+ * \param[inout] keys Keys to sort.
+ * \param[inout] values Value belonging to each key. Must be the same size as
+ *	keys.
+ * \param numThreads Maximum number of threads to sort with. 0 means use one
+ *	per core.
+ *
+ * \return None.
+ */
+void sortByKey(std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+	unsigned numThreads)
+{
+	size_t count = keys.size();
+	uint64_t all_bits = 0;
+
+	if (count < 2)
+		return;
+
+	numThreads = (unsigned)std::min((size_t)getThreadCount(numThreads),
+		std::max((size_t)1, count / RADIX_THREAD_MIN));
+
+	for (size_t cnt = 0; cnt < count; cnt++)
+		all_bits |= keys[cnt];
+
+	std::vector<uint64_t> key_tmp(count);
+	std::vector<uint32_t> value_tmp(count);
+	// Count, then output position, of each digit in each thread's range
+	std::vector<size_t> offsets((size_t)numThreads * RADIX_SIZE);
+	size_t chunk = (count + numThreads - 1) / numThreads;
+
+	for (int shift = 0; shift < 64 && (all_bits >> shift);
+		shift += RADIX_BITS)
+	{
+		std::fill(offsets.begin(), offsets.end(), 0);
+
+		runThreads(numThreads, [&](unsigned thread)
+		{
+			size_t* counts = &offsets[(size_t)thread * RADIX_SIZE];
+			size_t end = std::min(count, (thread + 1) * chunk);
+
+			for (size_t cnt = thread * chunk; cnt < end; cnt++)
+				counts[(keys[cnt] >> shift) & (RADIX_SIZE - 1)]++;
+		});
+
+		// Turn counts into output positions. Lower threads come first
+		//  within each digit so the sort stays stable.
+		size_t sum = 0;
+		bool single_digit = false;
+
+		for (size_t digit = 0; digit < RADIX_SIZE; digit++)
+		{
+			size_t digit_start = sum;
+
+			for (unsigned thread = 0; thread < numThreads; thread++)
+			{
+				size_t& entry = offsets[thread * RADIX_SIZE + digit];
+				size_t num = entry;
+
+				entry = sum;
+				sum += num;
+			}
+
+			if (sum - digit_start == count)
+				single_digit = true;
+		}
+
+		if (single_digit)
+			continue;
+
+		runThreads(numThreads, [&](unsigned thread)
+		{
+			size_t* positions = &offsets[(size_t)thread * RADIX_SIZE];
+			size_t end = std::min(count, (thread + 1) * chunk);
+
+			for (size_t cnt = thread * chunk; cnt < end; cnt++)
+			{
+				size_t pos = positions[(keys[cnt] >> shift) &
+					(RADIX_SIZE - 1)]++;
+
+				key_tmp[pos] = keys[cnt];
+				value_tmp[pos] = values[cnt];
+			}
+		});
+
+		keys.swap(key_tmp);
+		values.swap(value_tmp);
+	}
+}
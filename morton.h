@@ -0,0 +1,26 @@
+/**
+ * \file morton.h
+ * \brief Morton (Z-order) codes and a parallel radix sort for putting
+ *	geometry in spatially coherent order.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _MORTON_
+#define _MORTON_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#define MORTON_BITS 21 //!< Bits per axis of a Morton code, so that all three
+	//!< interleave into 63 bits.
+
+uint64_t mortonCode(uint32_t x, uint32_t y, uint32_t z);
+
+void computeMortonCodes(const float* x, const float* y, const float* z,
+	size_t count, const float min[3], float scale, uint64_t* codes);
+
+void sortByKey(std::vector<uint64_t>& keys, std::vector<uint32_t>& values,
+	unsigned numThreads);
+
+#endif /* _MORTON_ */
@@ -0,0 +1,1243 @@
+/**
+ * \file offset.cpp
+ * \brief Offsetting of 2D polygons with holes, i.e. for laser kerf
+ *	compensation.
+ * \author Gregory Gluszek.
+ */
+
+#include "offset.h"
+
+#include <math.h>
+#include <algorithm>
+#include <unordered_map>
+
+#define OFFSET_DEFAULT_MITRE_LIMIT 2.0 //!< Default longest mitre, as a 
+	//!< multiple of offset distance.
+#define OFFSET_DEFAULT_ARC_TOLERANCE 0.01 //!< Default furthest round joins 
+	//!< can be from a true arc, as a fraction of offset distance.
+#define OFFSET_PARAM_EPSILON 1e-9 //!< Intersections this close to the end of
+	//!< an edge (as a fraction of its length) are taken to be at the end.
+#define OFFSET_EDGES_PER_CELL 2 //!< Grid is sized for about this many edges
+	//!< per cell.
+#define OFFSET_SNAP_RATIO 1e-10 //!< Points closer than this fraction of the
+	//!< size of the outline are merged.
+#define OFFSET_MERGE_RATIO 1e-5 //!< Input points closer than this fraction
+	//!< of the size of the input are merged before offsetting.
+#define OFFSET_PROBE_RATIO 1e-12 //!< How far to each side of an edge winding
+	//!< is sampled, as a fraction of the size of the outline.
+#define OFFSET_STAGE_EDGES 1 //!< Offsets are made in steps of about this 
+	//!< many times the average edge length of the loops being offset.
+#define OFFSET_MAX_STAGES 16 //!< Most steps an offset is split into.
+
+/**
+ * Constructor.
+ */
+Offsetter::Offsetter()
+: mitreLimit(OFFSET_DEFAULT_MITRE_LIMIT)
+, arcTolerance(OFFSET_DEFAULT_ARC_TOLERANCE)
+, columns(1)
+, rows(1)
+{
+	gridMin[0] = gridMin[1] = 0;
+	cellSize[0] = cellSize[1] = 1;
+}
+
+/**
+ * Set the longest a mitre join can be before it is squared off.
+ *
+ * \param limit Longest mitre as a multiple of offset distance. Values below
+ *	1 are treated as 1.
+ *
+ * \return None.
+ */
+void Offsetter::setMitreLimit(double limit)
+{
+	mitreLimit = std::max(1.0, limit);
+}
+
+/**
+ * Set how closely round joins follow a true arc. Input points closer than
+ *  this to the line through their neighbors are also dropped.
+ *
+ * \param tolerance Furthest join can be from arc, as a fraction of offset 
+ *	distance.
+ *
+ * \return None.
+ */
+void Offsetter::setArcTolerance(double tolerance)
+{
+	arcTolerance = std::min(0.5, std::max(1e-6, tolerance));
+}
+
+/**
+ * \return Mean length of the edges of a set of loops, 0 if there are none.
+ */
+static double averageEdgeLength(const std::vector<std::vector<double> >& loops)
+{
+	double len_sum = 0;
+	size_t num_edges = 0;
+
+	for (size_t loop = 0; loop < loops.size(); loop++)
+	{
+		const std::vector<double>& pts = loops[loop];
+		size_t num_pts = pts.size() / 2;
+
+		for (size_t cnt = 0; cnt < num_pts; cnt++)
+		{
+			size_t next = (cnt + 1) % num_pts;
+
+			len_sum += hypot(pts[2*next] - pts[2*cnt], 
+				pts[2*next + 1] - pts[2*cnt + 1]);
+		}
+		num_edges += num_pts;
+	}
+
+	return num_edges ? len_sum / (double)num_edges : 0;
+}
+
+/**
+ * Offset loops by a distance and merge the results into outlines that do not
+ *  cross themselves or each other. Distances much longer than the edges of 
+ *  the loops are covered in several steps. Each raw offset edge can cross 
+ *  every other one within twice the distance, so going a few edge lengths 
+ *  at a time fills in small detail early and keeps later steps cheap. This
+ *  is exact for round joins, while mitres cut short by the mitre limit are 
+ *  cut short at each step.
+ *
+ * \param[in] loops x, y pairs of each loop. Filled region must be on the left
+ *	of every loop.
+ * \param distance Distance to move edges. Positive grows the filled region,
+ *	negative shrinks it.
+ * \param join How to join edges around convex corners.
+ * \param[out] out x, y pairs of each resulting loop, with filled region on 
+ *	the left.
+ *
+ * \return None.
+ */
+void Offsetter::offset(const std::vector<std::vector<double> >& loops,
+	double distance, Join join, std::vector<std::vector<double> >& out)
+{
+	std::vector<std::vector<double> > current;
+	double remaining = fabs(distance);
+
+	for (int stages_left = OFFSET_MAX_STAGES; ; stages_left--)
+	{
+		const std::vector<std::vector<double> >& src = 
+			stages_left == OFFSET_MAX_STAGES ? loops : current;
+		double step = remaining;
+
+		if (stages_left > 1)
+			step = std::min(remaining, std::max(remaining / stages_left,
+				OFFSET_STAGE_EDGES * averageEdgeLength(src)));
+
+		if (step >= remaining)
+		{
+			offsetStep(src, copysign(remaining, distance), join, out);
+			return;
+		}
+
+		offsetStep(src, copysign(step, distance), join, out);
+		current.swap(out);
+		remaining -= step;
+	}
+}
+
+/**
+ * Offset loops by a distance in one step, see offset().
+ *
+ * \param[in] loops x, y pairs of each loop.
+ * \param distance Distance to move edges.
+ * \param join How to join edges around convex corners.
+ * \param[out] out x, y pairs of each resulting loop.
+ *
+ * \return None.
+ */
+void Offsetter::offsetStep(const std::vector<std::vector<double> >& loops,
+	double distance, Join join, std::vector<std::vector<double> >& out)
+{
+	nodes.clear();
+	edges.clear();
+	loopEnds.clear();
+	kept.clear();
+	out.clear();
+
+	mergeInputPoints(loops);
+
+	for (size_t cnt = 0; cnt < inputs.size(); cnt++)
+		addRawLoop(inputs[cnt], distance, join);
+
+	if (edges.empty())
+		return;
+
+	buildGrid();
+	buildCellWinding();
+	splitEdges();
+	chainLoops(out);
+}
+
+/**
+ * Group points that are almost on top of each other.
+ *
+ * \param[in] pts x, y pairs of points.
+ * \param numPts Number of points.
+ * \param ratio Points closer than this fraction of the size of the box 
+ *	around all of them, or of their distance from the origin if larger, 
+ *	along both axes, are grouped. Rounding errors grow with both.
+ * \param[out] canonical Index of the first point in each point's group.
+ *
+ * \return Size of box around all points.
+ */
+static double mergeClosePoints(const double* pts, size_t numPts, double ratio,
+	std::vector<uint32_t>& canonical)
+{
+	double min[2] = {INFINITY, INFINITY};
+	double max[2] = {-INFINITY, -INFINITY};
+
+	canonical.resize(numPts);
+	for (uint32_t cnt = 0; cnt < numPts; cnt++)
+	{
+		canonical[cnt] = cnt;
+
+		for (int axis = 0; axis < 2; axis++)
+		{
+			min[axis] = std::min(min[axis], pts[2*cnt + axis]);
+			max[axis] = std::max(max[axis], pts[2*cnt + axis]);
+		}
+	}
+
+	double extent = std::max(max[0] - min[0], max[1] - min[1]);
+	double tolerance = ratio * std::max(extent, std::max(
+		std::max(fabs(min[0]), fabs(max[0])), 
+		std::max(fabs(min[1]), fabs(max[1]))));
+
+	if (!(tolerance > 0))
+		return extent;
+
+	// Cells are as wide as the tolerance, so any point in range is in the
+	//  same or a neighboring cell. Each cell holds the first point to land
+	//  in it, since any later ones are close enough to group with it.
+	std::unordered_map<uint64_t, uint32_t> cells;
+
+	cells.reserve(numPts);
+
+	for (uint32_t cnt = 0; cnt < numPts; cnt++)
+	{
+		const double* pt = &pts[2*cnt];
+		int64_t col = (int64_t)floor((pt[0] - min[0]) / tolerance);
+		int64_t row = (int64_t)floor((pt[1] - min[1]) / tolerance);
+		bool found = false;
+
+		for (int64_t near_row = row - 1; !found && near_row <= row + 1;
+			near_row++)
+		{
+			for (int64_t near_col = col - 1; !found && 
+				near_col <= col + 1; near_col++)
+			{
+				std::unordered_map<uint64_t, uint32_t>::const_iterator 
+					it = cells.find((uint64_t)near_col << 32 ^ 
+					(uint64_t)near_row);
+
+				if (it == cells.end())
+					continue;
+
+				const double* other = &pts[2 * it->second];
+
+				if (fabs(other[0] - pt[0]) <= tolerance &&
+					fabs(other[1] - pt[1]) <= tolerance)
+				{
+					canonical[cnt] = it->second;
+					found = true;
+				}
+			}
+		}
+
+		if (!found)
+			cells[(uint64_t)col << 32 ^ (uint64_t)row] = cnt;
+	}
+
+	return extent;
+}
+
+/**
+ * Copy loops into inputs, moving points that are almost on top of each 
+ *  other onto the first of them. Loops that should share points (i.e. the
+ *  borders of neighboring faces) often miss by a rounding error, which 
+ *  would leave their offset edges almost but not quite on top of each 
+ *  other, too close together to tell which side of them is filled.
+ *
+ * \param[in] loops x, y pairs of each loop.
+ *
+ * \return None.
+ */
+void Offsetter::mergeInputPoints(const std::vector<std::vector<double> >& loops)
+{
+	std::vector<double> pts;
+	std::vector<uint32_t> canonical;
+
+	for (size_t loop = 0; loop < loops.size(); loop++)
+		pts.insert(pts.end(), loops[loop].begin(), loops[loop].begin() + 
+			(loops[loop].size() & ~(size_t)1));
+
+	mergeClosePoints(pts.data(), pts.size() / 2, OFFSET_MERGE_RATIO, 
+		canonical);
+
+	inputs.resize(loops.size());
+
+	for (size_t loop = 0, pt = 0; loop < loops.size(); loop++)
+	{
+		size_t num_pts = loops[loop].size() / 2;
+
+		inputs[loop].resize(2 * num_pts);
+		for (size_t cnt = 0; cnt < num_pts; cnt++, pt++)
+		{
+			inputs[loop][2*cnt] = pts[2 * canonical[pt]];
+			inputs[loop][2*cnt + 1] = pts[2 * canonical[pt] + 1];
+		}
+	}
+}
+
+/**
+ * \return Index of new node at the given point.
+ */
+uint32_t Offsetter::addNode(double x, double y)
+{
+	nodes.push_back(x);
+	nodes.push_back(y);
+
+	return (uint32_t)(nodes.size() / 2 - 1);
+}
+
+/**
+ * \return Squared distance from point p to segment from a to b.
+ */
+static double segmentDistance2(const double* p, const double* a, 
+	const double* b)
+{
+	double dx = b[0] - a[0], dy = b[1] - a[1];
+	double len2 = dx * dx + dy * dy;
+	double t = len2 > 0 ? ((p[0] - a[0]) * dx + (p[1] - a[1]) * dy) / len2 : 0;
+
+	t = std::min(1.0, std::max(0.0, t));
+	dx = a[0] + t * dx - p[0];
+	dy = a[1] + t * dy - p[1];
+
+	return dx * dx + dy * dy;
+}
+
+/**
+ * Drop points of a loop that are within tolerance of the line through the
+ *  points either side (Douglas-Peucker). Mesh borders often have many 
+ *  nearly collinear points, and zig-zags much smaller than the offset 
+ *  distance would otherwise each leave a reversed loop to be cleaned up.
+ *
+ * \param[in] loop x, y pairs of loop.
+ * \param tolerance Furthest a dropped point can be from the result.
+ * \param[out] out x, y pairs of points kept.
+ *
+ * \return None.
+ */
+static void simplifyLoop(const std::vector<double>& loop, double tolerance,
+	std::vector<double>& out)
+{
+	size_t num_pts = loop.size() / 2;
+	std::vector<uint8_t> keep(num_pts, 0);
+	std::vector<std::pair<size_t, size_t> > stack;
+	size_t far = 0;
+	double far_dist = -1;
+
+	out.clear();
+	if (num_pts < 4)
+	{
+		out = loop;
+		return;
+	}
+
+	// Split closed loop into two chains at the point furthest from the 
+	//  first. Chain end num_pts wraps back to point 0.
+	for (size_t cnt = 1; cnt < num_pts; cnt++)
+	{
+		double dx = loop[2*cnt] - loop[0], dy = loop[2*cnt + 1] - loop[1];
+
+		if (dx * dx + dy * dy > far_dist)
+		{
+			far_dist = dx * dx + dy * dy;
+			far = cnt;
+		}
+	}
+
+	keep[0] = keep[far] = 1;
+	stack.push_back(std::make_pair((size_t)0, far));
+	stack.push_back(std::make_pair(far, num_pts));
+
+	while (!stack.empty())
+	{
+		size_t first = stack.back().first;
+		size_t last = stack.back().second;
+		double max_dist = tolerance * tolerance;
+		size_t split = 0;
+
+		stack.pop_back();
+
+		for (size_t cnt = first + 1; cnt < last; cnt++)
+		{
+			double dist = segmentDistance2(&loop[2*cnt], &loop[2*first],
+				&loop[2 * (last % num_pts)]);
+
+			if (dist > max_dist)
+			{
+				max_dist = dist;
+				split = cnt;
+			}
+		}
+
+		if (!split)
+			continue;
+
+		keep[split] = 1;
+		stack.push_back(std::make_pair(first, split));
+		stack.push_back(std::make_pair(split, last));
+	}
+
+	for (size_t cnt = 0; cnt < num_pts; cnt++)
+	{
+		if (!keep[cnt])
+			continue;
+
+		out.push_back(loop[2*cnt]);
+		out.push_back(loop[2*cnt + 1]);
+	}
+}
+
+/**
+ * Add edges of a single loop moved out by distance, with joins at corners.
+ *  Concave corners are joined through the original point, which leaves a
+ *  small reversed loop that splitEdges() removes.
+ *
+ * \param[in] loop x, y pairs of loop.
+ * \param distance Offset distance.
+ * \param join Join type for convex corners.
+ *
+ * \return None.
+ */
+void Offsetter::addRawLoop(const std::vector<double>& loop, double distance,
+	Join join)
+{
+	std::vector<double> simple;
+	std::vector<double> pts;
+	std::vector<double> dirs;
+	std::vector<double> lens;
+
+	simplifyLoop(loop, arcTolerance * fabs(distance), simple);
+
+	// Repeated points have no direction
+	for (size_t cnt = 0; cnt + 1 < simple.size(); cnt += 2)
+	{
+		size_t num = pts.size();
+
+		if (num && pts[num - 2] == simple[cnt] && 
+			pts[num - 1] == simple[cnt + 1])
+			continue;
+
+		pts.push_back(simple[cnt]);
+		pts.push_back(simple[cnt + 1]);
+	}
+
+	while (pts.size() > 2 && pts[0] == pts[pts.size() - 2] && 
+		pts[1] == pts[pts.size() - 1])
+		pts.resize(pts.size() - 2);
+
+	size_t num_pts = pts.size() / 2;
+
+	if (num_pts < 3)
+		return;
+
+	dirs.resize(2 * num_pts);
+	lens.resize(num_pts);
+	for (size_t cnt = 0; cnt < num_pts; cnt++)
+	{
+		size_t next = (cnt + 1) % num_pts;
+		double dx = pts[2*next] - pts[2*cnt];
+		double dy = pts[2*next + 1] - pts[2*cnt + 1];
+		double len = sqrt(dx * dx + dy * dy);
+
+		dirs[2*cnt] = dx / len;
+		dirs[2*cnt + 1] = dy / len;
+		lens[cnt] = len;
+	}
+
+	uint32_t first = (uint32_t)(nodes.size() / 2);
+
+	// Each join ends where the offset of the edge leaving its point starts
+	for (size_t cnt = 0; cnt < num_pts; cnt++)
+	{
+		size_t prev = (cnt + num_pts - 1) % num_pts;
+
+		addJoin(pts[2*cnt], pts[2*cnt + 1], &dirs[2*prev], &dirs[2*cnt],
+			std::min(lens[prev], lens[cnt]), distance, join);
+	}
+
+	uint32_t last = (uint32_t)(nodes.size() / 2);
+
+	for (uint32_t node = first; node < last; node++)
+	{
+		Edge edge;
+
+		edge.from = node;
+		edge.to = node + 1 < last ? node + 1 : first;
+		edges.push_back(edge);
+	}
+
+	loopEnds.push_back((uint32_t)edges.size());
+}
+
+/**
+ * Add the points joining the offsets of two edges that meet at a point.
+ *
+ * \param px Point edges meet at.
+ * \param py
+ * \param[in] prev Unit direction of edge ending at point.
+ * \param[in] cur Unit direction of edge starting at point.
+ * \param minLen Length of shorter of the two edges.
+ * \param distance Offset distance.
+ * \param join Join type for convex corners.
+ *
+ * \return None.
+ */
+void Offsetter::addJoin(double px, double py, const double prev[2],
+	const double cur[2], double minLen, double distance, Join join)
+{
+	double side = distance < 0 ? -1 : 1;
+	double dist = fabs(distance);
+	// Unit normals pointing to the side edges are moved to
+	double prev_norm[2] = {side * prev[1], -side * prev[0]};
+	double cur_norm[2] = {side * cur[1], -side * cur[0]};
+	double cross = prev[0] * cur[1] - prev[1] * cur[0];
+	double dot = prev[0] * cur[0] + prev[1] * cur[1];
+
+	// Straight on
+	if (fabs(cross) < 1e-12 && dot > 0)
+	{
+		addNode(px + cur_norm[0] * dist, py + cur_norm[1] * dist);
+		return;
+	}
+
+	// Offsets of the two edges cross each other. Where they cross within
+	//  both edges, that is the corner. Otherwise go back through the 
+	//  original point, leaving a reversed loop for splitEdges() to remove.
+	if (cross * side < 0 && dot > -1 + 1e-12)
+	{
+		double inner[2] = {prev_norm[0] + cur_norm[0], 
+			prev_norm[1] + cur_norm[1]};
+		double cos_half = sqrt((1 + dot) / 2);
+		double sin_half = sqrt((1 - dot) / 2);
+		double inner_len = sqrt(inner[0] * inner[0] + inner[1] * inner[1]);
+
+		// Distance from original point to crossing, along each edge.
+		//  Edges can be cut back from both ends, so only half each.
+		if (2 * dist * sin_half < minLen * cos_half)
+		{
+			addNode(px + inner[0] / inner_len * dist / cos_half,
+				py + inner[1] / inner_len * dist / cos_half);
+			return;
+		}
+
+		addNode(px + prev_norm[0] * dist, py + prev_norm[1] * dist);
+		addNode(px, py);
+		addNode(px + cur_norm[0] * dist, py + cur_norm[1] * dist);
+		return;
+	}
+
+	if (join == JOIN_ROUND)
+	{
+		double angle = atan2(prev_norm[0] * cur_norm[1] - 
+			prev_norm[1] * cur_norm[0], prev_norm[0] * cur_norm[0] + 
+			prev_norm[1] * cur_norm[1]);
+		double step = 2 * acos(1 - arcTolerance);
+
+		// Turns away from the offset side, and a full reversal is
+		//  half a turn around the end of the edge
+		if (angle * side <= 0)
+			angle += side * 2 * M_PI;
+
+		int num_steps = (int)ceil(fabs(angle) / step);
+
+		// A mitre is already within tolerance of the arc
+		if (num_steps <= 1 && fabs(angle) < M_PI / 2)
+		{
+			double mitre[2] = {prev_norm[0] + cur_norm[0], 
+				prev_norm[1] + cur_norm[1]};
+			double scale = 2 * dist / (mitre[0] * mitre[0] + 
+				mitre[1] * mitre[1]);
+
+			addNode(px + mitre[0] * scale, py + mitre[1] * scale);
+			return;
+		}
+
+		for (int cnt = 0; cnt <= num_steps; cnt++)
+		{
+			double theta = angle * cnt / num_steps;
+			double cos_theta = cos(theta);
+			double sin_theta = sin(theta);
+
+			addNode(px + (prev_norm[0] * cos_theta - prev_norm[1] * 
+				sin_theta) * dist, py + (prev_norm[0] * sin_theta + 
+				prev_norm[1] * cos_theta) * dist);
+		}
+
+		return;
+	}
+
+	// Mitre points along the bisector of the normals, or straight ahead
+	//  if the edge doubles back on itself
+	double mitre[2] = {prev_norm[0] + cur_norm[0], prev_norm[1] + cur_norm[1]};
+	double mitre_len = sqrt(mitre[0] * mitre[0] + mitre[1] * mitre[1]);
+
+	if (mitre_len < 1e-12)
+	{
+		mitre[0] = prev[0];
+		mitre[1] = prev[1];
+	}
+	else
+	{
+		mitre[0] /= mitre_len;
+		mitre[1] /= mitre_len;
+	}
+
+	double cos_half = prev_norm[0] * mitre[0] + prev_norm[1] * mitre[1];
+
+	if (cos_half * mitreLimit >= 1)
+	{
+		addNode(px + mitre[0] * dist / cos_half, 
+			py + mitre[1] * dist / cos_half);
+		return;
+	}
+
+	// Square off mitre where it reaches the limit
+	double limit = mitreLimit * dist - cos_half * dist;
+	double prev_along = prev[0] * mitre[0] + prev[1] * mitre[1];
+	double cur_along = -(cur[0] * mitre[0] + cur[1] * mitre[1]);
+
+	if (prev_along < 1e-12 || cur_along < 1e-12)
+	{
+		addNode(px + prev_norm[0] * dist, py + prev_norm[1] * dist);
+		addNode(px + cur_norm[0] * dist, py + cur_norm[1] * dist);
+		return;
+	}
+
+	addNode(px + prev_norm[0] * dist + prev[0] * limit / prev_along,
+		py + prev_norm[1] * dist + prev[1] * limit / prev_along);
+	addNode(px + cur_norm[0] * dist - cur[0] * limit / cur_along,
+		py + cur_norm[1] * dist - cur[1] * limit / cur_along);
+}
+
+/**
+ * Sort edges into a uniform grid by their bounding boxes.
+ *
+ * \return None.
+ */
+void Offsetter::buildGrid()
+{
+	double max[2] = {-INFINITY, -INFINITY};
+	double extent[2];
+
+	gridMin[0] = gridMin[1] = INFINITY;
+	for (size_t cnt = 0; cnt + 1 < nodes.size(); cnt += 2)
+	{
+		for (int axis = 0; axis < 2; axis++)
+		{
+			gridMin[axis] = std::min(gridMin[axis], nodes[cnt + axis]);
+			max[axis] = std::max(max[axis], nodes[cnt + axis]);
+		}
+	}
+
+	// Square cells, about OFFSET_EDGES_PER_CELL edges each
+	extent[0] = std::max(max[0] - gridMin[0], 1e-300);
+	extent[1] = std::max(max[1] - gridMin[1], 1e-300);
+	double cell = sqrt(extent[0] * extent[1] * OFFSET_EDGES_PER_CELL / 
+		(double)edges.size());
+
+	columns = (int)std::min(4096.0, std::max(1.0, ceil(extent[0] / cell)));
+	rows = (int)std::min(4096.0, std::max(1.0, ceil(extent[1] / cell)));
+	cellSize[0] = extent[0] / columns;
+	cellSize[1] = extent[1] / rows;
+
+	cellOffsets.assign((size_t)columns * rows + 1, 0);
+
+	// Count, then fill, edges in each cell
+	for (int pass = 0; pass < 2; pass++)
+	{
+		std::vector<uint32_t> fill;
+
+		if (pass)
+		{
+			for (size_t cnt = 1; cnt < cellOffsets.size(); cnt++)
+				cellOffsets[cnt] += cellOffsets[cnt - 1];
+			cellEdges.resize(cellOffsets.back());
+			fill.assign(cellOffsets.begin(), cellOffsets.end() - 1);
+		}
+
+		for (uint32_t cnt = 0; cnt < edges.size(); cnt++)
+		{
+			const double* from = &nodes[2*edges[cnt].from];
+			const double* to = &nodes[2*edges[cnt].to];
+			int col_end = getColumn(std::max(from[0], to[0]));
+			int row_end = getRow(std::max(from[1], to[1]));
+
+			for (int row = getRow(std::min(from[1], to[1])); 
+				row <= row_end; row++)
+			{
+				for (int col = getColumn(std::min(from[0], to[0])); 
+					col <= col_end; col++)
+				{
+					size_t cell = (size_t)row * columns + col;
+
+					if (pass)
+						cellEdges[fill[cell]++] = cnt;
+					else
+						cellOffsets[cell + 1]++;
+				}
+			}
+		}
+	}
+}
+
+/**
+ * \return Grid column containing x, clamped to the grid.
+ */
+int Offsetter::getColumn(double x) const
+{
+	double col = floor((x - gridMin[0]) / cellSize[0]);
+
+	if (!(col > 0))
+		return 0;
+
+	return (int)std::min(col, (double)columns - 1);
+}
+
+/**
+ * \return Grid row containing y, clamped to the grid.
+ */
+int Offsetter::getRow(double y) const
+{
+	double row = floor((y - gridMin[1]) / cellSize[1]);
+
+	if (!(row > 0))
+		return 0;
+
+	return (int)std::min(row, (double)rows - 1);
+}
+
+/**
+ * Split edges wherever they cross, then keep the pieces that have filled
+ *  region (winding number above zero) on their left and none on their 
+ *  right. These are the border of the union of all offset loops.
+ *
+ * \return None.
+ */
+void Offsetter::splitEdges()
+{
+	std::vector<Edge> pieces;
+	// Ends of different edges that meet, to be merged into one node
+	std::vector<Edge> joins;
+
+	splits.assign(edges.size(), std::vector<Split>());
+
+	for (size_t cell = 0; cell + 1 < cellOffsets.size(); cell++)
+	{
+		const uint32_t* list = &cellEdges[cellOffsets[cell]];
+		size_t list_size = cellOffsets[cell + 1] - cellOffsets[cell];
+
+		for (size_t first = 0; first < list_size; first++)
+		{
+			const Edge& edge_a = edges[list[first]];
+			const double* a0 = &nodes[2*edge_a.from];
+			const double* a1 = &nodes[2*edge_a.to];
+
+			for (size_t second = first + 1; second < list_size; 
+				second++)
+			{
+				const Edge& edge_b = edges[list[second]];
+				const double* b0 = &nodes[2*edge_b.from];
+				const double* b1 = &nodes[2*edge_b.to];
+
+				if (edge_a.from == edge_b.from || 
+					edge_a.from == edge_b.to ||
+					edge_a.to == edge_b.from || 
+					edge_a.to == edge_b.to)
+					continue;
+
+				if (std::max(a0[0], a1[0]) < std::min(b0[0], b1[0]) ||
+					std::max(b0[0], b1[0]) < std::min(a0[0], a1[0]) ||
+					std::max(a0[1], a1[1]) < std::min(b0[1], b1[1]) ||
+					std::max(b0[1], b1[1]) < std::min(a0[1], a1[1]))
+					continue;
+
+				double ax = a1[0] - a0[0], ay = a1[1] - a0[1];
+				double bx = b1[0] - b0[0], by = b1[1] - b0[1];
+				double qx = b0[0] - a0[0], qy = b0[1] - a0[1];
+				double denom = ax * by - ay * bx;
+
+				// Parallel edges are left unsplit
+				if (fabs(denom) <= 1e-12 * sqrt((ax * ax + ay * ay) *
+					(bx * bx + by * by)))
+					continue;
+
+				double t = (qx * by - qy * bx) / denom;
+				double u = (qx * ay - qy * ax) / denom;
+
+				if (t < -OFFSET_PARAM_EPSILON || 
+					t > 1 + OFFSET_PARAM_EPSILON ||
+					u < -OFFSET_PARAM_EPSILON || 
+					u > 1 + OFFSET_PARAM_EPSILON)
+					continue;
+
+				double x = a0[0] + t * ax;
+				double y = a0[1] + t * ay;
+
+				// Edges share every cell their crossing could be
+				//  in, so only record it in one
+				if ((size_t)getRow(y) * columns + getColumn(x) != cell)
+					continue;
+
+				bool t_end = t <= OFFSET_PARAM_EPSILON || 
+					t >= 1 - OFFSET_PARAM_EPSILON;
+				bool u_end = u <= OFFSET_PARAM_EPSILON || 
+					u >= 1 - OFFSET_PARAM_EPSILON;
+				uint32_t node;
+
+				if (t_end && u_end)
+				{
+					Edge join;
+
+					join.from = t < 0.5 ? edge_a.from : edge_a.to;
+					join.to = u < 0.5 ? edge_b.from : edge_b.to;
+					joins.push_back(join);
+					continue;
+				}
+				else if (t_end)
+					node = t < 0.5 ? edge_a.from : edge_a.to;
+				else if (u_end)
+					node = u < 0.5 ? edge_b.from : edge_b.to;
+				else
+					node = addNode(x, y);
+
+				// addNode() may have moved nodes
+				a0 = &nodes[2*edge_a.from];
+				a1 = &nodes[2*edge_a.to];
+
+				if (!t_end)
+				{
+					Split split = {t, node};
+					splits[list[first]].push_back(split);
+				}
+
+				if (!u_end)
+				{
+					Split split = {u, node};
+					splits[list[second]].push_back(split);
+				}
+			}
+		}
+	}
+
+	// Merge points that ended up in the same place
+	std::vector<uint32_t> canonical;
+	double extent = mergeClosePoints(nodes.data(), nodes.size() / 2, 
+		OFFSET_SNAP_RATIO, canonical);
+
+	// Every group is led by its lowest node, so joining groups means 
+	//  pointing the higher leader at the lower one
+	for (size_t cnt = 0; cnt < joins.size(); cnt++)
+	{
+		uint32_t lhs = joins[cnt].from;
+		uint32_t rhs = joins[cnt].to;
+
+		while (canonical[lhs] != lhs)
+			lhs = canonical[lhs];
+		while (canonical[rhs] != rhs)
+			rhs = canonical[rhs];
+
+		canonical[std::max(lhs, rhs)] = std::min(lhs, rhs);
+	}
+
+	for (uint32_t node = 0; node < canonical.size(); node++)
+		canonical[node] = canonical[canonical[node]];
+
+	// Start of each raw loop's pieces, plus one extra entry marking the end
+	std::vector<size_t> loop_pieces(1, 0);
+	// Raw edge each piece is part of, and how far along it its middle is
+	std::vector<uint32_t> piece_edges;
+	std::vector<double> piece_mids;
+	size_t loop = 0;
+
+	for (size_t cnt = 0; cnt < edges.size(); cnt++)
+	{
+		std::vector<Split>& list = splits[cnt];
+		uint32_t from = canonical[edges[cnt].from];
+
+		if (cnt == loopEnds[loop])
+		{
+			loop_pieces.push_back(pieces.size());
+			loop++;
+		}
+
+		std::sort(list.begin(), list.end(), 
+			[](const Split& lhs, const Split& rhs)
+			{
+				return lhs.t < rhs.t;
+			});
+
+		double from_t = 0;
+
+		for (size_t split = 0; split <= list.size(); split++)
+		{
+			Edge piece;
+			double to_t = split < list.size() ? list[split].t : 1;
+
+			piece.from = from;
+			piece.to = canonical[split < list.size() ? list[split].node :
+				edges[cnt].to];
+
+			if (piece.from != piece.to)
+			{
+				pieces.push_back(piece);
+				piece_edges.push_back((uint32_t)cnt);
+				piece_mids.push_back((from_t + to_t) / 2);
+			}
+
+			from = piece.to;
+			from_t = to_t;
+		}
+	}
+
+	loop_pieces.push_back(pieces.size());
+
+	// Winding on either side of a loop can only change where another edge
+	//  meets it, so it only needs testing once per run of pieces between
+	//  such points. The longest piece of each run is tested, since short
+	//  ones next to crossings are where near coincident edges can put the
+	//  sample on the wrong side.
+	std::vector<uint8_t> degree(canonical.size(), 0);
+	double probe = extent > 0 ? extent * OFFSET_PROBE_RATIO : 1e-9;
+
+	for (size_t cnt = 0; cnt < pieces.size(); cnt++)
+	{
+		degree[pieces[cnt].from] = (uint8_t)std::min(3, 
+			degree[pieces[cnt].from] + 1);
+		degree[pieces[cnt].to] = (uint8_t)std::min(3, 
+			degree[pieces[cnt].to] + 1);
+	}
+
+	for (size_t loop_cnt = 0; loop_cnt + 1 < loop_pieces.size(); loop_cnt++)
+	{
+		size_t begin = loop_pieces[loop_cnt];
+		size_t num = loop_pieces[loop_cnt + 1] - begin;
+		size_t first = 0;
+
+		while (first < num && degree[pieces[begin + first].from] <= 2)
+			first++;
+		if (first == num)
+			first = 0;
+
+		size_t step = 0;
+		while (step < num)
+		{
+			size_t run_end = step + 1;
+			while (run_end < num && degree[pieces[begin + 
+				(first + run_end) % num].from] <= 2)
+				run_end++;
+
+			size_t longest = begin + (first + step) % num;
+			double longest_len2 = -1;
+			for (size_t cnt = step; cnt < run_end; cnt++)
+			{
+				size_t index = begin + (first + cnt) % num;
+				const double* from = &nodes[2*pieces[index].from];
+				const double* to = &nodes[2*pieces[index].to];
+				double dx = to[0] - from[0], dy = to[1] - from[1];
+				if (dx * dx + dy * dy > longest_len2)
+				{
+					longest_len2 = dx * dx + dy * dy;
+					longest = index;
+				}
+			}
+
+			// Sampled beside the raw edge rather than the piece, since
+			//  snapping can move piece ends to the wrong side of 
+			//  edges almost on top of this one
+			const Edge& edge = edges[piece_edges[longest]];
+			const double* from = &nodes[2*edge.from];
+			const double* to = &nodes[2*edge.to];
+			double dx = to[0] - from[0], dy = to[1] - from[1];
+			double len = sqrt(dx * dx + dy * dy);
+			double offset = std::min(len * 0.01, probe) / len;
+			double mid_x = from[0] + dx * piece_mids[longest];
+			double mid_y = from[1] + dy * piece_mids[longest];
+
+			// Right of edge is (dy, -dx)
+			bool keep = winding(mid_x + dy * offset, 
+				mid_y - dx * offset) == 0 &&
+				winding(mid_x - dy * offset, 
+				mid_y + dx * offset) > 0;
+
+			if (keep)
+			{
+				for (size_t cnt = step; cnt < run_end; cnt++)
+					kept.push_back(pieces[begin + 
+						(first + cnt) % num]);
+			}
+			step = run_end;
+		}
+	}
+
+	// Edges of different loops snapped on top of each other going the same
+	//  way are both kept, only one is needed
+	std::sort(kept.begin(), kept.end(), 
+		[](const Edge& lhs, const Edge& rhs)
+		{
+			return lhs.from < rhs.from || 
+				(lhs.from == rhs.from && lhs.to < rhs.to);
+		});
+	kept.erase(std::unique(kept.begin(), kept.end(), 
+		[](const Edge& lhs, const Edge& rhs)
+		{
+			return lhs.from == rhs.from && lhs.to == rhs.to;
+		}), kept.end());
+}
+
+/**
+ * Find where an edge crosses a horizontal line. Points on the line count as
+ *  being below it.
+ *
+ * \param[in] from Start of edge.
+ * \param[in] to End of edge.
+ * \param y Height of line.
+ * \param[out] crossX Where edge crosses line.
+ *
+ * \return 1 if edge crosses line going up, -1 going down, 0 if it does not.
+ */
+static int crossHorizontal(const double* from, const double* to, double y,
+	double& crossX)
+{
+	int dir;
+
+	if (from[1] <= y && to[1] > y)
+		dir = 1;
+	else if (to[1] <= y && from[1] > y)
+		dir = -1;
+	else
+		return 0;
+
+	crossX = from[0] + (y - from[1]) * (to[0] - from[0]) / (to[1] - from[1]);
+	crossX = std::min(std::max(crossX, std::min(from[0], to[0])), 
+		std::max(from[0], to[0]));
+
+	return dir;
+}
+
+/**
+ * Find where an edge crosses a vertical line. Points on the line count as 
+ *  being left of it.
+ *
+ * \param[in] from Start of edge.
+ * \param[in] to End of edge.
+ * \param x Position of line.
+ * \param[out] crossY Where edge crosses line.
+ *
+ * \return 1 if edge crosses line going right, -1 going left, 0 if it does 
+ *	not.
+ */
+static int crossVertical(const double* from, const double* to, double x,
+	double& crossY)
+{
+	int dir;
+
+	if (from[0] <= x && to[0] > x)
+		dir = 1;
+	else if (to[0] <= x && from[0] > x)
+		dir = -1;
+	else
+		return 0;
+
+	crossY = from[1] + (x - from[0]) * (to[1] - from[1]) / (to[0] - from[0]);
+	crossY = std::min(std::max(crossY, std::min(from[1], to[1])), 
+		std::max(from[1], to[1]));
+
+	return dir;
+}
+
+/**
+ * Find the winding number at the center of every grid cell, with one sweep
+ *  from right to left along each row.
+ *
+ * \return None.
+ */
+void Offsetter::buildCellWinding()
+{
+	cellWinding.assign((size_t)columns * rows, 0);
+
+	for (int row = 0; row < rows; row++)
+	{
+		double y = gridMin[1] + (row + 0.5) * cellSize[1];
+		int right = 0;
+
+		for (int col = columns - 1; col >= 0; col--)
+		{
+			size_t cell = (size_t)row * columns + col;
+			double center_x = gridMin[0] + (col + 0.5) * cellSize[0];
+			int wind = right;
+
+			for (uint32_t entry = cellOffsets[cell]; 
+				entry < cellOffsets[cell + 1]; entry++)
+			{
+				const Edge& edge = edges[cellEdges[entry]];
+				double cross_x;
+				int dir = crossHorizontal(&nodes[2*edge.from], 
+					&nodes[2*edge.to], y, cross_x);
+
+				// Edges can span several cells, only count the 
+				//  crossing in the cell it is in
+				if (!dir || getColumn(cross_x) != col)
+					continue;
+
+				right += dir;
+				if (cross_x > center_x)
+					wind += dir;
+			}
+
+			cellWinding[cell] = wind;
+		}
+	}
+}
+
+/**
+ * \return Winding number of offset loops around a point. Found from the 
+ *	winding at the center of the point's cell, plus edges crossed going
+ *	straight across and then straight up or down to the center.
+ */
+int Offsetter::winding(double x, double y) const
+{
+	int row = getRow(y);
+	int col = getColumn(x);
+	size_t cell = (size_t)row * columns + col;
+	double center_x = gridMin[0] + (col + 0.5) * cellSize[0];
+	double center_y = gridMin[1] + (row + 0.5) * cellSize[1];
+	double min_x = std::min(x, center_x), max_x = std::max(x, center_x);
+	double min_y = std::min(y, center_y), max_y = std::max(y, center_y);
+	int wind = cellWinding[cell];
+
+	for (uint32_t entry = cellOffsets[cell]; entry < cellOffsets[cell + 1]; 
+		entry++)
+	{
+		const double* from = &nodes[2*edges[cellEdges[entry]].from];
+		const double* to = &nodes[2*edges[cellEdges[entry]].to];
+		double cross;
+		int dir = crossHorizontal(from, to, y, cross);
+
+		// Edges going up are on the right of the filled region
+		if (dir && cross > min_x && cross <= max_x)
+			wind += x < center_x ? dir : -dir;
+
+		dir = crossVertical(from, to, center_x, cross);
+
+		// Edges going right are on the bottom of the filled region
+		if (dir && cross > min_y && cross <= max_y)
+			wind += y < center_y ? -dir : dir;
+	}
+
+	return wind;
+}
+
+/**
+ * Join kept edges end to end into loops.
+ *
+ * \param[out] out x, y pairs of each loop.
+ *
+ * \return None.
+ */
+void Offsetter::chainLoops(std::vector<std::vector<double> >& out)
+{
+	size_t num_nodes = nodes.size() / 2;
+	// Kept edges leaving each node, grouped by node
+	std::vector<uint32_t> offsets(num_nodes + 1, 0);
+	std::vector<uint32_t> outgoing(kept.size());
+	std::vector<uint8_t> used(kept.size(), 0);
+	double extent = std::max(cellSize[0] * columns, cellSize[1] * rows);
+	double minArea = extent * OFFSET_MERGE_RATIO * extent * 
+		OFFSET_MERGE_RATIO;
+
+	for (size_t cnt = 0; cnt < kept.size(); cnt++)
+		offsets[kept[cnt].from + 1]++;
+	for (size_t node = 0; node < num_nodes; node++)
+		offsets[node + 1] += offsets[node];
+	{
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+
+		for (uint32_t cnt = 0; cnt < kept.size(); cnt++)
+			outgoing[fill[kept[cnt].from]++] = cnt;
+	}
+
+	for (uint32_t first = 0; first < kept.size(); first++)
+	{
+		std::vector<double> loop;
+		uint32_t edge = first;
+		double area = 0;
+
+		if (used[first])
+			continue;
+
+		while (true)
+		{
+			uint32_t node = kept[edge].to;
+			uint32_t next = offsets[node];
+
+			used[edge] = 1;
+			loop.push_back(nodes[2*kept[edge].from]);
+			loop.push_back(nodes[2*kept[edge].from + 1]);
+
+			if (node == kept[first].from)
+				break;
+
+			while (next < offsets[node + 1] && used[outgoing[next]])
+				next++;
+
+			// Only happens if rounding broke up the border. Loop is
+			//  closed with a straight edge.
+			if (next == offsets[node + 1])
+				break;
+
+			edge = outgoing[next];
+		}
+
+		// Splitting leaves points partway along straight edges
+		std::vector<double> simple;
+		size_t num_pts = loop.size() / 2;
+
+		for (size_t cnt = 0; cnt < num_pts; cnt++)
+		{
+			const double* prev = &loop[2 * ((cnt + num_pts - 1) % num_pts)];
+			const double* pt = &loop[2*cnt];
+			const double* next = &loop[2 * ((cnt + 1) % num_pts)];
+			double ax = pt[0] - prev[0], ay = pt[1] - prev[1];
+			double bx = next[0] - pt[0], by = next[1] - pt[1];
+			double cross = ax * by - ay * bx;
+
+			if (fabs(cross) <= 1e-12 * sqrt((ax * ax + ay * ay) * 
+				(bx * bx + by * by)) && ax * bx + ay * by > 0)
+				continue;
+
+			simple.push_back(pt[0]);
+			simple.push_back(pt[1]);
+		}
+
+		num_pts = simple.size() / 2;
+		for (size_t cnt = 0, prev = num_pts - 1; cnt < num_pts; 
+			prev = cnt++)
+			area += simple[2*prev] * simple[2*cnt + 1] - 
+				simple[2*cnt] * simple[2*prev + 1];
+
+		// Slivers left where rounding put edges on top of each other
+		if (num_pts >= 3 && fabs(area) > 2 * minArea)
+			out.push_back(simple);
+	}
+}
@@ -0,0 +1,114 @@
+/**
+ * \file offset.h
+ * \brief Offsetting of 2D polygons with holes, i.e. for laser kerf
+ *	compensation.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _OFFSET_
+#define _OFFSET_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/**
+ * Grows (or shrinks) a set of loops by a fixed distance. Loops must have the
+ *  filled region on their left, i.e. counter clockwise outer borders and
+ *  clockwise holes, so growing moves outer borders out and holes in. Loops 
+ *  are offset edge by edge and then merged, so overlapping loops (i.e. 
+ *  faces of a net sharing fold edges) come out as one outline and any self
+ *  intersections the offset creates are removed.
+ *
+ * Not thread safe, but separate instances can be used on separate threads.
+ */
+class Offsetter
+{
+public:
+	/**
+	 * How offset edges are joined around convex corners.
+	 */
+	enum Join
+	{
+		JOIN_MITRE = 0, //!< Extend edges until they meet, up to the
+			//!< mitre limit.
+		JOIN_ROUND //!< Circular arc around the corner.
+	};
+
+	Offsetter();
+
+	void setMitreLimit(double limit);
+	void setArcTolerance(double tolerance);
+
+	void offset(const std::vector<std::vector<double> >& loops,
+		double distance, Join join,
+		std::vector<std::vector<double> >& out);
+
+private:
+	/**
+	 * Straight edge between two nodes.
+	 */
+	struct Edge
+	{
+		uint32_t from; //!< Index into nodes of start point.
+		uint32_t to; //!< Index into nodes of end point.
+	};
+
+	/**
+	 * Point where an edge is split, at parameter t along it.
+	 */
+	struct Split
+	{
+		double t;
+		uint32_t node;
+	};
+
+	void offsetStep(const std::vector<std::vector<double> >& loops,
+		double distance, Join join,
+		std::vector<std::vector<double> >& out);
+	void mergeInputPoints(const std::vector<std::vector<double> >& loops);
+	uint32_t addNode(double x, double y);
+	void addRawLoop(const std::vector<double>& loop, double distance,
+		Join join);
+	void addJoin(double px, double py, const double prev[2],
+		const double cur[2], double minLen, double distance, Join join);
+	void buildGrid();
+	void buildCellWinding();
+	int getColumn(double x) const;
+	int getRow(double y) const;
+	void splitEdges();
+	int winding(double x, double y) const;
+	void chainLoops(std::vector<std::vector<double> >& out);
+
+	double mitreLimit; //!< Longest a mitre can be, as a multiple of the
+		//!< offset distance. Longer ones are squared off.
+	double arcTolerance; //!< Furthest round joins can be from a true arc,
+		//!< as a fraction of the offset distance. Also how far input
+		//!< points can be moved by simplification.
+
+	std::vector<std::vector<double> > inputs; //!< Loops being offset, with
+		//!< points that are almost in the same place merged.
+	std::vector<double> nodes; //!< x, y of each point.
+	std::vector<Edge> edges; //!< Edges of raw offset loops, then edges 
+		//!< split where they cross each other.
+	std::vector<uint32_t> loopEnds; //!< One past the last of each raw 
+		//!< loop's edges in edges.
+	std::vector<std::vector<Split> > splits; //!< Where each raw edge 
+		//!< crosses another.
+	std::vector<Edge> kept; //!< Split edges on the border of the filled
+		//!< region.
+
+	double gridMin[2]; //!< Minimum corner of grid.
+	double cellSize[2]; //!< Width and height of each grid cell.
+	int columns; //!< Number of grid cells across.
+	int rows; //!< Number of grid cells down.
+	std::vector<uint32_t> cellOffsets; //!< Start of each cell's entries in
+		//!< cellEdges, row by row, plus one extra entry marking the end.
+	std::vector<uint32_t> cellEdges; //!< Index into edges of every edge
+		//!< whose bounding box overlaps each cell, grouped by cell. Keeps
+		//!< intersection and winding tests to nearby edges.
+	std::vector<int> cellWinding; //!< Winding number at the center of each
+		//!< cell, so that winding() only needs to look at one cell.
+};
+
+#endif /* _OFFSET_ */
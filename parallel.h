@@ -0,0 +1,50 @@
+/**
+ * \file parallel.h
+ * \brief Helpers for splitting work across threads.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _PARALLEL_
+#define _PARALLEL_
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/**
+ * \param numThreads Requested number of threads. 0 means one per core.
+ *
+ * \return Number of threads to use.
+ */
+inline unsigned getThreadCount(unsigned numThreads)
+{
+	if (!numThreads)
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	return numThreads;
+}
+
+/**
+ * Run a function on a number of threads, one of which is the calling thread,
+ *  and wait for all of them to finish.
+ *
+ * \param numThreads Number of threads.
+ * \param func Called with the index of each thread.
+ *
+ * \return None.
+ */
+template <typename Func>
+void runThreads(unsigned numThreads, const Func& func)
+{
+	std::vector<std::thread> threads;
+
+	for (unsigned thread = 1; thread < numThreads; thread++)
+		threads.push_back(std::thread(func, thread));
+
+	func(0);
+
+	for (size_t cnt = 0; cnt < threads.size(); cnt++)
+		threads[cnt].join();
+}
+
+#endif /* _PARALLEL_ */
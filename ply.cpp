@@ -0,0 +1,822 @@
+/**
+ * \file ply.cpp
+ * \brief Reading of binary PLY (Polygon File Format) files, as written by
+ *	scanners, without welding their already shared vertices again.
+ * \author Gregory Gluszek.
+ */
+
+#include "ply.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sstream>
+#include <algorithm>
+#include <type_traits>
+
+#define PLY_MAX_HEADER 65536 //!< Most bytes searched for the end of the header
+	//!< before giving up on a file.
+
+/**
+ * \param[in] data Start of file.
+ * \param size Size of data in bytes.
+ *
+ * \return True if data starts with the PLY magic line.
+ */
+bool isPly(const uint8_t* data, size_t size)
+{
+	return size >= 4 && !memcmp(data, "ply", 3) &&
+		(data[3] == '\n' || data[3] == '\r');
+}
+
+/**
+ * \param[in] filename File to check.
+ *
+ * \return True if file can be read and starts with the PLY magic line.
+ */
+bool isPlyFile(const char* filename)
+{
+	uint8_t magic[4];
+	FILE* file = fopen(filename, "r");
+
+	if (!file)
+		return false;
+
+	size_t elem_read = fread(magic, 1, sizeof(magic), file);
+	fclose(file);
+
+	return isPly(magic, elem_read);
+}
+
+/**
+ * Constructor. Nothing is mapped until map() is called.
+ */
+MappedFile::MappedFile()
+: data(NULL)
+, size(0)
+{
+}
+
+/**
+ * Destructor.
+ */
+MappedFile::~MappedFile()
+{
+	if (data)
+		munmap(data, size);
+}
+
+/**
+ * Map a whole file. Pages are read in as they are first touched, and the
+ *  kernel is told they will be read in order so it reads well ahead.
+ *
+ * \param[in] filename File to map.
+ *
+ * \return True if mapped. Empty files map to no data.
+ */
+bool MappedFile::map(const char* filename)
+{
+	struct stat info;
+	int fd = open(filename, O_RDONLY);
+
+	if (fd < 0)
+		return false;
+
+	if (fstat(fd, &info))
+	{
+		close(fd);
+		return false;
+	}
+
+	size = (size_t)info.st_size;
+	if (!size)
+	{
+		close(fd);
+		return true;
+	}
+
+	data = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		data = NULL;
+		size = 0;
+		return false;
+	}
+
+	madvise(data, size, MADV_SEQUENTIAL);
+
+	return true;
+}
+
+/**
+ * \return Contents of file. NULL if nothing is mapped.
+ */
+const uint8_t* MappedFile::getData() const
+{
+	return (const uint8_t*)data;
+}
+
+/**
+ * \return Size of file in bytes.
+ */
+size_t MappedFile::getSize() const
+{
+	return size;
+}
+
+/**
+ * Constructor. Holds no file until parse() is called.
+ */
+PlyReader::PlyReader()
+: data(NULL)
+, size(0)
+, elements()
+, vertexElement(-1)
+, faceElement(-1)
+, indexProperty(-1)
+{
+	for (int axis = 0; axis < 3; axis++)
+	{
+		coordOffsets[axis] = 0;
+		coordTypes[axis] = TYPE_FLOAT32;
+	}
+}
+
+/**
+ * Parse the header of a file and find where its vertex and face records
+ *  start. Elements before these that hold lists are stepped over record by
+ *  record, since their size is not known up front.
+ *
+ * \param[in] data Contents of file. Must stay valid while reading.
+ * \param size Size of data in bytes.
+ * \param[out] error Why the file cannot be read, if it cannot.
+ *
+ * \return True if vertices and faces can be read.
+ */
+bool PlyReader::parse(const uint8_t* data, size_t size, std::string& error)
+{
+	const char* text = (const char*)data;
+	size_t header_end = 0;
+	bool little_endian = false;
+	static const char* coord_names[3] = {"x", "y", "z"};
+	static const char end_line[] = "end_header";
+
+	this->data = data;
+	this->size = size;
+	elements.clear();
+	vertexElement = faceElement = indexProperty = -1;
+
+	if (!isPly(data, size))
+	{
+		error = "missing ply magic";
+		return false;
+	}
+
+	// Header is text lines ending at end_header, records follow right
+	//  after its line break
+	for (size_t pos = 0; pos + sizeof(end_line) <= size &&
+		pos < PLY_MAX_HEADER; pos++)
+	{
+		if (text[pos] == '\n' && !memcmp(text + pos + 1, end_line,
+			sizeof(end_line) - 1))
+		{
+			size_t end = pos + sizeof(end_line);
+
+			while (end < size && text[end] != '\n')
+				end++;
+			header_end = end + 1;
+			break;
+		}
+	}
+
+	if (!header_end || header_end > size)
+	{
+		error = "no end_header line";
+		return false;
+	}
+
+	std::istringstream header(std::string(text, header_end));
+	std::string line;
+
+	while (std::getline(header, line))
+	{
+		std::istringstream words(line);
+		std::string keyword;
+
+		words >> keyword;
+
+		if (keyword == "format")
+		{
+			std::string format;
+
+			words >> format;
+			little_endian = format == "binary_little_endian";
+			if (!little_endian)
+			{
+				error = "format " + format + " not supported, only"
+					" binary_little_endian";
+				return false;
+			}
+		}
+		else if (keyword == "element")
+		{
+			Element element;
+			unsigned long long count = 0;
+
+			if (!(words >> element.name >> count))
+			{
+				error = "bad element line \"" + line + "\"";
+				return false;
+			}
+			element.count = (size_t)count;
+			element.start = 0;
+			element.recordSize = 0;
+			elements.push_back(element);
+		}
+		else if (keyword == "property")
+		{
+			Property property;
+			std::string type;
+
+			if (elements.empty() || !(words >> type))
+			{
+				error = "bad property line \"" + line + "\"";
+				return false;
+			}
+
+			property.isList = type == "list";
+			property.countType = TYPE_UINT8;
+			if (property.isList)
+			{
+				std::string count_type;
+
+				if (!(words >> count_type >> type) ||
+					!parseType(count_type, property.countType))
+				{
+					error = "bad property line \"" + line + "\"";
+					return false;
+				}
+			}
+
+			if (!parseType(type, property.type) ||
+				!(words >> property.name))
+			{
+				error = "bad property line \"" + line + "\"";
+				return false;
+			}
+			elements.back().properties.push_back(property);
+		}
+	}
+
+	if (!little_endian)
+	{
+		error = "no format line";
+		return false;
+	}
+
+	for (size_t cnt = 0; cnt < elements.size(); cnt++)
+	{
+		Element& element = elements[cnt];
+		size_t record_size = 0;
+
+		if (element.name == "vertex")
+			vertexElement = (int)cnt;
+		else if (element.name == "face")
+			faceElement = (int)cnt;
+
+		for (size_t prop = 0; prop < element.properties.size(); prop++)
+		{
+			if (element.properties[prop].isList)
+			{
+				record_size = 0;
+				break;
+			}
+			record_size += getTypeSize(element.properties[prop].type);
+		}
+		element.recordSize = record_size;
+	}
+
+	if (vertexElement < 0 || faceElement < 0)
+	{
+		error = "no vertex or no face element";
+		return false;
+	}
+
+	// Find coordinates within vertex records
+	const Element& vertex = elements[vertexElement];
+
+	if (!vertex.recordSize)
+	{
+		error = "vertex element has list properties";
+		return false;
+	}
+
+	if (vertex.count > UINT32_MAX)
+	{
+		error = "too many vertices";
+		return false;
+	}
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		size_t offset = 0;
+		bool found = false;
+
+		for (size_t prop = 0; prop < vertex.properties.size(); prop++)
+		{
+			const Property& property = vertex.properties[prop];
+
+			if (property.name == coord_names[axis])
+			{
+				coordOffsets[axis] = offset;
+				coordTypes[axis] = property.type;
+				found = true;
+				break;
+			}
+			offset += getTypeSize(property.type);
+		}
+
+		if (!found)
+		{
+			error = std::string("vertex has no ") + coord_names[axis] +
+				" property";
+			return false;
+		}
+	}
+
+	// Find vertex index list within face records
+	const Element& face = elements[faceElement];
+
+	for (size_t prop = 0; prop < face.properties.size(); prop++)
+	{
+		const Property& property = face.properties[prop];
+
+		if (property.isList && (property.name == "vertex_indices" ||
+			property.name == "vertex_index"))
+		{
+			indexProperty = (int)prop;
+			break;
+		}
+	}
+
+	if (indexProperty < 0 ||
+		face.properties[indexProperty].type == TYPE_FLOAT32 ||
+		face.properties[indexProperty].type == TYPE_FLOAT64)
+	{
+		error = "face has no integer vertex_indices list";
+		return false;
+	}
+
+	// Step over records to find where each element needed starts
+	size_t offset = header_end;
+	size_t last = (size_t)std::max(vertexElement, faceElement);
+
+	for (size_t cnt = 0; cnt <= last; cnt++)
+	{
+		Element& element = elements[cnt];
+
+		element.start = offset;
+		if (cnt == last)
+			break;
+
+		if (element.recordSize)
+		{
+			if (element.count > (size - offset) / element.recordSize)
+			{
+				error = "file ends in " + element.name + " element";
+				return false;
+			}
+			offset += element.count * element.recordSize;
+			continue;
+		}
+
+		for (size_t rec = 0; rec < element.count; rec++)
+		{
+			if (!skipRecord(element, offset))
+			{
+				error = "file ends in " + element.name + " element";
+				return false;
+			}
+		}
+	}
+
+	if (vertex.count > (size - vertex.start) / vertex.recordSize)
+	{
+		error = "file ends in vertex element";
+		return false;
+	}
+
+	return true;
+}
+
+/**
+ * \return Number of vertices in file.
+ */
+size_t PlyReader::getNumVertices() const
+{
+	return elements[vertexElement].count;
+}
+
+/**
+ * \return Number of faces in file. Faces with more than three vertices
+ *	become more than one triangle.
+ */
+size_t PlyReader::getNumFaces() const
+{
+	return elements[faceElement].count;
+}
+
+/**
+ * \param magnitude Distance from origin to check against.
+ *
+ * \return True if any coordinate is at least magnitude from the origin.
+ */
+bool PlyReader::hasCoordBeyond(double magnitude) const
+{
+	const Element& element = elements[vertexElement];
+	const uint8_t* record = data + element.start;
+
+	for (size_t cnt = 0; cnt < element.count; cnt++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			if (fabs(readReal(record + coordOffsets[axis],
+				coordTypes[axis])) >= magnitude)
+				return true;
+		}
+
+		record += element.recordSize;
+	}
+
+	return false;
+}
+
+/**
+ * Copy out the position of every vertex. Files holding nothing but packed
+ *  single precision positions are copied in one go.
+ *
+ * \param[out] coords x, y and z of each vertex. Must have room for three
+ *	per vertex.
+ *
+ * \return None.
+ */
+template <typename Real>
+void PlyReader::readVertices(Real* coords) const
+{
+	const Element& element = elements[vertexElement];
+	const uint8_t* record = data + element.start;
+	bool packed_float = true;
+
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (coordTypes[axis] != TYPE_FLOAT32 ||
+			coordOffsets[axis] != axis * sizeof(float))
+			packed_float = false;
+	}
+
+	if (packed_float && std::is_same<Real, float>::value &&
+		element.recordSize == 3 * sizeof(float))
+	{
+		memcpy(coords, record, element.count * element.recordSize);
+		return;
+	}
+
+	for (size_t cnt = 0; cnt < element.count; cnt++)
+	{
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const uint8_t* value = record + coordOffsets[axis];
+
+			if (coordTypes[axis] == TYPE_FLOAT32)
+			{
+				float single;
+
+				memcpy(&single, value, sizeof(single));
+				coords[3*cnt + axis] = (Real)single;
+			}
+			else
+			{
+				coords[3*cnt + axis] =
+					(Real)readReal(value, coordTypes[axis]);
+			}
+		}
+
+		record += element.recordSize;
+	}
+}
+
+/**
+ * Copy out the vertex indices of every face, splitting faces with more than
+ *  three vertices into a fan of triangles. Faces with fewer than three
+ *  vertices are dropped. Triangles whose indices are 32 bit with a byte 
+ *  count, and whose other properties are not lists, which covers what 
+ *  scanners write, are copied without looking at their layout.
+ *
+ * \param[out] vertexIds Index of each vertex of each triangle.
+ * \param[out] error Why the faces cannot be read, if they cannot.
+ *
+ * \return True if every face was read and only refers to vertices in file.
+ */
+bool PlyReader::readTriangles(std::vector<uint32_t>& vertexIds,
+	std::string& error) const
+{
+	const Element& element = elements[faceElement];
+	const Property& indices = element.properties[indexProperty];
+	size_t count_size = getTypeSize(indices.countType);
+	size_t item_size = getTypeSize(indices.type);
+	uint32_t num_vertices = (uint32_t)getNumVertices();
+	bool simple = indices.countType == TYPE_UINT8 && 
+		item_size == sizeof(uint32_t);
+	// Bytes before and after index list in records, if simple
+	size_t lead = 0;
+	size_t trail = 0;
+	size_t offset = element.start;
+
+	for (size_t prop = 0; prop < element.properties.size(); prop++)
+	{
+		const Property& property = element.properties[prop];
+
+		if ((int)prop == indexProperty)
+			continue;
+
+		if (property.isList)
+			simple = false;
+		else if ((int)prop < indexProperty)
+			lead += getTypeSize(property.type);
+		else
+			trail += getTypeSize(property.type);
+	}
+
+	vertexIds.clear();
+	vertexIds.reserve(3 * element.count);
+
+	for (size_t rec = 0; rec < element.count; rec++)
+	{
+		size_t record_size = lead + 1 + 3 * sizeof(uint32_t) + trail;
+
+		if (simple && offset + record_size <= size &&
+			data[offset + lead] == 3)
+		{
+			uint32_t ids[3];
+
+			memcpy(ids, data + offset + lead + 1, sizeof(ids));
+			if (ids[0] >= num_vertices || ids[1] >= num_vertices ||
+				ids[2] >= num_vertices)
+			{
+				error = "face " + std::to_string(rec) + " refers to "
+					"missing vertex";
+				return false;
+			}
+
+			vertexIds.push_back(ids[0]);
+			vertexIds.push_back(ids[1]);
+			vertexIds.push_back(ids[2]);
+			offset += record_size;
+			continue;
+		}
+
+		for (size_t prop = 0; prop < element.properties.size(); prop++)
+		{
+			const Property& property = element.properties[prop];
+
+			if ((int)prop != indexProperty)
+			{
+				if (!skipProperty(property, offset))
+				{
+					error = "file ends in face element";
+					return false;
+				}
+				continue;
+			}
+
+			if (offset + count_size > size)
+			{
+				error = "file ends in face element";
+				return false;
+			}
+
+			uint32_t num_ids = readIndex(data + offset,
+				indices.countType);
+
+			offset += count_size;
+			if (num_ids > (size - offset) / item_size)
+			{
+				error = "file ends in face element";
+				return false;
+			}
+
+			for (uint32_t cnt = 0; cnt < num_ids; cnt++)
+			{
+				uint32_t id = readIndex(data + offset + cnt *
+					item_size, indices.type);
+
+				if (id >= num_vertices)
+				{
+					error = "face " + std::to_string(rec) +
+						" refers to missing vertex";
+					return false;
+				}
+
+				if (cnt < 2)
+					continue;
+
+				vertexIds.push_back(readIndex(data + offset,
+					indices.type));
+				vertexIds.push_back(readIndex(data + offset +
+					(cnt - 1) * item_size, indices.type));
+				vertexIds.push_back(id);
+			}
+
+			offset += num_ids * item_size;
+		}
+	}
+
+	return true;
+}
+
+/**
+ * \param[in] name Type name from header, in either its old or sized form.
+ * \param[out] type Matching type.
+ *
+ * \return True if name is a known type.
+ */
+bool PlyReader::parseType(const std::string& name, Type& type)
+{
+	static const char* names[NUM_TYPES][2] =
+	{
+		{"char", "int8"},
+		{"uchar", "uint8"},
+		{"short", "int16"},
+		{"ushort", "uint16"},
+		{"int", "int32"},
+		{"uint", "uint32"},
+		{"float", "float32"},
+		{"double", "float64"}
+	};
+
+	for (int cnt = 0; cnt < NUM_TYPES; cnt++)
+	{
+		if (name == names[cnt][0] || name == names[cnt][1])
+		{
+			type = (Type)cnt;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * \param type Type of value.
+ *
+ * \return Size of value in bytes.
+ */
+size_t PlyReader::getTypeSize(Type type)
+{
+	static const size_t sizes[NUM_TYPES] = {1, 1, 2, 2, 4, 4, 4, 8};
+
+	return sizes[type];
+}
+
+/**
+ * \param[in] data Value as stored in file.
+ * \param type Integer type of value.
+ *
+ * \return Value as an index. Negative values wrap to large indices, so are
+ *	caught as missing vertices.
+ */
+uint32_t PlyReader::readIndex(const uint8_t* data, Type type)
+{
+	switch (type)
+	{
+		case TYPE_INT8:
+			return (uint32_t)(int32_t)(int8_t)data[0];
+
+		case TYPE_UINT8:
+			return data[0];
+
+		case TYPE_INT16:
+		{
+			int16_t value;
+
+			memcpy(&value, data, sizeof(value));
+			return (uint32_t)(int32_t)value;
+		}
+
+		case TYPE_UINT16:
+		{
+			uint16_t value;
+
+			memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		default:
+		{
+			uint32_t value;
+
+			memcpy(&value, data, sizeof(value));
+			return value;
+		}
+	}
+}
+
+/**
+ * \param[in] data Value as stored in file.
+ * \param type Type of value.
+ *
+ * \return Value.
+ */
+double PlyReader::readReal(const uint8_t* data, Type type)
+{
+	switch (type)
+	{
+		case TYPE_FLOAT32:
+		{
+			float value;
+
+			memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		case TYPE_FLOAT64:
+		{
+			double value;
+
+			memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		case TYPE_INT32:
+		{
+			int32_t value;
+
+			memcpy(&value, data, sizeof(value));
+			return value;
+		}
+
+		case TYPE_INT8:
+		case TYPE_INT16:
+			return (double)(int32_t)readIndex(data, type);
+
+		default:
+			return readIndex(data, type);
+	}
+}
+
+/**
+ * Step over one property of a record.
+ *
+ * \param[in] property Property to step over.
+ * \param[inout] offset Offset into file of property. Moved past it.
+ *
+ * \return False if file ends before the property does.
+ */
+bool PlyReader::skipProperty(const Property& property, size_t& offset) const
+{
+	size_t item_size = getTypeSize(property.type);
+	size_t num_items = 1;
+
+	if (property.isList)
+	{
+		size_t count_size = getTypeSize(property.countType);
+
+		if (offset + count_size > size)
+			return false;
+		num_items = readIndex(data + offset, property.countType);
+		offset += count_size;
+	}
+
+	if (num_items > (size - offset) / item_size)
+		return false;
+	offset += num_items * item_size;
+
+	return true;
+}
+
+/**
+ * Step over one record of an element.
+ *
+ * \param[in] element Element record belongs to.
+ * \param[inout] offset Offset into file of record. Moved to the next one.
+ *
+ * \return False if file ends before the record does.
+ */
+bool PlyReader::skipRecord(const Element& element, size_t& offset) const
+{
+	for (size_t prop = 0; prop < element.properties.size(); prop++)
+	{
+		if (!skipProperty(element.properties[prop], offset))
+			return false;
+	}
+
+	return true;
+}
+
+template void PlyReader::readVertices<float>(float* coords) const;
+template void PlyReader::readVertices<double>(double* coords) const;
@@ -0,0 +1,124 @@
+/**
+ * \file ply.h
+ * \brief Reading of binary PLY (Polygon File Format) files, as written by
+ *	scanners, without welding their already shared vertices again.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _PLY_
+#define _PLY_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+bool isPly(const uint8_t* data, size_t size);
+bool isPlyFile(const char* filename);
+
+/**
+ * Read only view of a whole file mapped into memory. Unmapped when
+ *  destroyed.
+ */
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool map(const char* filename);
+
+	const uint8_t* getData() const;
+	size_t getSize() const;
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+	void* data; //!< Start of mapping. NULL if not mapped.
+	size_t size; //!< Size of file in bytes.
+};
+
+/**
+ * Layout of the vertex and face elements of a binary little endian PLY file,
+ *  found from its header, so that they can be copied out of the file's bytes
+ *  where they lie. Only the x, y and z properties of vertices and the vertex
+ *  index list of faces are read. Any other elements and properties are
+ *  stepped over.
+ */
+class PlyReader
+{
+public:
+	PlyReader();
+
+	bool parse(const uint8_t* data, size_t size, std::string& error);
+
+	size_t getNumVertices() const;
+	size_t getNumFaces() const;
+	bool hasCoordBeyond(double magnitude) const;
+
+	template <typename Real>
+	void readVertices(Real* coords) const;
+	bool readTriangles(std::vector<uint32_t>& vertexIds,
+		std::string& error) const;
+
+private:
+	/**
+	 * Scalar types properties may have.
+	 */
+	enum Type
+	{
+		TYPE_INT8 = 0,
+		TYPE_UINT8,
+		TYPE_INT16,
+		TYPE_UINT16,
+		TYPE_INT32,
+		TYPE_UINT32,
+		TYPE_FLOAT32,
+		TYPE_FLOAT64,
+		NUM_TYPES
+	};
+
+	/**
+	 * Property of each record of an element.
+	 */
+	struct Property
+	{
+		std::string name;
+		bool isList; //!< Record holds a count, then that many items.
+		Type countType; //!< Type of count. Only used for lists.
+		Type type; //!< Type of value, or of each item of a list.
+	};
+
+	/**
+	 * Element of file, i.e. vertex or face, and its records.
+	 */
+	struct Element
+	{
+		std::string name;
+		size_t count; //!< Number of records.
+		std::vector<Property> properties;
+		size_t start; //!< Offset into file of first record.
+		size_t recordSize; //!< Size of every record, 0 if they vary
+			//!< because of lists.
+	};
+
+	static bool parseType(const std::string& name, Type& type);
+	static size_t getTypeSize(Type type);
+	static uint32_t readIndex(const uint8_t* data, Type type);
+	static double readReal(const uint8_t* data, Type type);
+	bool skipProperty(const Property& property, size_t& offset) const;
+	bool skipRecord(const Element& element, size_t& offset) const;
+
+	const uint8_t* data; //!< Contents of file.
+	size_t size; //!< Size of file in bytes.
+	std::vector<Element> elements; //!< Elements in the order they are
+		//!< stored in.
+	int vertexElement; //!< Index into elements of vertices, -1 if none.
+	int faceElement; //!< Index into elements of faces, -1 if none.
+	size_t coordOffsets[3]; //!< Offset of x, y and z in vertex records.
+	Type coordTypes[3]; //!< Type of x, y and z.
+	int indexProperty; //!< Index into face properties of vertex indices.
+};
+
+#endif /* _PLY_ */
@@ -0,0 +1,569 @@
+/**
+ * \file prefetch.cpp
+ * \brief Reads files into memory ahead of when they are converted, so that
+ *	batches of small files on slow storage are not held up waiting on
+ *	each open and read in turn.
+ * \author Gregory Gluszek.
+ */
+
+#include "prefetch.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <algorithm>
+
+#define PREFETCH_READ_MAX (1u << 30) //!< Most bytes asked for in one read,
+	//!< as reads are limited to 32 bit lengths.
+
+/**
+ * io_uring submission and completion queues, mapped from the kernel.
+ */
+struct Prefetcher::Ring
+{
+	int fd; //!< io_uring instance.
+	void* map; //!< Mapping holding both queue rings.
+	size_t mapSize;
+	struct io_uring_sqe* sqes; //!< Submission queue entries.
+	size_t sqesSize;
+	unsigned* sqHead; //!< Submission entries up to here were consumed.
+	unsigned* sqTail; //!< Submission entries up to here were queued.
+	unsigned* sqMask;
+	unsigned* sqArray; //!< Index into sqes of each queued entry.
+	unsigned* cqHead; //!< Completions up to here were handled.
+	unsigned* cqTail; //!< Completions up to here were posted.
+	unsigned* cqMask;
+	struct io_uring_cqe* cqes; //!< Completion queue entries.
+	unsigned toSubmit; //!< Entries queued since last submission.
+};
+
+/**
+ * Constructor. Starts reading straight away.
+ *
+ * \param[in] filenames Files to read.
+ * \param inFlight Most files to be reading, or holding read but not yet
+ *	taken, at once.
+ * \param backend How to issue reads.
+ */
+Prefetcher::Prefetcher(const std::vector<std::string>& filenames,
+	unsigned inFlight, Backend backend)
+: filenames(filenames)
+, inFlight(std::max(1u, inFlight))
+, backend(backend)
+, ring(NULL)
+, numStarted(0)
+, numTaken(0)
+, stopping(false)
+{
+	const char* env = getenv("MDLCONV_READER");
+
+	if (backend == BACKEND_AUTO && env && !strcmp(env, "threads"))
+		this->backend = BACKEND_THREADS;
+
+	if (this->backend != BACKEND_THREADS && startUring())
+	{
+		this->backend = BACKEND_URING;
+		threads.push_back(std::thread(&Prefetcher::runUring, this));
+		return;
+	}
+
+	this->backend = BACKEND_THREADS;
+
+	unsigned num_threads = (unsigned)std::min((size_t)this->inFlight,
+		filenames.size());
+
+	for (unsigned cnt = 0; cnt < num_threads; cnt++)
+		threads.push_back(std::thread(&Prefetcher::runThread, this));
+}
+
+/**
+ * Destructor. Stops starting reads, and waits for any in flight to finish.
+ */
+Prefetcher::~Prefetcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		stopping = true;
+	}
+
+	roomCond.notify_all();
+
+	for (size_t cnt = 0; cnt < threads.size(); cnt++)
+		threads[cnt].join();
+
+	stopUring();
+}
+
+/**
+ * Take the next file to be read, waiting if none is ready yet.
+ *
+ * \param[out] file File read.
+ *
+ * \return False once every file has been handed out.
+ */
+bool Prefetcher::next(File& file)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+
+	readyCond.wait(lock, [&]()
+	{
+		return !ready.empty() || numTaken == filenames.size();
+	});
+
+	if (ready.empty())
+		return false;
+
+	file = std::move(ready.front());
+	ready.pop_front();
+	numTaken++;
+
+	lock.unlock();
+	roomCond.notify_one();
+
+	return true;
+}
+
+/**
+ * \return How reads are being issued. Never BACKEND_AUTO.
+ */
+Prefetcher::Backend Prefetcher::getBackend() const
+{
+	return backend;
+}
+
+/**
+ * \param backend How reads are issued.
+ *
+ * \return Name of backend.
+ */
+const char* Prefetcher::getName(Backend backend)
+{
+	switch (backend)
+	{
+		case BACKEND_URING:
+			return "io_uring";
+
+		case BACKEND_THREADS:
+			return "threads";
+
+		default:
+			return "auto";
+	}
+}
+
+/**
+ * Set up io_uring queues for reading, with an entry for every file in
+ *  flight. Fails on kernels without io_uring, or too old to open, stat and
+ *  close files through it, and where io_uring is blocked (i.e. by seccomp).
+ *
+ * \return True if ring is ready to use.
+ */
+bool Prefetcher::startUring()
+{
+	struct io_uring_params params;
+
+	memset(&params, 0, sizeof(params));
+
+	int fd = (int)syscall(__NR_io_uring_setup, inFlight, &params);
+
+	if (fd < 0)
+		return false;
+
+	// Fast poll came after open, stat and close were added, and single
+	//  mapping before that
+	if (!(params.features & IORING_FEAT_FAST_POLL) ||
+		!(params.features & IORING_FEAT_SINGLE_MMAP))
+	{
+		close(fd);
+		return false;
+	}
+
+	size_t sq_size = params.sq_off.array +
+		params.sq_entries * sizeof(unsigned);
+	size_t cq_size = params.cq_off.cqes +
+		params.cq_entries * sizeof(struct io_uring_cqe);
+	size_t map_size = std::max(sq_size, cq_size);
+	size_t sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+	void* map = mmap(NULL, map_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+
+	if (map == MAP_FAILED)
+	{
+		close(fd);
+		return false;
+	}
+
+	void* sqes = mmap(NULL, sqes_size, PROT_READ | PROT_WRITE,
+		MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+
+	if (sqes == MAP_FAILED)
+	{
+		munmap(map, map_size);
+		close(fd);
+		return false;
+	}
+
+	uint8_t* base = (uint8_t*)map;
+
+	ring = new Ring();
+	ring->fd = fd;
+	ring->map = map;
+	ring->mapSize = map_size;
+	ring->sqes = (struct io_uring_sqe*)sqes;
+	ring->sqesSize = sqes_size;
+	ring->sqHead = (unsigned*)(base + params.sq_off.head);
+	ring->sqTail = (unsigned*)(base + params.sq_off.tail);
+	ring->sqMask = (unsigned*)(base + params.sq_off.ring_mask);
+	ring->sqArray = (unsigned*)(base + params.sq_off.array);
+	ring->cqHead = (unsigned*)(base + params.cq_off.head);
+	ring->cqTail = (unsigned*)(base + params.cq_off.tail);
+	ring->cqMask = (unsigned*)(base + params.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe*)(base + params.cq_off.cqes);
+	ring->toSubmit = 0;
+
+	slots.resize(inFlight);
+	for (uint32_t cnt = inFlight; cnt > 0; cnt--)
+		freeSlots.push_back(cnt - 1);
+
+	return true;
+}
+
+/**
+ * Unmap and close io_uring queues, if they were set up.
+ *
+ * \return None.
+ */
+void Prefetcher::stopUring()
+{
+	if (!ring)
+		return;
+
+	munmap(ring->sqes, ring->sqesSize);
+	munmap(ring->map, ring->mapSize);
+	close(ring->fd);
+	delete ring;
+	ring = NULL;
+}
+
+/**
+ * Body of the thread issuing reads through io_uring. Starts files while
+ *  there is room, and otherwise waits for operations to complete, moving each
+ *  file on to its next operation until it has been read and closed.
+ *
+ * \return None.
+ */
+void Prefetcher::runUring()
+{
+	uint32_t index;
+
+	while (true)
+	{
+		// Only wait for room when nothing is in flight, as otherwise
+		//  completions need handling
+		while (!freeSlots.empty() &&
+			claim(freeSlots.size() == slots.size(), index))
+		{
+			uint32_t slot = freeSlots.back();
+
+			freeSlots.pop_back();
+			slots[slot].stage = STAGE_OPEN;
+			slots[slot].fd = -1;
+			slots[slot].done = 0;
+			slots[slot].file.index = index;
+			slots[slot].file.data.clear();
+			slots[slot].file.error = 0;
+			queueOp(slot);
+		}
+
+		if (freeSlots.size() == slots.size())
+			break;
+
+		int submitted = (int)syscall(__NR_io_uring_enter, ring->fd,
+			ring->toSubmit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+
+		if (submitted < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+				continue;
+
+			fprintf(stderr, "io_uring failed: %s\n", strerror(errno));
+			//TODO: add proper exception throwing
+			exit(EXIT_FAILURE);
+		}
+
+		ring->toSubmit -= (unsigned)submitted;
+
+		unsigned head = *ring->cqHead;
+		unsigned tail = __atomic_load_n(ring->cqTail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; head++)
+		{
+			const struct io_uring_cqe& cqe =
+				ring->cqes[head & *ring->cqMask];
+
+			finishOp((uint32_t)cqe.user_data, cqe.res);
+		}
+
+		__atomic_store_n(ring->cqHead, head, __ATOMIC_RELEASE);
+	}
+}
+
+/**
+ * Queue the operation for the stage a file has reached. Submitted with the
+ *  next io_uring_enter.
+ *
+ * \param slot Index into slots of file.
+ *
+ * \return None.
+ */
+void Prefetcher::queueOp(uint32_t slot)
+{
+	Slot& entry = slots[slot];
+	unsigned tail = *ring->sqTail;
+	unsigned pos = tail & *ring->sqMask;
+	struct io_uring_sqe* sqe = &ring->sqes[pos];
+
+	// There is an entry per slot and each slot has one operation in
+	//  flight, so the queue cannot be full
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->user_data = slot;
+
+	switch (entry.stage)
+	{
+		case STAGE_OPEN:
+			sqe->opcode = IORING_OP_OPENAT;
+			sqe->fd = AT_FDCWD;
+			sqe->addr = (uint64_t)(uintptr_t)
+				filenames[entry.file.index].c_str();
+			sqe->open_flags = O_RDONLY | O_CLOEXEC;
+			break;
+
+		case STAGE_STAT:
+		{
+			// Size of open file, as fstat would give
+			static const char empty_path[] = "";
+
+			sqe->opcode = IORING_OP_STATX;
+			sqe->fd = entry.fd;
+			sqe->addr = (uint64_t)(uintptr_t)empty_path;
+			sqe->len = STATX_SIZE;
+			sqe->off = (uint64_t)(uintptr_t)&entry.info;
+			sqe->statx_flags = AT_EMPTY_PATH;
+			break;
+		}
+
+		case STAGE_READ:
+			sqe->opcode = IORING_OP_READ;
+			sqe->fd = entry.fd;
+			sqe->addr = (uint64_t)(uintptr_t)
+				(entry.file.data.data() + entry.done);
+			sqe->len = (uint32_t)std::min((uint64_t)PREFETCH_READ_MAX,
+				entry.file.data.size() - entry.done);
+			sqe->off = entry.done;
+			break;
+
+		case STAGE_CLOSE:
+			sqe->opcode = IORING_OP_CLOSE;
+			sqe->fd = entry.fd;
+			break;
+	}
+
+	ring->sqArray[pos] = pos;
+	__atomic_store_n(ring->sqTail, tail + 1, __ATOMIC_RELEASE);
+	ring->toSubmit++;
+}
+
+/**
+ * Handle an operation completing, moving its file on to the next stage or
+ *  handing it over once closed.
+ *
+ * \param slot Index into slots of file.
+ * \param result Result of operation, negative errno on failure.
+ *
+ * \return None.
+ */
+void Prefetcher::finishOp(uint32_t slot, int result)
+{
+	Slot& entry = slots[slot];
+	std::vector<uint8_t>& data = entry.file.data;
+
+	if (result < 0 && entry.stage != STAGE_CLOSE)
+	{
+		entry.file.error = -result;
+		data.clear();
+
+		if (entry.fd < 0)
+		{
+			complete(entry.file);
+			freeSlots.push_back(slot);
+			return;
+		}
+
+		entry.stage = STAGE_CLOSE;
+		queueOp(slot);
+		return;
+	}
+
+	switch (entry.stage)
+	{
+		case STAGE_OPEN:
+			entry.fd = result;
+			entry.stage = STAGE_STAT;
+			break;
+
+		case STAGE_STAT:
+			data.resize((size_t)entry.info.stx_size);
+			entry.stage = data.empty() ? STAGE_CLOSE : STAGE_READ;
+			break;
+
+		case STAGE_READ:
+			entry.done += (uint64_t)result;
+
+			// A read of nothing means file got shorter
+			if (!result)
+				data.resize(entry.done);
+
+			if (entry.done == data.size())
+				entry.stage = STAGE_CLOSE;
+			break;
+
+		case STAGE_CLOSE:
+			complete(entry.file);
+			freeSlots.push_back(slot);
+			return;
+	}
+
+	queueOp(slot);
+}
+
+/**
+ * Body of each thread doing blocking reads, when io_uring is not used.
+ *
+ * \return None.
+ */
+void Prefetcher::runThread()
+{
+	uint32_t index;
+
+	while (claim(true, index))
+	{
+		File file;
+
+		file.index = index;
+		file.error = readFile(filenames[index].c_str(), file.data);
+		complete(file);
+	}
+}
+
+/**
+ * Pick the next file to read, if there is room for another in flight.
+ *
+ * \param wait True to wait for room if there is none.
+ * \param[out] index Index into filenames of file to read.
+ *
+ * \return False if there is no room or no files left, or reading is being
+ *	stopped.
+ */
+bool Prefetcher::claim(bool wait, uint32_t& index)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	auto has_room = [&]()
+	{
+		return stopping || numStarted == filenames.size() ||
+			numStarted - numTaken < inFlight;
+	};
+
+	if (wait)
+		roomCond.wait(lock, has_room);
+	else if (!has_room())
+		return false;
+
+	if (stopping || numStarted == filenames.size())
+		return false;
+
+	index = numStarted++;
+
+	return true;
+}
+
+/**
+ * Hand over a file that has been read.
+ *
+ * \param[inout] file File read. Contents are moved out.
+ *
+ * \return None.
+ */
+void Prefetcher::complete(File& file)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		ready.push_back(std::move(file));
+	}
+
+	readyCond.notify_one();
+}
+
+/**
+ * Read a whole file with blocking calls.
+ *
+ * \param[in] filename File to read.
+ * \param[out] data Contents of file.
+ *
+ * \return 0 on success, else errno of failed call.
+ */
+int Prefetcher::readFile(const char* filename, std::vector<uint8_t>& data)
+{
+	int fd = open(filename, O_RDONLY | O_CLOEXEC);
+	struct stat info;
+	size_t done = 0;
+
+	data.clear();
+	if (fd < 0)
+		return errno;
+
+	if (fstat(fd, &info))
+	{
+		int error = errno;
+
+		close(fd);
+		return error;
+	}
+
+	data.resize((size_t)info.st_size);
+	while (done < data.size())
+	{
+		ssize_t num_read = read(fd, &data[done], data.size() - done);
+
+		if (num_read < 0 && errno == EINTR)
+			continue;
+
+		if (num_read < 0)
+		{
+			int error = errno;
+
+			close(fd);
+			data.clear();
+			return error;
+		}
+
+		// File got shorter
+		if (!num_read)
+			break;
+
+		done += (size_t)num_read;
+	}
+
+	data.resize(done);
+	close(fd);
+
+	return 0;
+}
@@ -0,0 +1,123 @@
+/**
+ * \file prefetch.h
+ * \brief Reads files into memory ahead of when they are converted, so that
+ *	batches of small files on slow storage are not held up waiting on
+ *	each open and read in turn.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _PREFETCH_
+#define _PREFETCH_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * Reads a list of files on a background thread, keeping up to a set number
+ *  in flight at once, and hands each one over whole once it has been read.
+ *  Files are handed over in the order their reads finish, not the order they
+ *  were listed in. Files read but not yet taken count towards the number in
+ *  flight, so memory stays bounded however far reading gets ahead.
+ *
+ * Reads are issued through io_uring where the kernel supports it, so a
+ *  single thread can have every open, stat, read and close outstanding at
+ *  once. Otherwise, or if the MDLCONV_READER environment variable is set to
+ *  threads, one thread per file in flight does plain blocking reads.
+ *
+ * next() may be called from any number of threads.
+ */
+class Prefetcher
+{
+public:
+	/**
+	 * How reads are issued.
+	 */
+	enum Backend
+	{
+		BACKEND_AUTO = 0, //!< io_uring if available, else threads.
+		BACKEND_URING,
+		BACKEND_THREADS
+	};
+
+	/**
+	 * File read into memory.
+	 */
+	struct File
+	{
+		uint32_t index; //!< Index into list of file names.
+		std::vector<uint8_t> data; //!< Contents of file.
+		int error; //!< errno of failed open or read, 0 on success.
+	};
+
+	Prefetcher(const std::vector<std::string>& filenames, unsigned inFlight,
+		Backend backend = BACKEND_AUTO);
+	~Prefetcher();
+
+	bool next(File& file);
+
+	Backend getBackend() const;
+	static const char* getName(Backend backend);
+
+private:
+	struct Ring;
+
+	/**
+	 * Progress of a file being read through io_uring.
+	 */
+	enum Stage
+	{
+		STAGE_OPEN = 0,
+		STAGE_STAT,
+		STAGE_READ,
+		STAGE_CLOSE
+	};
+
+	/**
+	 * File being read through io_uring.
+	 */
+	struct Slot
+	{
+		Stage stage; //!< Operation in flight.
+		int fd; //!< Open file, -1 until open completes.
+		struct statx info; //!< Size of file, once stat completes.
+		uint64_t done; //!< Bytes read so far.
+		File file; //!< File being read into. data is sized once stat
+			//!< completes.
+	};
+
+	bool startUring();
+	void stopUring();
+	void runUring();
+	void runThread();
+	bool claim(bool wait, uint32_t& index);
+	void complete(File& file);
+	void queueOp(uint32_t slot);
+	void finishOp(uint32_t slot, int result);
+	static int readFile(const char* filename, std::vector<uint8_t>& data);
+
+	std::vector<std::string> filenames; //!< Files to read, in order.
+	unsigned inFlight; //!< Most files being read or waiting to be taken.
+	Backend backend; //!< How reads are being issued.
+
+	Ring* ring; //!< io_uring queues. NULL for BACKEND_THREADS.
+	std::vector<Slot> slots; //!< Files being read through ring.
+	std::vector<uint32_t> freeSlots; //!< Index into slots of unused slots.
+
+	std::vector<std::thread> threads; //!< Threads issuing reads.
+	std::mutex mutex; //!< Guards everything below.
+	std::condition_variable readyCond; //!< Signalled when a file is read.
+	std::condition_variable roomCond; //!< Signalled when a file is taken.
+	std::deque<File> ready; //!< Files read and waiting to be taken.
+	uint32_t numStarted; //!< Files reads have been started on.
+	uint32_t numTaken; //!< Files handed out by next().
+	bool stopping; //!< Set to stop starting reads.
+};
+
+#endif /* _PREFETCH_ */
@@ -0,0 +1,264 @@
+/**
+ * \file raster.cpp
+ * \brief Software rasterizer for drawing preview images of models without a
+ *	GPU or windowing system.
+ * \author Gregory Gluszek.
+ */
+
+#include "raster.h"
+#include "parallel.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+
+#define RASTER_TILE_SIZE 64 //!< Width and height of tiles in pixels. Depth
+	//!< and color of a tile take 32KB, so stay in cache while drawn.
+
+#define RASTER_BATCH 65536 //!< Triangles set up at a time. Fixed, rather than
+	//!< split by thread, so triangles reach tiles in the same order however
+	//!< many threads there are.
+
+/**
+ * Constructor.
+ *
+ * \param width Width of image in pixels.
+ * \param height Height of image in pixels.
+ * \param background Color of pixels no triangle is drawn over, with red,
+ *	green and blue in the low three bytes.
+ */
+Rasterizer::Rasterizer(int width, int height, uint32_t background)
+: width(width)
+, height(height)
+, tilesX((width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE)
+, tilesY((height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE)
+, depth((size_t)width * (size_t)height, INFINITY)
+, color((size_t)width * (size_t)height, background)
+{
+}
+
+/**
+ * Draw triangles over what has been drawn so far. Triangles facing either
+ *  way are drawn.
+ *
+ * \param[in] x Column of each vertex, in pixels. Pixel centers are at half
+ *	pixel offsets.
+ * \param[in] y Row of each vertex, in pixels, going down the image.
+ * \param[in] z Depth of each vertex. Nearer triangles have lower depth.
+ * \param[in] vertexIds Index into x, y and z of each vertex of each
+ *	triangle.
+ * \param[in] colors Color of each triangle, with red, green and blue in the
+ *	low three bytes.
+ * \param numTriangles Number of triangles.
+ * \param numThreads Most threads to draw with.
+ *
+ * \return None.
+ */
+void Rasterizer::draw(const float* x, const float* y, const float* z,
+	const uint32_t* vertexIds, const uint32_t* colors, size_t numTriangles,
+	unsigned numThreads)
+{
+	size_t num_batches = (numTriangles + RASTER_BATCH - 1) / RASTER_BATCH;
+	int num_tiles = tilesX * tilesY;
+	std::vector<Batch> batches(num_batches);
+	std::atomic<size_t> next_batch(0);
+	std::atomic<int> next_tile(0);
+
+	runThreads((unsigned)std::max((size_t)1, std::min(num_batches,
+		(size_t)numThreads)), [&](unsigned)
+	{
+		size_t batch = 0;
+
+		while ((batch = next_batch++) < num_batches)
+		{
+			setupBatch(x, y, z, vertexIds, colors, batch * RASTER_BATCH,
+				std::min(numTriangles, (batch + 1) * RASTER_BATCH),
+				batches[batch]);
+		}
+	});
+
+	runThreads(std::max(1u, std::min((unsigned)num_tiles, numThreads)),
+		[&](unsigned)
+	{
+		std::vector<float> tile_depth(RASTER_TILE_SIZE * RASTER_TILE_SIZE +
+			RASTER_TILE_PAD);
+		std::vector<uint32_t> tile_color(tile_depth.size());
+		int tile = 0;
+
+		while ((tile = next_tile++) < num_tiles)
+			drawTile(tile, batches, tile_depth, tile_color);
+	});
+}
+
+/**
+ * Copy out the image drawn so far.
+ *
+ * \param[out] rgb Red, green and blue of each pixel, row by row from the
+ *	top.
+ *
+ * \return None.
+ */
+void Rasterizer::getImage(std::vector<uint8_t>& rgb) const
+{
+	rgb.resize(3 * color.size());
+
+	for (size_t cnt = 0; cnt < color.size(); cnt++)
+	{
+		rgb[3*cnt] = (uint8_t)color[cnt];
+		rgb[3*cnt + 1] = (uint8_t)(color[cnt] >> 8);
+		rgb[3*cnt + 2] = (uint8_t)(color[cnt] >> 16);
+	}
+}
+
+/**
+ * Set up a range of triangles for rasterizing and sort them into the tiles
+ *  they touch. Triangles that cover no pixel centers, which on dense models
+ *  is most of them, are dropped here.
+ *
+ * \param[in] x See draw().
+ * \param[in] y
+ * \param[in] z
+ * \param[in] vertexIds
+ * \param[in] colors
+ * \param begin First triangle to set up.
+ * \param end One past last triangle to set up.
+ * \param[out] batch Triangles set up and the tiles each touches.
+ *
+ * \return None.
+ */
+void Rasterizer::setupBatch(const float* x, const float* y, const float* z,
+	const uint32_t* vertexIds, const uint32_t* colors, size_t begin,
+	size_t end, Batch& batch) const
+{
+	batch.bins.resize((size_t)(tilesX * tilesY));
+
+	for (size_t tri = begin; tri < end; tri++)
+	{
+		const uint32_t* ids = &vertexIds[3 * tri];
+		float vx[3] = {x[ids[0]], x[ids[1]], x[ids[2]]};
+		float vy[3] = {y[ids[0]], y[ids[1]], y[ids[2]]};
+		float vz[3] = {z[ids[0]], z[ids[1]], z[ids[2]]};
+		float area = (vx[1] - vx[0]) * (vy[2] - vy[0]) -
+			(vy[1] - vy[0]) * (vx[2] - vx[0]);
+		RasterTriangle raster;
+
+		// Also drops triangles with NaN coordinates
+		if (!(area > 0 || area < 0))
+			continue;
+
+		// Wind all triangles the same way so inside is always positive
+		if (area < 0)
+		{
+			std::swap(vx[1], vx[2]);
+			std::swap(vy[1], vy[2]);
+			std::swap(vz[1], vz[2]);
+			area = -area;
+		}
+
+		// Pixels whose centers lie within the triangle's bounds
+		float first_col = std::max(0.0f, ceilf(std::min(std::min(vx[0],
+			vx[1]), vx[2]) - 0.5f));
+		float last_col = std::min((float)(width - 1), floorf(std::max(
+			std::max(vx[0], vx[1]), vx[2]) - 0.5f));
+		float first_row = std::max(0.0f, ceilf(std::min(std::min(vy[0],
+			vy[1]), vy[2]) - 0.5f));
+		float last_row = std::min((float)(height - 1), floorf(std::max(
+			std::max(vy[0], vy[1]), vy[2]) - 0.5f));
+
+		if (!(first_col <= last_col && first_row <= last_row))
+			continue;
+
+		for (int edge = 0; edge < 3; edge++)
+		{
+			int next = (edge + 1) % 3;
+
+			raster.edges[edge][0] = vy[edge] - vy[next];
+			raster.edges[edge][1] = vx[next] - vx[edge];
+			raster.edges[edge][2] = vx[edge] * vy[next] -
+				vy[edge] * vx[next];
+		}
+
+		float dx1 = vx[1] - vx[0], dy1 = vy[1] - vy[0], dz1 = vz[1] - vz[0];
+		float dx2 = vx[2] - vx[0], dy2 = vy[2] - vy[0], dz2 = vz[2] - vz[0];
+
+		raster.depth[0] = (dz1 * dy2 - dz2 * dy1) / area;
+		raster.depth[1] = (dx1 * dz2 - dz1 * dx2) / area;
+		raster.depth[2] = vz[0] - raster.depth[0] * vx[0] -
+			raster.depth[1] * vy[0];
+
+		raster.bounds[0] = (int32_t)first_col;
+		raster.bounds[1] = (int32_t)last_col;
+		raster.bounds[2] = (int32_t)first_row;
+		raster.bounds[3] = (int32_t)last_row;
+		raster.color = colors[tri];
+
+		uint32_t index = (uint32_t)batch.triangles.size();
+
+		batch.triangles.push_back(raster);
+		for (int row = raster.bounds[2] / RASTER_TILE_SIZE;
+			row <= raster.bounds[3] / RASTER_TILE_SIZE; row++)
+		{
+			for (int col = raster.bounds[0] / RASTER_TILE_SIZE;
+				col <= raster.bounds[1] / RASTER_TILE_SIZE; col++)
+				batch.bins[(size_t)(row * tilesX + col)].push_back(index);
+		}
+	}
+}
+
+/**
+ * Draw every triangle touching a tile, batch by batch.
+ *
+ * \param tileId Index of tile, going along rows of tiles.
+ * \param[in] batches Triangles set up and sorted into tiles.
+ * \param tileDepth Scratch buffer for depth of tile. Must hold a full tile
+ *	and RASTER_TILE_PAD more.
+ * \param tileColor Scratch buffer for color of tile, sized as tileDepth.
+ *
+ * \return None.
+ */
+void Rasterizer::drawTile(int tileId, const std::vector<Batch>& batches,
+	std::vector<float>& tileDepth, std::vector<uint32_t>& tileColor)
+{
+	RasterTile tile;
+
+	tile.x = (tileId % tilesX) * RASTER_TILE_SIZE;
+	tile.y = (tileId / tilesX) * RASTER_TILE_SIZE;
+	tile.width = std::min(RASTER_TILE_SIZE, width - tile.x);
+	tile.height = std::min(RASTER_TILE_SIZE, height - tile.y);
+	tile.depth = tileDepth.data();
+	tile.color = tileColor.data();
+
+	// Start from what has been drawn so far
+	for (int row = 0; row < tile.height; row++)
+	{
+		size_t from = (size_t)(tile.y + row) * (size_t)width +
+			(size_t)tile.x;
+		size_t to = (size_t)(row * tile.width);
+
+		memcpy(&tileDepth[to], &depth[from],
+			(size_t)tile.width * sizeof(float));
+		memcpy(&tileColor[to], &color[from],
+			(size_t)tile.width * sizeof(uint32_t));
+	}
+
+	for (size_t batch = 0; batch < batches.size(); batch++)
+	{
+		const std::vector<uint32_t>& bin = batches[batch].bins[tileId];
+
+		rasterizeTriangles(batches[batch].triangles.data(), bin.data(),
+			bin.size(), tile);
+	}
+
+	for (int row = 0; row < tile.height; row++)
+	{
+		size_t to = (size_t)(tile.y + row) * (size_t)width +
+			(size_t)tile.x;
+		size_t from = (size_t)(row * tile.width);
+
+		memcpy(&depth[to], &tileDepth[from],
+			(size_t)tile.width * sizeof(float));
+		memcpy(&color[to], &tileColor[from],
+			(size_t)tile.width * sizeof(uint32_t));
+	}
+}
@@ -0,0 +1,66 @@
+/**
+ * \file raster.h
+ * \brief Software rasterizer for drawing preview images of models without a
+ *	GPU or windowing system.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _RASTER_
+#define _RASTER_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "kernels.h"
+
+/**
+ * Draws triangles into an image with a depth buffer. The image is split into
+ *  square tiles. Triangles are first set up and sorted into the tiles they
+ *  touch, in fixed size batches spread across threads. Each tile is then
+ *  drawn by one thread with buffers of its own, small enough to stay in
+ *  cache, using the rasterizeTriangles() kernel.
+ *
+ * Within a tile, triangles are drawn in the order given whatever the number
+ *  of threads, so the image does not depend on it.
+ */
+class Rasterizer
+{
+public:
+	Rasterizer(int width, int height, uint32_t background);
+
+	void draw(const float* x, const float* y, const float* depth,
+		const uint32_t* vertexIds, const uint32_t* colors,
+		size_t numTriangles, unsigned numThreads);
+
+	void getImage(std::vector<uint8_t>& rgb) const;
+
+private:
+	/**
+	 * Triangles set up by one batch, sorted into tiles.
+	 */
+	struct Batch
+	{
+		std::vector<RasterTriangle> triangles; //!< Triangles of batch
+			//!< that cover any pixel centers.
+		std::vector<std::vector<uint32_t> > bins; //!< Index into
+			//!< triangles of each triangle touching each tile.
+	};
+
+	void setupBatch(const float* x, const float* y, const float* depth,
+		const uint32_t* vertexIds, const uint32_t* colors, size_t begin,
+		size_t end, Batch& batch) const;
+	void drawTile(int tileId, const std::vector<Batch>& batches,
+		std::vector<float>& tileDepth, std::vector<uint32_t>& tileColor);
+
+	int width;
+	int height;
+	int tilesX; //!< Number of columns of tiles.
+	int tilesY; //!< Number of rows of tiles.
+	std::vector<float> depth; //!< Depth of nearest triangle drawn at each
+		//!< pixel, row by row.
+	std::vector<uint32_t> color; //!< Color of nearest triangle drawn at
+		//!< each pixel, or background.
+};
+
+#endif /* _RASTER_ */
@@ -0,0 +1,425 @@
+/**
+ * \file stats.cpp
+ * \brief Phase timing and counter instrumentation for model conversion.
+ * \author Gregory Gluszek.
+ */
+
+#include "stats.h"
+#include "kernels.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+int Stats::cacheMissFd = -1;
+
+/**
+ * Constructor.
+ *
+ * \param[inout] stats Stats to accumulate elapsed time into.
+ * \param phase Phase the elapsed time is attributed to.
+ */
+Stats::ScopedTimer::ScopedTimer(Stats& stats, Phase phase)
+: stats(stats)
+, phase(phase)
+, start(std::chrono::steady_clock::now())
+, startMisses(readCacheMisses())
+{
+}
+
+/**
+ * Destructor. Adds time elapsed since construction to the phase.
+ */
+Stats::ScopedTimer::~ScopedTimer()
+{
+	std::chrono::duration<double> elapsed =
+		std::chrono::steady_clock::now() - start;
+
+	stats.addTime(phase, elapsed.count());
+	stats.addCacheMisses(phase, readCacheMisses() - startMisses);
+}
+
+/**
+ * Constructor.
+ */
+Stats::Stats()
+: label("")
+{
+	reset();
+}
+
+/**
+ * Clear all accumulated times and counters.
+ *
+ * \return None.
+ */
+void Stats::reset()
+{
+	for (int cnt = 0; cnt < NUM_PHASES; cnt++)
+	{
+		phaseTimes[cnt] = 0;
+		phaseCacheMisses[cnt] = 0;
+	}
+
+	for (int cnt = 0; cnt < NUM_COUNTERS; cnt++)
+		counters[cnt] = 0;
+}
+
+/**
+ * Set label identifying what was measured (i.e. the input filename).
+ *
+ * \param[in] label Label to report along with stats.
+ *
+ * \return None.
+ */
+void Stats::setLabel(const std::string& label)
+{
+	this->label = label;
+}
+
+/**
+ * \return Label identifying what was measured.
+ */
+const std::string& Stats::getLabel() const
+{
+	return label;
+}
+
+/**
+ * Accumulate time spent in a phase.
+ *
+ * \param phase Phase time was spent in.
+ * \param seconds Time spent.
+ *
+ * \return None.
+ */
+void Stats::addTime(Phase phase, double seconds)
+{
+	phaseTimes[phase] += seconds;
+}
+
+/**
+ * \return Seconds accumulated for the given phase.
+ */
+double Stats::getTime(Phase phase) const
+{
+	return phaseTimes[phase];
+}
+
+/**
+ * \return Seconds accumulated over all phases.
+ */
+double Stats::getTotalTime() const
+{
+	double total = 0;
+
+	for (int cnt = 0; cnt < NUM_PHASES; cnt++)
+		total += phaseTimes[cnt];
+
+	return total;
+}
+
+/**
+ * Increment a counter.
+ *
+ * \param counter Counter to increment.
+ * \param amount Amount to add to counter.
+ *
+ * \return None.
+ */
+void Stats::increment(Counter counter, uint64_t amount)
+{
+	counters[counter] += amount;
+}
+
+/**
+ * Overwrite the value of a counter. Used for sizes rather than events.
+ *
+ * \param counter Counter to set.
+ * \param value New value of counter.
+ *
+ * \return None.
+ */
+void Stats::set(Counter counter, uint64_t value)
+{
+	counters[counter] = value;
+}
+
+/**
+ * \return Current value of counter.
+ */
+uint64_t Stats::getCount(Counter counter) const
+{
+	return counters[counter];
+}
+
+/**
+ * Add hardware cache misses to a phase.
+ *
+ * \param phase Phase to add misses to.
+ * \param misses Number of misses.
+ *
+ * \return None.
+ */
+void Stats::addCacheMisses(Phase phase, uint64_t misses)
+{
+	phaseCacheMisses[phase] += misses;
+}
+
+/**
+ * \return Hardware cache misses accumulated in phase. Always 0 unless
+ *	enableCacheMisses() succeeded before the phase ran.
+ */
+uint64_t Stats::getCacheMisses(Phase phase) const
+{
+	return phaseCacheMisses[phase];
+}
+
+/**
+ * Start counting hardware cache misses of this process, so that phases timed
+ *  afterwards also report misses. Threads started after this is called are
+ *  counted too. Needs the perf_event_open syscall to be permitted, which it
+ *  often is not in containers or with a strict perf_event_paranoid setting.
+ *
+ * \return True if misses are being counted.
+ */
+bool Stats::enableCacheMisses()
+{
+	if (cacheMissFd >= 0)
+		return true;
+
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.inherit = 1;
+
+	cacheMissFd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+
+	return cacheMissFd >= 0;
+}
+
+/**
+ * \return True if enableCacheMisses() has succeeded.
+ */
+bool Stats::cacheMissesEnabled()
+{
+	return cacheMissFd >= 0;
+}
+
+/**
+ * \return Cache misses counted since enableCacheMisses() was called, or 0 if
+ *	misses are not being counted.
+ */
+uint64_t Stats::readCacheMisses()
+{
+	uint64_t count = 0;
+
+	if (cacheMissFd < 0)
+		return 0;
+
+	if (read(cacheMissFd, &count, sizeof(count)) != sizeof(count))
+		return 0;
+
+	return count;
+}
+
+/**
+ * \return Peak resident set size of this process in kilobytes, or -1 if it
+ *	could not be determined.
+ */
+long Stats::getPeakRssKb()
+{
+	struct rusage usage;
+
+	memset(&usage, 0, sizeof(usage));
+
+	if (getrusage(RUSAGE_SELF, &usage))
+		return -1;
+
+	// ru_maxrss is reported in kilobytes on Linux
+	return usage.ru_maxrss;
+}
+
+/**
+ * \return Name used to identify phase in reports.
+ */
+const char* Stats::getName(Phase phase)
+{
+	switch (phase)
+	{
+		case HEADER_READ:
+			return "header_read";
+		case TRIANGLE_DECODE:
+			return "triangle_decode";
+		case NORMAL_COMPUTE:
+			return "normal_compute";
+		case VERTEX_WELD:
+			return "vertex_weld";
+		case CLEANUP:
+			return "cleanup";
+		case DECIMATE:
+			return "decimate";
+		case REORDER:
+			return "reorder";
+		case ADJACENCY:
+			return "adjacency";
+		case FACE_BUILD:
+			return "face_build";
+		case EXPORT:
+			return "export";
+		case BVH_BUILD:
+			return "bvh_build";
+		case UNFOLD:
+			return "unfold";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * \return Name used to identify counter in reports.
+ */
+const char* Stats::getName(Counter counter)
+{
+	switch (counter)
+	{
+		case TRIANGLES:
+			return "triangles";
+		case VERTICES:
+			return "vertices";
+		case HASH_PROBES:
+			return "hash_probes";
+		case NEIGHBOR_LINKS:
+			return "neighbor_links";
+		case FACES:
+			return "faces";
+		case BORDER_POINTS:
+			return "border_points";
+		case NORMAL_MISMATCHES:
+			return "normal_mismatches";
+		case DUPLICATES_REMOVED:
+			return "duplicates_removed";
+		case DEGENERATES_REMOVED:
+			return "degenerates_removed";
+		case DECIMATED_TRIANGLES:
+			return "decimated_triangles";
+		case EDGES:
+			return "edges";
+		case NON_MANIFOLD_EDGES:
+			return "non_manifold_edges";
+		case NETS:
+			return "nets";
+		case BODIES:
+			return "bodies";
+		case SHEETS:
+			return "sheets";
+		case LABELS:
+			return "labels";
+		case JOINTS:
+			return "joints";
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ * Escape string so it can be placed between quotes in JSON output.
+ *
+ * \param[in] str String to escape.
+ *
+ * \return Escaped string.
+ */
+static std::string jsonEscape(const std::string& str)
+{
+	std::string escaped = "";
+	char buf[8];
+
+	for (size_t cnt = 0; cnt < str.size(); cnt++)
+	{
+		unsigned char c = (unsigned char)str[cnt];
+
+		if (c == '"' || c == '\\')
+		{
+			escaped += '\\';
+			escaped += (char)c;
+		}
+		else if (c < 0x20)
+		{
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			escaped += buf;
+		}
+		else
+		{
+			escaped += (char)c;
+		}
+	}
+
+	return escaped;
+}
+
+/**
+ * \return JSON object containing all phase times (in seconds), counters, SIMD
+ *	variant chosen for each kernel and peak resident set size.
+ */
+std::string Stats::toJson() const
+{
+	std::string json = "";
+	char buf[64];
+
+	json += "{\n";
+	json += "  \"label\": \"" + jsonEscape(label) + "\",\n";
+
+	json += "  \"phase_seconds\": {\n";
+	for (int cnt = 0; cnt < NUM_PHASES; cnt++)
+	{
+		snprintf(buf, sizeof(buf), "%.9f", phaseTimes[cnt]);
+		json += "    \"" + std::string(getName((Phase)cnt)) + "\": " +
+			buf + ",\n";
+	}
+	snprintf(buf, sizeof(buf), "%.9f", getTotalTime());
+	json += "    \"total\": " + std::string(buf) + "\n";
+	json += "  },\n";
+
+	if (cacheMissesEnabled())
+	{
+		json += "  \"phase_cache_misses\": {\n";
+		for (int cnt = 0; cnt < NUM_PHASES; cnt++)
+		{
+			json += "    \"" + std::string(getName((Phase)cnt)) + 
+				"\": " + std::to_string(phaseCacheMisses[cnt]);
+			json += (cnt + 1 < NUM_PHASES) ? ",\n" : "\n";
+		}
+		json += "  },\n";
+	}
+
+	json += "  \"counters\": {\n";
+	for (int cnt = 0; cnt < NUM_COUNTERS; cnt++)
+	{
+		json += "    \"" + std::string(getName((Counter)cnt)) + "\": " +
+			std::to_string(counters[cnt]);
+		json += (cnt + 1 < NUM_COUNTERS) ? ",\n" : "\n";
+	}
+	json += "  },\n";
+
+	json += "  \"kernels\": {\n";
+	for (int cnt = 0; cnt < NUM_KERNELS; cnt++)
+	{
+		json += "    \"" + std::string(getKernelName((Kernel)cnt)) +
+			"\": \"" + getKernelVariantName((Kernel)cnt) + "\"";
+		json += (cnt + 1 < NUM_KERNELS) ? ",\n" : "\n";
+	}
+	json += "  },\n";
+
+	json += "  \"peak_rss_kb\": " + std::to_string(getPeakRssKb()) + "\n";
+	json += "}\n";
+
+	return json;
+}
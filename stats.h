@@ -0,0 +1,127 @@
+/**
+ * \file stats.h
+ * \brief Phase timing and counter instrumentation for model conversion.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _STATS_
+#define _STATS_
+
+#include <stdint.h>
+#include <string>
+#include <chrono>
+
+class Stats
+{
+public:
+	/**
+	 * Phases of a conversion run that are individually timed.
+	 */
+	enum Phase
+	{
+		HEADER_READ = 0,
+		TRIANGLE_DECODE,
+		NORMAL_COMPUTE,
+		VERTEX_WELD,
+		CLEANUP,
+		DECIMATE,
+		REORDER,
+		ADJACENCY,
+		FACE_BUILD,
+		EXPORT,
+		BVH_BUILD,
+		UNFOLD,
+		NUM_PHASES
+	};
+
+	/**
+	 * Event and size counters accumulated during a conversion run.
+	 */
+	enum Counter
+	{
+		TRIANGLES = 0,
+		VERTICES,
+		HASH_PROBES,
+		NEIGHBOR_LINKS,
+		FACES,
+		BORDER_POINTS,
+		NORMAL_MISMATCHES,
+		DUPLICATES_REMOVED,
+		DEGENERATES_REMOVED,
+		DECIMATED_TRIANGLES,
+		EDGES,
+		NON_MANIFOLD_EDGES,
+		NETS,
+		BODIES,
+		SHEETS,
+		LABELS,
+		JOINTS,
+		NUM_COUNTERS
+	};
+
+	/**
+	 * Accumulates the time between construction and destruction into
+	 *  the given phase.
+	 */
+	class ScopedTimer
+	{
+	public:
+		ScopedTimer(Stats& stats, Phase phase);
+		~ScopedTimer();
+
+	private:
+		Stats& stats; //!< Stats to accumulate time into.
+		Phase phase; //!< Phase being timed.
+		std::chrono::steady_clock::time_point start; //!< Time timer
+			//!< was created.
+		uint64_t startMisses; //!< Cache miss count when timer was
+			//!< created.
+	};
+
+	Stats();
+
+	void reset();
+
+	void setLabel(const std::string& label);
+	const std::string& getLabel() const;
+
+	void addTime(Phase phase, double seconds);
+	double getTime(Phase phase) const;
+	double getTotalTime() const;
+
+	void increment(Counter counter, uint64_t amount = 1);
+	void set(Counter counter, uint64_t value);
+	uint64_t getCount(Counter counter) const;
+
+	void addCacheMisses(Phase phase, uint64_t misses);
+	uint64_t getCacheMisses(Phase phase) const;
+
+	static long getPeakRssKb();
+
+	static bool enableCacheMisses();
+	static bool cacheMissesEnabled();
+	static uint64_t readCacheMisses();
+
+	static const char* getName(Phase phase);
+	static const char* getName(Counter counter);
+
+	std::string toJson() const;
+
+private:
+	std::string label; //!< Identifies what was measured (i.e. input file).
+
+	double phaseTimes[NUM_PHASES]; //!< Accumulated seconds spent in each
+		//!< phase.
+
+	uint64_t counters[NUM_COUNTERS]; //!< Accumulated value of each
+		//!< counter.
+
+	uint64_t phaseCacheMisses[NUM_PHASES]; //!< Accumulated hardware cache
+		//!< misses in each phase. Only counted once 
+		//!< enableCacheMisses() succeeds.
+
+	static int cacheMissFd; //!< perf event counting cache misses of this
+		//!< process and threads it starts. -1 when not counting.
+};
+
+#endif /* _STATS_ */
@@ -0,0 +1,443 @@
+/**
+ * \file svgpath.cpp
+ * \brief SVG shape made of several straight line subpaths, written either as
+ *	one compact path element or as plain polygons, polylines and lines, and
+ *	SVG group of rotated text labels.
+ * \author Gregory Gluszek.
+ */
+
+#include "svgpath.h"
+
+#include <stdio.h>
+#include <inttypes.h>
+#include <math.h>
+
+/**
+ * Constructor.
+ *
+ * \param[in] stroke Stroke to draw all subpaths with.
+ * \param precision Decimal places to round coordinates to in a compact path
+ *	element, up to MAX_PRECISION. Negative to write plain shapes instead.
+ */
+SvgPath::SvgPath(const svg::Stroke& stroke, int precision)
+: svg::Shape(svg::Fill(), stroke)
+, precision(precision < MAX_PRECISION ? precision : MAX_PRECISION)
+{
+}
+
+/**
+ * Start a new subpath.
+ *
+ * \param x Coordinates of first point of subpath.
+ * \param y
+ *
+ * \return None.
+ */
+void SvgPath::moveTo(double x, double y)
+{
+	Subpath subpath;
+
+	subpath.begin = (uint32_t)points.size();
+	subpath.end = subpath.begin + 1;
+	subpath.closed = false;
+	subpaths.push_back(subpath);
+	points.push_back(svg::Point(x, y));
+}
+
+/**
+ * Add a straight line to the current subpath. Starts a new subpath if there
+ *  is none.
+ *
+ * \param x Coordinates of end of line.
+ * \param y
+ *
+ * \return None.
+ */
+void SvgPath::lineTo(double x, double y)
+{
+	if (subpaths.empty() || subpaths.back().closed)
+	{
+		moveTo(x, y);
+		return;
+	}
+
+	points.push_back(svg::Point(x, y));
+	subpaths.back().end++;
+}
+
+/**
+ * Join the current subpath back to its first point. Following lines start a
+ *  new subpath.
+ *
+ * \return None.
+ */
+void SvgPath::close()
+{
+	if (!subpaths.empty())
+		subpaths.back().closed = true;
+}
+
+/**
+ * \return True if there is nothing to draw.
+ */
+bool SvgPath::empty() const
+{
+	for (size_t cnt = 0; cnt < subpaths.size(); cnt++)
+	{
+		if (subpaths[cnt].end - subpaths[cnt].begin > 1)
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * \param[in] layout Layout of the document shape is written to.
+ *
+ * \return SVG elements drawing all subpaths.
+ */
+std::string SvgPath::toString(const svg::Layout& layout) const
+{
+	if (empty())
+		return std::string();
+
+	if (precision < 0)
+		return toShapesString(layout);
+
+	return toPathString(layout);
+}
+
+/**
+ * Move all points.
+ *
+ * \param[in] offset Amount to move by.
+ *
+ * \return None.
+ */
+void SvgPath::offset(const svg::Point& offset)
+{
+	for (size_t cnt = 0; cnt < points.size(); cnt++)
+	{
+		points[cnt].x += offset.x;
+		points[cnt].y += offset.y;
+	}
+}
+
+/**
+ * Append a fixed point number to path data, with no trailing zeros, no
+ *  leading zero before the decimal point and a separator only where the
+ *  previous number would otherwise run into it.
+ *
+ * \param[in,out] data Path data to append to.
+ * \param value Number in units of 10^-precision.
+ * \param precision Decimal places value has.
+ * \param[in,out] afterNumber True if data ends in a number. Set on return.
+ * \param[in,out] afterPoint True if the number data ends in has a decimal
+ *	point, so another can follow with no separator. Updated on return.
+ *
+ * \return None.
+ */
+static void appendNumber(std::string& data, int64_t value, int precision,
+	bool& afterNumber, bool& afterPoint)
+{
+	uint64_t magnitude = value < 0 ? (uint64_t)0 - (uint64_t)value :
+		(uint64_t)value;
+	uint64_t scale = 1;
+	char text[48];
+	int len = 0;
+
+	for (int cnt = 0; cnt < precision; cnt++)
+		scale *= 10;
+
+	uint64_t whole = magnitude / scale;
+	uint64_t frac = magnitude % scale;
+	int digits = precision;
+
+	while (frac && !(frac % 10))
+	{
+		frac /= 10;
+		digits--;
+	}
+
+	if (value < 0)
+		text[len++] = '-';
+	if (whole || !frac)
+		len += snprintf(text + len, sizeof(text) - len, "%" PRIu64, whole);
+	if (frac)
+		len += snprintf(text + len, sizeof(text) - len, ".%0*" PRIu64,
+			digits, frac);
+
+	if (afterNumber && text[0] != '-' && !(text[0] == '.' && afterPoint))
+		data += ' ';
+
+	data.append(text, len);
+	afterNumber = true;
+	afterPoint = frac != 0;
+}
+
+/**
+ * \param[in] layout Layout of the document shape is written to.
+ *
+ * \return Single path element with coordinates relative to the previous
+ *	point, so that most are only a few digits long. Coordinates are rounded
+ *	before differences are taken, so rounding does not add up along the
+ *	path. Horizontal and vertical lines are written with one coordinate
+ *	and repeated commands are left out.
+ */
+std::string SvgPath::toPathString(const svg::Layout& layout) const
+{
+	double scale = pow(10.0, precision);
+	std::string data;
+	int64_t cur_x = 0, cur_y = 0;
+	char command = 0;
+	bool after_number = false;
+	bool after_point = false;
+
+	data.reserve(points.size() * 8);
+
+	for (size_t path_cnt = 0; path_cnt < subpaths.size(); path_cnt++)
+	{
+		const Subpath& subpath = subpaths[path_cnt];
+		int64_t start_x = 0, start_y = 0;
+
+		if (subpath.end - subpath.begin < 2)
+			continue;
+
+		for (uint32_t cnt = subpath.begin; cnt < subpath.end; cnt++)
+		{
+			int64_t x = llround(svg::translateX(points[cnt].x, layout) *
+				scale);
+			int64_t y = llround(svg::translateY(points[cnt].y, layout) *
+				scale);
+			int64_t dx = x - cur_x, dy = y - cur_y;
+			char next;
+
+			if (cnt == subpath.begin)
+			{
+				next = 'm';
+				start_x = x;
+				start_y = y;
+			}
+			else if (!dx && !dy)
+				continue;
+			else if (!dx)
+				next = 'v';
+			else if (!dy)
+				next = 'h';
+			else
+				next = 'l';
+
+			if (next != command)
+			{
+				data += next;
+				after_number = false;
+			}
+
+			// Pairs after a move are lines
+			command = next == 'm' ? 'l' : next;
+
+			if (next != 'v')
+				appendNumber(data, dx, precision, after_number,
+					after_point);
+			if (next != 'h')
+				appendNumber(data, dy, precision, after_number,
+					after_point);
+
+			cur_x = x;
+			cur_y = y;
+		}
+
+		if (subpath.closed)
+		{
+			data += 'z';
+			command = 'z';
+			after_number = false;
+			cur_x = start_x;
+			cur_y = start_y;
+		}
+	}
+
+	std::stringstream ss;
+
+	ss << svg::elemStart("path") << "d=\"" << data << "\" " <<
+		svg::attribute("fill", "none") << stroke.toString(layout) <<
+		svg::emptyElemEnd();
+
+	return ss.str();
+}
+
+/**
+ * \param[in] layout Layout of the document shape is written to.
+ *
+ * \return Polygon for each closed subpath, line or polyline for each open
+ *	one.
+ */
+std::string SvgPath::toShapesString(const svg::Layout& layout) const
+{
+	std::string shapes;
+
+	for (size_t path_cnt = 0; path_cnt < subpaths.size(); path_cnt++)
+	{
+		const Subpath& subpath = subpaths[path_cnt];
+		uint32_t num_pts = subpath.end - subpath.begin;
+
+		if (num_pts < 2)
+			continue;
+
+		if (subpath.closed)
+		{
+			svg::Polygon polygon(fill, stroke);
+
+			for (uint32_t cnt = subpath.begin; cnt < subpath.end; cnt++)
+				polygon << points[cnt];
+			shapes += polygon.toString(layout);
+		}
+		else if (num_pts == 2)
+		{
+			shapes += svg::Line(points[subpath.begin],
+				points[subpath.begin + 1], stroke).toString(layout);
+		}
+		else
+		{
+			svg::Polyline polyline(fill, stroke);
+
+			for (uint32_t cnt = subpath.begin; cnt < subpath.end; cnt++)
+				polyline << points[cnt];
+			shapes += polyline.toString(layout);
+		}
+	}
+
+	return shapes;
+}
+
+/**
+ * Constructor.
+ *
+ * \param[in] fill Fill to draw text with.
+ * \param height Font size most labels are drawn at.
+ * \param precision Decimal places to round coordinates to, up to 
+ *	SvgPath::MAX_PRECISION. Negative for full precision.
+ */
+SvgLabels::SvgLabels(const svg::Fill& fill, double height, int precision)
+: svg::Shape(fill, svg::Stroke())
+, height(height)
+, precision(precision < SvgPath::MAX_PRECISION ? precision : 
+	SvgPath::MAX_PRECISION)
+{
+}
+
+/**
+ * Add a label.
+ *
+ * \param id Number written on label.
+ * \param x Middle of label's baseline.
+ * \param y
+ * \param dirX Unit vector along baseline.
+ * \param dirY
+ * \param height Font size of label.
+ *
+ * \return None.
+ */
+void SvgLabels::add(uint32_t id, double x, double y, double dirX, double dirY,
+	double height)
+{
+	Label label = {id, svg::Point(x, y), svg::Point(dirX, dirY), height};
+
+	labels.push_back(label);
+}
+
+/**
+ * \return True if there are no labels.
+ */
+bool SvgLabels::empty() const
+{
+	return labels.empty();
+}
+
+/**
+ * \param[in] layout Layout of the document shape is written to.
+ *
+ * \return Group element with a text element for each label.
+ */
+std::string SvgLabels::toString(const svg::Layout& layout) const
+{
+	if (labels.empty())
+		return std::string();
+
+	std::string group_height = formatNumber(svg::translateScale(height, 
+		layout));
+	std::stringstream ss;
+
+	ss << svg::elemStart("g") << fill.toString(layout) << 
+		svg::attribute("font-size", group_height) << 
+		svg::attribute("font-family", "sans-serif") << 
+		svg::attribute("text-anchor", "middle") << ">\n";
+
+	for (size_t cnt = 0; cnt < labels.size(); cnt++)
+	{
+		const Label& label = labels[cnt];
+		double x = svg::translateX(label.origin.x, layout);
+		double y = svg::translateY(label.origin.y, layout);
+
+		// Direction may be flipped by the layout
+		double dir_x = svg::translateX(label.origin.x + label.dir.x, 
+			layout) - x;
+		double dir_y = svg::translateY(label.origin.y + label.dir.y, 
+			layout) - y;
+		std::string label_height = formatNumber(svg::translateScale(
+			label.height, layout));
+
+		ss << svg::elemStart("text") << "transform=\"translate(" << 
+			formatNumber(x) << " " << formatNumber(y) << ")rotate(" << 
+			formatNumber(atan2(dir_y, dir_x) * 180 / M_PI) << ")\" ";
+		if (label_height != group_height)
+			ss << svg::attribute("font-size", label_height);
+		ss << ">" << label.id << svg::elemEnd("text");
+	}
+
+	ss << svg::elemEnd("g");
+
+	return ss.str();
+}
+
+/**
+ * Move all labels.
+ *
+ * \param[in] offset Amount to move by.
+ *
+ * \return None.
+ */
+void SvgLabels::offset(const svg::Point& offset)
+{
+	for (size_t cnt = 0; cnt < labels.size(); cnt++)
+	{
+		labels[cnt].origin.x += offset.x;
+		labels[cnt].origin.y += offset.y;
+	}
+}
+
+/**
+ * \param value Number to format.
+ *
+ * \return value rounded to precision decimal places with no trailing zeros,
+ *	or as the rest of the document writes numbers if precision is negative.
+ */
+std::string SvgLabels::formatNumber(double value) const
+{
+	if (precision < 0)
+	{
+		std::stringstream ss;
+
+		ss << value;
+		return ss.str();
+	}
+
+	std::string text;
+	bool after_number = false;
+	bool after_point = false;
+
+	appendNumber(text, llround(value * pow(10.0, precision)), precision,
+		after_number, after_point);
+
+	return text;
+}
@@ -0,0 +1,100 @@
+/**
+ * \file svgpath.h
+ * \brief SVG shape made of several straight line subpaths, written either as
+ *	one compact path element or as plain polygons, polylines and lines, and
+ *	SVG group of rotated text labels.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _SVG_PATH_
+#define _SVG_PATH_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "simple_svg_1.0.0.hpp"
+
+/**
+ * Set of open and closed straight line subpaths sharing a stroke. With a
+ *  precision of 0 or more, written as a single path element with relative
+ *  coordinates rounded to that many decimal places and no separators that
+ *  can be left out. Otherwise each closed subpath is written as a polygon and
+ *  each open one as a line or polyline, with full precision absolute
+ *  coordinates.
+ */
+class SvgPath : public svg::Shape
+{
+public:
+	static const int MAX_PRECISION = 9; //!< Most decimal places supported.
+
+	SvgPath(const svg::Stroke& stroke, int precision);
+
+	void moveTo(double x, double y);
+	void lineTo(double x, double y);
+	void close();
+	bool empty() const;
+
+	std::string toString(const svg::Layout& layout) const;
+	void offset(const svg::Point& offset);
+
+private:
+	/**
+	 * Range of points making up one subpath.
+	 */
+	struct Subpath
+	{
+		uint32_t begin; //!< Index into points of first point.
+		uint32_t end; //!< One past index into points of last point.
+		bool closed; //!< Last point joins back to first.
+	};
+
+	std::string toPathString(const svg::Layout& layout) const;
+	std::string toShapesString(const svg::Layout& layout) const;
+
+	int precision; //!< Decimal places of compact coordinates, negative
+		//!< for plain shapes.
+	std::vector<svg::Point> points; //!< Points of all subpaths in order.
+	std::vector<Subpath> subpaths;
+};
+
+/**
+ * Set of numbered text labels sharing a font and fill, each centered on a
+ *  point of its baseline and rotated to run along a direction. Written as a
+ *  group element holding the shared attributes, with a text element per
+ *  label giving only its position, angle and any size that differs from 
+ *  the group's. Coordinates are rounded as for SvgPath.
+ */
+class SvgLabels : public svg::Shape
+{
+public:
+	SvgLabels(const svg::Fill& fill, double height, int precision);
+
+	void add(uint32_t id, double x, double y, double dirX, double dirY,
+		double height);
+	bool empty() const;
+
+	std::string toString(const svg::Layout& layout) const;
+	void offset(const svg::Point& offset);
+
+private:
+	/**
+	 * Single label.
+	 */
+	struct Label
+	{
+		uint32_t id; //!< Number written on label.
+		svg::Point origin; //!< Middle of baseline.
+		svg::Point dir; //!< Unit vector along baseline.
+		double height; //!< Font size.
+	};
+
+	std::string formatNumber(double value) const;
+
+	double height; //!< Font size of group.
+	int precision; //!< Decimal places of coordinates, negative for full
+		//!< precision.
+	std::vector<Label> labels;
+};
+
+#endif /* _SVG_PATH_ */
@@ -0,0 +1,172 @@
+/**
+ * \file trace.cpp
+ * \brief Optional tracing of internal phases to Chrome trace-event JSON.
+ * \author Gregory Gluszek.
+ */
+
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+std::atomic<bool> Trace::enabled(false);
+std::string Trace::filename = "";
+uint64_t Trace::epoch = 0;
+std::mutex Trace::buffersMutex;
+std::vector<Trace::ThreadBuffer*> Trace::buffers;
+
+/**
+ * Constructor. Marks start of zone.
+ *
+ * \param[in] name Name of zone. Must remain valid until trace is written,
+ *	so this should be a string literal. NULL to not record zone.
+ * \param id Optional id to attach to zone, -1 for none.
+ */
+Trace::Zone::Zone(const char* name, int64_t id)
+: name(name)
+, id(id)
+, start(0)
+{
+	if (name && isEnabled())
+		start = now();
+}
+
+/**
+ * Destructor. Records zone in this thread's buffer.
+ */
+Trace::Zone::~Zone()
+{
+	if (!start || !isEnabled())
+		return;
+
+	Event event;
+
+	event.name = name;
+	event.id = id;
+	event.start = start;
+	event.duration = now() - start;
+
+	getThreadBuffer().events.push_back(event);
+}
+
+/**
+ * Start recording zones.
+ *
+ * \param[in] filename File to write trace to when stop() is called.
+ *
+ * \return None.
+ */
+void Trace::start(const char* filename)
+{
+	Trace::filename = filename;
+	epoch = now();
+	enabled.store(true);
+}
+
+/**
+ * Stop recording zones and write trace file. All threads that recorded zones
+ *  must have finished (or at least left their zones) before this is called.
+ *
+ * \return None.
+ */
+void Trace::stop()
+{
+	if (!enabled.exchange(false))
+		return;
+
+	write();
+}
+
+/**
+ * \return Monotonic time in ns. Never 0, so 0 can mean "not started".
+ */
+uint64_t Trace::now()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count() | 1;
+}
+
+/**
+ * \return Buffer for calling thread, creating and registering it on first
+ *	use.
+ */
+Trace::ThreadBuffer& Trace::getThreadBuffer()
+{
+	static thread_local ThreadBuffer* buffer = NULL;
+
+	if (!buffer)
+	{
+		std::lock_guard<std::mutex> lock(buffersMutex);
+
+		buffer = new ThreadBuffer();
+		buffer->tid = (uint32_t)buffers.size() + 1;
+		buffer->events.reserve(4096);
+		buffers.push_back(buffer);
+	}
+
+	return *buffer;
+}
+
+/**
+ * Write all recorded events to file in trace-event JSON format and clear
+ *  buffers.
+ *
+ * \return None.
+ */
+void Trace::write()
+{
+	std::lock_guard<std::mutex> lock(buffersMutex);
+	FILE* file = fopen(filename.c_str(), "w");
+	bool first = true;
+
+	if (!file)
+	{
+		fprintf(stderr, "Failed to open file \"%s\" for writing.\n",
+			filename.c_str());
+		//TODO: add proper exception throwing
+		exit(EXIT_FAILURE);
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	for (size_t cnt = 0; cnt < buffers.size(); cnt++)
+	{
+		ThreadBuffer* buffer = buffers[cnt];
+
+		fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\","
+			"\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s %u\"}}",
+			first ? "" : ",\n", buffer->tid,
+			buffer->tid == 1 ? "main" : "worker", buffer->tid);
+		first = false;
+
+		for (size_t evt = 0; evt < buffer->events.size(); evt++)
+		{
+			const Event& event = buffer->events[evt];
+			// Events from before start() would have negative time
+			double ts = event.start > epoch ?
+				(double)(event.start - epoch) / 1000 : 0;
+
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\","
+				"\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+				event.name, buffer->tid, ts,
+				(double)event.duration / 1000);
+			if (event.id >= 0)
+				fprintf(file, ",\"args\":{\"id\":%lld}",
+					(long long)event.id);
+			fprintf(file, "}");
+		}
+
+		buffer->events.clear();
+	}
+
+	fprintf(file, "\n]}\n");
+
+	if (fclose(file))
+	{
+		fprintf(stderr, "Failed to close file \"%s\" after writing "
+			"data.\n", filename.c_str());
+		//TODO: add proper exception throwing
+		exit(EXIT_FAILURE);
+	}
+}
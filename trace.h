@@ -0,0 +1,105 @@
+/**
+ * \file trace.h
+ * \brief Optional tracing of internal phases to Chrome trace-event JSON.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _TRACE_
+#define _TRACE_
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+// Helpers so each TRACE_ZONE in a scope gets a unique variable name
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+
+//! Record a zone with the given name from here until the end of the scope.
+#define TRACE_ZONE(name) \
+	Trace::Zone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+
+//! Record a zone with a numeric id (i.e. face number) attached.
+#define TRACE_ZONE_ID(name, id) \
+	Trace::Zone TRACE_CONCAT(trace_zone_, __LINE__)(name, (int64_t)(id))
+
+//! Record a zone with an id for one in every \a every values of \a count,
+//!  for zones on hot paths that would otherwise slow down what is traced.
+#define TRACE_ZONE_SAMPLED(name, id, count, every) \
+	Trace::Zone TRACE_CONCAT(trace_zone_, __LINE__)( \
+		(count) % (every) ? NULL : (name), (int64_t)(id))
+
+/**
+ * Collects timestamped zones into per-thread buffers and writes them out in
+ *  the Chrome/Perfetto trace-event format. Each thread only ever appends to
+ *  its own buffer, so recording takes no locks. A mutex is only taken the
+ *  first time a thread records a zone, to register its buffer.
+ */
+class Trace
+{
+public:
+	/**
+	 * Scoped zone. Records a complete event covering its lifetime if
+	 *  tracing was enabled when it was created.
+	 */
+	class Zone
+	{
+	public:
+		Zone(const char* name, int64_t id = -1);
+		~Zone();
+
+	private:
+		const char* name; //!< Zone name. Must be a string literal.
+		int64_t id; //!< Optional id attached to the event, -1 if none.
+		uint64_t start; //!< Start time in ns. 0 if tracing disabled.
+	};
+
+	static void start(const char* filename);
+	static void stop();
+
+	/**
+	 * \return True if zones are currently being recorded.
+	 */
+	static bool isEnabled()
+	{
+		return enabled.load(std::memory_order_relaxed);
+	}
+
+private:
+	/**
+	 * A single completed zone.
+	 */
+	struct Event
+	{
+		const char* name; //!< Zone name.
+		int64_t id; //!< Optional id, -1 if none.
+		uint64_t start; //!< Start time in ns.
+		uint64_t duration; //!< Duration in ns.
+	};
+
+	/**
+	 * Events recorded by a single thread.
+	 */
+	struct ThreadBuffer
+	{
+		uint32_t tid; //!< Sequential id given to thread in trace.
+		std::vector<Event> events; //!< Only appended to by owning
+			//!< thread.
+	};
+
+	static uint64_t now();
+	static ThreadBuffer& getThreadBuffer();
+	static void write();
+
+	static std::atomic<bool> enabled; //!< Whether zones are recorded.
+	static std::string filename; //!< File trace is written to on stop().
+	static uint64_t epoch; //!< Time tracing started, in ns.
+	static std::mutex buffersMutex; //!< Guards registration in buffers.
+	static std::vector<ThreadBuffer*> buffers; //!< Buffer of every thread
+		//!< that recorded a zone. Kept until exit so events from 
+		//!< finished threads can still be written.
+};
+
+#endif /* _TRACE_ */
@@ -0,0 +1,739 @@
+/**
+ * \file unfold.cpp
+ * \brief Flattens connected groups of planar faces into non-overlapping 2D
+ *	nets.
+ *
+ * Nets are grown breadth first from the largest face not yet placed. A face
+ *  is attached to the net by rotating it about the edge it shares with a
+ *  face already in the net. If it would overlap anything already placed the
+ *  face is left for a later net. Overlap checks only look at placed edges in
+ *  the uniform grid cells the new face covers, so the cost of placing a face
+ *  does not grow with the size of the net.
+ *
+ * \author Gregory Gluszek.
+ */
+
+#include "unfold.h"
+
+#include <math.h>
+#include <algorithm>
+#include <deque>
+
+#define UNFOLD_EPSILON 1e-5 //!< Relative tolerance used when deciding if
+	//!< edges properly cross. Edges that only touch do not overlap.
+
+template <typename Real>
+const uint32_t Unfolder<Real>::NO_FACE;
+
+/**
+ * Constructor.
+ */
+template <typename Real>
+Unfolder<Real>::Unfolder()
+: faces(NULL)
+, netCount(0)
+, cellSize(1)
+, stamp(0)
+{
+	startNet();
+}
+
+/**
+ * Split faces into nets. Results are available via getPlacements() and
+ *  isFold().
+ *
+ * \param[in] faces Faces to unfold. Must remain valid until this returns.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Unfolder<Real>::unfold(const std::vector<Face>& faces)
+{
+	this->faces = &faces;
+
+	placements.assign(faces.size(), Placement());
+	folds.assign(faces.size(), std::vector<std::vector<uint8_t> >());
+	placedInterior.assign(faces.size() * 2, 0);
+	edgeRefs.clear();
+	netCount = 0;
+
+	// Index every border edge and pick grid cell size from average edge
+	//  length
+	double edge_len_sum = 0;
+	for (uint32_t face_cnt = 0; face_cnt < faces.size(); face_cnt++)
+	{
+		const Face& face = faces[face_cnt];
+
+		placements[face_cnt].net = NO_FACE;
+		folds[face_cnt].resize(face.points.size());
+
+		for (uint32_t loop_cnt = 0; loop_cnt < face.points.size();
+			loop_cnt++)
+		{
+			const std::vector<Real>& pts = face.points[loop_cnt];
+			const std::vector<uint32_t>& ids = face.vertexIds[loop_cnt];
+			uint32_t num_pts = (uint32_t)ids.size();
+
+			folds[face_cnt][loop_cnt].assign(num_pts, 0);
+
+			for (uint32_t cnt = 0; cnt < num_pts; cnt++)
+			{
+				uint32_t next = (cnt + 1) % num_pts;
+				EdgeRef ref;
+
+				ref.key = ((uint64_t)ids[cnt] << 32) | ids[next];
+				ref.face = face_cnt;
+				ref.loop = loop_cnt;
+				ref.edge = cnt;
+				edgeRefs.push_back(ref);
+
+				edge_len_sum += hypot(pts[next*2] - pts[cnt*2],
+					pts[next*2+1] - pts[cnt*2+1]);
+			}
+		}
+	}
+
+	// Faces with no border, i.e. closed surfaces joined into one face,
+	//  are nets on their own
+	if (edgeRefs.empty())
+	{
+		for (uint32_t face_cnt = 0; face_cnt < faces.size(); face_cnt++)
+		{
+			Placement& placement = placements[face_cnt];
+
+			placement.net = netCount++;
+			placement.parent = NO_FACE;
+			placement.cosAngle = 1;
+			placement.sinAngle = 0;
+			placement.x = 0;
+			placement.y = 0;
+		}
+		return;
+	}
+
+	std::stable_sort(edgeRefs.begin(), edgeRefs.end());
+
+	cellSize = (Real)(edge_len_sum / (double)edgeRefs.size());
+	if (!(cellSize > 0))
+		cellSize = 1;
+
+	// Seed nets from largest faces first
+	std::vector<uint32_t> order(faces.size());
+	for (uint32_t cnt = 0; cnt < order.size(); cnt++)
+		order[cnt] = cnt;
+
+	std::stable_sort(order.begin(), order.end(),
+		[&faces](uint32_t lhs, uint32_t rhs)
+		{
+			return faces[lhs].area > faces[rhs].area;
+		});
+
+	std::deque<uint32_t> queue;
+
+	for (size_t seed_cnt = 0; seed_cnt < order.size(); seed_cnt++)
+	{
+		uint32_t seed = order[seed_cnt];
+
+		if (placements[seed].net != NO_FACE)
+			continue;
+
+		startNet();
+
+		Placement root;
+		root.net = netCount;
+		root.parent = NO_FACE;
+		root.cosAngle = 1;
+		root.sinAngle = 0;
+		root.x = 0;
+		root.y = 0;
+
+		place(seed, root);
+		queue.push_back(seed);
+
+		while (!queue.empty())
+		{
+			uint32_t face_id = queue.front();
+			queue.pop_front();
+
+			const Face& face = faces[face_id];
+			const Placement& placed = placements[face_id];
+
+			for (uint32_t loop_cnt = 0; loop_cnt < face.points.size();
+				loop_cnt++)
+			{
+				const std::vector<Real>& pts = face.points[loop_cnt];
+				const std::vector<uint32_t>& ids =
+					face.vertexIds[loop_cnt];
+				uint32_t num_pts = (uint32_t)ids.size();
+
+				for (uint32_t cnt = 0; cnt < num_pts; cnt++)
+				{
+					uint32_t neighbor = face.neighbors[loop_cnt][cnt];
+					uint32_t next = (cnt + 1) % num_pts;
+					EdgeRef hinge;
+
+					if (neighbor == NO_FACE ||
+						placements[neighbor].net != NO_FACE)
+						continue;
+
+					// Shared edge runs the other way around the neighbor
+					if (!findEdge(ids[next], ids[cnt], neighbor, hinge))
+						continue;
+
+					const Face& other = faces[neighbor];
+					const std::vector<Real>& other_pts =
+						other.points[hinge.loop];
+					uint32_t other_next = (hinge.edge + 1) %
+						(uint32_t)(other_pts.size() / 2);
+
+					// Ends of hinge in net coordinates
+					Real p1x, p1y, p2x, p2y;
+					transform(placed, pts[cnt*2], pts[cnt*2+1], p1x, p1y);
+					transform(placed, pts[next*2], pts[next*2+1], p2x,
+						p2y);
+
+					// Ends of hinge in neighbor coordinates. q1 matches p2
+					//  and q2 matches p1.
+					Real q1x = other_pts[hinge.edge*2];
+					Real q1y = other_pts[hinge.edge*2+1];
+					Real q2x = other_pts[other_next*2];
+					Real q2y = other_pts[other_next*2+1];
+
+					double angle = atan2(p1y - p2y, p1x - p2x) -
+						atan2(q2y - q1y, q2x - q1x);
+
+					Placement candidate;
+					candidate.net = netCount;
+					candidate.parent = face_id;
+					candidate.cosAngle = (Real)cos(angle);
+					candidate.sinAngle = (Real)sin(angle);
+					candidate.x = 0;
+					candidate.y = 0;
+
+					Real rx, ry;
+					transform(candidate, q1x, q1y, rx, ry);
+					candidate.x = p2x - rx;
+					candidate.y = p2y - ry;
+
+					if (overlaps(neighbor, candidate, hinge.loop,
+						hinge.edge))
+						continue;
+
+					folds[face_id][loop_cnt][cnt] = 1;
+					folds[neighbor][hinge.loop][hinge.edge] = 1;
+
+					place(neighbor, candidate);
+					queue.push_back(neighbor);
+				}
+			}
+		}
+
+		netCount++;
+	}
+}
+
+/**
+ * \return Placement of each face, indexed the same as the faces passed to
+ *	unfold().
+ */
+template <typename Real>
+const std::vector<typename Unfolder<Real>::Placement>& 
+	Unfolder<Real>::getPlacements() const
+{
+	return placements;
+}
+
+/**
+ * \return Number of nets faces were split into.
+ */
+template <typename Real>
+uint32_t Unfolder<Real>::getNetCount() const
+{
+	return netCount;
+}
+
+/**
+ * Check whether an edge is a fold between two faces of the same net rather
+ *  than an edge to cut.
+ *
+ * \param face Face edge belongs to.
+ * \param loop Loop within face.
+ * \param edge Edge from point edge to edge + 1 of loop.
+ *
+ * \return True if edge is a fold.
+ */
+template <typename Real>
+bool Unfolder<Real>::isFold(uint32_t face, uint32_t loop, 
+	uint32_t edge) const
+{
+	return folds[face][loop][edge] != 0;
+}
+
+/**
+ * Map a point from face coordinates to net coordinates.
+ *
+ * \param[in] placement Placement of the face.
+ * \param x Coordinates of point on face.
+ * \param y
+ * \param[out] outX Coordinates of point in net.
+ * \param[out] outY
+ *
+ * \return None.
+ */
+template <typename Real>
+void Unfolder<Real>::transform(const Placement& placement, Real x, Real y,
+	Real& outX, Real& outY)
+{
+	outX = placement.cosAngle * x - placement.sinAngle * y + placement.x;
+	outY = placement.sinAngle * x + placement.cosAngle * y + placement.y;
+}
+
+/**
+ * Find a directed border edge of a specific face.
+ *
+ * \param from Id of vertex edge starts at.
+ * \param to Id of vertex edge ends at.
+ * \param face Face edge must belong to.
+ * \param[out] ref Location of edge if found.
+ *
+ * \return True if edge was found.
+ */
+template <typename Real>
+bool Unfolder<Real>::findEdge(uint32_t from, uint32_t to, uint32_t face,
+	EdgeRef& ref) const
+{
+	EdgeRef key;
+	key.key = ((uint64_t)from << 32) | to;
+
+	typename std::vector<EdgeRef>::const_iterator it = std::lower_bound(
+		edgeRefs.begin(), edgeRefs.end(), key);
+
+	for (; it != edgeRefs.end() && it->key == key.key; it++)
+	{
+		if (it->face == face)
+		{
+			ref = *it;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Orientation of c relative to line through a and b.
+ *
+ * \return Positive if c is left of a->b, negative if right, 0 if collinear.
+ */
+static double orient(double ax, double ay, double bx, double by, double cx,
+	double cy)
+{
+	return (bx - ax) * (cy - ay) - (by - ay) * (cx - ax);
+}
+
+/**
+ * Check if two segments cross at a point interior to both. Segments that
+ *  only touch (e.g. share an end point) or are collinear do not cross.
+ *
+ * \return True if segments cross.
+ */
+static bool segmentsCross(double ax, double ay, double bx, double by,
+	double cx, double cy, double dx, double dy)
+{
+	double eps = UNFOLD_EPSILON * hypot(bx - ax, by - ay) *
+		hypot(dx - cx, dy - cy);
+
+	double d1 = orient(ax, ay, bx, by, cx, cy);
+	double d2 = orient(ax, ay, bx, by, dx, dy);
+	if (!((d1 > eps && d2 < -eps) || (d1 < -eps && d2 > eps)))
+		return false;
+
+	double d3 = orient(cx, cy, dx, dy, ax, ay);
+	double d4 = orient(cx, cy, dx, dy, bx, by);
+	return (d3 > eps && d4 < -eps) || (d3 < -eps && d4 > eps);
+}
+
+/**
+ * Check if point is inside a set of loops using the even-odd rule, so points
+ *  in holes are outside.
+ *
+ * \param[in] loops x, y pairs of each loop.
+ * \param x Point to check.
+ * \param y
+ *
+ * \return True if point is inside.
+ */
+template <typename Real>
+static bool pointInLoops(const std::vector<std::vector<Real> >& loops,
+	Real x, Real y)
+{
+	bool inside = false;
+
+	for (size_t loop_cnt = 0; loop_cnt < loops.size(); loop_cnt++)
+	{
+		const std::vector<Real>& pts = loops[loop_cnt];
+		size_t num_pts = pts.size() / 2;
+
+		for (size_t cnt = 0, prev = num_pts - 1; cnt < num_pts; prev = cnt++)
+		{
+			Real x1 = pts[prev*2];
+			Real y1 = pts[prev*2+1];
+			Real x2 = pts[cnt*2];
+			Real y2 = pts[cnt*2+1];
+
+			if ((y1 > y) != (y2 > y) &&
+				x < (x2 - x1) * (y - y1) / (y2 - y1) + x1)
+				inside = !inside;
+		}
+	}
+
+	return inside;
+}
+
+/**
+ * Check if a face would overlap anything already placed in the current net.
+ *
+ * \param face Face to check.
+ * \param[in] placement Where face would be placed.
+ * \param hingeLoop Loop containing edge face is attached by.
+ * \param hingeEdge Edge face is attached by. Lies on a placed edge so is
+ *	not checked.
+ *
+ * \return True if face overlaps.
+ */
+template <typename Real>
+bool Unfolder<Real>::overlaps(uint32_t face, const Placement& placement,
+	uint32_t hingeLoop, uint32_t hingeEdge)
+{
+	const Face& desc = (*faces)[face];
+
+	// Face in net coordinates
+	std::vector<std::vector<Real> > loops(desc.points.size());
+	Real min_x = INFINITY, min_y = INFINITY;
+	Real max_x = -INFINITY, max_y = -INFINITY;
+
+	for (size_t loop_cnt = 0; loop_cnt < desc.points.size(); loop_cnt++)
+	{
+		const std::vector<Real>& pts = desc.points[loop_cnt];
+		std::vector<Real>& out = loops[loop_cnt];
+
+		out.resize(pts.size());
+		for (size_t cnt = 0; cnt < pts.size(); cnt += 2)
+		{
+			transform(placement, pts[cnt], pts[cnt+1], out[cnt],
+				out[cnt+1]);
+			min_x = std::min(min_x, out[cnt]);
+			max_x = std::max(max_x, out[cnt]);
+			min_y = std::min(min_y, out[cnt+1]);
+			max_y = std::max(max_y, out[cnt+1]);
+		}
+	}
+
+	// Edge crossings
+	for (uint32_t loop_cnt = 0; loop_cnt < loops.size(); loop_cnt++)
+	{
+		const std::vector<Real>& pts = loops[loop_cnt];
+		uint32_t num_pts = (uint32_t)(pts.size() / 2);
+
+		for (uint32_t cnt = 0; cnt < num_pts; cnt++)
+		{
+			if (loop_cnt == hingeLoop && cnt == hingeEdge)
+				continue;
+
+			uint32_t next = (cnt + 1) % num_pts;
+			Real ax = pts[cnt*2];
+			Real ay = pts[cnt*2+1];
+			Real bx = pts[next*2];
+			Real by = pts[next*2+1];
+
+			stamp++;
+			segmentCellKeys(ax, ay, bx, by, cellKeys);
+
+			for (size_t key_cnt = 0; key_cnt < cellKeys.size(); key_cnt++)
+			{
+				std::unordered_map<uint64_t, std::vector<uint32_t> >::
+					const_iterator cell = segmentCells.find(
+					cellKeys[key_cnt]);
+
+				if (cell == segmentCells.end())
+					continue;
+
+				for (size_t seg_cnt = 0; seg_cnt < cell->second.size();
+					seg_cnt++)
+				{
+					uint32_t seg_id = cell->second[seg_cnt];
+					const Segment& seg = segments[seg_id];
+
+					if (stamps[seg_id] == stamp)
+						continue;
+					stamps[seg_id] = stamp;
+
+					if (segmentsCross(ax, ay, bx, by, seg.x1, seg.y1,
+						seg.x2, seg.y2))
+						return true;
+				}
+			}
+		}
+	}
+
+	// No edges cross, so face is either inside a placed face, contains a
+	//  placed face, or is clear. Check the first case by casting a ray from
+	//  the interior point and counting placed edges crossed. The ray goes
+	//  towards the closest side of the net to keep the walk short.
+	Real point[2];
+	transform(placement, desc.interior[0], desc.interior[1], point[0],
+		point[1]);
+
+	int axis = 0;
+	bool positive = true;
+	Real shortest = INFINITY;
+
+	for (int cnt = 0; cnt < 2; cnt++)
+	{
+		if (netMax[cnt] - point[cnt] < shortest)
+		{
+			shortest = netMax[cnt] - point[cnt];
+			axis = cnt;
+			positive = true;
+		}
+		if (point[cnt] - netMin[cnt] < shortest)
+		{
+			shortest = point[cnt] - netMin[cnt];
+			axis = cnt;
+			positive = false;
+		}
+	}
+
+	Real pu = point[axis]; // Along ray
+	Real pw = point[1 - axis]; // Across ray
+	int64_t line = cellCoord(pw);
+	int64_t step = positive ? 1 : -1;
+	int64_t last = cellCoord(positive ? netMax[axis] : netMin[axis]);
+	uint32_t crossings = 0;
+
+	stamp++;
+	for (int64_t iu = cellCoord(pu); positive ? iu <= last : iu >= last;
+		iu += step)
+	{
+		std::unordered_map<uint64_t, std::vector<uint32_t> >::
+			const_iterator cell = segmentCells.find(axis ?
+			cellKey(line, iu) : cellKey(iu, line));
+
+		if (cell == segmentCells.end())
+			continue;
+
+		for (size_t seg_cnt = 0; seg_cnt < cell->second.size(); seg_cnt++)
+		{
+			uint32_t seg_id = cell->second[seg_cnt];
+			const Segment& seg = segments[seg_id];
+
+			if (stamps[seg_id] == stamp)
+				continue;
+			stamps[seg_id] = stamp;
+
+			Real u1 = axis ? seg.y1 : seg.x1;
+			Real w1 = axis ? seg.x1 : seg.y1;
+			Real u2 = axis ? seg.y2 : seg.x2;
+			Real w2 = axis ? seg.x2 : seg.y2;
+
+			if ((w1 > pw) == (w2 > pw))
+				continue;
+
+			Real hit = (u2 - u1) * (pw - w1) / (w2 - w1) + u1;
+
+			if (positive ? hit > pu : hit < pu)
+				crossings++;
+		}
+	}
+
+	if (crossings & 1)
+		return true;
+
+	// Check for placed faces inside this one. Any such face has its interior
+	//  point inside this face's bounding box. Visit whichever is fewer of
+	//  the grid cells covered or the faces placed.
+	int64_t min_ix = cellCoord(min_x);
+	int64_t max_ix = cellCoord(max_x);
+	int64_t min_iy = cellCoord(min_y);
+	int64_t max_iy = cellCoord(max_y);
+	double num_cells = (double)(max_ix - min_ix + 1) *
+		(double)(max_iy - min_iy + 1);
+
+	if (num_cells <= (double)netFaces.size())
+	{
+		for (int64_t ix = min_ix; ix <= max_ix; ix++)
+		{
+			for (int64_t iy = min_iy; iy <= max_iy; iy++)
+			{
+				std::unordered_map<uint64_t, std::vector<uint32_t> >::
+					const_iterator cell = interiorCells.find(
+					cellKey(ix, iy));
+
+				if (cell == interiorCells.end())
+					continue;
+
+				for (size_t cnt = 0; cnt < cell->second.size(); cnt++)
+				{
+					uint32_t other = cell->second[cnt];
+
+					if (pointInLoops(loops, placedInterior[other*2],
+						placedInterior[other*2+1]))
+						return true;
+				}
+			}
+		}
+	}
+	else
+	{
+		for (size_t cnt = 0; cnt < netFaces.size(); cnt++)
+		{
+			uint32_t other = netFaces[cnt];
+			Real ox = placedInterior[other*2];
+			Real oy = placedInterior[other*2+1];
+
+			if (ox < min_x || ox > max_x || oy < min_y || oy > max_y)
+				continue;
+
+			if (pointInLoops(loops, ox, oy))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Add face to the current net.
+ *
+ * \param face Face to place.
+ * \param[in] placement Where to place it.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Unfolder<Real>::place(uint32_t face, const Placement& placement)
+{
+	const Face& desc = (*faces)[face];
+
+	placements[face] = placement;
+	netFaces.push_back(face);
+
+	for (size_t loop_cnt = 0; loop_cnt < desc.points.size(); loop_cnt++)
+	{
+		const std::vector<Real>& pts = desc.points[loop_cnt];
+		size_t num_pts = pts.size() / 2;
+
+		for (size_t cnt = 0; cnt < num_pts; cnt++)
+		{
+			size_t next = (cnt + 1) % num_pts;
+			Segment seg;
+
+			transform(placement, pts[cnt*2], pts[cnt*2+1], seg.x1, seg.y1);
+			transform(placement, pts[next*2], pts[next*2+1], seg.x2,
+				seg.y2);
+
+			uint32_t seg_id = (uint32_t)segments.size();
+			segments.push_back(seg);
+			stamps.push_back(0);
+
+			netMin[0] = std::min(netMin[0], std::min(seg.x1, seg.x2));
+			netMin[1] = std::min(netMin[1], std::min(seg.y1, seg.y2));
+			netMax[0] = std::max(netMax[0], std::max(seg.x1, seg.x2));
+			netMax[1] = std::max(netMax[1], std::max(seg.y1, seg.y2));
+
+			segmentCellKeys(seg.x1, seg.y1, seg.x2, seg.y2, cellKeys);
+			for (size_t key_cnt = 0; key_cnt < cellKeys.size(); key_cnt++)
+				segmentCells[cellKeys[key_cnt]].push_back(seg_id);
+		}
+	}
+
+	Real px, py;
+	transform(placement, desc.interior[0], desc.interior[1], px, py);
+	placedInterior[face*2] = px;
+	placedInterior[face*2+1] = py;
+	interiorCells[cellKey(cellCoord(px), cellCoord(py))].push_back(face);
+}
+
+/**
+ * Reset overlap grid for a new net.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Unfolder<Real>::startNet()
+{
+	segments.clear();
+	stamps.clear();
+	segmentCells.clear();
+	interiorCells.clear();
+	netFaces.clear();
+	stamp = 0;
+	netMin[0] = netMin[1] = INFINITY;
+	netMax[0] = netMax[1] = -INFINITY;
+}
+
+/**
+ * \return Key identifying grid cell in hash maps.
+ */
+template <typename Real>
+uint64_t Unfolder<Real>::cellKey(int64_t ix, int64_t iy) const
+{
+	return ((uint64_t)(uint32_t)ix << 32) | (uint32_t)iy;
+}
+
+/**
+ * Find grid cells a segment passes through. Walks the columns the segment
+ *  spans and takes the rows covered within each, so long diagonal edges do
+ *  not visit every cell of their bounding box.
+ *
+ * \param x1 Start of segment.
+ * \param y1
+ * \param x2 End of segment.
+ * \param y2
+ * \param[out] keys Keys of cells segment passes through.
+ *
+ * \return None.
+ */
+template <typename Real>
+void Unfolder<Real>::segmentCellKeys(Real x1, Real y1, Real x2, Real y2,
+	std::vector<uint64_t>& keys) const
+{
+	keys.clear();
+
+	if (x1 > x2)
+	{
+		std::swap(x1, x2);
+		std::swap(y1, y2);
+	}
+
+	int64_t first_ix = cellCoord(x1);
+	int64_t last_ix = cellCoord(x2);
+	Real slope = (x2 > x1) ? (y2 - y1) / (x2 - x1) : 0;
+
+	for (int64_t ix = first_ix; ix <= last_ix; ix++)
+	{
+		// Part of segment within this column
+		Real col_x1 = std::max(x1, (Real)ix * cellSize);
+		Real col_x2 = std::min(x2, (Real)(ix + 1) * cellSize);
+		Real col_y1 = (ix == first_ix) ? y1 : y1 + (col_x1 - x1) * slope;
+		Real col_y2 = (ix == last_ix) ? y2 : y1 + (col_x2 - x1) * slope;
+
+		int64_t first_iy = cellCoord(std::min(col_y1, col_y2));
+		int64_t last_iy = cellCoord(std::max(col_y1, col_y2));
+
+		for (int64_t iy = first_iy; iy <= last_iy; iy++)
+			keys.push_back(cellKey(ix, iy));
+	}
+}
+
+/**
+ * \return Index of grid row or column containing coordinate.
+ */
+template <typename Real>
+int64_t Unfolder<Real>::cellCoord(Real value) const
+{
+	return (int64_t)floor(value / cellSize);
+}
+
+template class Unfolder<float>;
+template class Unfolder<double>;
@@ -0,0 +1,145 @@
+/**
+ * \file unfold.h
+ * \brief Flattens connected groups of planar faces into non-overlapping 2D
+ *	nets.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _UNFOLD_
+#define _UNFOLD_
+
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+
+/**
+ * Unfolds faces given in coordinates of Real, which is Real or double, so
+ *  that double precision models are overlap checked at full precision.
+ */
+template <typename Real>
+class Unfolder
+{
+public:
+	static const uint32_t NO_FACE = 0xFFFFFFFF; //!< Marks open edges.
+
+	/**
+	 * Description of a face to be unfolded. Each face is given in 2D
+	 *  coordinates within its own plane.
+	 */
+	struct Face
+	{
+		std::vector<std::vector<Real> > points; //!< x, y pairs of each
+			//!< border loop. Loop 0 is the outer border, the rest
+			//!< are holes. Loops must be counter clockwise (outer)
+			//!< consistently across faces.
+		std::vector<std::vector<uint32_t> > vertexIds; //!< Id of 3D
+			//!< vertex at each point, used to match shared edges.
+		std::vector<std::vector<uint32_t> > neighbors; //!< Face on other
+			//!< side of edge from point n to n+1, or NO_FACE.
+		Real interior[2]; //!< A point strictly inside the face.
+		Real area; //!< Area of face, used to pick net seeds.
+	};
+
+	/**
+	 * Where a face ended up.
+	 */
+	struct Placement
+	{
+		uint32_t net; //!< Net face is part of.
+		uint32_t parent; //!< Face this was unfolded from, NO_FACE if
+			//!< face is the root of its net.
+		Real cosAngle; //!< Rotation from face coordinates to net.
+		Real sinAngle;
+		Real x; //!< Translation from face coordinates to net.
+		Real y;
+	};
+
+	Unfolder();
+
+	void unfold(const std::vector<Face>& faces);
+
+	const std::vector<Placement>& getPlacements() const;
+	uint32_t getNetCount() const;
+	bool isFold(uint32_t face, uint32_t loop, uint32_t edge) const;
+
+	static void transform(const Placement& placement, Real x, Real y,
+		Real& outX, Real& outY);
+
+private:
+	/**
+	 * Border edge of a face placed in the current net.
+	 */
+	struct Segment
+	{
+		Real x1;
+		Real y1;
+		Real x2;
+		Real y2;
+	};
+
+	/**
+	 * Location of a directed border edge, for matching shared edges.
+	 */
+	struct EdgeRef
+	{
+		uint64_t key; //!< Start vertex id in upper 32 bits, end in lower.
+		uint32_t face;
+		uint32_t loop;
+		uint32_t edge;
+
+		bool operator<(const EdgeRef& rhs) const
+		{
+			return key < rhs.key;
+		}
+	};
+
+	bool findEdge(uint32_t from, uint32_t to, uint32_t face,
+		EdgeRef& ref) const;
+	bool overlaps(uint32_t face, const Placement& placement,
+		uint32_t hingeLoop, uint32_t hingeEdge);
+	void place(uint32_t face, const Placement& placement);
+	void startNet();
+
+	uint64_t cellKey(int64_t ix, int64_t iy) const;
+	int64_t cellCoord(Real value) const;
+	void segmentCellKeys(Real x1, Real y1, Real x2, Real y2,
+		std::vector<uint64_t>& keys) const;
+
+	const std::vector<Face>* faces; //!< Faces being unfolded.
+
+	std::vector<Placement> placements; //!< Placement of each face.
+
+	std::vector<std::vector<std::vector<uint8_t> > > folds; //!< Per
+		//!< face, loop and edge. Set for edges that are folds rather
+		//!< than cuts.
+
+	std::vector<EdgeRef> edgeRefs; //!< Every border edge sorted by key.
+
+	uint32_t netCount; //!< Number of nets made.
+
+	Real cellSize; //!< Size of uniform grid cells.
+
+	std::vector<Segment> segments; //!< Edges placed in current net.
+
+	std::unordered_map<uint64_t, std::vector<uint32_t> > segmentCells;
+		//!< Indices into segments of edges overlapping each grid cell.
+
+	std::unordered_map<uint64_t, std::vector<uint32_t> > interiorCells;
+		//!< Faces in current net whose interior point is in each cell.
+
+	std::vector<uint32_t> netFaces; //!< Faces placed in current net.
+
+	std::vector<Real> placedInterior; //!< Interior point of each face in
+		//!< net coordinates, x, y pairs.
+
+	std::vector<uint32_t> stamps; //!< Per segment, query that last saw
+		//!< it. Avoids testing segments in multiple cells twice.
+	uint32_t stamp; //!< Current query.
+
+	Real netMin[2]; //!< Bounding box of current net.
+	Real netMax[2];
+
+	std::vector<uint64_t> cellKeys; //!< Scratch list of grid cells.
+};
+
+#endif /* _UNFOLD_ */
@@ -0,0 +1,268 @@
+/**
+ * \file weld.cpp
+ * \brief Concurrent hash table for welding identical vertices found by
+ *	multiple threads.
+ * \author Gregory Gluszek.
+ */
+
+#include "weld.h"
+#include "parallel.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdexcept>
+#include <string>
+
+#define WELD_THREAD_MIN 65536 //!< Minimum triangles per thread before welding
+	//!< is split across threads.
+
+/**
+ * Constructor. The table never grows, so it is sized to hold every vertex
+ *  slot at a load factor of at most three quarters.
+ *
+ * \param[in] triArrays Coordinates of vertices that will be inserted. Must 
+ *	stay valid for the life of the table.
+ * \param numTriangles Number of triangles in triArrays.
+ */
+WeldTable::WeldTable(const TriangleArrays& triArrays, uint32_t numTriangles)
+: triArrays(triArrays)
+, entries()
+{
+	size_t size = 16;
+
+	while (size < 4 * (size_t)numTriangles)
+		size *= 2;
+
+	// Value initialization zeroes every entry
+	std::vector<std::atomic<uint32_t> >(size).swap(entries);
+}
+
+/**
+ * \return True if the vertices at two slots have equal coordinates.
+ */
+bool WeldTable::equal(uint32_t lhs, uint32_t rhs) const
+{
+	uint32_t lhs_tri = lhs / 3, lhs_vtx = lhs % 3;
+	uint32_t rhs_tri = rhs / 3, rhs_vtx = rhs % 3;
+
+	// A slot always matches itself, even with NaN coordinates, so find()
+	//  works for them. Like the single threaded weld, NaN vertices never 
+	//  match each other and each get their own id.
+	if (lhs == rhs)
+		return true;
+
+	return triArrays.x[lhs_vtx][lhs_tri] == triArrays.x[rhs_vtx][rhs_tri] &&
+		triArrays.y[lhs_vtx][lhs_tri] == triArrays.y[rhs_vtx][rhs_tri] &&
+		triArrays.z[lhs_vtx][lhs_tri] == triArrays.z[rhs_vtx][rhs_tri];
+}
+
+/**
+ * Add a vertex to the table if no equal vertex is in it yet. If there is
+ *  one, the entry is lowered to this slot if it is lower. Safe to call from
+ *  multiple threads at once.
+ *
+ * \param slot Slot of vertex to add.
+ * \param hash Hash of vertex coordinates, as given by hashVertex().
+ * \param[inout] probes Incremented by the number of entries looked at.
+ *
+ * \return Lowest slot of an equal vertex inserted so far. Only final once
+ *	all inserts are done, see find().
+ */
+uint32_t WeldTable::insertOrGet(uint32_t slot, uint32_t hash, 
+	uint64_t& probes)
+{
+	size_t mask = entries.size() - 1;
+	size_t entry = hash & mask;
+	uint32_t value = slot + 1;
+
+	// Linear probe until we find vertex or claim an empty entry
+	while (true)
+	{
+		uint32_t current = entries[entry].load(std::memory_order_acquire);
+
+		probes++;
+
+		// On failure current is updated to what the winner stored
+		if (!current && entries[entry].compare_exchange_strong(current, 
+			value, std::memory_order_acq_rel))
+			return slot;
+
+		if (equal(current - 1, slot))
+		{
+			// Entries only ever move to lower slots of the same vertex
+			while (value < current && 
+				!entries[entry].compare_exchange_weak(current, value,
+				std::memory_order_acq_rel))
+				;
+
+			return std::min(current, value) - 1;
+		}
+
+		entry = (entry + 1) & mask;
+	}
+}
+
+/**
+ * Look up a vertex that has been inserted. Only call once all inserts are
+ *  done.
+ *
+ * \param slot Slot of vertex to look up.
+ * \param hash Hash of vertex coordinates.
+ *
+ * \return Lowest slot of all vertices equal to this one.
+ */
+uint32_t WeldTable::find(uint32_t slot, uint32_t hash) const
+{
+	size_t mask = entries.size() - 1;
+	size_t entry = hash & mask;
+
+	while (true)
+	{
+		uint32_t current = entries[entry].load(std::memory_order_relaxed);
+
+		if (!current)
+		{
+			fprintf(stderr, "Vertex slot %u missing from weld table.\n",
+				slot);
+			//TODO: add proper exception throwing
+			exit(EXIT_FAILURE);
+		}
+
+		if (equal(current - 1, slot))
+			return current - 1;
+
+		entry = (entry + 1) & mask;
+	}
+}
+
+/**
+ * \param numThreads Maximum number of threads to weld with. 0 means use one
+ *	per core.
+ * \param numTriangles Number of triangles to weld.
+ *
+ * \return Number of threads worth welding numTriangles with. Below two, the
+ *	single threaded weld in ModelConv is faster than weldVertices().
+ */
+unsigned getWeldThreadCount(unsigned numThreads, uint32_t numTriangles)
+{
+	return (unsigned)std::min((size_t)getThreadCount(numThreads),
+		std::max((size_t)1, (size_t)numTriangles / WELD_THREAD_MIN));
+}
+
+/**
+ * Weld vertices with equal coordinates on multiple threads. Vertex ids are
+ *  given out in order of each vertex's first slot, which is the order a
+ *  single thread adding vertices triangle by triangle gives them out in, so
+ *  ids do not depend on the number of threads.
+ *
+ * \param[in] triArrays Triangle data.
+ * \param[in] hashes Hash of each vertex, 3 runs of numTriangles in vertex
+ *	order like triArrays.
+ * \param numTriangles Number of triangles.
+ * \param numThreads Number of threads to weld with. 0 means use one per 
+ *	core. See getWeldThreadCount().
+ * \param[out] vertexIds Id of vertex at each slot. Must hold 3 * 
+ *	numTriangles elements.
+ * \param[out] firstSlots Lowest slot of each vertex id.
+ * \param[inout] probes Incremented by number of table entries looked at.
+ *
+ * \return Number of distinct vertices.
+ *
+ * \throw std::length_error if there are too many vertex slots to number.
+ */
+uint32_t weldVertices(const TriangleArrays& triArrays, const uint32_t* hashes,
+	uint32_t numTriangles, unsigned numThreads, uint32_t* vertexIds,
+	std::vector<uint32_t>& firstSlots, uint64_t& probes)
+{
+	if ((uint64_t)3 * numTriangles >= UINT32_MAX)
+		throw std::length_error("Too many triangles (" + 
+			std::to_string(numTriangles) + ") to weld");
+
+	numThreads = std::max(1u, std::min(getThreadCount(numThreads), 
+		numTriangles));
+
+	WeldTable table(triArrays, numTriangles);
+	// Lowest slot of vertex at each slot
+	std::vector<uint32_t> first_slot(3 * (size_t)numTriangles);
+	// Probes, then vertices first seen, in each thread's range
+	std::vector<uint64_t> thread_counts(numThreads, 0);
+	uint32_t chunk = (numTriangles + numThreads - 1) / numThreads;
+	const uint32_t* vtx_hashes[3] = {hashes, hashes + numTriangles, 
+		hashes + 2 * (size_t)numTriangles};
+
+	runThreads(numThreads, [&](unsigned thread)
+	{
+		uint32_t begin = std::min(numTriangles, thread * chunk);
+		uint32_t end = std::min(numTriangles, begin + chunk);
+		uint64_t thread_probes = 0;
+
+		for (uint32_t tri = begin; tri < end; tri++)
+			for (uint32_t vtx = 0; vtx < 3; vtx++)
+				table.insertOrGet(3*tri + vtx, vtx_hashes[vtx][tri],
+					thread_probes);
+
+		thread_counts[thread] = thread_probes;
+	});
+
+	for (unsigned thread = 0; thread < numThreads; thread++)
+		probes += thread_counts[thread];
+
+	runThreads(numThreads, [&](unsigned thread)
+	{
+		uint32_t begin = std::min(numTriangles, thread * chunk);
+		uint32_t end = std::min(numTriangles, begin + chunk);
+		uint64_t num_first = 0;
+
+		for (uint32_t slot = 3*begin; slot < 3*end; slot++)
+		{
+			first_slot[slot] = table.find(slot, 
+				vtx_hashes[slot % 3][slot / 3]);
+			num_first += (first_slot[slot] == slot);
+		}
+
+		thread_counts[thread] = num_first;
+	});
+
+	// Turn counts into first id given out by each thread
+	uint64_t num_vertices = 0;
+
+	for (unsigned thread = 0; thread < numThreads; thread++)
+	{
+		uint64_t num_first = thread_counts[thread];
+
+		thread_counts[thread] = num_vertices;
+		num_vertices += num_first;
+	}
+
+	firstSlots.resize(num_vertices);
+
+	runThreads(numThreads, [&](unsigned thread)
+	{
+		uint32_t begin = std::min(numTriangles, thread * chunk);
+		uint32_t end = std::min(numTriangles, begin + chunk);
+		uint32_t id = (uint32_t)thread_counts[thread];
+
+		for (uint32_t slot = 3*begin; slot < 3*end; slot++)
+		{
+			if (first_slot[slot] == slot)
+			{
+				vertexIds[slot] = id;
+				firstSlots[id++] = slot;
+			}
+		}
+	});
+
+	// First slots may be in another thread's range, so wait until all of
+	//  them have ids
+	runThreads(numThreads, [&](unsigned thread)
+	{
+		uint32_t begin = std::min(numTriangles, thread * chunk);
+		uint32_t end = std::min(numTriangles, begin + chunk);
+
+		for (uint32_t slot = 3*begin; slot < 3*end; slot++)
+			if (first_slot[slot] != slot)
+				vertexIds[slot] = vertexIds[first_slot[slot]];
+	});
+
+	return (uint32_t)num_vertices;
+}
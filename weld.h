@@ -0,0 +1,50 @@
+/**
+ * \file weld.h
+ * \brief Concurrent hash table for welding identical vertices found by
+ *	multiple threads.
+ * \author Gregory Gluszek.
+ */
+
+#ifndef _WELD_
+#define _WELD_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <vector>
+
+#include "kernels.h"
+
+/**
+ * Open addressing hash table of vertices that threads can insert into at
+ *  the same time without locking. Vertices are identified by slot, which is
+ *  3 * triangle + vertex number within triangle, and compared by the
+ *  coordinates at that slot. Each entry keeps the lowest slot of all the
+ *  equal vertices inserted, so once inserting is finished the result does not
+ *  depend on the order or number of threads inserts were made from.
+ */
+class WeldTable
+{
+public:
+	WeldTable(const TriangleArrays& triArrays, uint32_t numTriangles);
+
+	uint32_t insertOrGet(uint32_t slot, uint32_t hash, uint64_t& probes);
+	uint32_t find(uint32_t slot, uint32_t hash) const;
+
+private:
+	bool equal(uint32_t lhs, uint32_t rhs) const;
+
+	TriangleArrays triArrays; //!< Coordinates vertices are compared by.
+
+	std::vector<std::atomic<uint32_t> > entries; //!< Lowest slot + 1 of
+		//!< each distinct vertex. 0 indicates an empty entry. Size is
+		//!< a power of two.
+};
+
+unsigned getWeldThreadCount(unsigned numThreads, uint32_t numTriangles);
+
+uint32_t weldVertices(const TriangleArrays& triArrays, const uint32_t* hashes,
+	uint32_t numTriangles, unsigned numThreads, uint32_t* vertexIds,
+	std::vector<uint32_t>& firstSlots, uint64_t& probes);
+
+#endif /* _WELD_ */